@@ -30,8 +30,14 @@ struct emad_op_tlv {
 #define MAX_ENTRIES	10240
 
 const volatile bool targ_ms = false;
+const volatile bool targ_ll = false;
 const volatile __u16 targ_reg_id = 0;
 
+/* Index of the histograms that are being filled. User space flips it at
+ * the end of each interval and reads the other ones.
+ */
+volatile __u32 hist_index = 0;
+
 struct {
 	__uint(type, BPF_MAP_TYPE_HASH);
 	__uint(max_entries, MAX_ENTRIES);
@@ -41,12 +47,40 @@ struct {
 
 static struct hist initial_hist;
 
-struct {
-	__uint(type, BPF_MAP_TYPE_HASH);
-	__uint(max_entries, MAX_ENTRIES);
+/* Each CPU updates its own copy of the histogram, which spares the
+ * atomic operations on a shared cache line. User space sums the copies.
+ */
+struct hists_map {
+	__uint(type, BPF_MAP_TYPE_PERCPU_HASH);
+	__uint(max_entries, MAX_HISTS);
 	__type(key, struct hist_key);
 	__type(value, struct hist);
-} hists SEC(".maps");
+} hists0 SEC(".maps"), hists1 SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY_OF_MAPS);
+	__uint(max_entries, 2);
+	__uint(key_size, sizeof(u32));
+	__uint(value_size, sizeof(u32));
+	__array(values, struct hists_map);
+} hists SEC(".maps") = {
+	.values = { &hists0, &hists1 },
+};
+
+/* The top LL_SUB_BITS bits of the value below its leading one select the
+ * sub-bucket within the power of two.
+ */
+static __always_inline u64 ll_slot(u64 v)
+{
+	u64 e;
+
+	if (v < LL_SUB_SLOTS)
+		return v;
+
+	e = log2l(v);
+	return ((e - LL_SUB_BITS + 1) << LL_SUB_BITS) +
+	       ((v >> (e - LL_SUB_BITS)) & (LL_SUB_SLOTS - 1));
+}
 
 SEC("tracepoint/devlink/devlink_hwmsg")
 int handle__devlink_hwmsg(struct trace_event_raw_devlink_hwmsg *ctx)
@@ -56,7 +90,8 @@ int handle__devlink_hwmsg(struct trace_event_raw_devlink_hwmsg *ctx)
 	struct emad_op_tlv *op_tlv;
 	struct hist_key hkey;
 	struct hist *histp;
-	u32 buf_off;
+	u32 buf_off, index;
+	void *hmap;
 	s64 delta;
 
 	buf_off = ctx->__data_loc_buf & 0xFFFF;
@@ -85,10 +120,15 @@ int handle__devlink_hwmsg(struct trace_event_raw_devlink_hwmsg *ctx)
 	hkey.write = ((op_tlv->r_method & EMAD_OP_TLV_METHOD_MASK) ==
 		      EMAD_OP_TLV_METHOD_WRITE);
 
-	histp = bpf_map_lookup_elem(&hists, &hkey);
+	index = hist_index;
+	hmap = bpf_map_lookup_elem(&hists, &index);
+	if (!hmap)
+		goto cleanup;
+
+	histp = bpf_map_lookup_elem(hmap, &hkey);
 	if (!histp) {
-		bpf_map_update_elem(&hists, &hkey, &initial_hist, BPF_ANY);
-		histp = bpf_map_lookup_elem(&hists, &hkey);
+		bpf_map_update_elem(hmap, &hkey, &initial_hist, BPF_ANY);
+		histp = bpf_map_lookup_elem(hmap, &hkey);
 		if (!histp)
 			goto cleanup;
 	}
@@ -101,9 +141,18 @@ int handle__devlink_hwmsg(struct trace_event_raw_devlink_hwmsg *ctx)
 	slot = log2l(delta);
 	if (slot >= MAX_SLOTS)
 		slot = MAX_SLOTS - 1;
-	__sync_fetch_and_add(&histp->slots[slot], 1);
-	__sync_fetch_and_add(&histp->latency, delta);
-	__sync_fetch_and_add(&histp->count, 1);
+	histp->slots[slot]++;
+	histp->latency += delta;
+	histp->count++;
+	if (delta > histp->max)
+		histp->max = delta;
+
+	if (targ_ll) {
+		slot = ll_slot(delta);
+		if (slot >= MAX_LL_SLOTS)
+			slot = MAX_LL_SLOTS - 1;
+		histp->ll_slots[slot]++;
+	}
 
 cleanup:
 	bpf_map_delete_elem(&start, &op_tlv->tid);
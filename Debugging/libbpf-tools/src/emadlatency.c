@@ -4,6 +4,7 @@
 #include <argp.h>
 #include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
 #include <unistd.h>
 #include <bpf/bpf.h>
@@ -11,6 +12,7 @@
 #include <sys/resource.h>
 #include "emadlatency.h"
 #include "emadlatency.skel.h"
+#include "map_helpers.h"
 #include "trace_helpers.h"
 
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof(*(x)))
@@ -22,6 +24,8 @@ static struct env {
 	bool queries;
 	bool writes;
 	bool average;
+	bool percentiles;
+	bool stats;
 	bool verbose;
 	time_t interval;
 	int times;
@@ -37,7 +41,7 @@ const char *argp_program_bug_address = "<mlxsw@nvidia.com>";
 const char argp_program_doc[] =
 "Summarize EMAD latency as a histogram.\n"
 "\n"
-"USAGE: emadlatency [--help] [-T] [-m] [-r] [-q] [-w] [-a] [-v] [interval] [count]\n"
+"USAGE: emadlatency [--help] [-T] [-m] [-r] [-q] [-w] [-a] [-P] [-s] [-v] [interval] [count]\n"
 "\n"
 "EXAMPLES:\n"
 "    emadlatency             # summarize EMAD latency as a histogram\n"
@@ -46,7 +50,9 @@ const char argp_program_doc[] =
 "    emadlatency -r SFN      # measure latency of SFN EMADs only\n"
 "    emadlatency -q          # only show latency of EMAD queries\n"
 "    emadlatency -w          # only show latency of EMAD writes\n"
-"    emadlatency -a          # also show average latency\n";
+"    emadlatency -a          # also show average latency\n"
+"    emadlatency -P          # also show latency percentiles\n"
+"    emadlatency -s 1        # also show per-event tracing overhead\n";
 
 static const struct argp_option opts[] = {
 	{ "milliseconds", 'm', NULL, 0, "Millisecond histogram" },
@@ -55,6 +61,8 @@ static const struct argp_option opts[] = {
 	{ "query", 'q', NULL, 0, "Show latency of EMAD queries only" },
 	{ "write", 'w', NULL, 0, "Show latency of EMAD writes only" },
 	{ "average", 'a', NULL, 0, "Also show average latency" },
+	{ "percentiles", 'P', NULL, 0, "Also show latency percentiles" },
+	{ "stats", 's', NULL, 0, "Also show BPF program run time per event" },
 	{ "verbose", 'v', NULL, 0, "Verbose debug output" },
 	{},
 };
@@ -251,6 +259,12 @@ static error_t parse_arg(int key, char *arg, struct argp_state *state)
 	case 'a':
 		env.average = true;
 		break;
+	case 'P':
+		env.percentiles = true;
+		break;
+	case 's':
+		env.stats = true;
+		break;
 	case 'v':
 		env.verbose = true;
 		break;
@@ -294,55 +308,187 @@ static void sig_handler(int sig)
 	exiting = true;
 }
 
+static void sum_hists(struct hist *hist, const struct hist *percpu,
+		      int ncpus)
+{
+	int cpu, i;
+
+	memset(hist, 0, sizeof(*hist));
+	for (cpu = 0; cpu < ncpus; cpu++) {
+		for (i = 0; i < MAX_SLOTS; i++)
+			hist->slots[i] += percpu[cpu].slots[i];
+		for (i = 0; i < MAX_LL_SLOTS; i++)
+			hist->ll_slots[i] += percpu[cpu].ll_slots[i];
+		hist->latency += percpu[cpu].latency;
+		hist->count += percpu[cpu].count;
+		if (percpu[cpu].max > hist->max)
+			hist->max = percpu[cpu].max;
+	}
+}
+
+/* Highest value that falls into a log-linear bucket. This is the inverse
+ * of ll_slot() in the BPF program.
+ */
+static __u64 ll_slot_high(int slot)
+{
+	int e, sub;
+
+	if (slot < LL_SUB_SLOTS)
+		return slot;
+
+	e = slot / LL_SUB_SLOTS + LL_SUB_BITS - 1;
+	sub = slot % LL_SUB_SLOTS;
+	return ((__u64) (LL_SUB_SLOTS + sub + 1) << (e - LL_SUB_BITS)) - 1;
+}
+
+/* Report the upper bound of the bucket in which the percentile falls,
+ * but never more than the largest value seen.
+ */
+static __u64 hist_percentile(const struct hist *hist, __u64 total,
+			     int permille)
+{
+	__u64 target, cum = 0;
+	int i;
+
+	target = (total * permille + 999) / 1000;
+	if (!target)
+		target = 1;
+
+	for (i = 0; i < MAX_LL_SLOTS; i++) {
+		cum += hist->ll_slots[i];
+		if (cum >= target)
+			break;
+	}
+	if (i == MAX_LL_SLOTS || ll_slot_high(i) > hist->max)
+		return hist->max;
+	return ll_slot_high(i);
+}
+
+static void print_percentiles(const struct hist *hist, const char *units)
+{
+	__u64 total = 0;
+	int i;
+
+	for (i = 0; i < MAX_LL_SLOTS; i++)
+		total += hist->ll_slots[i];
+	if (!total)
+		return;
+
+	printf(" p50 = %llu %s, p90 = %llu %s, p99 = %llu %s, p99.9 = %llu %s, max = %llu %s\n",
+	       hist_percentile(hist, total, 500), units,
+	       hist_percentile(hist, total, 900), units,
+	       hist_percentile(hist, total, 990), units,
+	       hist_percentile(hist, total, 999), units,
+	       hist->max, units);
+}
+
+/* Make the programs fill the other histograms and return the FD of the
+ * map that they filled until now. Updating a map-in-map waits for the
+ * programs that are running to finish, so re-installing the retired map
+ * makes sure that no program still uses it once the update returns.
+ */
+static int swap_hists(struct emadlatency_bpf *obj)
+{
+	__u32 index = obj->bss->hist_index;
+	int err, fd;
+
+	fd = bpf_map__fd(index ? obj->maps.hists1 : obj->maps.hists0);
+	obj->bss->hist_index = !index;
+
+	err = bpf_map_update_elem(bpf_map__fd(obj->maps.hists), &index, &fd,
+				  BPF_ANY);
+	if (err < 0) {
+		fprintf(stderr, "Failed to swap histograms: %d\n", err);
+		return -1;
+	}
+
+	return fd;
+}
+
 static
-int print_log2_hists(struct bpf_map *hists)
+int print_log2_hists(struct emadlatency_bpf *obj, struct hist_key *keys,
+		     struct hist *percpu, int ncpus)
 {
 	const char *units = env.milliseconds ? "msecs" : "usecs";
-	struct hist_key lookup_key, next_key;
-	int err, fd = bpf_map__fd(hists);
+	struct hist_key invalid_key = {};
+	__u32 i, count = MAX_HISTS;
 	struct hist hist;
+	int err, fd;
+
+	fd = swap_hists(obj);
+	if (fd < 0)
+		return -1;
+
+	err = dump_hash(fd, keys, sizeof(*keys), percpu,
+			sizeof(*percpu) * ncpus, &count, &invalid_key);
+	if (err < 0) {
+		fprintf(stderr, "Failed to dump hists: %d\n", -errno);
+		return -1;
+	}
 
-	memset(&lookup_key, 0, sizeof(lookup_key));
-	while (!bpf_map_get_next_key(fd, &lookup_key, &next_key)) {
+	for (i = 0; i < count; i++) {
 		const char *reg_name;
 
-		err = bpf_map_lookup_elem(fd, &next_key, &hist);
-		if (err < 0) {
-			fprintf(stderr, "Failed to lookup hist: %d\n", err);
-			return -1;
-		}
-		if ((env.writes && env.writes != next_key.write) ||
-		    (env.queries && env.queries != !next_key.write)) {
-			lookup_key = next_key;
+		if ((env.writes && env.writes != keys[i].write) ||
+		    (env.queries && env.queries != !keys[i].write))
 			continue;
-		}
 
-		reg_name = name_find_by_reg_id(next_key.reg_id);
+		sum_hists(&hist, &percpu[i * ncpus], ncpus);
+		reg_name = name_find_by_reg_id(keys[i].reg_id);
 		printf("Register %s = %s (0x%x)\n",
-		       next_key.write ? "write" : "query",
+		       keys[i].write ? "write" : "query",
 		       reg_name ? reg_name : "Unknown register",
-		       next_key.reg_id);
+		       keys[i].reg_id);
 		if (env.average)
 			printf(" average = %llu %s, total = %llu %s, count = %llu\n",
 			       hist.latency / hist.count, units, hist.latency,
 			       units, hist.count);
+		if (env.percentiles)
+			print_percentiles(&hist, units);
 		print_log2_hist(hist.slots, MAX_SLOTS, units);
-		lookup_key = next_key;
 	}
 
-	memset(&lookup_key, 0, sizeof(lookup_key));
-	while (!bpf_map_get_next_key(fd, &lookup_key, &next_key)) {
-		err = bpf_map_delete_elem(fd, &next_key);
+	/* The programs no longer write to this map, so this does not race. */
+	for (i = 0; i < count; i++) {
+		err = bpf_map_delete_elem(fd, &keys[i]);
 		if (err < 0) {
 			fprintf(stderr, "Failed to cleanup hist : %d\n", err);
 			return -1;
 		}
-		lookup_key = next_key;
 	}
 
 	return 0;
 }
 
+/* Print how many times the program ran since the last call and how long
+ * it took on average, as the kernel accounts it with run-time statistics
+ * enabled. This is what "bpftool prog profile" and "bpftool prog show"
+ * report as run_cnt and run_time_ns.
+ */
+static int print_prog_stats(struct bpf_program *prog)
+{
+	static __u64 prev_cnt, prev_time_ns;
+	struct bpf_prog_info info = {};
+	__u32 len = sizeof(info);
+	__u64 cnt, time_ns;
+	int err;
+
+	err = bpf_obj_get_info_by_fd(bpf_program__fd(prog), &info, &len);
+	if (err) {
+		fprintf(stderr, "Failed to get program info: %d\n", err);
+		return -1;
+	}
+
+	cnt = info.run_cnt - prev_cnt;
+	time_ns = info.run_time_ns - prev_time_ns;
+	prev_cnt = info.run_cnt;
+	prev_time_ns = info.run_time_ns;
+
+	printf("Program runs = %llu, average = %llu nsecs\n", cnt,
+	       cnt ? time_ns / cnt : 0);
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
 	static const struct argp argp = {
@@ -351,6 +497,9 @@ int main(int argc, char **argv)
 		.doc = argp_program_doc,
 	};
 	struct emadlatency_bpf *obj;
+	int ncpus, stats_fd = -1;
+	struct hist_key *keys;
+	struct hist *percpu;
 	struct tm *tm;
 	char ts[32];
 	time_t t;
@@ -368,14 +517,30 @@ int main(int argc, char **argv)
 		return 1;
 	}
 
+	ncpus = libbpf_num_possible_cpus();
+	if (ncpus < 0) {
+		fprintf(stderr, "Failed to get number of CPUs: %d\n", ncpus);
+		return 1;
+	}
+
+	keys = calloc(MAX_HISTS, sizeof(*keys));
+	percpu = calloc(MAX_HISTS * ncpus, sizeof(*percpu));
+	if (!keys || !percpu) {
+		fprintf(stderr, "Failed to allocate histograms\n");
+		err = 1;
+		goto free_percpu;
+	}
+
 	obj = emadlatency_bpf__open();
 	if (!obj) {
 		fprintf(stderr, "Failed to open BPF object\n");
-		return 1;
+		err = 1;
+		goto free_percpu;
 	}
 
 	/* Initialize global data (filtering options). */
 	obj->rodata->targ_ms = env.milliseconds;
+	obj->rodata->targ_ll = env.percentiles;
 	obj->rodata->targ_reg_id = env.reg_id;
 
 	err = emadlatency_bpf__load(obj);
@@ -390,6 +555,17 @@ int main(int argc, char **argv)
 		goto cleanup;
 	}
 
+	/* Run-time statistics stay enabled for as long as the FD is open. */
+	if (env.stats) {
+		stats_fd = bpf_enable_stats(BPF_STATS_RUN_TIME);
+		if (stats_fd < 0) {
+			fprintf(stderr, "Failed to enable BPF run-time statistics: %d\n",
+				stats_fd);
+			err = stats_fd;
+			goto cleanup;
+		}
+	}
+
 	signal(SIGINT, sig_handler);
 	signal(SIGTERM, sig_handler);
 
@@ -407,7 +583,13 @@ int main(int argc, char **argv)
 			printf("%-8s\n", ts);
 		}
 
-		err = print_log2_hists(obj->maps.hists);
+		if (env.stats) {
+			err = print_prog_stats(obj->progs.handle__devlink_hwmsg);
+			if (err)
+				break;
+		}
+
+		err = print_log2_hists(obj, keys, percpu, ncpus);
 		if (err)
 			break;
 
@@ -416,7 +598,12 @@ int main(int argc, char **argv)
 	}
 
 cleanup:
+	if (stats_fd >= 0)
+		close(stats_fd);
 	emadlatency_bpf__destroy(obj);
+free_percpu:
+	free(percpu);
+	free(keys);
 
 	return err != 0;
 }
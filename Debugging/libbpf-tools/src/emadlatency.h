@@ -3,6 +3,15 @@
 #define __EMADLATENCY_H
 
 #define MAX_SLOTS	27
+#define MAX_HISTS	256
+
+/* Log-linear buckets split each power of two into LL_SUB_SLOTS linear
+ * sub-buckets, which bounds the relative error of a percentile by
+ * 1 / LL_SUB_SLOTS. Values below LL_SUB_SLOTS get a bucket each.
+ */
+#define LL_SUB_BITS	4
+#define LL_SUB_SLOTS	(1 << LL_SUB_BITS)
+#define MAX_LL_SLOTS	((MAX_SLOTS - LL_SUB_BITS + 1) * LL_SUB_SLOTS)
 
 struct hist_key {
 	__u16 reg_id;
@@ -11,8 +20,10 @@ struct hist_key {
 
 struct hist {
 	__u32 slots[MAX_SLOTS];
+	__u32 ll_slots[MAX_LL_SLOTS];
 	__u64 latency;
 	__u64 count;
+	__u64 max;
 };
 
 #endif /* __EMADLATENCY_H */
@@ -85,15 +85,14 @@ int dump_hash(int map_fd,
 	if (batch_map_ops) {
 		err = dump_hash_batch(map_fd, keys, key_size,
 				      values, value_size, count);
-		if (err) {
-			if (errno != EINVAL) {
-				return -1;
-
-				/* assume that batch operations are not
-				 * supported and try non-batch mode */
-				batch_map_ops = false;
-			}
-		}
+		if (!err)
+			return 0;
+		if (errno != EINVAL)
+			return -1;
+
+		/* assume that batch operations are not
+		 * supported and try non-batch mode */
+		batch_map_ops = false;
 	}
 
 	if (!invalid_key) {
@@ -0,0 +1,320 @@
+/* SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0 */
+#ifndef __LIBRESMON_H
+#define __LIBRESMON_H
+
+/* libresmon, the client library of resmon. This is its API, the rest of
+ * resmon.h is internal to the daemon and the resmon tool.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <json-c/json_object.h>
+
+/* A-TCAM regions have up to 16 eRPs, and a rule delta is up to 8 bits wide. */
+#define RESMON_STAT_ERP_COUNT		16
+#define RESMON_STAT_DELTA_WIDTH_COUNT	9
+
+/* Prefix lengths 0-32 for IPv4 and 0-128 for IPv6. */
+#define RESMON_STAT_PREFIX_LEN_COUNT	129
+
+/* Free runs of KVD linear are binned by powers of two. */
+#define RESMON_STAT_KVDL_RUN_HIST_COUNT	21
+
+/* Durations and batch sizes are binned by powers of two, which covers
+ * nanoseconds up to about 18 minutes.
+ */
+#define RESMON_STAT_HIST_COUNT		40
+
+/* Table entries are binned by age into eight bins from 10 seconds to 64
+ * days, and one for the older ones.
+ */
+#define RESMON_STAT_AGE_BIN_COUNT	9
+
+/* resmon-jrpc.c */
+
+struct resmon_jrpc_counter {
+	const char *descr;
+	int64_t value;
+	uint64_t capacity;
+	bool has_forecast;
+	double ew_slope;
+	double window_slope;
+	/* Seconds until the capacity runs out, or -1 if usage is not
+	 * growing.
+	 */
+	int64_t exhaustion_s;
+};
+
+struct resmon_jrpc_reg {
+	const char *name;
+	int64_t id;
+	int64_t processed;
+	int64_t ignored;
+	int64_t errors;
+	int64_t time_ns;
+};
+
+struct resmon_jrpc_acl_region {
+	const char *device;
+	int64_t region_id;
+	const char *tcam_region_info;
+	int64_t capacity;
+	int64_t used;
+	int64_t kvd_slots;
+	int64_t resizes;
+	int64_t erps[RESMON_STAT_ERP_COUNT];
+	int64_t deltas[RESMON_STAT_DELTA_WIDTH_COUNT];
+};
+
+struct resmon_jrpc_lpm_vr {
+	const char *device;
+	const char *protocol;
+	int64_t virtual_router;
+	int64_t routes;
+	int64_t prefix_lens[RESMON_STAT_PREFIX_LEN_COUNT];
+	size_t num_prefix_lens;
+};
+
+struct resmon_jrpc_churn {
+	const char *name;
+	int64_t adds;
+	int64_t deletes;
+	int64_t redundant;
+	double add_rate;
+	double delete_rate;
+	double redundant_rate;
+};
+struct resmon_jrpc_churn_key {
+	const char *device;
+	const char *table;
+	const char *key;
+	int64_t redundant;
+};
+
+struct resmon_jrpc_burst_reg {
+	const char *name;
+	int64_t emads;
+};
+struct resmon_jrpc_burst {
+	const char *device;
+	int64_t start_ns;
+	int64_t duration_ns;
+	int64_t emads;
+	int64_t peak_rate;
+	bool ongoing;
+	struct resmon_jrpc_burst_reg *regs;
+	size_t num_regs;
+};
+void resmon_jrpc_bursts_free(struct resmon_jrpc_burst *bursts,
+			     size_t num_bursts);
+
+enum resmon_jrpc_plan_type {
+	RESMON_JRPC_PLAN_ROUTE,
+	RESMON_JRPC_PLAN_NEIGH,
+	RESMON_JRPC_PLAN_ACL,
+	RESMON_JRPC_PLAN_ACTSET,
+	RESMON_JRPC_PLAN_ADJ,
+	RESMON_JRPC_PLAN_FDB,
+};
+struct resmon_jrpc_plan_item {
+	enum resmon_jrpc_plan_type type;
+	int64_t count;
+	bool ipv6;
+	int64_t prefix_len;
+	int64_t key_blocks;
+};
+const char *resmon_jrpc_plan_type_name(enum resmon_jrpc_plan_type type);
+struct resmon_jrpc_plan_counter {
+	const char *descr;
+	int64_t value;
+	int64_t needed;
+};
+struct resmon_jrpc_plan {
+	struct resmon_jrpc_plan_counter *counters;
+	size_t num_counters;
+	int64_t capacity;
+	int64_t used;
+	int64_t needed;
+	int64_t headroom;
+	bool fits;
+};
+
+struct resmon_jrpc_kvdl {
+	const char *device;
+	int64_t size;
+	int64_t used;
+	int64_t free;
+	int64_t largest_free_run;
+	int64_t free_runs;
+	double fragmentation;
+	int64_t run_hist[RESMON_STAT_KVDL_RUN_HIST_COUNT];
+};
+
+struct resmon_jrpc_hist {
+	int64_t count;
+	int64_t sum;
+	int64_t max;
+	int64_t bins[RESMON_STAT_HIST_COUNT];
+};
+struct resmon_jrpc_health_reg {
+	const char *name;
+	struct resmon_jrpc_hist time_ns;
+};
+struct resmon_jrpc_health {
+	int64_t uptime_ns;
+	int64_t cpu_ns;
+	double cpu_load;
+	int64_t process_cpu_ns;
+	struct resmon_jrpc_hist delay_ns;
+	struct resmon_jrpc_hist batch;
+	struct resmon_jrpc_health_reg *regs;
+	size_t num_regs;
+};
+
+struct resmon_jrpc_error_class {
+	const char *name;
+	const char *descr;
+	int64_t count;
+};
+struct resmon_jrpc_error_sample {
+	const char *device;
+	const char *cls;
+	int64_t time_ns;
+	const char *message;
+	/* Of the EMAD. The hexdump may be of only the start of it. */
+	int64_t len;
+	const char *emad;
+};
+struct resmon_jrpc_errors {
+	struct resmon_jrpc_error_class *classes;
+	size_t num_classes;
+	struct resmon_jrpc_error_sample *samples;
+	size_t num_samples;
+	int64_t logged;
+	int64_t suppressed;
+};
+
+struct resmon_jrpc_recon_resource {
+	const char *device;
+	const char *name;
+	const char *devlink_name;
+	bool present;
+	int64_t checks;
+	int64_t failures;
+	int64_t occupancy;
+	int64_t accounted;
+	int64_t drift;
+	bool flagged;
+	int64_t rebases;
+	int64_t rebase_offset;
+};
+struct resmon_jrpc_recon {
+	int64_t interval_ns;
+	int64_t threshold;
+	int64_t persist;
+	const char *action;
+	struct resmon_jrpc_recon_resource *resources;
+	size_t num_resources;
+};
+
+struct resmon_jrpc_ages_table {
+	const char *device;
+	const char *name;
+	int64_t entries;
+	int64_t counts[RESMON_STAT_AGE_BIN_COUNT];
+};
+struct resmon_jrpc_aged_key {
+	const char *device;
+	const char *table;
+	const char *key;
+	int64_t age_s;
+	int64_t idle_s;
+	int64_t redundant;
+};
+struct resmon_jrpc_ages {
+	int64_t max_age_s[RESMON_STAT_AGE_BIN_COUNT - 1];
+	struct resmon_jrpc_ages_table *tables;
+	size_t num_tables;
+	struct resmon_jrpc_aged_key *oldest;
+	size_t num_oldest;
+};
+
+struct resmon_jrpc_emads {
+	int64_t emads;
+	int64_t errors;
+	const char *error;
+};
+
+/* resmon-client.c */
+
+/* A connection to the daemon that stays open across calls. The typed calls
+ * fill in the result structures of resmon-jrpc.c. Strings in them point
+ * into the response, which the client keeps until its next call or until
+ * it is closed. Arrays in them are allocated and the caller frees them.
+ */
+struct resmon_client;
+
+/* How long a call waits for its response unless the client is told
+ * otherwise.
+ */
+#define RESMON_CLIENT_TIMEOUT_MS	10000
+
+struct resmon_client *resmon_client_open(const char *sockdir, char **error);
+int resmon_client_set_timeout(struct resmon_client *client,
+			      unsigned int timeout_ms, char **error);
+void resmon_client_close(struct resmon_client *client);
+int resmon_client_call(struct resmon_client *client, const char *method,
+		       struct json_object *params_obj, int fd,
+		       enum json_type result_type,
+		       struct json_object **result, char **error);
+
+int resmon_client_ping(struct resmon_client *client, char **error);
+int resmon_client_stop(struct resmon_client *client, bool *stopping,
+		       char **error);
+int resmon_client_emad(struct resmon_client *client, const char *device,
+		       const char *payload, size_t payload_len,
+		       int64_t time_ns, char **error);
+int resmon_client_emads(struct resmon_client *client, const char *device,
+			int fd, struct resmon_jrpc_emads *emads,
+			char **error);
+int resmon_client_stats(struct resmon_client *client, const char *device,
+			bool forecast, struct resmon_jrpc_counter **counters,
+			size_t *num_counters, char **error);
+int resmon_client_regs(struct resmon_client *client, const char *device,
+		       struct resmon_jrpc_reg **regs, size_t *num_regs,
+		       int64_t *unknown, char **error);
+int resmon_client_acl(struct resmon_client *client, const char *device,
+		      struct resmon_jrpc_acl_region **regions,
+		      size_t *num_regions, char **error);
+int resmon_client_lpm(struct resmon_client *client, const char *device,
+		      struct resmon_jrpc_lpm_vr **vrs, size_t *num_vrs,
+		      char **error);
+int resmon_client_churn(struct resmon_client *client, const char *device,
+			int64_t top,
+			struct resmon_jrpc_churn **regs, size_t *num_regs,
+			struct resmon_jrpc_churn **tables, size_t *num_tables,
+			struct resmon_jrpc_churn_key **keys, size_t *num_keys,
+			char **error);
+int resmon_client_bursts(struct resmon_client *client, const char *device,
+			 struct resmon_jrpc_burst **bursts, size_t *num_bursts,
+			 char **error);
+int resmon_client_plan(struct resmon_client *client, const char *device,
+		       const struct resmon_jrpc_plan_item *items,
+		       size_t num_items, struct resmon_jrpc_plan *plan,
+		       char **error);
+int resmon_client_kvdl(struct resmon_client *client, const char *device,
+		       struct resmon_jrpc_kvdl **devs, size_t *num_devs,
+		       char **error);
+int resmon_client_health(struct resmon_client *client,
+			 struct resmon_jrpc_health *health, char **error);
+int resmon_client_errors(struct resmon_client *client, const char *device,
+			 struct resmon_jrpc_errors *errors, char **error);
+int resmon_client_recon(struct resmon_client *client, const char *device,
+			bool check, struct resmon_jrpc_recon *recon,
+			char **error);
+int resmon_client_ages(struct resmon_client *client, const char *device,
+		       const char *table, int64_t top, bool by_idle,
+		       struct resmon_jrpc_ages *ages, char **error);
+
+#endif /* __LIBRESMON_H */
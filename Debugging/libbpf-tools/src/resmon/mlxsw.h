@@ -13,8 +13,6 @@ enum mlxsw_reg_ralxx_protocol {
 	MLXSW_REG_RALXX_PROTOCOL_IPV6,
 };
 
-#define MLXSW_REG_RALUE_ID 0x8013
-
 enum mlxsw_reg_ralue_op {
 	/* Read operation. If entry doesn't exist, the operation fails. */
 	MLXSW_REG_RALUE_OP_QUERY_READ = 0,
@@ -42,8 +40,6 @@ enum mlxsw_reg_ralue_op {
 	MLXSW_REG_RALUE_OP_WRITE_DELETE = 3,
 };
 
-#define MLXSW_REG_PTAR_ID 0x3006
-
 enum mlxsw_reg_ptar_op {
 	/* allocate a TCAM region */
 	MLXSW_REG_PTAR_OP_ALLOC,
@@ -60,8 +56,6 @@ enum mlxsw_reg_ptar_key_type {
 	MLXSW_REG_PTAR_KEY_TYPE_FLEX2 = 0x51, /* Spectrum-2 */
 };
 
-#define MLXSW_REG_PTCE3_ID 0x3027
-
 enum mlxsw_reg_ptce3_op {
 	/* Write operation. Used to write a new entry to the table.
 	 * All R/W fields are relevant for new entry. Activity bit is set
@@ -75,10 +69,39 @@ enum mlxsw_reg_ptce3_op {
 	 MLXSW_REG_PTCE3_OP_QUERY_READ = 0,
 };
 
-#define MLXSW_REG_PEFA_ID 0x300F
-#define MLXSW_REG_IEDR_ID 0x3804
+enum mlxsw_reg_sfd_op {
+	/* Test. Response indicates if each of the records could be
+	 * added to the FDB.
+	 */
+	MLXSW_REG_SFD_OP_WRITE_TEST = 0,
+	/* Add/modify. Aged-out records cannot be added. This command removes
+	 * the learning notification of the {MAC, VID/FID}. Response includes
+	 * the entries that were added to the FDB.
+	 */
+	MLXSW_REG_SFD_OP_WRITE_EDIT = 1,
+	/* Remove record by {MAC, VID/FID}. This command also removes
+	 * the learning notification and aged-out notifications
+	 * of the {MAC, VID/FID}. The response provides current (pre-removal)
+	 * entries as non-aged-out.
+	 */
+	MLXSW_REG_SFD_OP_WRITE_REMOVE = 2,
+};
 
-#define MLXSW_REG_RAUHT_ID 0x8014
+enum mlxsw_reg_ratr_op {
+	/* Read */
+	MLXSW_REG_RATR_OP_QUERY_READ = 0,
+	/* Read and clear activity */
+	MLXSW_REG_RATR_OP_QUERY_READ_CLEAR = 2,
+	/* Write Adjacency entry */
+	MLXSW_REG_RATR_OP_WRITE_WRITE_ENTRY = 1,
+	/* Write Adjacency entry only if the activity is cleared.
+	 * The write may not succeed if the activity is set. There is not
+	 * direct feedback if the write has succeeded or not, however
+	 * the get will reveal the actual entry (SW can compare the get
+	 * response to the set command).
+	 */
+	MLXSW_REG_RATR_OP_WRITE_WRITE_ENTRY_ON_ACTIVITY = 3,
+};
 
 enum mlxsw_reg_rauht_op {
 	/* Read operation */
@@ -1,18 +1,171 @@
 // SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+#include <endian.h>
 #include <errno.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <syslog.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <bpf/bpf.h>
 #include <json-c/json_object.h>
+#define PCAP_DONT_INCLUDE_PCAP_BPF_H
+#include <pcap/pcap.h>
+#include <pcap/dlt.h>
 
 #include "resmon.h"
 #include "resmon.skel.h"
+#include "resmon-bpf.h"
 #include "../trace_helpers.h"
 
+int resmon_back_add_dev(struct resmon_back *back,
+			const char *bus_name, const char *dev_name)
+{
+	struct resmon_dev *devs;
+	struct resmon_dev dev = {};
+
+	dev.bus_name = strdup(bus_name);
+	if (dev.bus_name == NULL)
+		return -1;
+
+	dev.dev_name = strdup(dev_name);
+	if (dev.dev_name == NULL)
+		goto free_bus_name;
+
+	dev.stat = resmon_stat_create(&back->stat_config);
+	if (dev.stat == NULL)
+		goto free_dev_name;
+
+	devs = realloc(back->devs, (back->num_devs + 1) * sizeof(*devs));
+	if (devs == NULL)
+		goto destroy_stat;
+
+	devs[back->num_devs++] = dev;
+	back->devs = devs;
+	return 0;
+
+destroy_stat:
+	resmon_stat_destroy(dev.stat);
+free_dev_name:
+	free(dev.dev_name);
+free_bus_name:
+	free(dev.bus_name);
+	return -1;
+}
+
+void resmon_back_fini_devs(struct resmon_back *back)
+{
+	for (size_t i = 0; i < back->num_devs; i++) {
+		struct resmon_dev *dev = &back->devs[i];
+
+		resmon_stat_destroy(dev->stat);
+		free(dev->dev_name);
+		free(dev->bus_name);
+	}
+	free(back->devs);
+	back->devs = NULL;
+	back->num_devs = 0;
+}
+
+/* Devices are named the same way as in devlink, "bus_name/dev_name". */
+struct resmon_dev *resmon_back_find_dev(struct resmon_back *back,
+					const char *name)
+{
+	for (size_t i = 0; i < back->num_devs; i++) {
+		struct resmon_dev *dev = &back->devs[i];
+		size_t bus_name_len = strlen(dev->bus_name);
+
+		if (strncmp(name, dev->bus_name, bus_name_len) == 0 &&
+		    name[bus_name_len] == '/' &&
+		    strcmp(name + bus_name_len + 1, dev->dev_name) == 0)
+			return dev;
+	}
+
+	return NULL;
+}
+
+uint64_t resmon_back_clock_ns(clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* EMAD processing errors are logged at up to 10 messages a second, in
+ * bursts of up to 100. The "errors" method has all of them counted.
+ */
+#define RESMON_BACK_LOG_RATE		10
+#define RESMON_BACK_LOG_BURST		100
+
+static void resmon_back_base_init(struct resmon_back *back)
+{
+	uint64_t now_ns = resmon_back_clock_ns(CLOCK_MONOTONIC);
+
+	back->health = (struct resmon_back_health) {
+		.start_ns = now_ns,
+	};
+	back->log = (struct resmon_back_log) {
+		.tokens = RESMON_BACK_LOG_BURST,
+		.last_ns = now_ns,
+	};
+}
+
+__attribute__((format(printf, 2, 3)))
+static void resmon_back_log_error(struct resmon_back *back,
+				  const char *fmt, ...)
+{
+	struct resmon_back_log *log = &back->log;
+	uint64_t now_ns = resmon_back_clock_ns(CLOCK_MONOTONIC);
+	va_list ap;
+
+	log->tokens += (now_ns - log->last_ns) * RESMON_BACK_LOG_RATE / 1e9;
+	if (log->tokens > RESMON_BACK_LOG_BURST)
+		log->tokens = RESMON_BACK_LOG_BURST;
+	log->last_ns = now_ns;
+
+	if (log->tokens < 1) {
+		log->suppressed++;
+		log->unreported++;
+		return;
+	}
+	log->tokens--;
+	log->logged++;
+
+	if (log->unreported != 0) {
+		syslog(LOG_WARNING, "%" PRIu64 " EMAD processing errors were not logged",
+		       log->unreported);
+		log->unreported = 0;
+	}
+
+	va_start(ap, fmt);
+	vsyslog(LOG_ERR, fmt, ap);
+	va_end(ap);
+}
+
+/* The daemon is single-threaded, so the CPU time of the thread between
+ * cpu_ns and now went to processing the EMADs.
+ */
+static void resmon_back_health_account(struct resmon_back *back,
+				       uint64_t emads, uint64_t cpu_ns)
+{
+	struct resmon_back_health *health = &back->health;
+
+	if (emads == 0)
+		return;
+
+	resmon_stat_hist_record(&health->batch, emads);
+	health->cpu_ns += resmon_back_clock_ns(CLOCK_THREAD_CPUTIME_ID) -
+			  cpu_ns;
+}
+
 struct resmon_back_hw {
 	struct resmon_back base;
 	struct resmon_bpf *bpf_obj;
 	struct ring_buffer *ringbuf;
-	struct resmon_stat *stat;
 };
 
 static int resmon_back_libbpf_print_fn(enum libbpf_print_level level,
@@ -42,19 +195,103 @@ static int resmon_back_libbpf_print_fn(enum libbpf_print_level level,
 
 static int resmon_back_hw_rb_sample_cb(void *ctx, void *data, size_t len)
 {
+	const struct resmon_bpf_rec_hdr *hdr = data;
 	struct resmon_back_hw *back = ctx;
+	struct resmon_dev *dev;
+	uint64_t now_ns;
+	char *error;
+	int rc;
+
+	if (len < sizeof(*hdr) || hdr->dev_index >= back->base.num_devs) {
+		syslog(LOG_ERR, "Malformed ring buffer record");
+		return 0;
+	}
+	dev = &back->base.devs[hdr->dev_index];
+
+	rc = resmon_reg_process_emad(dev->stat, data + sizeof(*hdr),
+				     len - sizeof(*hdr), &error);
+	if (rc != 0) {
+		resmon_back_log_error(&back->base,
+				      "%s/%s: EMAD processing error: %s",
+				      dev->bus_name, dev->dev_name, error);
+		free(error);
+	}
+
+	/* Both times are CLOCK_MONOTONIC. */
+	now_ns = resmon_back_clock_ns(CLOCK_MONOTONIC);
+	resmon_stat_hist_record(&back->base.health.delay_ns,
+				now_ns > hdr->ktime_ns ?
+				now_ns - hdr->ktime_ns : 0);
+	return 0;
+}
+
+static int resmon_back_hw_add_dev_cb(const char *bus_name,
+				     const char *dev_name, void *priv)
+{
+	struct resmon_back_hw *back = priv;
+
+	if (back->base.num_devs >= RESMON_BPF_MAX_DEVS ||
+	    strlen(bus_name) >= RESMON_BPF_BUS_NAME_LEN ||
+	    strlen(dev_name) >= RESMON_BPF_DEV_NAME_LEN) {
+		fprintf(stderr, "Skipping devlink instance %s/%s\n",
+			bus_name, dev_name);
+		return 0;
+	}
+
+	return resmon_back_add_dev(&back->base, bus_name, dev_name);
+}
+
+static int resmon_back_hw_init_devs(struct resmon_back_hw *back)
+{
+	int fd = bpf_map__fd(back->bpf_obj->maps.devs);
+	uint64_t kvdl_size;
 	char *error;
 	int rc;
 
-	rc = resmon_reg_process_emad(back->stat, data, len, &error);
+	rc = resmon_dl_get_devs(resmon_back_hw_add_dev_cb, back, &error);
 	if (rc != 0) {
-		syslog(LOG_ERR, "EMAD processing error: %s", error);
+		fprintf(stderr, "Failed to list devlink instances: %s\n",
+			error);
 		free(error);
+		return -1;
+	}
+
+	for (__u32 i = 0; i < back->base.num_devs; i++) {
+		struct resmon_dev *dev = &back->base.devs[i];
+		struct resmon_bpf_dev_key key = {};
+
+		strncpy(key.bus_name, dev->bus_name, sizeof(key.bus_name) - 1);
+		strncpy(key.dev_name, dev->dev_name, sizeof(key.dev_name) - 1);
+		rc = bpf_map_update_elem(fd, &key, &i, BPF_ANY);
+		if (rc != 0) {
+			fprintf(stderr, "Failed to register %s/%s with BPF\n",
+				dev->bus_name, dev->dev_name);
+			return -1;
+		}
+		if (env.verbosity > 0)
+			fprintf(stderr, "Tracking %s/%s\n",
+				dev->bus_name, dev->dev_name);
+
+		/* Without the size, the KVD linear space that resmon tracks
+		 * ends with the highest slot in use.
+		 */
+		rc = resmon_dl_get_kvdl_size(dev->bus_name, dev->dev_name,
+					     &kvdl_size, &error);
+		if (rc != 0) {
+			free(error);
+			continue;
+		}
+		rc = resmon_stat_kvdl_size_set(dev->stat, kvdl_size);
+		if (rc != 0)
+			fprintf(stderr, "Not tracking KVD linear of %s/%s in full\n",
+				dev->bus_name, dev->dev_name);
 	}
+
 	return 0;
 }
 
-static struct resmon_back *resmon_back_hw_init(void)
+static struct resmon_back *
+resmon_back_hw_init(const struct resmon_back_args *args)
 {
 	struct resmon_back_hw *back;
 	struct ring_buffer *ringbuf;
@@ -64,6 +301,11 @@ static struct resmon_back *resmon_back_hw_init(void)
 	back = malloc(sizeof(*back));
 	if (back == NULL)
 		return NULL;
+	*back = (struct resmon_back_hw) {
+		.base.cls = &resmon_back_cls_hw,
+		.base.stat_config = args->stat_config,
+	};
+	resmon_back_base_init(&back->base);
 
 	libbpf_set_print(resmon_back_libbpf_print_fn);
 
@@ -84,11 +326,16 @@ static struct resmon_back *resmon_back_hw_init(void)
 		fprintf(stderr, "Failed to load the resmon BPF object\n");
 		goto destroy_bpf;
 	}
+	back->bpf_obj = bpf_obj;
+
+	rc = resmon_back_hw_init_devs(back);
+	if (rc != 0)
+		goto fini_devs;
 
 	ringbuf = ring_buffer__new(bpf_map__fd(bpf_obj->maps.ringbuf),
 				   resmon_back_hw_rb_sample_cb, back, NULL);
 	if (ringbuf == NULL)
-		goto destroy_bpf;
+		goto fini_devs;
 
 	rc = resmon_bpf__attach(bpf_obj);
 	if (rc != 0) {
@@ -96,16 +343,13 @@ static struct resmon_back *resmon_back_hw_init(void)
 		goto free_ringbuf;
 	}
 
-	*back = (struct resmon_back_hw) {
-		.base.cls = &resmon_back_cls_hw,
-		.bpf_obj = bpf_obj,
-		.ringbuf = ringbuf,
-	};
-
+	back->ringbuf = ringbuf;
 	return &back->base;
 
 free_ringbuf:
 	ring_buffer__free(ringbuf);
+fini_devs:
+	resmon_back_fini_devs(&back->base);
 destroy_bpf:
 	resmon_bpf__destroy(bpf_obj);
 free_back:
@@ -120,15 +364,29 @@ static void resmon_back_hw_fini(struct resmon_back *base)
 
 	resmon_bpf__detach(back->bpf_obj);
 	ring_buffer__free(back->ringbuf);
+	resmon_back_fini_devs(&back->base);
 	resmon_bpf__destroy(back->bpf_obj);
 	free(back);
 }
 
 static int resmon_back_hw_get_capacity(struct resmon_back *back,
+				       const struct resmon_dev *dev,
 				       uint64_t *capacity,
 				       char **error)
 {
-	return resmon_dl_get_kvd_size(capacity, error);
+	return resmon_dl_get_kvd_size(dev->bus_name, dev->dev_name,
+				      capacity, error);
+}
+
+static int resmon_back_hw_get_occupancy(struct resmon_back *back,
+					const struct resmon_dev *dev,
+					enum resmon_recon_resource resource,
+					bool *present, uint64_t *occupancy,
+					char **error)
+{
+	return resmon_dl_get_resource_occ(dev->bus_name, dev->dev_name,
+				resmon_recon_resource_devlink_name(resource),
+				present, occupancy, error);
 }
 
 static int resmon_back_hw_pollfd(struct resmon_back *base)
@@ -139,18 +397,19 @@ static int resmon_back_hw_pollfd(struct resmon_back *base)
 	return ring_buffer__epoll_fd(back->ringbuf);
 }
 
-static int resmon_back_hw_activity(struct resmon_back *base,
-				   struct resmon_stat *stat)
+static int resmon_back_hw_activity(struct resmon_back *base)
 {
 	struct resmon_back_hw *back =
 		container_of(base, struct resmon_back_hw, base);
+	uint64_t cpu_ns;
 	int n;
 
-	back->stat = stat;
+	cpu_ns = resmon_back_clock_ns(CLOCK_THREAD_CPUTIME_ID);
 	n = ring_buffer__consume(back->ringbuf);
-	back->stat = NULL;
 	if (n < 0)
 		return -1;
+
+	resmon_back_health_account(base, n, cpu_ns);
 	return 0;
 }
 
@@ -158,17 +417,28 @@ const struct resmon_back_cls resmon_back_cls_hw = {
 	.init = resmon_back_hw_init,
 	.fini = resmon_back_hw_fini,
 	.get_capacity = resmon_back_hw_get_capacity,
+	.get_occupancy = resmon_back_hw_get_occupancy,
 	.pollfd = resmon_back_hw_pollfd,
 	.activity = resmon_back_hw_activity,
 };
 
+/* Occupancy that a test set for a resource of a mock device. */
+struct resmon_back_mock_occ {
+	bool present;
+	uint64_t occupancy;
+};
+
 struct resmon_back_mock {
 	struct resmon_back base;
+	/* num_devs x resmon_recon_resource_count */
+	struct resmon_back_mock_occ *occs;
 };
 
-static struct resmon_back *resmon_back_mock_init(void)
+static struct resmon_back *
+resmon_back_mock_init(const struct resmon_back_args *args)
 {
 	struct resmon_back_mock *back;
+	int rc;
 
 	back = malloc(sizeof(*back));
 	if (back == NULL)
@@ -176,17 +446,51 @@ static struct resmon_back *resmon_back_mock_init(void)
 
 	*back = (struct resmon_back_mock) {
 		.base.cls = &resmon_back_cls_mock,
+		.base.stat_config = args->stat_config,
 	};
+	resmon_back_base_init(&back->base);
+
+	for (unsigned int i = 0; i < args->num_devs; i++) {
+		char dev_name[16];
+
+		snprintf(dev_name, sizeof(dev_name), "%u", i);
+		rc = resmon_back_add_dev(&back->base, "mock", dev_name);
+		if (rc != 0)
+			goto fini_devs;
+
+		if (args->mock_kvdl_size != 0) {
+			rc = resmon_stat_kvdl_size_set(back->base.devs[i].stat,
+						       args->mock_kvdl_size);
+			if (rc != 0)
+				goto fini_devs;
+		}
+	}
+
+	back->occs = calloc(args->num_devs * resmon_recon_resource_count,
+			    sizeof(*back->occs));
+	if (back->occs == NULL)
+		goto fini_devs;
 
 	return &back->base;
+
+fini_devs:
+	resmon_back_fini_devs(&back->base);
+	free(back);
+	return NULL;
 }
 
-static void resmon_back_mock_fini(struct resmon_back *back)
+static void resmon_back_mock_fini(struct resmon_back *base)
 {
+	struct resmon_back_mock *back =
+		container_of(base, struct resmon_back_mock, base);
+
+	free(back->occs);
+	resmon_back_fini_devs(base);
 	free(back);
 }
 
 static int resmon_back_mock_get_capacity(struct resmon_back *back,
+					 const struct resmon_dev *dev,
 					 uint64_t *capacity,
 					 char **error)
 {
@@ -194,44 +498,150 @@ static int resmon_back_mock_get_capacity(struct resmon_back *back,
 	return 0;
 }
 
-static int resmon_back_mock_emad_decode_payload(uint8_t *dec, const char *enc,
-						size_t dec_len)
+static struct resmon_back_mock_occ *
+resmon_back_mock_occ(struct resmon_back_mock *back,
+		     const struct resmon_dev *dev,
+		     enum resmon_recon_resource resource)
 {
-	for (size_t i = 0; i < dec_len; i++) {
-		char buf[3] = {enc[2 * i], enc[2 * i + 1], '\0'};
-		char *endptr = NULL;
-		long byte;
+	size_t dev_index = dev - back->base.devs;
 
-		errno = 0;
-		byte = strtol(buf, &endptr, 16);
-		if (errno || *endptr != '\0')
-			return -1;
-		dec[i] = byte;
-	}
+	return &back->occs[dev_index * resmon_recon_resource_count + resource];
+}
+
+/* Until a test sets it, devlink reports no occupancy for the resource. */
+static int resmon_back_mock_get_occupancy(struct resmon_back *base,
+					  const struct resmon_dev *dev,
+					  enum resmon_recon_resource resource,
+					  bool *present, uint64_t *occupancy,
+					  char **error)
+{
+	struct resmon_back_mock *back =
+		container_of(base, struct resmon_back_mock, base);
+	struct resmon_back_mock_occ *occ;
+
+	occ = resmon_back_mock_occ(back, dev, resource);
+	*present = occ->present;
+	*occupancy = occ->occupancy;
 	return 0;
 }
 
-static void resmon_back_mock_handle_emad(struct resmon_stat *stat,
+static void resmon_back_mock_handle_occupancy(struct resmon_back *base,
+					      struct resmon_sock *peer,
+					      struct json_object *params_obj,
+					      struct json_object *id)
+{
+	struct resmon_back_mock *back =
+		container_of(base, struct resmon_back_mock, base);
+	enum resmon_recon_resource resource;
+	struct resmon_back_mock_occ *occ;
+	const char *resource_name;
+	struct json_object *obj;
+	struct resmon_dev *dev;
+	const char *device;
+	int64_t occupancy;
+	char *error;
+	int rc;
+
+	rc = resmon_jrpc_dissect_params_occupancy(params_obj, &device,
+						  &resource_name, &occupancy,
+						  &error);
+	if (rc != 0) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		return;
+	}
+
+	if (device != NULL) {
+		dev = resmon_back_find_dev(base, device);
+		if (dev == NULL) {
+			resmon_d_respond_invalid_params(peer, id,
+							"Unknown device");
+			return;
+		}
+	} else {
+		dev = &base->devs[0];
+	}
+
+	if (resmon_recon_resource_parse(resource_name, &resource)) {
+		resmon_d_respond_invalid_params(peer, id, "Unknown resource");
+		return;
+	}
+
+	/* A negative occupancy makes the resource unreported again. */
+	occ = resmon_back_mock_occ(back, dev, resource);
+	*occ = (struct resmon_back_mock_occ) {
+		.present = occupancy >= 0,
+		.occupancy = occupancy >= 0 ? occupancy : 0,
+	};
+
+	obj = resmon_jrpc_new_object(id);
+	if (obj == NULL)
+		return;
+	if (json_object_object_add(obj, "result", NULL))
+		goto put_obj;
+
+	resmon_jrpc_send(peer, obj);
+	json_object_put(obj);
+	return;
+
+put_obj:
+	json_object_put(obj);
+	resmon_d_respond_memerr(peer, id);
+}
+
+static void resmon_back_mock_handle_emad(struct resmon_back *back,
 					 struct resmon_sock *peer,
 					 struct json_object *params_obj,
 					 struct json_object *id)
 {
 	struct json_object *obj;
+	struct resmon_dev *dev;
 	size_t dec_payload_len;
 	uint8_t *dec_payload;
 	const char *payload;
+	const char *device;
 	size_t payload_len;
+	int64_t time_ns;
+	uint64_t cpu_ns;
 	char *error;
 	int rc;
 
 	rc = resmon_jrpc_dissect_params_emad(params_obj, &payload,
-					     &payload_len, &error);
+					     &payload_len, &device, &time_ns,
+					     &error);
 	if (rc != 0) {
 		resmon_d_respond_invalid_params(peer, id, error);
 		free(error);
 		return;
 	}
 
+	if (device != NULL) {
+		dev = resmon_back_find_dev(back, device);
+		if (dev == NULL) {
+			resmon_d_respond_invalid_params(peer, id,
+							"Unknown device");
+			return;
+		}
+	} else {
+		dev = &back->devs[0];
+	}
+
+	/* Under the manual clock, the EMAD may move the time forward. This
+	 * lets tests drive the time-based statistics deterministically.
+	 */
+	if (time_ns >= 0) {
+		if (!back->stat_config.manual_clock) {
+			resmon_d_respond_invalid_params(peer, id,
+				    "EMAD time requires the manual clock");
+			return;
+		}
+		if (resmon_stat_clock_set(dev->stat, time_ns)) {
+			resmon_d_respond_invalid_params(peer, id,
+				    "EMAD time goes backwards");
+			return;
+		}
+	}
+
 	if (payload_len % 2 != 0) {
 		resmon_d_respond_invalid_params(peer, id,
 				    "EMAD payload has an odd length");
@@ -243,16 +653,17 @@ static void resmon_back_mock_handle_emad(struct resmon_stat *stat,
 	if (dec_payload == NULL)
 		goto err_respond_memerr;
 
-	rc = resmon_back_mock_emad_decode_payload(dec_payload, payload,
-						  dec_payload_len);
+	rc = resmon_jrpc_decode_hex(dec_payload, payload, payload_len);
 	if (rc != 0) {
 		resmon_d_respond_invalid_params(peer, id,
 				    "EMAD payload expected in hexdump format");
 		goto out;
 	}
 
-
-	rc = resmon_reg_process_emad(stat, dec_payload, dec_payload_len, &error);
+	cpu_ns = resmon_back_clock_ns(CLOCK_THREAD_CPUTIME_ID);
+	rc = resmon_reg_process_emad(dev->stat, dec_payload, dec_payload_len,
+				     &error);
+	resmon_back_health_account(back, 1, cpu_ns);
 	if (rc != 0) {
 		resmon_d_respond_error(peer, id, resmon_jrpc_e_reg_process_emad,
 				       "EMAD processing error", error);
@@ -280,15 +691,274 @@ err_respond_memerr:
 	resmon_d_respond_memerr(peer, id);
 }
 
+struct resmon_back_mock_inject {
+	struct resmon_dev *dev;
+	uint64_t emads;
+	uint64_t errors;
+	char *error;	/* Of the first EMAD that failed. */
+};
+
+static void resmon_back_mock_inject(struct resmon_back_mock_inject *inject,
+				    const uint8_t *buf, size_t len)
+{
+	char *error;
+	int rc;
+
+	inject->emads++;
+	rc = resmon_reg_process_emad(inject->dev->stat, buf, len, &error);
+	if (rc == 0)
+		return;
+
+	inject->errors++;
+	if (inject->error == NULL)
+		inject->error = error;
+	else
+		free(error);
+}
+
+static int
+resmon_back_mock_inject_array(struct resmon_back_mock_inject *inject,
+			      struct json_object *emads_obj,
+			      enum resmon_jrpc_encoding encoding,
+			      char **error)
+{
+	size_t num_emads = json_object_array_length(emads_obj);
+	size_t buf_size = 0;
+	uint8_t *buf = NULL;
+	int rc = 0;
+
+	for (size_t i = 0; i < num_emads; i++) {
+		struct json_object *emad_obj =
+			json_object_array_get_idx(emads_obj, i);
+		size_t enc_len;
+		const char *enc;
+		size_t dec_len;
+
+		if (json_object_get_type(emad_obj) != json_type_string) {
+			resmon_fmterr(error, "EMAD %zd is not a string", i);
+			rc = -1;
+			break;
+		}
+		enc = json_object_get_string(emad_obj);
+		enc_len = json_object_get_string_len(emad_obj);
+
+		/* Enough for either encoding. */
+		if (enc_len > buf_size) {
+			uint8_t *new_buf = realloc(buf, enc_len);
+
+			if (new_buf == NULL) {
+				resmon_fmterr(error, "Couldn't allocate EMAD buffer");
+				rc = -1;
+				break;
+			}
+			buf = new_buf;
+			buf_size = enc_len;
+		}
+
+		switch (encoding) {
+		case RESMON_JRPC_ENCODING_BASE64:
+			rc = resmon_jrpc_decode_base64(buf, &dec_len,
+						       enc, enc_len);
+			break;
+		case RESMON_JRPC_ENCODING_HEX:
+			dec_len = enc_len / 2;
+			rc = resmon_jrpc_decode_hex(buf, enc, enc_len);
+			break;
+		}
+		if (rc != 0) {
+			resmon_fmterr(error, "EMAD %zd is not valid %s", i,
+				      encoding == RESMON_JRPC_ENCODING_HEX ?
+				      "hex" : "base64");
+			break;
+		}
+
+		resmon_back_mock_inject(inject, buf, dec_len);
+	}
+
+	free(buf);
+	return rc;
+}
+
+/* A passed file holds EMADs back to back, each prefixed with its length as
+ * a 32-bit big-endian number.
+ */
+static int resmon_back_mock_inject_fd(struct resmon_back_mock_inject *inject,
+				      int fd, char **error)
+{
+	const uint8_t *map;
+	struct stat st;
+	size_t off = 0;
+	uint32_t len;
+	int rc = 0;
+
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+		resmon_fmterr(error, "The passed file is not a regular file");
+		return -1;
+	}
+	if (st.st_size == 0)
+		return 0;
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		resmon_fmterr(error, "Couldn't map the passed file: %m");
+		return -1;
+	}
+	madvise((void *) map, st.st_size, MADV_SEQUENTIAL);
+
+	while (off < st.st_size) {
+		if (st.st_size - off < sizeof(len)) {
+			resmon_fmterr(error, "EMAD record at offset %zd is truncated",
+				      off);
+			rc = -1;
+			break;
+		}
+		memcpy(&len, map + off, sizeof(len));
+		len = be32toh(len);
+		off += sizeof(len);
+
+		if (st.st_size - off < len) {
+			resmon_fmterr(error, "EMAD record at offset %zd is truncated",
+				      off - sizeof(len));
+			rc = -1;
+			break;
+		}
+		resmon_back_mock_inject(inject, map + off, len);
+		off += len;
+	}
+
+	munmap((void *) map, st.st_size);
+	return rc;
+}
+
+static void resmon_back_mock_handle_emads(struct resmon_back *back,
+					  struct resmon_sock *peer,
+					  struct json_object *params_obj,
+					  struct json_object *id)
+{
+	struct resmon_back_mock_inject inject = {};
+	enum resmon_jrpc_encoding encoding;
+	struct json_object *result_obj;
+	struct json_object *emads_obj;
+	struct json_object *obj;
+	const char *device;
+	uint64_t cpu_ns;
+	char *error;
+	int rc;
+
+	/* The EMADs come either in the request, as an array of base64 or hex
+	 * strings, or in a file passed along with it:
+	 *
+	 * {
+	 *     "params": {
+	 *         "device": optional device name,
+	 *         "emads": [ "AQIDBA==", ... ],
+	 *         "encoding": "base64" (default) or "hex"
+	 *     }
+	 * }
+	 *
+	 * An EMAD that fails to process does not stop the rest, one that
+	 * fails to decode fails the request. The response is as follows:
+	 *
+	 * {
+	 *     "id": ...,
+	 *     "result": {
+	 *         "emads": number of EMADs processed,
+	 *         "errors": number of those that failed,
+	 *         "error": message of the first failure, if any
+	 *     }
+	 * }
+	 */
+
+	rc = resmon_jrpc_dissect_params_emads(params_obj, &device, &emads_obj,
+					      &encoding, &error);
+	if (rc != 0) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		return;
+	}
+
+	inject.dev = &back->devs[0];
+	if (device != NULL) {
+		inject.dev = resmon_back_find_dev(back, device);
+		if (inject.dev == NULL) {
+			resmon_d_respond_invalid_params(peer, id,
+							"Unknown device");
+			return;
+		}
+	}
+
+	cpu_ns = resmon_back_clock_ns(CLOCK_THREAD_CPUTIME_ID);
+	if (emads_obj != NULL) {
+		rc = resmon_back_mock_inject_array(&inject, emads_obj,
+						   encoding, &error);
+	} else if (peer->msg_fd >= 0) {
+		rc = resmon_back_mock_inject_fd(&inject, peer->msg_fd, &error);
+	} else {
+		resmon_d_respond_invalid_params(peer, id,
+				    "No EMADs in the request nor a file passed with it");
+		return;
+	}
+	resmon_back_health_account(back, inject.emads, cpu_ns);
+	if (rc != 0) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		goto out;
+	}
+
+	obj = resmon_jrpc_new_object(id);
+	if (obj == NULL)
+		goto out;
+
+	result_obj = json_object_new_object();
+	if (result_obj == NULL)
+		goto put_obj;
+
+	rc = resmon_jrpc_object_add_int(result_obj, "emads", inject.emads);
+	if (rc != 0)
+		goto put_result_obj;
+
+	rc = resmon_jrpc_object_add_int(result_obj, "errors", inject.errors);
+	if (rc != 0)
+		goto put_result_obj;
+
+	if (inject.error != NULL) {
+		rc = resmon_jrpc_object_add_str(result_obj, "error",
+						inject.error);
+		if (rc != 0)
+			goto put_result_obj;
+	}
+
+	rc = json_object_object_add(obj, "result", result_obj);
+	if (rc != 0)
+		goto put_result_obj;
+
+	resmon_jrpc_send(peer, obj);
+	json_object_put(obj);
+	goto out;
+
+put_result_obj:
+	json_object_put(result_obj);
+put_obj:
+	json_object_put(obj);
+	resmon_d_respond_memerr(peer, id);
+out:
+	free(inject.error);
+}
+
 static bool resmon_back_mock_handle_method(struct resmon_back *back,
-					   struct resmon_stat *stat,
 					   const char *method,
 					   struct resmon_sock *peer,
 					   struct json_object *params_obj,
 					   struct json_object *id)
 {
 	if (strcmp(method, "emad") == 0) {
-		resmon_back_mock_handle_emad(stat, peer, params_obj, id);
+		resmon_back_mock_handle_emad(back, peer, params_obj, id);
+		return true;
+	} else if (strcmp(method, "emads") == 0) {
+		resmon_back_mock_handle_emads(back, peer, params_obj, id);
+		return true;
+	} else if (strcmp(method, "occupancy") == 0) {
+		resmon_back_mock_handle_occupancy(back, peer, params_obj, id);
 		return true;
 	} else {
 		return false;
@@ -304,6 +974,399 @@ const struct resmon_back_cls resmon_back_cls_mock = {
 	.init = resmon_back_mock_init,
 	.fini = resmon_back_mock_fini,
 	.get_capacity = resmon_back_mock_get_capacity,
+	.get_occupancy = resmon_back_mock_get_occupancy,
 	.handle_method = resmon_back_mock_handle_method,
 	.pollfd = resmon_back_mock_pollfd,
 };
+
+/* Frames in the capture start with an Ethernet header, which the BPF
+ * program strips before passing the EMAD on.
+ */
+#define RESMON_BACK_REPLAY_ETH_HDR_LEN	0x10
+
+/* Frames replayed in one go when going as fast as possible. In between,
+ * the daemon gets to serve requests.
+ */
+#define RESMON_BACK_REPLAY_BATCH	4096
+
+struct resmon_back_replay {
+	struct resmon_back base;
+	char *file;
+	pcap_t *pcap;
+	int timerfd;
+	double speed;
+	uint64_t kvd_size;
+
+	/* The next frame, when it is not due yet. */
+	struct pcap_pkthdr *hdr;
+	const u_char *data;
+
+	uint64_t first_ts_ns;
+	uint64_t start_ns;
+	struct resmon_back_replay_stats stats;
+};
+
+static uint64_t resmon_back_replay_now_ns(void)
+{
+	return resmon_back_clock_ns(CLOCK_MONOTONIC);
+}
+
+static int resmon_back_replay_arm(struct resmon_back_replay *back,
+				  uint64_t due_ns)
+{
+	struct itimerspec its = {
+		.it_value = {
+			.tv_sec = due_ns / 1000000000ULL,
+			.tv_nsec = due_ns % 1000000000ULL,
+		},
+	};
+
+	return timerfd_settime(back->timerfd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static void resmon_back_replay_frame(struct resmon_back_replay *back,
+				     uint64_t ts_ns)
+{
+	struct resmon_dev *dev = &back->base.devs[0];
+	const uint8_t *buf = back->data;
+	size_t len = back->hdr->caplen;
+	char *error;
+	int rc;
+
+	back->stats.frames++;
+	if (len < RESMON_BACK_REPLAY_ETH_HDR_LEN)
+		return;
+	buf += RESMON_BACK_REPLAY_ETH_HDR_LEN;
+	len -= RESMON_BACK_REPLAY_ETH_HDR_LEN;
+	if (!resmon_reg_emad_is_tracked(buf, len))
+		return;
+
+	/* The statistics follow the time of the capture. Captured frames
+	 * may be slightly out of order, in which case the clock holds.
+	 */
+	resmon_stat_clock_set(dev->stat, ts_ns - back->first_ts_ns);
+
+	back->stats.emads++;
+	back->stats.bytes += len;
+	rc = resmon_reg_process_emad(dev->stat, buf, len, &error);
+	if (rc != 0) {
+		back->stats.errors++;
+		if (env.verbosity > 0)
+			resmon_back_log_error(&back->base,
+					      "%s: frame %" PRIu64 ": EMAD processing error: %s",
+					      back->file, back->stats.frames,
+					      error);
+		free(error);
+	}
+}
+
+/* Replay the frames that are due. Returns 0 and the time when the next
+ * frame is due, or 1 when the capture is over.
+ */
+static int resmon_back_replay_step(struct resmon_back_replay *back,
+				   uint64_t now_ns, uint64_t *pdue_ns)
+{
+	uint64_t ts_ns;
+	int rc;
+
+	for (int i = 0; i < RESMON_BACK_REPLAY_BATCH; i++) {
+		if (back->hdr == NULL) {
+			rc = pcap_next_ex(back->pcap, &back->hdr, &back->data);
+			if (rc == PCAP_ERROR_BREAK)
+				return 1;
+			if (rc < 0) {
+				syslog(LOG_ERR, "%s: Failed to read frame: %s",
+				       back->file, pcap_geterr(back->pcap));
+				return 1;
+			}
+		}
+
+		ts_ns = back->hdr->ts.tv_sec * 1000000000ULL +
+			back->hdr->ts.tv_usec * 1000ULL;
+		if (back->stats.frames == 0)
+			back->first_ts_ns = ts_ns;
+		else if (ts_ns < back->first_ts_ns)
+			ts_ns = back->first_ts_ns;
+
+		if (back->speed != 0) {
+			uint64_t due_ns = back->start_ns +
+				(ts_ns - back->first_ts_ns) / back->speed;
+
+			if (due_ns > now_ns) {
+				*pdue_ns = due_ns;
+				return 0;
+			}
+		}
+
+		resmon_back_replay_frame(back, ts_ns);
+		back->hdr = NULL;
+	}
+
+	*pdue_ns = now_ns;
+	return 0;
+}
+
+static struct resmon_back *
+resmon_back_replay_init(const struct resmon_back_args *args)
+{
+	char errbuf[PCAP_ERRBUF_SIZE];
+	struct resmon_back_replay *back;
+	int rc;
+
+	back = malloc(sizeof(*back));
+	if (back == NULL)
+		return NULL;
+
+	*back = (struct resmon_back_replay) {
+		.base.cls = &resmon_back_cls_replay,
+		.base.stat_config = args->stat_config,
+		.speed = args->replay_speed,
+		.kvd_size = args->replay_kvd_size,
+	};
+	back->base.stat_config.manual_clock = true;
+	resmon_back_base_init(&back->base);
+
+	back->file = strdup(args->replay_file);
+	if (back->file == NULL)
+		goto free_back;
+
+	back->pcap = pcap_open_offline(back->file, errbuf);
+	if (back->pcap == NULL) {
+		fprintf(stderr, "Failed to open %s: %s\n", back->file, errbuf);
+		goto free_file;
+	}
+
+	if (pcap_datalink(back->pcap) != DLT_EN10MB) {
+		fprintf(stderr, "%s is not a capture of EMADs\n", back->file);
+		goto close_pcap;
+	}
+
+	back->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+	if (back->timerfd < 0) {
+		fprintf(stderr, "Failed to create timer: %m\n");
+		goto close_pcap;
+	}
+
+	/* The capture does not say which device the EMADs are from. */
+	rc = resmon_back_add_dev(&back->base, "replay", "0");
+	if (rc != 0)
+		goto close_timerfd;
+
+	back->start_ns = resmon_back_replay_now_ns();
+	rc = resmon_back_replay_arm(back, back->start_ns);
+	if (rc != 0)
+		goto fini_devs;
+
+	return &back->base;
+
+fini_devs:
+	resmon_back_fini_devs(&back->base);
+close_timerfd:
+	close(back->timerfd);
+close_pcap:
+	pcap_close(back->pcap);
+free_file:
+	free(back->file);
+free_back:
+	free(back);
+	return NULL;
+}
+
+static void resmon_back_replay_fini(struct resmon_back *base)
+{
+	struct resmon_back_replay *back =
+		container_of(base, struct resmon_back_replay, base);
+
+	resmon_back_fini_devs(&back->base);
+	close(back->timerfd);
+	pcap_close(back->pcap);
+	free(back->file);
+	free(back);
+}
+
+static int resmon_back_replay_get_capacity(struct resmon_back *base,
+					   const struct resmon_dev *dev,
+					   uint64_t *capacity,
+					   char **error)
+{
+	struct resmon_back_replay *back =
+		container_of(base, struct resmon_back_replay, base);
+
+	if (back->kvd_size == 0) {
+		resmon_fmterr(error, "The KVD size of the captured device is not known, see option kvd-size");
+		return -1;
+	}
+
+	*capacity = back->kvd_size;
+	return 0;
+}
+
+static void resmon_back_replay_handle_replay(struct resmon_back *base,
+					     struct resmon_sock *peer,
+					     struct json_object *params_obj,
+					     struct json_object *id)
+{
+	struct resmon_back_replay *back =
+		container_of(base, struct resmon_back_replay, base);
+	const struct resmon_back_replay_stats *stats = &back->stats;
+	struct json_object *result_obj;
+	struct json_object *obj;
+	char *error;
+	double rate;
+	int rc;
+
+	/* The request has no parameters. The response describes the
+	 * progress of the replay:
+	 *
+	 * {
+	 *     "id": ...,
+	 *     "result": {
+	 *         "file": path to the capture,
+	 *         "done": whether the whole capture was replayed,
+	 *         "frames": frames read from the capture,
+	 *         "emads": EMADs passed to the register decoder,
+	 *         "errors": EMADs that failed to process,
+	 *         "bytes": bytes of EMADs passed to the decoder,
+	 *         "elapsed_ns": wall-clock time of the replay,
+	 *         "rate": EMADs per second of the replay
+	 *     }
+	 * }
+	 */
+
+	rc = resmon_jrpc_dissect_params_empty(params_obj, &error);
+	if (rc) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		return;
+	}
+
+	obj = resmon_jrpc_new_object(id);
+	if (obj == NULL)
+		return;
+
+	result_obj = json_object_new_object();
+	if (result_obj == NULL)
+		goto put_obj;
+
+	rc = resmon_jrpc_object_add_str(result_obj, "file", back->file);
+	if (rc != 0)
+		goto put_result_obj;
+
+	rc = resmon_jrpc_object_add_bool(result_obj, "done", stats->done);
+	if (rc != 0)
+		goto put_result_obj;
+
+	rc = resmon_jrpc_object_add_int(result_obj, "frames", stats->frames);
+	if (rc != 0)
+		goto put_result_obj;
+
+	rc = resmon_jrpc_object_add_int(result_obj, "emads", stats->emads);
+	if (rc != 0)
+		goto put_result_obj;
+
+	rc = resmon_jrpc_object_add_int(result_obj, "errors", stats->errors);
+	if (rc != 0)
+		goto put_result_obj;
+
+	rc = resmon_jrpc_object_add_int(result_obj, "bytes", stats->bytes);
+	if (rc != 0)
+		goto put_result_obj;
+
+	rc = resmon_jrpc_object_add_int(result_obj, "elapsed_ns",
+					stats->elapsed_ns);
+	if (rc != 0)
+		goto put_result_obj;
+
+	rate = stats->elapsed_ns ? stats->emads * 1e9 / stats->elapsed_ns : 0;
+	rc = resmon_jrpc_object_add_double(result_obj, "rate", rate);
+	if (rc != 0)
+		goto put_result_obj;
+
+	rc = json_object_object_add(obj, "result", result_obj);
+	if (rc)
+		goto put_result_obj;
+
+	resmon_jrpc_send(peer, obj);
+	json_object_put(obj);
+	return;
+
+put_result_obj:
+	json_object_put(result_obj);
+put_obj:
+	json_object_put(obj);
+	resmon_d_respond_memerr(peer, id);
+}
+
+static bool resmon_back_replay_handle_method(struct resmon_back *back,
+					     const char *method,
+					     struct resmon_sock *peer,
+					     struct json_object *params_obj,
+					     struct json_object *id)
+{
+	if (strcmp(method, "replay") == 0) {
+		resmon_back_replay_handle_replay(back, peer, params_obj, id);
+		return true;
+	} else {
+		return false;
+	}
+}
+
+static int resmon_back_replay_pollfd(struct resmon_back *base)
+{
+	struct resmon_back_replay *back =
+		container_of(base, struct resmon_back_replay, base);
+
+	return back->timerfd;
+}
+
+static int resmon_back_replay_activity(struct resmon_back *base)
+{
+	struct resmon_back_replay *back =
+		container_of(base, struct resmon_back_replay, base);
+	struct resmon_back_replay_stats *stats = &back->stats;
+	uint64_t emads = stats->emads;
+	uint64_t expirations;
+	uint64_t cpu_ns;
+	uint64_t now_ns;
+	uint64_t due_ns;
+	int rc;
+
+	if (read(back->timerfd, &expirations, sizeof(expirations)) < 0 &&
+	    errno != EAGAIN)
+		return -1;
+	if (stats->done)
+		return 0;
+
+	cpu_ns = resmon_back_clock_ns(CLOCK_THREAD_CPUTIME_ID);
+	now_ns = resmon_back_replay_now_ns();
+	rc = resmon_back_replay_step(back, now_ns, &due_ns);
+	stats->elapsed_ns = resmon_back_replay_now_ns() - back->start_ns;
+	resmon_back_health_account(base, stats->emads - emads, cpu_ns);
+	if (rc == 0)
+		return resmon_back_replay_arm(back, due_ns);
+
+	stats->done = true;
+	syslog(LOG_INFO, "%s: Replayed %" PRIu64 " EMADs (%" PRIu64 " errors) of %" PRIu64 " frames in %" PRIu64 " ms",
+	       back->file, stats->emads, stats->errors, stats->frames,
+	       stats->elapsed_ns / 1000000);
+	return 0;
+}
+
+const struct resmon_back_replay_stats *
+resmon_back_replay_stats(struct resmon_back *base)
+{
+	struct resmon_back_replay *back =
+		container_of(base, struct resmon_back_replay, base);
+
+	assert(base->cls == &resmon_back_cls_replay);
+	return &back->stats;
+}
+
+const struct resmon_back_cls resmon_back_cls_replay = {
+	.init = resmon_back_replay_init,
+	.fini = resmon_back_replay_fini,
+	.get_capacity = resmon_back_replay_get_capacity,
+	.handle_method = resmon_back_replay_handle_method,
+	.pollfd = resmon_back_replay_pollfd,
+	.activity = resmon_back_replay_activity,
+};
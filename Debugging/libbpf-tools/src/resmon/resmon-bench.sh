@@ -0,0 +1,50 @@
+#!/bin/bash
+
+# Benchmark resmon under a synthesized production-scale EMAD stream. The
+# table sizes can be overridden through the environment.
+
+EXIT_STATUS=0
+RESMON="./resmon/resmon --sockdir ."
+PCAP=/tmp/resmon-bench.pcap
+
+LOAD_ARGS="routes4 ${ROUTES4-900000} routes6 ${ROUTES6-150000} \
+	   neighs ${NEIGHS-50000} regions ${REGIONS-64} rules ${RULES-2000} \
+	   actions ${ACTIONS-100000} batch ${BATCH-1000}"
+
+################### Injection in mock mode ###################
+
+$RESMON stop &> /dev/null
+$RESMON start mode mock devices 2 &> /dev/null &
+pid=$!
+sleep 1
+
+echo "Injection in mock mode"
+echo
+$RESMON load $LOAD_ARGS pid $pid
+if [[ $? -ne 0 ]]; then
+	echo "Load generation failed"
+	EXIT_STATUS=1
+fi
+
+$RESMON stop &> /dev/null
+wait $pid
+
+######################### Replay #########################
+
+echo
+echo "Replay of a capture"
+echo
+$RESMON load $LOAD_ARGS pcap $PCAP
+if [[ $? -ne 0 ]]; then
+	echo "Capture generation failed"
+	EXIT_STATUS=1
+fi
+
+$RESMON replay file $PCAP 2>&1 | sed -n '/^Frames/,$p'
+if [[ ${PIPESTATUS[0]} -ne 0 ]]; then
+	echo "Replay failed"
+	EXIT_STATUS=1
+fi
+
+rm -f $PCAP
+exit $EXIT_STATUS
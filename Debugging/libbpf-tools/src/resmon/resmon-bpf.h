@@ -0,0 +1,41 @@
+/* SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0 */
+#ifndef __RESMON_BPF_H
+#define __RESMON_BPF_H
+
+#define RESMON_BPF_MAX_DEVS		16
+#define RESMON_BPF_BUS_NAME_LEN		16
+#define RESMON_BPF_DEV_NAME_LEN		32
+
+/* Registers whose EMADs resmon processes. The BPF program filters EMADs
+ * by this list and user space generates its register dispatch from it.
+ *
+ * X(NAME, name, ID)
+ */
+#define RESMON_REGS(X) \
+	X(RALUE, ralue, 0x8013) \
+	X(PTAR, ptar, 0x3006) \
+	X(PTCE3, ptce3, 0x3027) \
+	X(PEFA, pefa, 0x300F) \
+	X(IEDR, iedr, 0x3804) \
+	X(RAUHT, rauht, 0x8014) \
+	X(RATR, ratr, 0x8008) \
+	X(SFD, sfd, 0x200A)
+
+/* Key of the devs map, which user space populates with the devlink
+ * instances that resmon tracks. Both names are NUL-padded.
+ */
+struct resmon_bpf_dev_key {
+	char bus_name[RESMON_BPF_BUS_NAME_LEN];
+	char dev_name[RESMON_BPF_DEV_NAME_LEN];
+};
+
+/* Each ring buffer record starts with this header, the EMAD follows. The
+ * time is that of the tracepoint hit, as bpf_ktime_get_ns() has it.
+ */
+struct resmon_bpf_rec_hdr {
+	__u32 dev_index;
+	__u32 resv;
+	__u64 ktime_ns;
+};
+
+#endif /* __RESMON_BPF_H */
@@ -1,122 +1,58 @@
 // SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
-#include <errno.h>
+#include <ctype.h>
+#include <endian.h>
+#include <limits.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <time.h>
-#include <json-c/json_object.h>
-#include <json-c/json_tokener.h>
-#include <json-c/json_util.h>
+#include <unistd.h>
 
 #include "resmon.h"
 
-static bool resmon_c_validate_id(struct json_object *id_obj, int expect_id)
+static void resmon_c_print_error(char *error)
 {
-	int64_t id;
-
-	id = json_object_get_int64(id_obj);
-	return id == expect_id;
-}
-
-static void resmon_c_handle_response_error(struct json_object *error_obj)
-{
-	struct json_object *data;
-	const char *message;
-	int64_t code;
-	char *error;
-	int err;
-
-	err = resmon_jrpc_dissect_error(error_obj, &code, &message, &data,
-					&error);
-	if (err != 0) {
-		fprintf(stderr, "Invalid error object: %s\n", error);
-		free(error);
-		return;
-	}
-
-	if (data != NULL)
-		fprintf(stderr, "Error %" PRId64 ": %s (%s)\n", code, message,
-			json_object_to_json_string(data));
-	else
-		fprintf(stderr, "Error %" PRId64 ": %s\n", code, message);
+	fprintf(stderr, "%s\n", error);
+	free(error);
 }
 
-static bool resmon_c_handle_response(struct json_object *j, int expect_id,
-				     enum json_type result_type,
-				     struct json_object **ret_result)
+static struct resmon_client *resmon_c_client_open(void)
 {
-	struct json_object *result;
-	struct json_object *id;
-	bool is_error;
+	struct resmon_client *client;
 	char *error;
-	int err;
-
-	err = resmon_jrpc_dissect_response(j, &id, &result, &is_error, &error);
-	if (err) {
-		fprintf(stderr, "Invalid response object: %s\n", error);
-		free(error);
-		return false;
-	}
-
-	if (!resmon_c_validate_id(id, expect_id)) {
-		fprintf(stderr, "Unknown response ID: %s\n",
-			json_object_to_json_string(id));
-		return false;
-	}
-
-	if (is_error) {
-		resmon_c_handle_response_error(result);
-		return false;
-	}
-
-	if (json_object_get_type(result) != result_type) {
-		fprintf(stderr, "Unexpected result type: %s expected, got %s\n",
-			json_type_to_name(json_object_get_type(result)),
-			json_type_to_name(result_type));
-		return false;
-	}
 
-	*ret_result = json_object_get(result);
-	return true;
+	client = resmon_client_open(env.sockdir, &error);
+	if (client == NULL)
+		resmon_c_print_error(error);
+	return client;
 }
 
-static struct json_object *resmon_c_send_request(struct json_object *request)
+static int resmon_c_cmd_dev(int argc, char **argv, const char **device,
+			    void (*help_cb)(void))
 {
-	struct json_object *response_obj = NULL;
-	struct resmon_sock peer;
-	struct resmon_sock cli;
-	char *response;
-	int err;
-
-	err = resmon_sock_open_c(&cli, &peer, env.sockdir);
-	if (err < 0) {
-		fprintf(stderr, "Failed to open a socket: %m\n");
-		return NULL;
-	}
+	*device = NULL;
 
-	err = resmon_jrpc_send(&peer, request);
-	if (err < 0) {
-		fprintf(stderr, "Failed to send the RPC message: %m\n");
-		goto close_fd;
-	}
-
-	err = resmon_sock_recv(&cli, &peer, &response);
-	if (err < 0) {
-		fprintf(stderr, "Failed to receive an RPC response\n");
-		goto close_fd;
-	}
+	while (argc > 0) {
+		if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+			*device = *argv;
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "help") == 0) {
+			help_cb();
+			return 1;
+		} else {
+			fprintf(stderr, "What is \"%s\"?\n", *argv);
+			return -1;
+		}
+		continue;
 
-	response_obj = json_tokener_parse(response);
-	if (response_obj == NULL) {
-		fprintf(stderr, "Failed to parse RPC response as JSON.\n");
-		goto free_response;
+incomplete_command:
+		fprintf(stderr, "Command line is not complete. Try option \"help\"\n");
+		return -1;
 	}
 
-free_response:
-	free(response);
-close_fd:
-	resmon_sock_close_c(&cli);
-	return response_obj;
+	return 0;
 }
 
 static int resmon_c_cmd_noargs(int argc, char **argv, void (*help_cb)(void))
@@ -144,57 +80,25 @@ static void resmon_c_ping_help(void)
 
 static int resmon_c_ping_jrpc(void)
 {
-	struct json_object *response;
-	struct json_object *request;
-	struct json_object *result;
-	const int id = 1;
+	struct resmon_client *client;
+	char *error;
 	int err;
-	int nr;
-	int rc;
-	int r;
 
-	request = resmon_jrpc_new_request(id, "ping");
-	if (request == NULL)
+	client = resmon_c_client_open();
+	if (client == NULL)
 		return -1;
 
-	srand(time(NULL));
-	r = rand();
-	rc = resmon_jrpc_object_add_int(request, "params", r);
-	if (rc != 0) {
-		fprintf(stderr, "Failed to form a request object.\n");
-		err = -1;
-		goto put_request;
-	}
-
-	response = resmon_c_send_request(request);
-	if (response == NULL) {
-		err = -1;
-		goto put_request;
-	}
-
-	if (!resmon_c_handle_response(response, id, json_type_int, &result)) {
-		err = -1;
-		goto put_response;
-	}
-
-	nr = json_object_get_int(result);
-	if (nr != r) {
-		fprintf(stderr, "Unexpected ping response: sent %d, got %d.\n",
-			r, nr);
-		err = -1;
-		goto put_result;
+	err = resmon_client_ping(client, &error);
+	if (err != 0) {
+		resmon_c_print_error(error);
+		goto close_client;
 	}
 
 	if (env.verbosity > 0)
 		fprintf(stderr, "resmond is alive\n");
-	err = 0;
-
-put_result:
-	json_object_put(result);
-put_response:
-	json_object_put(response);
-put_request:
-	json_object_put(request);
+
+close_client:
+	resmon_client_close(client);
 	return err;
 }
 
@@ -219,44 +123,32 @@ static void resmon_c_stop_help(void)
 
 static int resmon_c_stop_jrpc(void)
 {
-	struct json_object *response;
-	struct json_object *request;
-	struct json_object *result;
-	const int id = 1;
+	struct resmon_client *client;
+	bool stopping;
+	char *error;
 	int err;
 
-	request = resmon_jrpc_new_request(id, "stop");
-	if (request == NULL)
+	client = resmon_c_client_open();
+	if (client == NULL)
 		return -1;
 
-	response = resmon_c_send_request(request);
-	if (response == NULL) {
-		err = -1;
-		goto put_request;
-	}
-
-	if (!resmon_c_handle_response(response, id, json_type_boolean,
-				      &result)) {
-		err = -1;
-		goto put_response;
+	err = resmon_client_stop(client, &stopping, &error);
+	if (err != 0) {
+		resmon_c_print_error(error);
+		goto close_client;
 	}
 
-	if (json_object_get_boolean(result)) {
+	if (stopping) {
 		if (env.verbosity > 0)
 			fprintf(stderr, "resmond will stop\n");
-		err = 0;
 	} else {
 		if (env.verbosity > 0)
 			fprintf(stderr, "resmond refuses to stop\n");
 		err = -1;
 	}
 
-
-	json_object_put(result);
-put_response:
-	json_object_put(response);
-put_request:
-	json_object_put(request);
+close_client:
+	resmon_client_close(client);
 	return err;
 }
 
@@ -274,78 +166,44 @@ int resmon_c_stop(int argc, char **argv)
 static void resmon_c_emad_help(void)
 {
 	fprintf(stderr,
-		"Usage: resmon emad [hex | raw] string PAYLOAD\n"
+		"Usage: resmon emad [dev DEV] [time NS] [hex | raw] string PAYLOAD\n"
+		"\n"
+		"  time: move the manual clock of the daemon to NS nanoseconds\n"
 		"\n"
 	);
 }
 
-static int resmon_c_emad_jrpc(const char *payload, size_t payload_len)
+static int resmon_c_emad_jrpc(const char *payload, size_t payload_len,
+			      const char *device, int64_t time_ns)
 {
-	struct json_object *payload_obj;
-	struct json_object *params_obj;
-	struct json_object *response;
-	struct json_object *request;
-	struct json_object *result;
-	const int id = 1;
+	struct resmon_client *client;
+	char *error;
 	int err;
 
-	request = resmon_jrpc_new_request(id, "emad");
-	if (request == NULL)
+	client = resmon_c_client_open();
+	if (client == NULL)
 		return -1;
 
-	params_obj = json_object_new_object();
-	if (params_obj == NULL) {
-		err = -ENOMEM;
-		goto put_request;
-	}
-
-	payload_obj = json_object_new_string_len(payload, payload_len);
-	if (payload_obj == NULL) {
-		err = -ENOMEM;
-		goto put_params_obj;
-	}
-
-	if (json_object_object_add(params_obj, "payload", payload_obj)) {
-		err = -ENOMEM;
-		goto put_payload_obj;
-	}
-	payload_obj = NULL;
-
-	if (json_object_object_add(request, "params", params_obj)) {
-		err = -1;
-		goto put_params_obj;
-	}
-	params_obj = NULL;
-
-	response = resmon_c_send_request(request);
-	if (response == NULL) {
-		err = -1;
-		goto put_request;
-	}
-
-	if (!resmon_c_handle_response(response, id, json_type_null, &result)) {
-		err = -1;
-		goto put_response;
+	err = resmon_client_emad(client, device, payload, payload_len,
+				 time_ns, &error);
+	if (err != 0) {
+		resmon_c_print_error(error);
+		goto close_client;
 	}
 
 	if (env.verbosity > 0)
 		fprintf(stderr, "resmond took the EMAD\n");
 
-	json_object_put(result);
-put_response:
-	json_object_put(response);
-put_payload_obj:
-	json_object_put(payload_obj);
-put_params_obj:
-	json_object_put(params_obj);
-put_request:
-	json_object_put(request);
+close_client:
+	resmon_client_close(client);
 	return err;
 }
 
 int resmon_c_emad(int argc, char **argv)
 {
+	const char *device = NULL;
 	char *payload = NULL;
+	int64_t time_ns = -1;
 	size_t payload_len;
 	enum {
 		mode_hex,
@@ -356,8 +214,25 @@ int resmon_c_emad(int argc, char **argv)
 	while (argc > 0) {
 		if (strcmp(*argv, "raw") == 0) {
 			mode = mode_raw;
+			NEXT_ARG_FWD();
 		} else if (strcmp(*argv, "hex") == 0) {
 			mode = mode_hex;
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+			device = *argv;
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "time") == 0) {
+			char *endptr;
+
+			NEXT_ARG();
+			time_ns = strtoll(*argv, &endptr, 10);
+			if (*endptr != '\0' || time_ns < 0) {
+				fprintf(stderr, "Invalid time: %s\n", *argv);
+				rc = -1;
+				goto out;
+			}
+			NEXT_ARG_FWD();
 		} else if (strcmp(*argv, "string") == 0) {
 			NEXT_ARG();
 			payload = strdup(*argv);
@@ -408,17 +283,193 @@ incomplete_command:
 		payload_len = payload_len * 2;
 	}
 
-	rc = resmon_c_emad_jrpc(payload, payload_len);
+	rc = resmon_c_emad_jrpc(payload, payload_len, device, time_ns);
 
 out:
 	free(payload);
 	return rc;
 }
 
+static void resmon_c_emads_help(void)
+{
+	fprintf(stderr,
+		"Usage: resmon emads [dev DEV] [file FILE]\n"
+		"\n"
+		"  file: read EMADs in hex, one per line, from FILE rather than\n"
+		"        from the standard input\n"
+		"\n"
+	);
+}
+
+/* Convert EMADs in hex, one per line, to length-prefixed binary records. */
+static int resmon_c_emads_convert(FILE *in, FILE *out, size_t *pnum_emads)
+{
+	size_t num_emads = 0;
+	size_t line_size = 0;
+	uint8_t *buf = NULL;
+	size_t buf_size = 0;
+	char *line = NULL;
+	ssize_t line_len;
+	size_t lineno = 0;
+	uint32_t len_be;
+	int rc = 0;
+
+	while ((line_len = getline(&line, &line_size, in)) >= 0) {
+		lineno++;
+		while (line_len > 0 &&
+		       isspace((unsigned char) line[line_len - 1]))
+			line_len--;
+		if (line_len == 0)
+			continue;
+
+		if (line_len / 2 > buf_size) {
+			uint8_t *new_buf = realloc(buf, line_len / 2);
+
+			if (new_buf == NULL) {
+				fprintf(stderr, "Failed to allocate EMAD buffer: %m\n");
+				rc = -1;
+				goto out;
+			}
+			buf = new_buf;
+			buf_size = line_len / 2;
+		}
+
+		if (resmon_jrpc_decode_hex(buf, line, line_len)) {
+			fprintf(stderr, "Line %zd is not an EMAD in hex\n",
+				lineno);
+			rc = -1;
+			goto out;
+		}
+
+		len_be = htobe32(line_len / 2);
+		if (fwrite(&len_be, sizeof(len_be), 1, out) != 1 ||
+		    fwrite(buf, line_len / 2, 1, out) != 1) {
+			fprintf(stderr, "Failed to write EMADs: %m\n");
+			rc = -1;
+			goto out;
+		}
+		num_emads++;
+	}
+
+	if (fflush(out) != 0) {
+		fprintf(stderr, "Failed to write EMADs: %m\n");
+		rc = -1;
+		goto out;
+	}
+	*pnum_emads = num_emads;
+
+out:
+	free(line);
+	free(buf);
+	return rc;
+}
+
+static int resmon_c_emads_jrpc(const char *device, int fd)
+{
+	struct resmon_client *client;
+	struct resmon_jrpc_emads emads;
+	char *error;
+	int err;
+
+	client = resmon_c_client_open();
+	if (client == NULL)
+		return -1;
+
+	/* A long capture takes the daemon a while to replay. */
+	err = resmon_client_set_timeout(client, 0, &error);
+	if (err != 0) {
+		resmon_c_print_error(error);
+		goto close_client;
+	}
+
+	err = resmon_client_emads(client, device, fd, &emads, &error);
+	if (err != 0) {
+		resmon_c_print_error(error);
+		goto close_client;
+	}
+
+	fprintf(stderr, "Injected %" PRId64 " EMADs, %" PRId64 " failed\n",
+		emads.emads, emads.errors);
+	if (emads.error != NULL)
+		fprintf(stderr, "First failure: %s\n", emads.error);
+
+close_client:
+	resmon_client_close(client);
+	return err;
+}
+
+int resmon_c_emads(int argc, char **argv)
+{
+	const char *device = NULL;
+	const char *file = NULL;
+	size_t num_emads;
+	FILE *in = stdin;
+	FILE *out;
+	int rc;
+
+	while (argc > 0) {
+		if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+			device = *argv;
+		} else if (strcmp(*argv, "file") == 0) {
+			NEXT_ARG();
+			file = *argv;
+		} else if (strcmp(*argv, "help") == 0) {
+			resmon_c_emads_help();
+			return 0;
+		} else {
+			fprintf(stderr, "What is \"%s\"?\n", *argv);
+			return -1;
+		}
+		NEXT_ARG_FWD();
+		continue;
+
+incomplete_command:
+		fprintf(stderr, "Command line is not complete. Try option \"help\"\n");
+		return -1;
+	}
+
+	if (file != NULL) {
+		in = fopen(file, "r");
+		if (in == NULL) {
+			fprintf(stderr, "Failed to open %s: %m\n", file);
+			return -1;
+		}
+	}
+
+	/* The EMADs go to the daemon in a file of their own, which is passed
+	 * along with the request.
+	 */
+	out = tmpfile();
+	if (out == NULL) {
+		fprintf(stderr, "Failed to create a temporary file: %m\n");
+		rc = -1;
+		goto close_in;
+	}
+
+	rc = resmon_c_emads_convert(in, out, &num_emads);
+	if (rc != 0)
+		goto close_out;
+
+	if (env.verbosity > 0)
+		fprintf(stderr, "Injecting %zd EMADs\n", num_emads);
+
+	rc = resmon_c_emads_jrpc(device, fileno(out));
+
+close_out:
+	fclose(out);
+close_in:
+	if (in != stdin)
+		fclose(in);
+	return rc;
+}
+
 static void resmon_c_stats_help(void)
 {
 	fprintf(stderr,
-		"Usage: resmon stats\n"
+		"Usage: resmon stats [dev DEV] [forecast]\n"
+		"\n"
+		"  forecast: show usage trends and estimated time to exhaustion\n"
 		"\n"
 	);
 }
@@ -435,60 +486,1681 @@ static void resmon_c_stats_print(struct resmon_jrpc_counter *counters,
 			counters[i].value * 100 / counters[i].capacity);
 }
 
-static int resmon_c_stats_jrpc(void)
+static void resmon_c_stats_print_eta(int64_t exhaustion_s)
+{
+	if (exhaustion_s < 0)
+		fprintf(stderr, "%16s\n", "-");
+	else if (exhaustion_s < 24 * 3600)
+		fprintf(stderr, "%7" PRId64 ":%02" PRId64 ":%02" PRId64 "\n",
+			exhaustion_s / 3600, exhaustion_s / 60 % 60,
+			exhaustion_s % 60);
+	else
+		fprintf(stderr, "%14" PRId64 " d\n", exhaustion_s / (24 * 3600));
+}
+
+static void
+resmon_c_stats_print_forecast(struct resmon_jrpc_counter *counters,
+			      size_t num_counters)
+{
+	fprintf(stderr, "%-30s%12s%14s%14s%16s\n",
+		"Resource", "Usage", "EW [/s]", "Window [/s]", "Exhaustion");
+
+	for (size_t i = 0; i < num_counters; i++) {
+		fprintf(stderr, "%-30s%12" PRId64 "%14.2f%14.2f",
+			counters[i].descr, counters[i].value,
+			counters[i].ew_slope, counters[i].window_slope);
+		resmon_c_stats_print_eta(counters[i].exhaustion_s);
+	}
+}
+
+static int resmon_c_stats_jrpc(const char *device, bool forecast)
 {
 	struct resmon_jrpc_counter *counters;
-	struct json_object *response;
-	struct json_object *request;
-	struct json_object *result;
+	struct resmon_client *client;
 	size_t num_counters;
-	const int id = 1;
 	char *error;
-	int err = 0;
+	int err;
 
-	request = resmon_jrpc_new_request(id, "stats");
-	if (request == NULL)
+	client = resmon_c_client_open();
+	if (client == NULL)
 		return -1;
 
-	response = resmon_c_send_request(request);
-	if (response == NULL) {
-		err = -1;
-		goto put_request;
+	err = resmon_client_stats(client, device, forecast, &counters,
+				  &num_counters, &error);
+	if (err != 0) {
+		resmon_c_print_error(error);
+		goto close_client;
 	}
 
-	if (!resmon_c_handle_response(response, id, json_type_object,
-				      &result)) {
-		err = -1;
-		goto put_response;
+	if (forecast)
+		resmon_c_stats_print_forecast(counters, num_counters);
+	else
+		resmon_c_stats_print(counters, num_counters);
+
+	free(counters);
+close_client:
+	resmon_client_close(client);
+	return err;
+}
+
+int resmon_c_stats(int argc, char **argv)
+{
+	const char *device = NULL;
+	bool forecast = false;
+
+	while (argc > 0) {
+		if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+			device = *argv;
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "forecast") == 0) {
+			forecast = true;
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "help") == 0) {
+			resmon_c_stats_help();
+			return 0;
+		} else {
+			fprintf(stderr, "What is \"%s\"?\n", *argv);
+			return -1;
+		}
+		continue;
+
+incomplete_command:
+		fprintf(stderr, "Command line is not complete. Try option \"help\"\n");
+		return -1;
+	}
+
+	return resmon_c_stats_jrpc(device, forecast);
+}
+
+static void resmon_c_regs_help(void)
+{
+	fprintf(stderr,
+		"Usage: resmon regs [dev DEV]\n"
+		"\n"
+	);
+}
+
+static void resmon_c_regs_print(struct resmon_jrpc_reg *regs,
+				size_t num_regs, int64_t unknown)
+{
+	fprintf(stderr, "%-10s%-8s%12s%12s%12s%14s%12s\n",
+		"Register", "ID", "Processed", "Ignored", "Errors",
+		"Time [us]", "Avg [ns]");
+
+	for (size_t i = 0; i < num_regs; i++) {
+		int64_t count = regs[i].processed + regs[i].ignored +
+				regs[i].errors;
+
+		fprintf(stderr, "%-10s0x%04" PRIx64 "  %12" PRId64 "%12" PRId64
+			"%12" PRId64 "%14" PRId64 "%12" PRId64 "\n",
+			regs[i].name, regs[i].id, regs[i].processed,
+			regs[i].ignored, regs[i].errors,
+			regs[i].time_ns / 1000,
+			count ? regs[i].time_ns / count : 0);
 	}
 
-	err = resmon_jrpc_dissect_stats(result, &counters, &num_counters,
-					&error);
+	fprintf(stderr, "\nUnknown or malformed EMADs: %" PRId64 "\n", unknown);
+}
+
+static int resmon_c_regs_jrpc(const char *device)
+{
+	struct resmon_client *client;
+	struct resmon_jrpc_reg *regs;
+	size_t num_regs;
+	int64_t unknown;
+	char *error;
+	int err;
+
+	client = resmon_c_client_open();
+	if (client == NULL)
+		return -1;
+
+	err = resmon_client_regs(client, device, &regs, &num_regs, &unknown,
+				 &error);
 	if (err != 0) {
-		fprintf(stderr, "Invalid counters object: %s\n", error);
-		free(error);
-		goto put_result;
+		resmon_c_print_error(error);
+		goto close_client;
 	}
 
-	resmon_c_stats_print(counters, num_counters);
+	resmon_c_regs_print(regs, num_regs, unknown);
 
-	free(counters);
-put_result:
-	json_object_put(result);
-put_response:
-	json_object_put(response);
-put_request:
-	json_object_put(request);
+	free(regs);
+close_client:
+	resmon_client_close(client);
 	return err;
 }
 
-int resmon_c_stats(int argc, char **argv)
+int resmon_c_regs(int argc, char **argv)
 {
+	const char *device;
 	int err;
 
-	err = resmon_c_cmd_noargs(argc, argv, resmon_c_stats_help);
+	err = resmon_c_cmd_dev(argc, argv, &device, resmon_c_regs_help);
 	if (err != 0)
-		return err;
+		return err < 0 ? err : 0;
+
+	return resmon_c_regs_jrpc(device);
+}
+
+static void resmon_c_acl_help(void)
+{
+	fprintf(stderr,
+		"Usage: resmon acl [dev DEV]\n"
+		"\n"
+	);
+}
+
+static void resmon_c_print_hist(const char *title, const int64_t *hist,
+				size_t size)
+{
+	size_t used = 0;
+
+	for (size_t i = 0; i < size; i++)
+		if (hist[i])
+			used++;
+
+	fprintf(stderr, "%-18s%zd", title, used);
+	for (size_t i = 0; i < size; i++)
+		if (hist[i])
+			fprintf(stderr, " %zd:%" PRId64, i, hist[i]);
+	fprintf(stderr, "\n");
+}
+
+static void resmon_c_acl_print(struct resmon_jrpc_acl_region *regions,
+			       size_t num_regions)
+{
+	fprintf(stderr, "%-20s%-8s%-24s%8s%8s\n",
+		"Device", "Region", "Usage", "Slots", "Resizes");
+
+	for (size_t i = 0; i < num_regions; i++) {
+		struct resmon_jrpc_acl_region *region = &regions[i];
+		char usage[32];
+
+		snprintf(usage, sizeof(usage),
+			 "%" PRId64 " / %" PRId64 " (%" PRId64 "%%)",
+			 region->used, region->capacity,
+			 region->capacity ?
+				region->used * 100 / region->capacity : 0);
+		fprintf(stderr, "%-20s%-8" PRId64 "%-24s%8" PRId64 "%8" PRId64
+			"\n", region->device, region->region_id, usage,
+			region->kvd_slots, region->resizes);
+		resmon_c_print_hist("  eRPs in use:", region->erps,
+				    ARRAY_SIZE(region->erps));
+		resmon_c_print_hist("  Delta widths:", region->deltas,
+				    ARRAY_SIZE(region->deltas));
+	}
+}
+
+static int resmon_c_acl_jrpc(const char *device)
+{
+	struct resmon_jrpc_acl_region *regions;
+	struct resmon_client *client;
+	size_t num_regions;
+	char *error;
+	int err;
+
+	client = resmon_c_client_open();
+	if (client == NULL)
+		return -1;
+
+	err = resmon_client_acl(client, device, &regions, &num_regions,
+				&error);
+	if (err != 0) {
+		resmon_c_print_error(error);
+		goto close_client;
+	}
+
+	resmon_c_acl_print(regions, num_regions);
+
+	free(regions);
+close_client:
+	resmon_client_close(client);
+	return err;
+}
+
+int resmon_c_acl(int argc, char **argv)
+{
+	const char *device;
+	int err;
+
+	err = resmon_c_cmd_dev(argc, argv, &device, resmon_c_acl_help);
+	if (err != 0)
+		return err < 0 ? err : 0;
+
+	return resmon_c_acl_jrpc(device);
+}
+
+static void resmon_c_lpm_help(void)
+{
+	fprintf(stderr,
+		"Usage: resmon lpm [dev DEV]\n"
+		"\n"
+	);
+}
+
+static void resmon_c_lpm_print(struct resmon_jrpc_lpm_vr *vrs, size_t num_vrs)
+{
+	fprintf(stderr, "%-20s%-10s%-6s%10s\n",
+		"Device", "Protocol", "VR", "Routes");
+
+	for (size_t i = 0; i < num_vrs; i++) {
+		struct resmon_jrpc_lpm_vr *vr = &vrs[i];
+
+		fprintf(stderr, "%-20s%-10s%-6" PRId64 "%10" PRId64 "\n",
+			vr->device, vr->protocol, vr->virtual_router,
+			vr->routes);
+		resmon_c_print_hist("  Prefix lengths:", vr->prefix_lens,
+				    vr->num_prefix_lens);
+	}
+}
+
+static int resmon_c_lpm_jrpc(const char *device)
+{
+	struct resmon_client *client;
+	struct resmon_jrpc_lpm_vr *vrs;
+	size_t num_vrs;
+	char *error;
+	int err;
+
+	client = resmon_c_client_open();
+	if (client == NULL)
+		return -1;
+
+	err = resmon_client_lpm(client, device, &vrs, &num_vrs, &error);
+	if (err != 0) {
+		resmon_c_print_error(error);
+		goto close_client;
+	}
+
+	resmon_c_lpm_print(vrs, num_vrs);
+
+	free(vrs);
+close_client:
+	resmon_client_close(client);
+	return err;
+}
+
+int resmon_c_lpm(int argc, char **argv)
+{
+	const char *device;
+	int err;
+
+	err = resmon_c_cmd_dev(argc, argv, &device, resmon_c_lpm_help);
+	if (err != 0)
+		return err < 0 ? err : 0;
+
+	return resmon_c_lpm_jrpc(device);
+}
+
+static void resmon_c_churn_help(void)
+{
+	fprintf(stderr,
+		"Usage: resmon churn [dev DEV] [top COUNT]\n"
+		"\n"
+	);
+}
+
+static void resmon_c_churn_print_items(const char *title,
+				       const struct resmon_jrpc_churn *items,
+				       size_t num_items)
+{
+	fprintf(stderr, "%-10s%12s%12s%12s%10s%10s%10s\n",
+		title, "Adds", "Deletes", "Redundant",
+		"Adds/s", "Dels/s", "Red/s");
+
+	for (size_t i = 0; i < num_items; i++) {
+		const struct resmon_jrpc_churn *item = &items[i];
+
+		fprintf(stderr, "%-10s%12" PRId64 "%12" PRId64 "%12" PRId64
+			"%10.1f%10.1f%10.1f\n",
+			item->name, item->adds, item->deletes,
+			item->redundant, item->add_rate, item->delete_rate,
+			item->redundant_rate);
+	}
+}
+
+static void resmon_c_churn_print(const struct resmon_jrpc_churn *regs,
+				 size_t num_regs,
+				 const struct resmon_jrpc_churn *tables,
+				 size_t num_tables,
+				 const struct resmon_jrpc_churn_key *keys,
+				 size_t num_keys)
+{
+	resmon_c_churn_print_items("Register", regs, num_regs);
+	fprintf(stderr, "\n");
+	resmon_c_churn_print_items("Table", tables, num_tables);
+
+	if (num_keys == 0)
+		return;
+
+	fprintf(stderr, "\n%-20s%-8s%12s  %s\n",
+		"Device", "Table", "Redundant", "Key");
+	for (size_t i = 0; i < num_keys; i++)
+		fprintf(stderr, "%-20s%-8s%12" PRId64 "  %s\n",
+			keys[i].device, keys[i].table, keys[i].redundant,
+			keys[i].key);
+}
+
+static int resmon_c_churn_jrpc(const char *device, int64_t top)
+{
+	struct resmon_jrpc_churn_key *keys;
+	struct resmon_jrpc_churn *tables;
+	struct resmon_jrpc_churn *regs;
+	struct resmon_client *client;
+	size_t num_tables;
+	size_t num_keys;
+	size_t num_regs;
+	char *error;
+	int err;
+
+	client = resmon_c_client_open();
+	if (client == NULL)
+		return -1;
+
+	err = resmon_client_churn(client, device, top, &regs, &num_regs,
+				  &tables, &num_tables, &keys, &num_keys,
+				  &error);
+	if (err != 0) {
+		resmon_c_print_error(error);
+		goto close_client;
+	}
+
+	resmon_c_churn_print(regs, num_regs, tables, num_tables,
+			     keys, num_keys);
+
+	free(keys);
+	free(tables);
+	free(regs);
+close_client:
+	resmon_client_close(client);
+	return err;
+}
+
+int resmon_c_churn(int argc, char **argv)
+{
+	const char *device = NULL;
+	int64_t top = 10;
+
+	while (argc > 0) {
+		if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+			device = *argv;
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "top") == 0) {
+			char *endptr;
+
+			NEXT_ARG();
+			top = strtoll(*argv, &endptr, 10);
+			if (*endptr != '\0' || top < 0) {
+				fprintf(stderr, "Invalid count: %s\n", *argv);
+				return -1;
+			}
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "help") == 0) {
+			resmon_c_churn_help();
+			return 0;
+		} else {
+			fprintf(stderr, "What is \"%s\"?\n", *argv);
+			return -1;
+		}
+		continue;
+
+incomplete_command:
+		fprintf(stderr, "Command line is not complete. Try option \"help\"\n");
+		return -1;
+	}
+
+	return resmon_c_churn_jrpc(device, top);
+}
+
+static void resmon_c_bursts_help(void)
+{
+	fprintf(stderr,
+		"Usage: resmon bursts [dev DEV]\n"
+		"\n"
+	);
+}
+
+static void resmon_c_bursts_print(const struct resmon_jrpc_burst *bursts,
+				  size_t num_bursts)
+{
+	fprintf(stderr, "%-20s%-14s%12s%10s%12s  %s\n",
+		"Device", "Start", "Duration", "EMADs", "Peak/s",
+		"Registers");
+
+	for (size_t i = 0; i < num_bursts; i++) {
+		const struct resmon_jrpc_burst *burst = &bursts[i];
+		time_t start = burst->start_ns / 1000000000;
+		char duration[32];
+		char stamp[32];
+		struct tm tm;
+
+		localtime_r(&start, &tm);
+		strftime(stamp, sizeof(stamp), "%H:%M:%S", &tm);
+		snprintf(stamp + strlen(stamp), sizeof(stamp) - strlen(stamp),
+			 ".%03" PRId64, burst->start_ns / 1000000 % 1000);
+		snprintf(duration, sizeof(duration), "%" PRId64 ".%03" PRId64
+			 "%s", burst->duration_ns / 1000000,
+			 burst->duration_ns / 1000 % 1000,
+			 burst->ongoing ? "+" : "");
+
+		fprintf(stderr, "%-20s%-14s%10s ms%10" PRId64 "%12" PRId64 " ",
+			burst->device, stamp, duration, burst->emads,
+			burst->peak_rate);
+		for (size_t j = 0; j < burst->num_regs; j++)
+			fprintf(stderr, " %s:%" PRId64, burst->regs[j].name,
+				burst->regs[j].emads);
+		fprintf(stderr, "\n");
+	}
+}
+
+static int resmon_c_bursts_jrpc(const char *device)
+{
+	struct resmon_jrpc_burst *bursts;
+	struct resmon_client *client;
+	size_t num_bursts;
+	char *error;
+	int err;
+
+	client = resmon_c_client_open();
+	if (client == NULL)
+		return -1;
+
+	err = resmon_client_bursts(client, device, &bursts, &num_bursts,
+				   &error);
+	if (err != 0) {
+		resmon_c_print_error(error);
+		goto close_client;
+	}
+
+	resmon_c_bursts_print(bursts, num_bursts);
+
+	resmon_jrpc_bursts_free(bursts, num_bursts);
+close_client:
+	resmon_client_close(client);
+	return err;
+}
+
+int resmon_c_bursts(int argc, char **argv)
+{
+	const char *device;
+	int err;
+
+	err = resmon_c_cmd_dev(argc, argv, &device, resmon_c_bursts_help);
+	if (err != 0)
+		return err < 0 ? err : 0;
+
+	return resmon_c_bursts_jrpc(device);
+}
+
+static void resmon_c_plan_help(void)
+{
+	fprintf(stderr,
+		"Usage: resmon plan [dev DEV] ITEM [ITEM...]\n"
+		"where  ITEM := { route { ipv4 | ipv6 } prefix LEN |\n"
+		"                 neigh { ipv4 | ipv6 } |\n"
+		"                 acl keys NUM | actset | adj | fdb } count NUM\n"
+		"\n"
+		"  keys: number of flexible key blocks of the ACL region\n"
+		"\n"
+	);
+}
+
+static void resmon_c_plan_print(const struct resmon_jrpc_plan *plan)
+{
+	fprintf(stderr, "%-30s%12s%12s\n", "Resource", "Usage", "Needed");
+
+	for (size_t i = 0; i < plan->num_counters; i++)
+		fprintf(stderr, "%-30s%12" PRId64 "%12" PRId64 "\n",
+			plan->counters[i].descr, plan->counters[i].value,
+			plan->counters[i].needed);
+	fprintf(stderr, "%-30s%12" PRId64 "%12" PRId64 "\n",
+		"Total", plan->used, plan->needed);
+
+	fprintf(stderr, "\nCapacity %" PRId64 ", headroom after the batch %"
+		PRId64 ": the batch %s\n", plan->capacity, plan->headroom,
+		plan->fits ? "fits" : "does not fit");
+}
+
+static int resmon_c_plan_jrpc(const char *device,
+			      const struct resmon_jrpc_plan_item *items,
+			      size_t num_items)
+{
+	struct resmon_client *client;
+	struct resmon_jrpc_plan plan;
+	char *error;
+	int err;
+
+	client = resmon_c_client_open();
+	if (client == NULL)
+		return -1;
+
+	err = resmon_client_plan(client, device, items, num_items, &plan,
+				 &error);
+	if (err != 0) {
+		resmon_c_print_error(error);
+		goto close_client;
+	}
+
+	resmon_c_plan_print(&plan);
+
+	free(plan.counters);
+close_client:
+	resmon_client_close(client);
+	return err;
+}
+
+static int resmon_c_plan_parse_num(const char *arg, int64_t *pnum)
+{
+	char *endptr;
+
+	*pnum = strtoll(arg, &endptr, 10);
+	if (*endptr != '\0' || *pnum < 0) {
+		fprintf(stderr, "Invalid number: %s\n", arg);
+		return -1;
+	}
+	return 0;
+}
+
+static int resmon_c_plan_parse_type(const char *arg,
+				    enum resmon_jrpc_plan_type *ptype)
+{
+	enum resmon_jrpc_plan_type type;
+
+	for (type = RESMON_JRPC_PLAN_ROUTE; type <= RESMON_JRPC_PLAN_FDB;
+	     type++) {
+		if (strcmp(arg, resmon_jrpc_plan_type_name(type)) == 0) {
+			*ptype = type;
+			return 0;
+		}
+	}
+
+	fprintf(stderr, "What is \"%s\"?\n", arg);
+	return -1;
+}
+
+/* Parse one ITEM of the command line. Returns the number of arguments
+ * consumed, or -1 on error.
+ */
+static int resmon_c_plan_parse_item(int argc, char **argv,
+				    struct resmon_jrpc_plan_item *item)
+{
+	const char *type = *argv;
+	int argc_0 = argc;
+
+	*item = (struct resmon_jrpc_plan_item) {};
+	if (resmon_c_plan_parse_type(type, &item->type))
+		return -1;
+
+	switch (item->type) {
+	case RESMON_JRPC_PLAN_ROUTE:
+	case RESMON_JRPC_PLAN_NEIGH:
+		NEXT_ARG();
+		if (strcmp(*argv, "ipv4") == 0) {
+			item->ipv6 = false;
+		} else if (strcmp(*argv, "ipv6") == 0) {
+			item->ipv6 = true;
+		} else {
+			fprintf(stderr, "Unknown protocol: %s\n", *argv);
+			return -1;
+		}
+		break;
+	case RESMON_JRPC_PLAN_ACL:
+		NEXT_ARG();
+		if (strcmp(*argv, "keys") != 0)
+			goto err_expected;
+		NEXT_ARG();
+		if (resmon_c_plan_parse_num(*argv, &item->key_blocks))
+			return -1;
+		break;
+	case RESMON_JRPC_PLAN_ACTSET:
+	case RESMON_JRPC_PLAN_ADJ:
+	case RESMON_JRPC_PLAN_FDB:
+		break;
+	}
+
+	if (item->type == RESMON_JRPC_PLAN_ROUTE) {
+		NEXT_ARG();
+		if (strcmp(*argv, "prefix") != 0)
+			goto err_expected;
+		NEXT_ARG();
+		if (resmon_c_plan_parse_num(*argv, &item->prefix_len))
+			return -1;
+	}
+
+	NEXT_ARG();
+	if (strcmp(*argv, "count") != 0)
+		goto err_expected;
+	NEXT_ARG();
+	if (resmon_c_plan_parse_num(*argv, &item->count))
+		return -1;
+
+	NEXT_ARG_FWD();
+	return argc_0 - argc;
+
+err_expected:
+	fprintf(stderr, "Unexpected \"%s\" in %s item. Try option \"help\"\n",
+		*argv, type);
+	return -1;
+incomplete_command:
+	fprintf(stderr, "Command line is not complete. Try option \"help\"\n");
+	return -1;
+}
+
+int resmon_c_plan(int argc, char **argv)
+{
+	struct resmon_jrpc_plan_item *items = NULL;
+	const char *device = NULL;
+	size_t num_items = 0;
+	int err = -1;
+
+	while (argc > 0) {
+		struct resmon_jrpc_plan_item *new_items;
+		int n;
+
+		if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+			device = *argv;
+			NEXT_ARG_FWD();
+			continue;
+		} else if (strcmp(*argv, "help") == 0) {
+			resmon_c_plan_help();
+			err = 0;
+			goto out;
+		}
+
+		new_items = realloc(items, (num_items + 1) * sizeof(*items));
+		if (new_items == NULL) {
+			fprintf(stderr, "Failed to allocate plan items: %m\n");
+			goto out;
+		}
+		items = new_items;
+
+		n = resmon_c_plan_parse_item(argc, argv, &items[num_items]);
+		if (n < 0)
+			goto out;
+		num_items++;
+		argc -= n;
+		argv += n;
+		continue;
+
+incomplete_command:
+		fprintf(stderr, "Command line is not complete. Try option \"help\"\n");
+		goto out;
+	}
+
+	if (num_items == 0) {
+		fprintf(stderr, "No items given. Try option \"help\"\n");
+		goto out;
+	}
+
+	err = resmon_c_plan_jrpc(device, items, num_items);
+
+out:
+	free(items);
+	return err;
+}
+
+static void resmon_c_kvdl_help(void)
+{
+	fprintf(stderr,
+		"Usage: resmon kvdl [dev DEV]\n"
+		"\n"
+	);
+}
+
+static void resmon_c_kvdl_print(struct resmon_jrpc_kvdl *devs,
+				size_t num_devs)
+{
+	fprintf(stderr, "%-20s%10s%10s%10s%12s%10s%8s\n",
+		"Device", "Size", "Used", "Free", "Largest", "Runs", "Frag");
+
+	for (size_t i = 0; i < num_devs; i++) {
+		struct resmon_jrpc_kvdl *dev = &devs[i];
+
+		fprintf(stderr, "%-20s%10" PRId64 "%10" PRId64 "%10" PRId64
+			"%12" PRId64 "%10" PRId64 "%7.1f%%\n",
+			dev->device, dev->size, dev->used, dev->free,
+			dev->largest_free_run, dev->free_runs,
+			dev->fragmentation * 100);
+		resmon_c_print_hist("  Free runs (log2):", dev->run_hist,
+				    ARRAY_SIZE(dev->run_hist));
+	}
+}
+
+static int resmon_c_kvdl_jrpc(const char *device)
+{
+	struct resmon_jrpc_kvdl *devs;
+	struct resmon_client *client;
+	size_t num_devs;
+	char *error;
+	int err;
+
+	client = resmon_c_client_open();
+	if (client == NULL)
+		return -1;
+
+	err = resmon_client_kvdl(client, device, &devs, &num_devs, &error);
+	if (err != 0) {
+		resmon_c_print_error(error);
+		goto close_client;
+	}
+
+	resmon_c_kvdl_print(devs, num_devs);
+
+	free(devs);
+close_client:
+	resmon_client_close(client);
+	return err;
+}
+
+int resmon_c_kvdl(int argc, char **argv)
+{
+	const char *device;
+	int err;
+
+	err = resmon_c_cmd_dev(argc, argv, &device, resmon_c_kvdl_help);
+	if (err != 0)
+		return err < 0 ? err : 0;
+
+	return resmon_c_kvdl_jrpc(device);
+}
+
+static void resmon_c_health_help(void)
+{
+	fprintf(stderr,
+		"Usage: resmon health\n"
+		"\n"
+	);
+}
+
+/* The bins only bound the percentile. Report the upper bound, which the
+ * largest value recorded tightens for the last bin in use.
+ */
+static int64_t resmon_c_hist_percentile(const struct resmon_jrpc_hist *hist,
+					double pct)
+{
+	int64_t rank = hist->count * pct / 100;
+	int64_t seen = 0;
+
+	for (size_t i = 0; i < ARRAY_SIZE(hist->bins); i++) {
+		seen += hist->bins[i];
+		if (seen > rank) {
+			int64_t upper = (2LL << i) - 1;
+
+			return upper < hist->max ? upper : hist->max;
+		}
+	}
+	return hist->max;
+}
+
+static void resmon_c_health_print_hist(const char *name,
+				       const struct resmon_jrpc_hist *hist)
+{
+	if (hist->count == 0) {
+		fprintf(stderr, "%-16s%12d%12s%12s%12s%12s\n",
+			name, 0, "-", "-", "-", "-");
+		return;
+	}
+
+	fprintf(stderr, "%-16s%12" PRId64 "%12" PRId64 "%12" PRId64
+		"%12" PRId64 "%12" PRId64 "\n",
+		name, hist->count, hist->sum / hist->count,
+		resmon_c_hist_percentile(hist, 50),
+		resmon_c_hist_percentile(hist, 99), hist->max);
+}
+
+static void resmon_c_health_print(const struct resmon_jrpc_health *health)
+{
+	fprintf(stderr, "Uptime: %.1f s\n", health->uptime_ns / 1e9);
+	fprintf(stderr, "CPU: %.3f s processing EMADs (%.2f%%), %.3f s in total\n",
+		health->cpu_ns / 1e9, health->cpu_load * 100,
+		health->process_cpu_ns / 1e9);
+	fprintf(stderr, "\n");
+
+	fprintf(stderr, "%-16s%12s%12s%12s%12s%12s\n",
+		"", "Count", "Avg", "p50", "p99", "Max");
+	resmon_c_health_print_hist("Delay (ns)", &health->delay_ns);
+	resmon_c_health_print_hist("Batch (EMADs)", &health->batch);
+	for (size_t i = 0; i < health->num_regs; i++) {
+		const struct resmon_jrpc_health_reg *reg = &health->regs[i];
+		char name[32];
+
+		snprintf(name, sizeof(name), "%s (ns)", reg->name);
+		resmon_c_health_print_hist(name, &reg->time_ns);
+	}
+}
+
+static int resmon_c_health_jrpc(void)
+{
+	struct resmon_jrpc_health health;
+	struct resmon_client *client;
+	char *error;
+	int err;
+
+	client = resmon_c_client_open();
+	if (client == NULL)
+		return -1;
+
+	err = resmon_client_health(client, &health, &error);
+	if (err != 0) {
+		resmon_c_print_error(error);
+		goto close_client;
+	}
+
+	resmon_c_health_print(&health);
+
+	free(health.regs);
+close_client:
+	resmon_client_close(client);
+	return err;
+}
+
+int resmon_c_health(int argc, char **argv)
+{
+	int err;
+
+	err = resmon_c_cmd_noargs(argc, argv, resmon_c_health_help);
+	if (err != 0)
+		return err;
+
+	return resmon_c_health_jrpc();
+}
+
+static void resmon_c_errors_help(void)
+{
+	fprintf(stderr,
+		"Usage: resmon errors [dev DEV]\n"
+		"\n"
+	);
+}
+
+/* Without -v, only the start of the offending EMADs is shown. */
+#define RESMON_C_ERRORS_HEX_LEN		64
+
+static void resmon_c_errors_print(const struct resmon_jrpc_errors *errors)
+{
+	fprintf(stderr, "%-20s%-26s%12s\n", "Class", "Description", "Count");
+	for (size_t i = 0; i < errors->num_classes; i++) {
+		const struct resmon_jrpc_error_class *cls = &errors->classes[i];
+
+		fprintf(stderr, "%-20s%-26s%12" PRId64 "\n",
+			cls->name, cls->descr, cls->count);
+	}
+	fprintf(stderr, "Logged %" PRId64 ", suppressed %" PRId64 "\n",
+		errors->logged, errors->suppressed);
+
+	if (errors->num_samples == 0)
+		return;
+
+	fprintf(stderr, "\n%-14s%-20s%-20s%6s  %s\n",
+		"Time", "Device", "Class", "Len", "Message");
+	for (size_t i = 0; i < errors->num_samples; i++) {
+		const struct resmon_jrpc_error_sample *sample =
+			&errors->samples[i];
+		time_t time = sample->time_ns / 1000000000;
+		size_t hex_len = strlen(sample->emad);
+		char stamp[32];
+		struct tm tm;
+
+		localtime_r(&time, &tm);
+		strftime(stamp, sizeof(stamp), "%H:%M:%S", &tm);
+		snprintf(stamp + strlen(stamp), sizeof(stamp) - strlen(stamp),
+			 ".%03" PRId64, sample->time_ns / 1000000 % 1000);
+
+		fprintf(stderr, "%-14s%-20s%-20s%6" PRId64 "  %s\n",
+			stamp, sample->device, sample->cls, sample->len,
+			sample->message);
+
+		if (env.verbosity == 0 && hex_len > RESMON_C_ERRORS_HEX_LEN)
+			fprintf(stderr, "  %.*s...\n",
+				RESMON_C_ERRORS_HEX_LEN, sample->emad);
+		else
+			fprintf(stderr, "  %s\n", sample->emad);
+	}
+}
+
+static int resmon_c_errors_jrpc(const char *device)
+{
+	struct resmon_jrpc_errors errors;
+	struct resmon_client *client;
+	char *error;
+	int err;
+
+	client = resmon_c_client_open();
+	if (client == NULL)
+		return -1;
+
+	err = resmon_client_errors(client, device, &errors, &error);
+	if (err != 0) {
+		resmon_c_print_error(error);
+		goto close_client;
+	}
+
+	resmon_c_errors_print(&errors);
+
+	free(errors.samples);
+	free(errors.classes);
+close_client:
+	resmon_client_close(client);
+	return err;
+}
+
+int resmon_c_errors(int argc, char **argv)
+{
+	const char *device;
+	int err;
+
+	err = resmon_c_cmd_dev(argc, argv, &device, resmon_c_errors_help);
+	if (err != 0)
+		return err < 0 ? err : 0;
+
+	return resmon_c_errors_jrpc(device);
+}
+
+static void resmon_c_recon_help(void)
+{
+	fprintf(stderr,
+		"Usage: resmon recon [dev DEV] [check]\n"
+		"\n"
+		"  check: reconcile the accounting with devlink first\n"
+		"\n"
+	);
+}
+
+static void resmon_c_recon_print(const struct resmon_jrpc_recon *recon)
+{
+	fprintf(stderr, "Interval: %" PRId64 " s, threshold: %" PRId64
+		" entries, persist: %" PRId64 " checks, action: %s\n\n",
+		recon->interval_ns / 1000000000, recon->threshold,
+		recon->persist, recon->action);
+
+	fprintf(stderr, "%-20s%-10s%12s%12s%10s%8s%10s%8s  %s\n",
+		"Device", "Resource", "Occupancy", "Accounted", "Drift",
+		"Checks", "Rebased", "Fails", "Status");
+	for (size_t i = 0; i < recon->num_resources; i++) {
+		const struct resmon_jrpc_recon_resource *res =
+			&recon->resources[i];
+
+		if (!res->present) {
+			fprintf(stderr, "%-20s%-10s%12s%12s%10s%8" PRId64
+				"%10s%8" PRId64 "  %s\n",
+				res->device, res->name, "-", "-", "-",
+				res->checks, "-", res->failures,
+				"not reported");
+			continue;
+		}
+
+		fprintf(stderr, "%-20s%-10s%12" PRId64 "%12" PRId64 "%10" PRId64
+			"%8" PRId64 "%10" PRId64 "%8" PRId64 "  %s\n",
+			res->device, res->name, res->occupancy,
+			res->accounted, res->drift, res->checks,
+			res->rebase_offset, res->failures,
+			res->flagged ? "drifted" :
+			llabs(res->drift) > recon->threshold ? "drifting" :
+			"ok");
+	}
+}
+
+static int resmon_c_recon_jrpc(const char *device, bool check)
+{
+	struct resmon_jrpc_recon recon;
+	struct resmon_client *client;
+	char *error;
+	int err;
+
+	client = resmon_c_client_open();
+	if (client == NULL)
+		return -1;
+
+	err = resmon_client_recon(client, device, check, &recon, &error);
+	if (err != 0) {
+		resmon_c_print_error(error);
+		goto close_client;
+	}
+
+	resmon_c_recon_print(&recon);
+
+	free(recon.resources);
+close_client:
+	resmon_client_close(client);
+	return err;
+}
+
+int resmon_c_recon(int argc, char **argv)
+{
+	const char *device = NULL;
+	bool check = false;
+
+	while (argc > 0) {
+		if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+			device = *argv;
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "check") == 0) {
+			check = true;
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "help") == 0) {
+			resmon_c_recon_help();
+			return 0;
+		} else {
+			fprintf(stderr, "What is \"%s\"?\n", *argv);
+			return -1;
+		}
+		continue;
+
+incomplete_command:
+		fprintf(stderr, "Command line is not complete. Try option \"help\"\n");
+		return -1;
+	}
+
+	return resmon_c_recon_jrpc(device, check);
+}
+
+static void resmon_c_ages_help(void)
+{
+	fprintf(stderr,
+		"Usage: resmon ages [dev DEV] [table TABLE] [top COUNT]\n"
+		"                   [by {age | idle}]\n"
+		"\n"
+		"  table: one of ralue, ptce3, kvdl, rauht and fdb\n"
+		"  by: list the entries inserted (default), or updated, the\n"
+		"      longest ago\n"
+		"\n"
+	);
+}
+
+static void resmon_c_ages_fmt_bound(char *buf, size_t size, int64_t s)
+{
+	if (s % 86400 == 0)
+		snprintf(buf, size, "<=%" PRId64 "d", s / 86400);
+	else if (s % 3600 == 0)
+		snprintf(buf, size, "<=%" PRId64 "h", s / 3600);
+	else if (s % 60 == 0)
+		snprintf(buf, size, "<=%" PRId64 "m", s / 60);
+	else
+		snprintf(buf, size, "<=%" PRId64 "s", s);
+}
+
+static void resmon_c_ages_print(const struct resmon_jrpc_ages *ages)
+{
+	char bound[16];
+
+	fprintf(stderr, "%-20s%-8s%10s", "Device", "Table", "Entries");
+	for (size_t i = 0; i < ARRAY_SIZE(ages->max_age_s); i++) {
+		resmon_c_ages_fmt_bound(bound, sizeof(bound),
+					ages->max_age_s[i]);
+		fprintf(stderr, "%8s", bound);
+	}
+	fprintf(stderr, "%8s\n", "older");
+
+	for (size_t i = 0; i < ages->num_tables; i++) {
+		const struct resmon_jrpc_ages_table *table = &ages->tables[i];
+
+		fprintf(stderr, "%-20s%-8s%10" PRId64, table->device,
+			table->name, table->entries);
+		for (size_t j = 0; j < ARRAY_SIZE(table->counts); j++)
+			fprintf(stderr, "%8" PRId64, table->counts[j]);
+		fprintf(stderr, "\n");
+	}
+
+	if (ages->num_oldest == 0)
+		return;
+
+	fprintf(stderr, "\n%-20s%-8s%10s%10s%12s  %s\n",
+		"Device", "Table", "Age [s]", "Idle [s]", "Redundant", "Key");
+	for (size_t i = 0; i < ages->num_oldest; i++) {
+		const struct resmon_jrpc_aged_key *key = &ages->oldest[i];
+
+		fprintf(stderr, "%-20s%-8s%10" PRId64 "%10" PRId64 "%12" PRId64
+			"  %s\n",
+			key->device, key->table, key->age_s, key->idle_s,
+			key->redundant, key->key);
+	}
+}
+
+static int resmon_c_ages_jrpc(const char *device, const char *table,
+			      int64_t top, bool by_idle)
+{
+	struct resmon_jrpc_ages ages;
+	struct resmon_client *client;
+	char *error;
+	int err;
+
+	client = resmon_c_client_open();
+	if (client == NULL)
+		return -1;
+
+	err = resmon_client_ages(client, device, table, top, by_idle, &ages,
+				 &error);
+	if (err != 0) {
+		resmon_c_print_error(error);
+		goto close_client;
+	}
+
+	resmon_c_ages_print(&ages);
+
+	free(ages.oldest);
+	free(ages.tables);
+close_client:
+	resmon_client_close(client);
+	return err;
+}
+
+int resmon_c_ages(int argc, char **argv)
+{
+	const char *device = NULL;
+	const char *table = NULL;
+	bool by_idle = false;
+	int64_t top = 10;
+
+	while (argc > 0) {
+		if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+			device = *argv;
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "table") == 0) {
+			NEXT_ARG();
+			table = *argv;
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "top") == 0) {
+			char *endptr;
+
+			NEXT_ARG();
+			top = strtoll(*argv, &endptr, 10);
+			if (*endptr != '\0' || top < 0) {
+				fprintf(stderr, "Invalid count: %s\n", *argv);
+				return -1;
+			}
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "by") == 0) {
+			NEXT_ARG();
+			if (strcmp(*argv, "age") == 0) {
+				by_idle = false;
+			} else if (strcmp(*argv, "idle") == 0) {
+				by_idle = true;
+			} else {
+				fprintf(stderr, "Unrecognized order: %s\n",
+					*argv);
+				return -1;
+			}
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "help") == 0) {
+			resmon_c_ages_help();
+			return 0;
+		} else {
+			fprintf(stderr, "What is \"%s\"?\n", *argv);
+			return -1;
+		}
+		continue;
+
+incomplete_command:
+		fprintf(stderr, "Command line is not complete. Try option \"help\"\n");
+		return -1;
+	}
+
+	return resmon_c_ages_jrpc(device, table, top, by_idle);
+}
+
+static void resmon_c_top_help(void)
+{
+	fprintf(stderr,
+		"Usage: resmon top [dev DEV] [interval MS] [count COUNT]\n"
+		"                  [by {vr | region | reg}]\n"
+		"\n"
+		"  interval: milliseconds between refreshes, 1000 by default\n"
+		"  count: stop after COUNT refreshes rather than on a signal\n"
+		"  by: break the usage down by virtual router, ACL region or\n"
+		"      register as well\n"
+		"\n"
+	);
+}
+
+enum resmon_c_top_by {
+	RESMON_C_TOP_BY_NONE,
+	RESMON_C_TOP_BY_VR,
+	RESMON_C_TOP_BY_REGION,
+	RESMON_C_TOP_BY_REG,
+};
+
+struct resmon_c_top_args {
+	const char *device;
+	unsigned int interval_ms;
+	uint64_t count;
+	enum resmon_c_top_by by;
+};
+
+/* A sample outlives the response that it was taken from, and keeps copies
+ * of the names that identify its rows across samples.
+ */
+struct resmon_c_top_row {
+	char name[48];
+	int64_t value;
+	int64_t capacity;
+};
+
+struct resmon_c_top_rows {
+	struct resmon_c_top_row *rows;
+	size_t num_rows;
+};
+
+struct resmon_c_top_sample {
+	uint64_t time_ns;
+	struct resmon_c_top_rows counters;
+	struct resmon_c_top_rows breakdown;
+};
+
+static volatile sig_atomic_t resmon_c_top_quit;
+
+static void resmon_c_top_sig(int signo)
+{
+	resmon_c_top_quit = 1;
+}
+
+static uint64_t resmon_c_top_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int resmon_c_top_rows_alloc(struct resmon_c_top_rows *rows,
+				   size_t num_rows, char **error)
+{
+	rows->rows = calloc(num_rows, sizeof(*rows->rows));
+	if (rows->rows == NULL && num_rows != 0) {
+		resmon_fmterr(error, "Failed to allocate a sample: %m");
+		return -1;
+	}
+	rows->num_rows = num_rows;
+	return 0;
+}
+
+static int resmon_c_top_sample_vrs(struct resmon_client *client,
+				   const char *device,
+				   struct resmon_c_top_rows *rows,
+				   char **error)
+{
+	struct resmon_jrpc_lpm_vr *vrs;
+	size_t num_vrs;
+	int err;
+
+	err = resmon_client_lpm(client, device, &vrs, &num_vrs, error);
+	if (err != 0)
+		return err;
+
+	err = resmon_c_top_rows_alloc(rows, num_vrs, error);
+	if (err != 0)
+		goto free_vrs;
+
+	for (size_t i = 0; i < num_vrs; i++) {
+		snprintf(rows->rows[i].name, sizeof(rows->rows[i].name),
+			 "%s %s VR %" PRId64, vrs[i].device, vrs[i].protocol,
+			 vrs[i].virtual_router);
+		rows->rows[i].value = vrs[i].routes;
+	}
+
+free_vrs:
+	free(vrs);
+	return err;
+}
+
+static int resmon_c_top_sample_regions(struct resmon_client *client,
+				       const char *device,
+				       struct resmon_c_top_rows *rows,
+				       char **error)
+{
+	struct resmon_jrpc_acl_region *regions;
+	size_t num_regions;
+	int err;
+
+	err = resmon_client_acl(client, device, &regions, &num_regions, error);
+	if (err != 0)
+		return err;
+
+	err = resmon_c_top_rows_alloc(rows, num_regions, error);
+	if (err != 0)
+		goto free_regions;
+
+	for (size_t i = 0; i < num_regions; i++) {
+		snprintf(rows->rows[i].name, sizeof(rows->rows[i].name),
+			 "%s region %" PRId64, regions[i].device,
+			 regions[i].region_id);
+		rows->rows[i].value = regions[i].used;
+		rows->rows[i].capacity = regions[i].capacity;
+	}
+
+free_regions:
+	free(regions);
+	return err;
+}
+
+/* Registers have no usage, their rows count the EMADs seen instead. */
+static int resmon_c_top_sample_regs(struct resmon_client *client,
+				    const char *device,
+				    struct resmon_c_top_rows *rows,
+				    char **error)
+{
+	struct resmon_jrpc_reg *regs;
+	size_t num_regs;
+	int64_t unknown;
+	int err;
+
+	err = resmon_client_regs(client, device, &regs, &num_regs, &unknown,
+				 error);
+	if (err != 0)
+		return err;
+
+	err = resmon_c_top_rows_alloc(rows, num_regs, error);
+	if (err != 0)
+		goto free_regs;
+
+	for (size_t i = 0; i < num_regs; i++) {
+		snprintf(rows->rows[i].name, sizeof(rows->rows[i].name),
+			 "%s EMADs", regs[i].name);
+		rows->rows[i].value = regs[i].processed + regs[i].ignored +
+				      regs[i].errors;
+	}
+
+free_regs:
+	free(regs);
+	return err;
+}
+
+static int resmon_c_top_sample(struct resmon_client *client,
+			       const struct resmon_c_top_args *args,
+			       struct resmon_c_top_sample *sample,
+			       char **error)
+{
+	struct resmon_jrpc_counter *counters;
+	struct resmon_c_top_rows *rows;
+	size_t num_counters;
+	int err;
+
+	err = resmon_client_stats(client, args->device, false, &counters,
+				  &num_counters, error);
+	if (err != 0)
+		return err;
+	sample->time_ns = resmon_c_top_now_ns();
+
+	rows = &sample->counters;
+	err = resmon_c_top_rows_alloc(rows, num_counters, error);
+	if (err != 0)
+		goto free_counters;
+
+	for (size_t i = 0; i < num_counters; i++) {
+		snprintf(rows->rows[i].name, sizeof(rows->rows[i].name),
+			 "%s", counters[i].descr);
+		rows->rows[i].value = counters[i].value;
+		rows->rows[i].capacity = counters[i].capacity;
+	}
+
+	switch (args->by) {
+	case RESMON_C_TOP_BY_NONE:
+		break;
+	case RESMON_C_TOP_BY_VR:
+		err = resmon_c_top_sample_vrs(client, args->device,
+					      &sample->breakdown, error);
+		break;
+	case RESMON_C_TOP_BY_REGION:
+		err = resmon_c_top_sample_regions(client, args->device,
+						  &sample->breakdown, error);
+		break;
+	case RESMON_C_TOP_BY_REG:
+		err = resmon_c_top_sample_regs(client, args->device,
+					       &sample->breakdown, error);
+		break;
+	}
+
+free_counters:
+	free(counters);
+	return err;
+}
+
+static void resmon_c_top_sample_fini(struct resmon_c_top_sample *sample)
+{
+	free(sample->breakdown.rows);
+	free(sample->counters.rows);
+	*sample = (struct resmon_c_top_sample) {};
+}
+
+/* Rows mostly stay where they were, look there first. */
+static const struct resmon_c_top_row *
+resmon_c_top_row_find(const struct resmon_c_top_rows *rows, size_t i,
+		      const char *name)
+{
+	if (i < rows->num_rows && strcmp(rows->rows[i].name, name) == 0)
+		return &rows->rows[i];
+
+	for (i = 0; i < rows->num_rows; i++)
+		if (strcmp(rows->rows[i].name, name) == 0)
+			return &rows->rows[i];
+	return NULL;
+}
+
+static void resmon_c_top_print_rows(const char *title,
+				    const struct resmon_c_top_rows *rows,
+				    const struct resmon_c_top_rows *prev_rows,
+				    double elapsed_s)
+{
+	fprintf(stderr, "%-30s%12s%12s%8s%10s%12s\n",
+		title, "Value", "Capacity", "Util", "Delta", "Rate [/s]");
+
+	for (size_t i = 0; i < rows->num_rows; i++) {
+		const struct resmon_c_top_row *row = &rows->rows[i];
+		const struct resmon_c_top_row *prev = NULL;
+		char capacity[24] = "-";
+		char delta[24] = "-";
+		char rate[24] = "-";
+		char util[16] = "-";
+
+		if (prev_rows != NULL)
+			prev = resmon_c_top_row_find(prev_rows, i, row->name);
+
+		if (row->capacity > 0) {
+			snprintf(capacity, sizeof(capacity), "%" PRId64,
+				 row->capacity);
+			snprintf(util, sizeof(util), "%.1f%%",
+				 row->value * 100.0 / row->capacity);
+		}
+		if (prev != NULL && elapsed_s > 0) {
+			snprintf(delta, sizeof(delta), "%+" PRId64,
+				 row->value - prev->value);
+			snprintf(rate, sizeof(rate), "%.1f",
+				 (row->value - prev->value) / elapsed_s);
+		}
+
+		fprintf(stderr, "%-30s%12" PRId64 "%12s%8s%10s%12s\n",
+			row->name, row->value, capacity, util, delta, rate);
+	}
+}
+
+static const char *const resmon_c_top_by_titles[] = {
+	[RESMON_C_TOP_BY_VR] = "Virtual router",
+	[RESMON_C_TOP_BY_REGION] = "ACL region",
+	[RESMON_C_TOP_BY_REG] = "Register",
+};
+
+static void resmon_c_top_print(const struct resmon_c_top_args *args,
+			       uint64_t seq,
+			       const struct resmon_c_top_sample *sample,
+			       const struct resmon_c_top_sample *prev)
+{
+	double elapsed_s = 0;
+
+	/* On a terminal, each sample replaces the last one. */
+	if (isatty(STDERR_FILENO))
+		fprintf(stderr, "\033[H\033[2J");
+	else if (seq != 0)
+		fprintf(stderr, "\n");
+
+	if (prev != NULL)
+		elapsed_s = (sample->time_ns - prev->time_ns) / 1e9;
+
+	fprintf(stderr, "Sample %" PRIu64 ", every %u ms", seq + 1,
+		args->interval_ms);
+	if (prev != NULL)
+		fprintf(stderr, ", %.3f s since the last one", elapsed_s);
+	fprintf(stderr, "\n\n");
+
+	resmon_c_top_print_rows("Resource", &sample->counters,
+				prev ? &prev->counters : NULL, elapsed_s);
+
+	if (args->by == RESMON_C_TOP_BY_NONE)
+		return;
+
+	fprintf(stderr, "\n");
+	resmon_c_top_print_rows(resmon_c_top_by_titles[args->by],
+				&sample->breakdown,
+				prev ? &prev->breakdown : NULL, elapsed_s);
+}
+
+static void resmon_c_top_timespec_add_ms(struct timespec *ts,
+					 unsigned int ms)
+{
+	ts->tv_sec += ms / 1000;
+	ts->tv_nsec += ms % 1000 * 1000000L;
+	if (ts->tv_nsec >= 1000000000) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000;
+	}
+}
+
+static bool resmon_c_top_timespec_before(const struct timespec *a,
+					 const struct timespec *b)
+{
+	return a->tv_sec < b->tv_sec ||
+	       (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+/* One client serves the whole session. The refreshes keep to a fixed
+ * schedule rather than drifting by the time that each one takes. After a
+ * refresh that overruns its interval, the schedule restarts a full interval
+ * on, rather than have the missed refreshes follow back to back while the
+ * daemon is busy.
+ */
+static int resmon_c_top_jrpc(const struct resmon_c_top_args *args)
+{
+	struct resmon_c_top_sample samples[2] = {};
+	struct resmon_client *client;
+	struct sigaction sa = {
+		.sa_handler = resmon_c_top_sig,
+	};
+	struct timespec next;
+	struct timespec now;
+	char *error;
+	int err = 0;
+
+	client = resmon_c_client_open();
+	if (client == NULL)
+		return -1;
+
+	/* Without SA_RESTART, a signal cuts a pending call short. */
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	for (uint64_t seq = 0; args->count == 0 || seq < args->count; seq++) {
+		struct resmon_c_top_sample *sample = &samples[seq % 2];
+		struct resmon_c_top_sample *prev = &samples[(seq + 1) % 2];
+
+		resmon_c_top_sample_fini(sample);
+		err = resmon_c_top_sample(client, args, sample, &error);
+		if (resmon_c_top_quit) {
+			if (err != 0)
+				free(error);
+			err = 0;
+			break;
+		}
+		if (err != 0) {
+			resmon_c_print_error(error);
+			break;
+		}
+
+		resmon_c_top_print(args, seq, sample, seq ? prev : NULL);
+
+		if (seq + 1 == args->count)
+			break;
+		resmon_c_top_timespec_add_ms(&next, args->interval_ms);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (resmon_c_top_timespec_before(&next, &now)) {
+			next = now;
+			resmon_c_top_timespec_add_ms(&next, args->interval_ms);
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		if (resmon_c_top_quit)
+			break;
+	}
+
+	resmon_c_top_sample_fini(&samples[1]);
+	resmon_c_top_sample_fini(&samples[0]);
+	resmon_client_close(client);
+	return err;
+}
+
+int resmon_c_top(int argc, char **argv)
+{
+	struct resmon_c_top_args args = {
+		.interval_ms = 1000,
+	};
+
+	while (argc > 0) {
+		if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+			args.device = *argv;
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "interval") == 0) {
+			char *endptr;
+			long long ms;
+
+			NEXT_ARG();
+			ms = strtoll(*argv, &endptr, 10);
+			if (*endptr != '\0' || ms <= 0 || ms > UINT_MAX) {
+				fprintf(stderr, "Invalid interval: %s\n",
+					*argv);
+				return -1;
+			}
+			args.interval_ms = ms;
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "count") == 0) {
+			char *endptr;
+
+			NEXT_ARG();
+			args.count = strtoull(*argv, &endptr, 10);
+			if (*endptr != '\0' || **argv == '-') {
+				fprintf(stderr, "Invalid count: %s\n", *argv);
+				return -1;
+			}
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "by") == 0) {
+			NEXT_ARG();
+			if (strcmp(*argv, "vr") == 0) {
+				args.by = RESMON_C_TOP_BY_VR;
+			} else if (strcmp(*argv, "region") == 0) {
+				args.by = RESMON_C_TOP_BY_REGION;
+			} else if (strcmp(*argv, "reg") == 0) {
+				args.by = RESMON_C_TOP_BY_REG;
+			} else {
+				fprintf(stderr, "Unrecognized breakdown: %s\n",
+					*argv);
+				return -1;
+			}
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "help") == 0) {
+			resmon_c_top_help();
+			return 0;
+		} else {
+			fprintf(stderr, "What is \"%s\"?\n", *argv);
+			return -1;
+		}
+		continue;
+
+incomplete_command:
+		fprintf(stderr, "Command line is not complete. Try option \"help\"\n");
+		return -1;
+	}
 
-	return resmon_c_stats_jrpc();
+	return resmon_c_top_jrpc(&args);
 }
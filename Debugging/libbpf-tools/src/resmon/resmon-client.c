@@ -0,0 +1,702 @@
+// SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <json-c/json_object.h>
+#include <json-c/json_tokener.h>
+
+#include "resmon.h"
+
+/* libresmon, the client side of the daemon's JSON-RPC protocol. A program
+ * that polls the daemon keeps one client open, which saves it setting up a
+ * socket for each query, and gets the results in the structures that the
+ * dissectors of resmon-jrpc.c fill in rather than as JSON.
+ */
+
+struct resmon_client {
+	struct resmon_sock cli;
+	struct resmon_sock peer;
+	int next_id;
+	/* The response to the last call, which its result points into. */
+	struct json_object *response;
+};
+
+struct resmon_client *resmon_client_open(const char *sockdir, char **error)
+{
+	struct resmon_client *client;
+	int err;
+
+	client = calloc(1, sizeof(*client));
+	if (client == NULL) {
+		resmon_fmterr(error, "Failed to allocate a client: %m");
+		return NULL;
+	}
+
+	err = resmon_sock_open_c(&client->cli, &client->peer, sockdir);
+	if (err != 0) {
+		resmon_fmterr(error, "Failed to open a socket to the daemon in %s",
+			      sockdir);
+		goto free_client;
+	}
+
+	err = resmon_client_set_timeout(client, RESMON_CLIENT_TIMEOUT_MS,
+					error);
+	if (err != 0)
+		goto close_cli;
+
+	client->next_id = 1;
+	return client;
+
+close_cli:
+	resmon_sock_close_c(&client->cli);
+free_client:
+	free(client);
+	return NULL;
+}
+
+/* A timeout of 0 waits for a response for as long as it takes. */
+int resmon_client_set_timeout(struct resmon_client *client,
+			      unsigned int timeout_ms, char **error)
+{
+	struct timeval tv = {
+		.tv_sec = timeout_ms / 1000,
+		.tv_usec = timeout_ms % 1000 * 1000,
+	};
+	int err;
+
+	err = setsockopt(client->cli.fd, SOL_SOCKET, SO_RCVTIMEO, &tv,
+			 sizeof(tv));
+	if (err != 0) {
+		resmon_fmterr(error, "Failed to set the response timeout: %m");
+		return -1;
+	}
+
+	return 0;
+}
+
+void resmon_client_close(struct resmon_client *client)
+{
+	json_object_put(client->response);
+	resmon_sock_close_c(&client->cli);
+	free(client);
+}
+
+static int resmon_client_nomem(const char *method, char **error)
+{
+	resmon_fmterr(error, "Failed to form the %s request", method);
+	return -1;
+}
+
+static struct json_object *resmon_client_recv(struct resmon_client *client,
+					      char **error)
+{
+	struct json_object *response;
+	struct resmon_sock peer;
+	char *buf;
+	int err;
+
+	err = resmon_sock_recv(&client->cli, &peer, &buf);
+	if (err != 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			resmon_fmterr(error, "Timed out waiting for an RPC response");
+		else
+			resmon_fmterr(error, "Failed to receive an RPC response");
+		return NULL;
+	}
+	if (peer.msg_fd >= 0)
+		close(peer.msg_fd);
+
+	response = json_tokener_parse(buf);
+	free(buf);
+	if (response == NULL)
+		resmon_fmterr(error, "Failed to parse RPC response as JSON");
+	return response;
+}
+
+static int resmon_client_error(struct json_object *error_obj, char **error)
+{
+	struct json_object *data;
+	char *dissect_error;
+	const char *message;
+	int64_t code;
+	int err;
+
+	err = resmon_jrpc_dissect_error(error_obj, &code, &message, &data,
+					&dissect_error);
+	if (err != 0) {
+		resmon_fmterr(error, "Invalid error object: %s", dissect_error);
+		free(dissect_error);
+		return -1;
+	}
+
+	if (data != NULL)
+		resmon_fmterr(error, "Error %" PRId64 ": %s (%s)", code, message,
+			      json_object_to_json_string(data));
+	else
+		resmon_fmterr(error, "Error %" PRId64 ": %s", code, message);
+	return -1;
+}
+
+/* Call the method and wait for its response, passing fd along with the
+ * request unless it is negative. The result is valid until the next call.
+ */
+int resmon_client_call(struct resmon_client *client, const char *method,
+		       struct json_object *params_obj, int fd,
+		       enum json_type result_type,
+		       struct json_object **result, char **error)
+{
+	struct json_object *request;
+	struct json_object *result_obj;
+	struct json_object *id_obj;
+	int id = client->next_id++;
+	char *dissect_error;
+	bool is_error;
+	int err;
+
+	json_object_put(client->response);
+	client->response = NULL;
+
+	request = resmon_jrpc_new_request(id, method);
+	if (request == NULL)
+		return resmon_client_nomem(method, error);
+
+	if (params_obj != NULL &&
+	    json_object_object_add(request, "params",
+				   json_object_get(params_obj))) {
+		json_object_put(params_obj);
+		json_object_put(request);
+		return resmon_client_nomem(method, error);
+	}
+
+	if (fd >= 0)
+		err = resmon_jrpc_send_fd(&client->peer, request, fd);
+	else
+		err = resmon_jrpc_send(&client->peer, request);
+	json_object_put(request);
+	if (err != 0) {
+		resmon_fmterr(error, "Failed to send the RPC message: %m");
+		return -1;
+	}
+
+	/* The response to an earlier call that timed out may still be queued.
+	 * Skip it. An error response with a null ID is to a request that the
+	 * daemon could not make out, which can only be this one.
+	 */
+	do {
+		json_object_put(client->response);
+		client->response = resmon_client_recv(client, error);
+		if (client->response == NULL)
+			return -1;
+
+		err = resmon_jrpc_dissect_response(client->response, &id_obj,
+						   &result_obj, &is_error,
+						   &dissect_error);
+		if (err != 0) {
+			resmon_fmterr(error, "Invalid response object: %s",
+				      dissect_error);
+			free(dissect_error);
+			return -1;
+		}
+	} while (!(is_error && id_obj == NULL) &&
+		 json_object_get_int64(id_obj) != id);
+
+	if (is_error)
+		return resmon_client_error(result_obj, error);
+
+	if (json_object_get_type(result_obj) != result_type) {
+		resmon_fmterr(error, "Unexpected result type: %s expected, got %s",
+			      json_type_to_name(result_type),
+			      json_type_to_name(json_object_get_type(result_obj)));
+		return -1;
+	}
+
+	*result = result_obj;
+	return 0;
+}
+
+/* Prefix the error of a result dissector with the method. */
+static int resmon_client_dissected(int err, const char *method, char **error)
+{
+	char *dissect_error;
+
+	if (err == 0)
+		return 0;
+
+	dissect_error = *error;
+	resmon_fmterr(error, "Invalid %s result: %s", method, dissect_error);
+	free(dissect_error);
+	return err;
+}
+
+/* Parameters of the methods that take an optional device selector. */
+static struct json_object *resmon_client_params_dev(const char *device)
+{
+	struct json_object *params_obj;
+
+	params_obj = json_object_new_object();
+	if (params_obj == NULL)
+		return NULL;
+
+	if (device != NULL &&
+	    resmon_jrpc_object_add_str(params_obj, "device", device)) {
+		json_object_put(params_obj);
+		return NULL;
+	}
+
+	return params_obj;
+}
+
+static int resmon_client_call_dev(struct resmon_client *client,
+				  const char *method, const char *device,
+				  struct json_object **result, char **error)
+{
+	struct json_object *params_obj;
+	int err;
+
+	params_obj = resmon_client_params_dev(device);
+	if (params_obj == NULL)
+		return resmon_client_nomem(method, error);
+
+	err = resmon_client_call(client, method, params_obj, -1,
+				 json_type_object, result, error);
+	json_object_put(params_obj);
+	return err;
+}
+
+int resmon_client_ping(struct resmon_client *client, char **error)
+{
+	struct json_object *params_obj;
+	struct json_object *result;
+	int err;
+	int nr;
+	int r;
+
+	r = rand();
+	params_obj = json_object_new_int(r);
+	if (params_obj == NULL)
+		return resmon_client_nomem("ping", error);
+
+	err = resmon_client_call(client, "ping", params_obj, -1,
+				 json_type_int, &result, error);
+	json_object_put(params_obj);
+	if (err != 0)
+		return err;
+
+	nr = json_object_get_int(result);
+	if (nr != r) {
+		resmon_fmterr(error, "Unexpected ping response: sent %d, got %d",
+			      r, nr);
+		return -1;
+	}
+
+	return 0;
+}
+
+int resmon_client_stop(struct resmon_client *client, bool *stopping,
+		       char **error)
+{
+	struct json_object *result;
+	int err;
+
+	err = resmon_client_call(client, "stop", NULL, -1, json_type_boolean,
+				 &result, error);
+	if (err != 0)
+		return err;
+
+	*stopping = json_object_get_boolean(result);
+	return 0;
+}
+
+/* A negative time_ns leaves the clock of the daemon alone. */
+int resmon_client_emad(struct resmon_client *client, const char *device,
+		       const char *payload, size_t payload_len,
+		       int64_t time_ns, char **error)
+{
+	struct json_object *payload_obj;
+	struct json_object *params_obj;
+	struct json_object *result;
+	int err;
+
+	params_obj = resmon_client_params_dev(device);
+	if (params_obj == NULL)
+		return resmon_client_nomem("emad", error);
+
+	payload_obj = json_object_new_string_len(payload, payload_len);
+	if (payload_obj == NULL ||
+	    json_object_object_add(params_obj, "payload", payload_obj)) {
+		json_object_put(payload_obj);
+		err = resmon_client_nomem("emad", error);
+		goto put_params_obj;
+	}
+
+	if (time_ns >= 0 &&
+	    resmon_jrpc_object_add_int(params_obj, "time_ns", time_ns)) {
+		err = resmon_client_nomem("emad", error);
+		goto put_params_obj;
+	}
+
+	err = resmon_client_call(client, "emad", params_obj, -1,
+				 json_type_null, &result, error);
+
+put_params_obj:
+	json_object_put(params_obj);
+	return err;
+}
+
+/* The EMADs are in fd as records of a big-endian 32-bit length and the
+ * EMAD, which only a daemon in mock mode takes.
+ */
+int resmon_client_emads(struct resmon_client *client, const char *device,
+			int fd, struct resmon_jrpc_emads *emads,
+			char **error)
+{
+	struct json_object *params_obj;
+	struct json_object *result;
+	int err;
+
+	params_obj = resmon_client_params_dev(device);
+	if (params_obj == NULL)
+		return resmon_client_nomem("emads", error);
+
+	err = resmon_client_call(client, "emads", params_obj, fd,
+				 json_type_object, &result, error);
+	if (err != 0)
+		goto put_params_obj;
+
+	err = resmon_jrpc_dissect_emads(result, emads, error);
+	err = resmon_client_dissected(err, "emads", error);
+
+put_params_obj:
+	json_object_put(params_obj);
+	return err;
+}
+
+int resmon_client_stats(struct resmon_client *client, const char *device,
+			bool forecast, struct resmon_jrpc_counter **counters,
+			size_t *num_counters, char **error)
+{
+	struct json_object *params_obj;
+	struct json_object *result;
+	int err;
+
+	params_obj = resmon_client_params_dev(device);
+	if (params_obj == NULL)
+		return resmon_client_nomem("stats", error);
+
+	if (forecast &&
+	    resmon_jrpc_object_add_bool(params_obj, "forecast", true)) {
+		err = resmon_client_nomem("stats", error);
+		goto put_params_obj;
+	}
+
+	err = resmon_client_call(client, "stats", params_obj, -1,
+				 json_type_object, &result, error);
+	if (err != 0)
+		goto put_params_obj;
+
+	err = resmon_jrpc_dissect_stats(result, counters, num_counters, error);
+	err = resmon_client_dissected(err, "stats", error);
+
+put_params_obj:
+	json_object_put(params_obj);
+	return err;
+}
+
+int resmon_client_regs(struct resmon_client *client, const char *device,
+		       struct resmon_jrpc_reg **regs, size_t *num_regs,
+		       int64_t *unknown, char **error)
+{
+	struct json_object *result;
+	int err;
+
+	err = resmon_client_call_dev(client, "regs", device, &result, error);
+	if (err != 0)
+		return err;
+
+	err = resmon_jrpc_dissect_regs(result, regs, num_regs, unknown, error);
+	return resmon_client_dissected(err, "regs", error);
+}
+
+int resmon_client_acl(struct resmon_client *client, const char *device,
+		      struct resmon_jrpc_acl_region **regions,
+		      size_t *num_regions, char **error)
+{
+	struct json_object *result;
+	int err;
+
+	err = resmon_client_call_dev(client, "acl", device, &result, error);
+	if (err != 0)
+		return err;
+
+	err = resmon_jrpc_dissect_acl(result, regions, num_regions, error);
+	return resmon_client_dissected(err, "acl", error);
+}
+
+int resmon_client_lpm(struct resmon_client *client, const char *device,
+		      struct resmon_jrpc_lpm_vr **vrs, size_t *num_vrs,
+		      char **error)
+{
+	struct json_object *result;
+	int err;
+
+	err = resmon_client_call_dev(client, "lpm", device, &result, error);
+	if (err != 0)
+		return err;
+
+	err = resmon_jrpc_dissect_lpm(result, vrs, num_vrs, error);
+	return resmon_client_dissected(err, "lpm", error);
+}
+
+int resmon_client_churn(struct resmon_client *client, const char *device,
+			int64_t top,
+			struct resmon_jrpc_churn **regs, size_t *num_regs,
+			struct resmon_jrpc_churn **tables, size_t *num_tables,
+			struct resmon_jrpc_churn_key **keys, size_t *num_keys,
+			char **error)
+{
+	struct json_object *params_obj;
+	struct json_object *result;
+	int err;
+
+	params_obj = resmon_client_params_dev(device);
+	if (params_obj == NULL)
+		return resmon_client_nomem("churn", error);
+
+	if (resmon_jrpc_object_add_int(params_obj, "top", top)) {
+		err = resmon_client_nomem("churn", error);
+		goto put_params_obj;
+	}
+
+	err = resmon_client_call(client, "churn", params_obj, -1,
+				 json_type_object, &result, error);
+	if (err != 0)
+		goto put_params_obj;
+
+	err = resmon_jrpc_dissect_churn(result, regs, num_regs, tables,
+					num_tables, keys, num_keys, error);
+	err = resmon_client_dissected(err, "churn", error);
+
+put_params_obj:
+	json_object_put(params_obj);
+	return err;
+}
+
+/* Free the result with resmon_jrpc_bursts_free(). */
+int resmon_client_bursts(struct resmon_client *client, const char *device,
+			 struct resmon_jrpc_burst **bursts, size_t *num_bursts,
+			 char **error)
+{
+	struct json_object *result;
+	int err;
+
+	err = resmon_client_call_dev(client, "bursts", device, &result, error);
+	if (err != 0)
+		return err;
+
+	err = resmon_jrpc_dissect_bursts(result, bursts, num_bursts, error);
+	return resmon_client_dissected(err, "bursts", error);
+}
+
+static struct json_object *
+resmon_client_plan_item(const struct resmon_jrpc_plan_item *item)
+{
+	struct json_object *item_obj;
+
+	item_obj = json_object_new_object();
+	if (item_obj == NULL)
+		return NULL;
+
+	if (resmon_jrpc_object_add_str(item_obj, "type",
+				       resmon_jrpc_plan_type_name(item->type)) ||
+	    resmon_jrpc_object_add_int(item_obj, "count", item->count))
+		goto put_item_obj;
+
+	switch (item->type) {
+	case RESMON_JRPC_PLAN_ROUTE:
+		if (resmon_jrpc_object_add_int(item_obj, "prefix_len",
+					       item->prefix_len))
+			goto put_item_obj;
+		/* Fall through. */
+	case RESMON_JRPC_PLAN_NEIGH:
+		if (resmon_jrpc_object_add_str(item_obj, "protocol",
+					       item->ipv6 ? "ipv6" : "ipv4"))
+			goto put_item_obj;
+		break;
+	case RESMON_JRPC_PLAN_ACL:
+		if (resmon_jrpc_object_add_int(item_obj, "key_blocks",
+					       item->key_blocks))
+			goto put_item_obj;
+		break;
+	case RESMON_JRPC_PLAN_ACTSET:
+	case RESMON_JRPC_PLAN_ADJ:
+	case RESMON_JRPC_PLAN_FDB:
+		break;
+	}
+
+	return item_obj;
+
+put_item_obj:
+	json_object_put(item_obj);
+	return NULL;
+}
+
+int resmon_client_plan(struct resmon_client *client, const char *device,
+		       const struct resmon_jrpc_plan_item *items,
+		       size_t num_items, struct resmon_jrpc_plan *plan,
+		       char **error)
+{
+	struct json_object *params_obj;
+	struct json_object *items_obj;
+	struct json_object *result;
+	int err;
+
+	params_obj = resmon_client_params_dev(device);
+	if (params_obj == NULL)
+		return resmon_client_nomem("plan", error);
+
+	items_obj = json_object_new_array();
+	if (items_obj == NULL ||
+	    json_object_object_add(params_obj, "items", items_obj)) {
+		json_object_put(items_obj);
+		err = resmon_client_nomem("plan", error);
+		goto put_params_obj;
+	}
+
+	for (size_t i = 0; i < num_items; i++) {
+		struct json_object *item_obj;
+
+		item_obj = resmon_client_plan_item(&items[i]);
+		if (item_obj == NULL ||
+		    json_object_array_add(items_obj, item_obj)) {
+			json_object_put(item_obj);
+			err = resmon_client_nomem("plan", error);
+			goto put_params_obj;
+		}
+	}
+
+	err = resmon_client_call(client, "plan", params_obj, -1,
+				 json_type_object, &result, error);
+	if (err != 0)
+		goto put_params_obj;
+
+	err = resmon_jrpc_dissect_plan(result, plan, error);
+	err = resmon_client_dissected(err, "plan", error);
+
+put_params_obj:
+	json_object_put(params_obj);
+	return err;
+}
+
+int resmon_client_kvdl(struct resmon_client *client, const char *device,
+		       struct resmon_jrpc_kvdl **devs, size_t *num_devs,
+		       char **error)
+{
+	struct json_object *result;
+	int err;
+
+	err = resmon_client_call_dev(client, "kvdl", device, &result, error);
+	if (err != 0)
+		return err;
+
+	err = resmon_jrpc_dissect_kvdl(result, devs, num_devs, error);
+	return resmon_client_dissected(err, "kvdl", error);
+}
+
+int resmon_client_health(struct resmon_client *client,
+			 struct resmon_jrpc_health *health, char **error)
+{
+	struct json_object *result;
+	int err;
+
+	err = resmon_client_call(client, "health", NULL, -1, json_type_object,
+				 &result, error);
+	if (err != 0)
+		return err;
+
+	err = resmon_jrpc_dissect_health(result, health, error);
+	return resmon_client_dissected(err, "health", error);
+}
+
+int resmon_client_errors(struct resmon_client *client, const char *device,
+			 struct resmon_jrpc_errors *errors, char **error)
+{
+	struct json_object *result;
+	int err;
+
+	err = resmon_client_call_dev(client, "errors", device, &result, error);
+	if (err != 0)
+		return err;
+
+	err = resmon_jrpc_dissect_errors(result, errors, error);
+	return resmon_client_dissected(err, "errors", error);
+}
+
+int resmon_client_recon(struct resmon_client *client, const char *device,
+			bool check, struct resmon_jrpc_recon *recon,
+			char **error)
+{
+	struct json_object *params_obj;
+	struct json_object *result;
+	int err;
+
+	params_obj = resmon_client_params_dev(device);
+	if (params_obj == NULL)
+		return resmon_client_nomem("recon", error);
+
+	if (resmon_jrpc_object_add_bool(params_obj, "check", check)) {
+		err = resmon_client_nomem("recon", error);
+		goto put_params_obj;
+	}
+
+	err = resmon_client_call(client, "recon", params_obj, -1,
+				 json_type_object, &result, error);
+	if (err != 0)
+		goto put_params_obj;
+
+	err = resmon_jrpc_dissect_recon(result, recon, error);
+	err = resmon_client_dissected(err, "recon", error);
+
+put_params_obj:
+	json_object_put(params_obj);
+	return err;
+}
+
+/* A NULL table covers all the tables. */
+int resmon_client_ages(struct resmon_client *client, const char *device,
+		       const char *table, int64_t top, bool by_idle,
+		       struct resmon_jrpc_ages *ages, char **error)
+{
+	struct json_object *params_obj;
+	struct json_object *result;
+	int err;
+
+	params_obj = resmon_client_params_dev(device);
+	if (params_obj == NULL)
+		return resmon_client_nomem("ages", error);
+
+	if ((table != NULL &&
+	     resmon_jrpc_object_add_str(params_obj, "table", table)) ||
+	    resmon_jrpc_object_add_int(params_obj, "top", top) ||
+	    resmon_jrpc_object_add_str(params_obj, "by",
+				       by_idle ? "idle" : "age")) {
+		err = resmon_client_nomem("ages", error);
+		goto put_params_obj;
+	}
+
+	err = resmon_client_call(client, "ages", params_obj, -1,
+				 json_type_object, &result, error);
+	if (err != 0)
+		goto put_params_obj;
+
+	err = resmon_jrpc_dissect_ages(result, ages, error);
+	err = resmon_client_dissected(err, "ages", error);
+
+put_params_obj:
+	json_object_put(params_obj);
+	return err;
+}
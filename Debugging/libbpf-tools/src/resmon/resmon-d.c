@@ -1,11 +1,13 @@
 // SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
 #include <errno.h>
+#include <inttypes.h>
 #include <poll.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <syslog.h>
+#include <time.h>
 #include <json-c/json_object.h>
 #include <json-c/json_tokener.h>
 #include <systemd/sd-daemon.h>
@@ -156,141 +158,2578 @@ static const char *const resmon_d_counter_names[] = {
 #undef RESMON_COUNTER_EXPAND_AS_NAME_STR
 #undef RESMON_COUNTER_EXPAND_AS_DESC
 
+/* A forecast of the selected devices. Each device has a KVD of its own, so
+ * the slopes add up, but the time to exhaustion is that of the device that
+ * runs out first.
+ */
+struct resmon_d_forecast {
+	double ew_slope;
+	double window_slope;
+	/* Seconds, or -1 if the usage grows on none of the devices. */
+	int64_t exhaustion_s;
+};
+
+/* All counters of a device draw from the same KVD. Each of them is
+ * therefore forecast to run out when it alone has used up the space left
+ * by the total usage. The steeper of the two slopes is taken.
+ */
+static int64_t resmon_d_exhaustion_s(const struct resmon_stat_trend *trend,
+				     int64_t total, uint64_t capacity)
+{
+	int64_t headroom = (int64_t) capacity - total;
+	double slope;
+
+	slope = trend->ew_slope > trend->window_slope ?
+		trend->ew_slope : trend->window_slope;
+	if (slope <= 0)
+		return -1;
+
+	if (headroom < 0)
+		headroom = 0;
+	return headroom / slope;
+}
+
+static void resmon_d_forecast_add(struct resmon_d_forecast *forecast,
+				  const struct resmon_stat_trend *trend,
+				  int64_t total, uint64_t capacity)
+{
+	int64_t exhaustion_s = resmon_d_exhaustion_s(trend, total, capacity);
+
+	forecast->ew_slope += trend->ew_slope;
+	forecast->window_slope += trend->window_slope;
+	if (exhaustion_s >= 0 &&
+	    (forecast->exhaustion_s < 0 ||
+	     exhaustion_s < forecast->exhaustion_s))
+		forecast->exhaustion_s = exhaustion_s;
+}
+
+static int
+resmon_d_stats_attach_forecast(struct json_object *counter_obj,
+			       const struct resmon_d_forecast *forecast)
+{
+	struct json_object *forecast_obj;
+	int rc;
+
+	forecast_obj = json_object_new_object();
+	if (forecast_obj == NULL)
+		return -1;
+
+	rc = resmon_jrpc_object_add_double(forecast_obj, "ew_slope",
+					   forecast->ew_slope);
+	if (rc != 0)
+		goto put_forecast_obj;
+
+	rc = resmon_jrpc_object_add_double(forecast_obj, "window_slope",
+					   forecast->window_slope);
+	if (rc != 0)
+		goto put_forecast_obj;
+
+	if (forecast->exhaustion_s >= 0) {
+		rc = resmon_jrpc_object_add_int(forecast_obj, "exhaustion_s",
+						forecast->exhaustion_s);
+		if (rc != 0)
+			goto put_forecast_obj;
+	}
+
+	rc = json_object_object_add(counter_obj, "forecast", forecast_obj);
+	if (rc != 0)
+		goto put_forecast_obj;
+
+	return 0;
+
+put_forecast_obj:
+	json_object_put(forecast_obj);
+	return -1;
+}
+
 static int resmon_d_stats_attach_counter(struct json_object *counters_obj,
 					 const char *name, const char *descr,
-					 int64_t value, uint64_t capacity)
+					 int64_t value, uint64_t capacity,
+					 const struct resmon_d_forecast *forecast)
+{
+	struct json_object *counter_obj;
+	int rc;
+
+	counter_obj = json_object_new_object();
+	if (counter_obj == NULL)
+		return -1;
+
+	rc = resmon_jrpc_object_add_str(counter_obj, "name", name);
+	if (rc != 0)
+		goto put_counter_obj;
+
+	rc = resmon_jrpc_object_add_str(counter_obj, "descr", descr);
+	if (rc != 0)
+		goto put_counter_obj;
+
+	rc = resmon_jrpc_object_add_int(counter_obj, "value", value);
+	if (rc != 0)
+		goto put_counter_obj;
+
+	rc = resmon_jrpc_object_add_int(counter_obj, "capacity", capacity);
+	if (rc != 0)
+		goto put_counter_obj;
+
+	if (forecast != NULL) {
+		rc = resmon_d_stats_attach_forecast(counter_obj, forecast);
+		if (rc != 0)
+			goto put_counter_obj;
+	}
+
+	rc = json_object_array_add(counters_obj, counter_obj);
+	if (rc)
+		goto put_counter_obj;
+
+	return 0;
+
+put_counter_obj:
+	json_object_put(counter_obj);
+	return -1;
+}
+
+/* Resolve the optional "device" selector of a request. Without a selector,
+ * all devices are selected and the caller is expected to aggregate.
+ */
+static int resmon_d_select_devs(struct resmon_back *back, const char *device,
+				struct resmon_dev **devs, size_t *num_devs,
+				char **error)
+{
+	struct resmon_dev *dev;
+
+	if (device == NULL) {
+		*devs = back->devs;
+		*num_devs = back->num_devs;
+		return 0;
+	}
+
+	dev = resmon_back_find_dev(back, device);
+	if (dev == NULL) {
+		resmon_fmterr(error, "Unknown device %s", device);
+		return -1;
+	}
+
+	*devs = dev;
+	*num_devs = 1;
+	return 0;
+}
+
+static void resmon_d_handle_stats(struct resmon_back *back,
+				  struct resmon_sock *peer,
+				  struct json_object *params_obj,
+				  struct json_object *id)
+{
+	struct resmon_d_forecast forecast[resmon_counter_count + 1];
+	struct resmon_stat_counters counters = {};
+	struct json_object *counters_obj;
+	struct json_object *result_obj;
+	struct resmon_dev *devs;
+	struct json_object *obj;
+	uint64_t capacity = 0;
+	const char *device;
+	size_t num_devs;
+	bool with_forecast;
+	char *error;
+	int rc;
+
+	/* The request may carry a "device" selector in the form
+	 * "bus_name/dev_name". Without it, the values and capacities of all
+	 * devices are summed up.
+	 *
+	 * With "forecast": true, each counter additionally carries a
+	 * "forecast" object with the exponentially weighted slope
+	 * "ew_slope" and the regression slope "window_slope" of its usage
+	 * in entries per second, and "exhaustion_s", the number of seconds
+	 * until the capacity runs out. The latter is absent if the usage is
+	 * not growing. Without a "device" selector, the slopes are summed up
+	 * and "exhaustion_s" is that of the device that runs out first.
+	 *
+	 * The response is as follows:
+	 *
+	 * {
+	 *     "id": ...,
+	 *     "result": {
+	 *         "counters": [
+	 *             {
+	 *                 "name": symbolic counter enum name,
+	 *                 "description": string with human-readable descr.,
+	 *                 "value": integer, value of the counter
+	 *             },
+	 *             ....
+	 *         ]
+	 *     }
+	 * }
+	 */
+
+	rc = resmon_jrpc_dissect_params_stats(params_obj, &device,
+					      &with_forecast, &error);
+	if (rc) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		return;
+	}
+
+	rc = resmon_d_select_devs(back, device, &devs, &num_devs, &error);
+	if (rc) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		return;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(forecast); i++)
+		forecast[i] = (struct resmon_d_forecast) {
+			.exhaustion_s = -1,
+		};
+
+	for (size_t i = 0; i < num_devs; i++) {
+		struct resmon_stat_forecast dev_forecast;
+		struct resmon_stat_counters dev_counters;
+		uint64_t dev_capacity;
+
+		rc = back->cls->get_capacity(back, &devs[i], &dev_capacity,
+					     &error);
+		if (rc != 0) {
+			resmon_d_respond_error(peer, id, resmon_jrpc_e_capacity,
+					       "Issue while retrieving capacity",
+					       error);
+			free(error);
+			return;
+		}
+		capacity += dev_capacity;
+
+		dev_counters = resmon_stat_counters(devs[i].stat);
+		for (size_t j = 0; j < ARRAY_SIZE(counters.values); j++)
+			counters.values[j] += dev_counters.values[j];
+		counters.total += dev_counters.total;
+
+		if (!with_forecast)
+			continue;
+		dev_forecast = resmon_stat_forecast(devs[i].stat);
+		for (size_t j = 0; j < ARRAY_SIZE(dev_forecast.values); j++)
+			resmon_d_forecast_add(&forecast[j],
+					      &dev_forecast.values[j],
+					      dev_counters.total, dev_capacity);
+		resmon_d_forecast_add(&forecast[resmon_counter_count],
+				      &dev_forecast.total, dev_counters.total,
+				      dev_capacity);
+	}
+
+	obj = resmon_jrpc_new_object(id);
+	if (obj == NULL)
+		return;
+
+	result_obj = json_object_new_object();
+	if (result_obj == NULL)
+		goto put_obj;
+
+	counters_obj = json_object_new_array();
+	if (counters_obj == NULL)
+		goto put_result_obj;
+
+	for (int i = 0; i < ARRAY_SIZE(counters.values); i++) {
+		rc = resmon_d_stats_attach_counter(counters_obj,
+				    resmon_d_counter_names[i],
+				    resmon_d_counter_descriptions[i],
+				    counters.values[i], capacity,
+				    with_forecast ? &forecast[i] : NULL);
+		if (rc)
+			goto put_counters_obj;
+	}
+
+	rc = resmon_d_stats_attach_counter(counters_obj, "TOTAL", "Total",
+				    counters.total, capacity,
+				    with_forecast ?
+				    &forecast[resmon_counter_count] : NULL);
+	if (rc)
+		goto put_counters_obj;
+
+	rc = json_object_object_add(result_obj, "counters", counters_obj);
+	if (rc != 0)
+		goto put_counters_obj;
+
+	rc = json_object_object_add(obj, "result", result_obj);
+	if (rc != 0)
+		goto put_result_obj;
+
+	resmon_jrpc_send(peer, obj);
+	json_object_put(obj);
+	return;
+
+put_counters_obj:
+	json_object_put(counters_obj);
+put_result_obj:
+	json_object_put(result_obj);
+put_obj:
+	json_object_put(obj);
+	resmon_d_respond_memerr(peer, id);
+}
+
+#define RESMON_REG_EXPAND_AS_NAME_STR(NAME, name, ID) \
+	[RESMON_REG_ ## NAME] = #NAME,
+#define RESMON_REG_EXPAND_AS_ID(NAME, name, ID) \
+	[RESMON_REG_ ## NAME] = ID,
+
+static const char *const resmon_d_reg_names[] = {
+	RESMON_REGS(RESMON_REG_EXPAND_AS_NAME_STR)
+};
+
+static const uint16_t resmon_d_reg_ids[] = {
+	RESMON_REGS(RESMON_REG_EXPAND_AS_ID)
+};
+
+#undef RESMON_REG_EXPAND_AS_ID
+#undef RESMON_REG_EXPAND_AS_NAME_STR
+
+static int resmon_d_regs_attach_reg(struct json_object *regs_obj,
+				    enum resmon_reg reg,
+				    const struct resmon_stat_reg_stat *reg_stat)
+{
+	struct json_object *reg_obj;
+	int rc;
+
+	reg_obj = json_object_new_object();
+	if (reg_obj == NULL)
+		return -1;
+
+	rc = resmon_jrpc_object_add_str(reg_obj, "name",
+					resmon_d_reg_names[reg]);
+	if (rc != 0)
+		goto put_reg_obj;
+
+	rc = resmon_jrpc_object_add_int(reg_obj, "id", resmon_d_reg_ids[reg]);
+	if (rc != 0)
+		goto put_reg_obj;
+
+	rc = resmon_jrpc_object_add_int(reg_obj, "processed",
+					reg_stat->processed);
+	if (rc != 0)
+		goto put_reg_obj;
+
+	rc = resmon_jrpc_object_add_int(reg_obj, "ignored", reg_stat->ignored);
+	if (rc != 0)
+		goto put_reg_obj;
+
+	rc = resmon_jrpc_object_add_int(reg_obj, "errors", reg_stat->errors);
+	if (rc != 0)
+		goto put_reg_obj;
+
+	rc = resmon_jrpc_object_add_int(reg_obj, "time_ns", reg_stat->time_ns);
+	if (rc != 0)
+		goto put_reg_obj;
+
+	rc = json_object_array_add(regs_obj, reg_obj);
+	if (rc)
+		goto put_reg_obj;
+
+	return 0;
+
+put_reg_obj:
+	json_object_put(reg_obj);
+	return -1;
+}
+
+static void resmon_d_handle_regs(struct resmon_back *back,
+				 struct resmon_sock *peer,
+				 struct json_object *params_obj,
+				 struct json_object *id)
+{
+	struct resmon_stat_reg_stats reg_stats = {};
+	struct json_object *result_obj;
+	struct json_object *regs_obj;
+	struct resmon_dev *devs;
+	struct json_object *obj;
+	const char *device;
+	size_t num_devs;
+	char *error;
+	int rc;
+
+	/* The request takes the same optional "device" selector as "stats".
+	 * The response is as follows:
+	 *
+	 * {
+	 *     "id": ...,
+	 *     "result": {
+	 *         "registers": [
+	 *             {
+	 *                 "name": "RALUE",
+	 *                 "id": 32787,
+	 *                 "processed": number of EMADs that changed state,
+	 *                 "ignored": number of EMADs that were no-ops,
+	 *                 "errors": number of EMADs that failed to process,
+	 *                 "time_ns": cumulative processing time
+	 *             },
+	 *             ....
+	 *         ],
+	 *         "unknown": number of EMADs not attributable to a register
+	 *     }
+	 * }
+	 */
+
+	rc = resmon_jrpc_dissect_params_device(params_obj, &device, &error);
+	if (rc) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		return;
+	}
+
+	rc = resmon_d_select_devs(back, device, &devs, &num_devs, &error);
+	if (rc) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		return;
+	}
+
+	for (size_t i = 0; i < num_devs; i++) {
+		struct resmon_stat_reg_stats dev_reg_stats;
+
+		dev_reg_stats = resmon_stat_reg_stats(devs[i].stat);
+		for (size_t j = 0; j < resmon_reg_count; j++) {
+			struct resmon_stat_reg_stat *sum = &reg_stats.regs[j];
+			struct resmon_stat_reg_stat *add =
+				&dev_reg_stats.regs[j];
+
+			sum->processed += add->processed;
+			sum->ignored += add->ignored;
+			sum->errors += add->errors;
+			sum->time_ns += add->time_ns;
+		}
+		reg_stats.unknown += dev_reg_stats.unknown;
+	}
+
+	obj = resmon_jrpc_new_object(id);
+	if (obj == NULL)
+		return;
+
+	result_obj = json_object_new_object();
+	if (result_obj == NULL)
+		goto put_obj;
+
+	regs_obj = json_object_new_array();
+	if (regs_obj == NULL)
+		goto put_result_obj;
+
+	for (int i = 0; i < resmon_reg_count; i++) {
+		rc = resmon_d_regs_attach_reg(regs_obj, i, &reg_stats.regs[i]);
+		if (rc)
+			goto put_regs_obj;
+	}
+
+	rc = json_object_object_add(result_obj, "registers", regs_obj);
+	if (rc)
+		goto put_regs_obj;
+
+	rc = resmon_jrpc_object_add_int(result_obj, "unknown",
+					reg_stats.unknown);
+	if (rc)
+		goto put_result_obj;
+
+	rc = json_object_object_add(obj, "result", result_obj);
+	if (rc)
+		goto put_result_obj;
+
+	resmon_jrpc_send(peer, obj);
+	json_object_put(obj);
+	return;
+
+put_regs_obj:
+	json_object_put(regs_obj);
+put_result_obj:
+	json_object_put(result_obj);
+put_obj:
+	json_object_put(obj);
+	resmon_d_respond_memerr(peer, id);
+}
+
+static int resmon_d_attach_dev_name(struct json_object *obj,
+				    const struct resmon_dev *dev)
+{
+	char name[RESMON_BPF_BUS_NAME_LEN + RESMON_BPF_DEV_NAME_LEN];
+
+	snprintf(name, sizeof(name), "%s/%s", dev->bus_name, dev->dev_name);
+	return resmon_jrpc_object_add_str(obj, "device", name);
+}
+
+struct resmon_d_acl_ctx {
+	const struct resmon_dev *dev;
+	struct json_object *regions_obj;
+};
+
+static int
+resmon_d_acl_attach_region(const struct resmon_stat_ptar_region *region,
+			   void *priv)
+{
+	char tcam_region_info[2 * sizeof(region->tcam_region_info) + 1];
+	struct resmon_d_acl_ctx *ctx = priv;
+	struct json_object *region_obj;
+	int rc;
+
+	for (size_t i = 0; i < sizeof(region->tcam_region_info); i++)
+		sprintf(&tcam_region_info[2 * i], "%02x",
+			region->tcam_region_info.tcam_region_info[i]);
+
+	region_obj = json_object_new_object();
+	if (region_obj == NULL)
+		return -1;
+
+	rc = resmon_d_attach_dev_name(region_obj, ctx->dev);
+	if (rc != 0)
+		goto put_region_obj;
+
+	rc = resmon_jrpc_object_add_int(region_obj, "region_id",
+					region->region_id);
+	if (rc != 0)
+		goto put_region_obj;
+
+	rc = resmon_jrpc_object_add_str(region_obj, "tcam_region_info",
+					tcam_region_info);
+	if (rc != 0)
+		goto put_region_obj;
+
+	rc = resmon_jrpc_object_add_int(region_obj, "capacity", region->size);
+	if (rc != 0)
+		goto put_region_obj;
+
+	rc = resmon_jrpc_object_add_int(region_obj, "used", region->used);
+	if (rc != 0)
+		goto put_region_obj;
+
+	rc = resmon_jrpc_object_add_int(region_obj, "kvd_slots",
+					region->kvd_alloc.slots);
+	if (rc != 0)
+		goto put_region_obj;
+
+	rc = resmon_jrpc_object_add_int(region_obj, "resizes",
+					region->resizes);
+	if (rc != 0)
+		goto put_region_obj;
+
+	rc = resmon_jrpc_object_add_int_array(region_obj, "erps", region->erps,
+					      ARRAY_SIZE(region->erps));
+	if (rc != 0)
+		goto put_region_obj;
+
+	rc = resmon_jrpc_object_add_int_array(region_obj, "deltas",
+					      region->deltas,
+					      ARRAY_SIZE(region->deltas));
+	if (rc != 0)
+		goto put_region_obj;
+
+	rc = json_object_array_add(ctx->regions_obj, region_obj);
+	if (rc)
+		goto put_region_obj;
+
+	return 0;
+
+put_region_obj:
+	json_object_put(region_obj);
+	return -1;
+}
+
+static void resmon_d_handle_acl(struct resmon_back *back,
+				struct resmon_sock *peer,
+				struct json_object *params_obj,
+				struct json_object *id)
+{
+	struct json_object *regions_obj;
+	struct json_object *result_obj;
+	struct resmon_d_acl_ctx ctx;
+	struct resmon_dev *devs;
+	struct json_object *obj;
+	const char *device;
+	size_t num_devs;
+	char *error;
+	int rc;
+
+	/* The request takes the same optional "device" selector as "stats".
+	 * Regions are listed per device, the response is as follows:
+	 *
+	 * {
+	 *     "id": ...,
+	 *     "result": {
+	 *         "regions": [
+	 *             {
+	 *                 "device": "pci/0000:01:00.0",
+	 *                 "region_id": number,
+	 *                 "tcam_region_info": hex string,
+	 *                 "capacity": region size in rules,
+	 *                 "used": number of rules in the region,
+	 *                 "kvd_slots": KVD slots taken by each rule,
+	 *                 "resizes": number of resizes of the region,
+	 *                 "erps": [ number of rules using eRP 0, ... ],
+	 *                 "deltas": [ number of rules with delta width 0, ... ]
+	 *             },
+	 *             ....
+	 *         ]
+	 *     }
+	 * }
+	 */
+
+	rc = resmon_jrpc_dissect_params_device(params_obj, &device, &error);
+	if (rc) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		return;
+	}
+
+	rc = resmon_d_select_devs(back, device, &devs, &num_devs, &error);
+	if (rc) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		return;
+	}
+
+	obj = resmon_jrpc_new_object(id);
+	if (obj == NULL)
+		return;
+
+	result_obj = json_object_new_object();
+	if (result_obj == NULL)
+		goto put_obj;
+
+	regions_obj = json_object_new_array();
+	if (regions_obj == NULL)
+		goto put_result_obj;
+
+	for (size_t i = 0; i < num_devs; i++) {
+		ctx = (struct resmon_d_acl_ctx) {
+			.dev = &devs[i],
+			.regions_obj = regions_obj,
+		};
+		rc = resmon_stat_ptar_foreach(devs[i].stat,
+					      resmon_d_acl_attach_region,
+					      &ctx);
+		if (rc)
+			goto put_regions_obj;
+	}
+
+	rc = json_object_object_add(result_obj, "regions", regions_obj);
+	if (rc)
+		goto put_regions_obj;
+
+	rc = json_object_object_add(obj, "result", result_obj);
+	if (rc)
+		goto put_result_obj;
+
+	resmon_jrpc_send(peer, obj);
+	json_object_put(obj);
+	return;
+
+put_regions_obj:
+	json_object_put(regions_obj);
+put_result_obj:
+	json_object_put(result_obj);
+put_obj:
+	json_object_put(obj);
+	resmon_d_respond_memerr(peer, id);
+}
+
+struct resmon_d_lpm_ctx {
+	const struct resmon_dev *dev;
+	struct json_object *vrs_obj;
+};
+
+static int resmon_d_lpm_attach_vr(const struct resmon_stat_lpm_vr *vr,
+				  void *priv)
+{
+	bool ipv6 = vr->protocol == MLXSW_REG_RALXX_PROTOCOL_IPV6;
+	struct resmon_d_lpm_ctx *ctx = priv;
+	struct json_object *vr_obj;
+	int rc;
+
+	vr_obj = json_object_new_object();
+	if (vr_obj == NULL)
+		return -1;
+
+	rc = resmon_d_attach_dev_name(vr_obj, ctx->dev);
+	if (rc != 0)
+		goto put_vr_obj;
+
+	rc = resmon_jrpc_object_add_str(vr_obj, "protocol",
+					ipv6 ? "ipv6" : "ipv4");
+	if (rc != 0)
+		goto put_vr_obj;
+
+	rc = resmon_jrpc_object_add_int(vr_obj, "virtual_router",
+					vr->virtual_router);
+	if (rc != 0)
+		goto put_vr_obj;
+
+	rc = resmon_jrpc_object_add_int(vr_obj, "routes", vr->routes);
+	if (rc != 0)
+		goto put_vr_obj;
+
+	rc = resmon_jrpc_object_add_int_array(vr_obj, "prefix_lens",
+					      vr->prefix_lens,
+					      ipv6 ? 128 + 1 : 32 + 1);
+	if (rc != 0)
+		goto put_vr_obj;
+
+	rc = json_object_array_add(ctx->vrs_obj, vr_obj);
+	if (rc)
+		goto put_vr_obj;
+
+	return 0;
+
+put_vr_obj:
+	json_object_put(vr_obj);
+	return -1;
+}
+
+static void resmon_d_handle_lpm(struct resmon_back *back,
+				struct resmon_sock *peer,
+				struct json_object *params_obj,
+				struct json_object *id)
+{
+	struct json_object *result_obj;
+	struct resmon_d_lpm_ctx ctx;
+	struct json_object *vrs_obj;
+	struct resmon_dev *devs;
+	struct json_object *obj;
+	const char *device;
+	size_t num_devs;
+	char *error;
+	int rc;
+
+	/* The request takes the same optional "device" selector as "stats".
+	 * Routes are summarized per device, protocol and virtual router:
+	 *
+	 * {
+	 *     "id": ...,
+	 *     "result": {
+	 *         "vrs": [
+	 *             {
+	 *                 "device": "pci/0000:01:00.0",
+	 *                 "protocol": "ipv4" or "ipv6",
+	 *                 "virtual_router": number,
+	 *                 "routes": number of routes in the VR,
+	 *                 "prefix_lens": [ number of /0 routes, ... ]
+	 *             },
+	 *             ....
+	 *         ]
+	 *     }
+	 * }
+	 *
+	 * "prefix_lens" has 33 elements for IPv4 and 129 for IPv6.
+	 */
+
+	rc = resmon_jrpc_dissect_params_device(params_obj, &device, &error);
+	if (rc) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		return;
+	}
+
+	rc = resmon_d_select_devs(back, device, &devs, &num_devs, &error);
+	if (rc) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		return;
+	}
+
+	obj = resmon_jrpc_new_object(id);
+	if (obj == NULL)
+		return;
+
+	result_obj = json_object_new_object();
+	if (result_obj == NULL)
+		goto put_obj;
+
+	vrs_obj = json_object_new_array();
+	if (vrs_obj == NULL)
+		goto put_result_obj;
+
+	for (size_t i = 0; i < num_devs; i++) {
+		ctx = (struct resmon_d_lpm_ctx) {
+			.dev = &devs[i],
+			.vrs_obj = vrs_obj,
+		};
+		rc = resmon_stat_lpm_foreach(devs[i].stat,
+					     resmon_d_lpm_attach_vr, &ctx);
+		if (rc)
+			goto put_vrs_obj;
+	}
+
+	rc = json_object_object_add(result_obj, "vrs", vrs_obj);
+	if (rc)
+		goto put_vrs_obj;
+
+	rc = json_object_object_add(obj, "result", result_obj);
+	if (rc)
+		goto put_result_obj;
+
+	resmon_jrpc_send(peer, obj);
+	json_object_put(obj);
+	return;
+
+put_vrs_obj:
+	json_object_put(vrs_obj);
+put_result_obj:
+	json_object_put(result_obj);
+put_obj:
+	json_object_put(obj);
+	resmon_d_respond_memerr(peer, id);
+}
+
+/* Add array_obj under key, or drop it if that fails. */
+static int resmon_d_object_add_array(struct json_object *obj,
+				     const char *key,
+				     struct json_object *array_obj)
+{
+	if (array_obj == NULL)
+		return -1;
+
+	if (json_object_object_add(obj, key, array_obj)) {
+		json_object_put(array_obj);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int resmon_d_churn_attach(struct json_object *array_obj,
+				 const char *name,
+				 const struct resmon_stat_churn *churn)
+{
+	struct json_object *churn_obj;
+	int rc;
+
+	churn_obj = json_object_new_object();
+	if (churn_obj == NULL)
+		return -1;
+
+	rc = resmon_jrpc_object_add_str(churn_obj, "name", name);
+	if (rc != 0)
+		goto put_churn_obj;
+
+	rc = resmon_jrpc_object_add_int(churn_obj, "adds", churn->counts.adds);
+	if (rc != 0)
+		goto put_churn_obj;
+
+	rc = resmon_jrpc_object_add_int(churn_obj, "deletes",
+					churn->counts.deletes);
+	if (rc != 0)
+		goto put_churn_obj;
+
+	rc = resmon_jrpc_object_add_int(churn_obj, "redundant",
+					churn->counts.redundant);
+	if (rc != 0)
+		goto put_churn_obj;
+
+	rc = resmon_jrpc_object_add_double(churn_obj, "add_rate",
+					   churn->add_rate);
+	if (rc != 0)
+		goto put_churn_obj;
+
+	rc = resmon_jrpc_object_add_double(churn_obj, "delete_rate",
+					   churn->delete_rate);
+	if (rc != 0)
+		goto put_churn_obj;
+
+	rc = resmon_jrpc_object_add_double(churn_obj, "redundant_rate",
+					   churn->redundant_rate);
+	if (rc != 0)
+		goto put_churn_obj;
+
+	rc = json_object_array_add(array_obj, churn_obj);
+	if (rc)
+		goto put_churn_obj;
+
+	return 0;
+
+put_churn_obj:
+	json_object_put(churn_obj);
+	return -1;
+}
+
+static char *resmon_d_key_str(const void *key, size_t key_size)
+{
+	const uint8_t *key_buf = key;
+	char *key_str;
+
+	key_str = malloc(2 * key_size + 1);
+	if (key_str == NULL)
+		return NULL;
+
+	for (size_t i = 0; i < key_size; i++)
+		sprintf(&key_str[2 * i], "%02x", key_buf[i]);
+	key_str[2 * key_size] = '\0';
+	return key_str;
+}
+
+static int
+resmon_d_churn_attach_key(struct json_object *keys_obj,
+			  const struct resmon_dev *dev,
+			  const struct resmon_stat_redundant_key *key)
+{
+	struct json_object *key_obj;
+	char *key_str;
+	int rc;
+
+	key_str = resmon_d_key_str(key->key, key->key_size);
+	if (key_str == NULL)
+		return -1;
+
+	key_obj = json_object_new_object();
+	if (key_obj == NULL)
+		goto free_key_str;
+
+	rc = resmon_d_attach_dev_name(key_obj, dev);
+	if (rc != 0)
+		goto put_key_obj;
+
+	rc = resmon_jrpc_object_add_str(key_obj, "table",
+					resmon_stat_table_name(key->table));
+	if (rc != 0)
+		goto put_key_obj;
+
+	rc = resmon_jrpc_object_add_str(key_obj, "key", key_str);
+	if (rc != 0)
+		goto put_key_obj;
+
+	rc = resmon_jrpc_object_add_int(key_obj, "redundant", key->redundant);
+	if (rc != 0)
+		goto put_key_obj;
+
+	rc = json_object_array_add(keys_obj, key_obj);
+	if (rc)
+		goto put_key_obj;
+
+	free(key_str);
+	return 0;
+
+put_key_obj:
+	json_object_put(key_obj);
+free_key_str:
+	free(key_str);
+	return -1;
+}
+
+static void resmon_d_handle_churn(struct resmon_back *back,
+				  struct resmon_sock *peer,
+				  struct json_object *params_obj,
+				  struct json_object *id)
+{
+	struct resmon_stat_churn tables[resmon_stat_table_count] = {};
+	struct resmon_stat_churn regs[resmon_reg_count] = {};
+	struct resmon_stat_redundant_key *top;
+	struct json_object *result_obj;
+	struct json_object *tables_obj;
+	struct json_object *regs_obj;
+	struct json_object *keys_obj;
+	struct resmon_dev *devs;
+	struct json_object *obj;
+	const char *device;
+	size_t num_devs;
+	int64_t max_top;
+	char *error;
+	int rc;
+
+	/* The request takes the optional "device" selector of "stats", and
+	 * an optional "top" with the number of most redundantly written keys
+	 * to list per device, ten by default. The response is as follows:
+	 *
+	 * {
+	 *     "id": ...,
+	 *     "result": {
+	 *         "registers": [
+	 *             {
+	 *                 "name": "RALUE",
+	 *                 "adds": number of entries added,
+	 *                 "deletes": number of entries deleted,
+	 *                 "redundant": number of writes of present entries,
+	 *                 "add_rate": adds per second,
+	 *                 "delete_rate": deletes per second,
+	 *                 "redundant_rate": redundant writes per second
+	 *             },
+	 *             ....
+	 *         ],
+	 *         "tables": [ the same per table, named e.g. "ralue" ],
+	 *         "top": [
+	 *             {
+	 *                 "device": "pci/0000:01:00.0",
+	 *                 "table": "ralue",
+	 *                 "key": hex dump of the table key,
+	 *                 "redundant": number of redundant writes
+	 *             },
+	 *             ....
+	 *         ]
+	 *     }
+	 * }
+	 *
+	 * The rates are exponentially weighted moving averages.
+	 */
+
+	rc = resmon_jrpc_dissect_params_churn(params_obj, &device, &max_top,
+					      &error);
+	if (rc) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		return;
+	}
+
+	rc = resmon_d_select_devs(back, device, &devs, &num_devs, &error);
+	if (rc) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		return;
+	}
+
+	for (size_t i = 0; i < num_devs; i++) {
+		struct resmon_stat_reg_stats reg_stats;
+
+		reg_stats = resmon_stat_reg_stats(devs[i].stat);
+		for (int j = 0; j < resmon_reg_count; j++)
+			resmon_stat_churn_add(&regs[j],
+					      &reg_stats.regs[j].churn);
+		for (int j = 0; j < resmon_stat_table_count; j++) {
+			struct resmon_stat_churn churn =
+				resmon_stat_table_churn(devs[i].stat, j);
+
+			resmon_stat_churn_add(&tables[j], &churn);
+		}
+	}
+
+	top = calloc(max_top, sizeof(*top));
+	if (top == NULL && max_top != 0) {
+		resmon_d_respond_memerr(peer, id);
+		return;
+	}
+
+	obj = resmon_jrpc_new_object(id);
+	if (obj == NULL)
+		goto free_top;
+
+	result_obj = json_object_new_object();
+	if (result_obj == NULL)
+		goto put_obj;
+
+	/* The arrays are owned by result_obj as soon as they are added. */
+	regs_obj = json_object_new_array();
+	if (resmon_d_object_add_array(result_obj, "registers", regs_obj))
+		goto put_result_obj;
+
+	tables_obj = json_object_new_array();
+	if (resmon_d_object_add_array(result_obj, "tables", tables_obj))
+		goto put_result_obj;
+
+	keys_obj = json_object_new_array();
+	if (resmon_d_object_add_array(result_obj, "top", keys_obj))
+		goto put_result_obj;
+
+	for (int i = 0; i < resmon_reg_count; i++) {
+		rc = resmon_d_churn_attach(regs_obj, resmon_d_reg_names[i],
+					   &regs[i]);
+		if (rc)
+			goto put_result_obj;
+	}
+
+	for (int i = 0; i < resmon_stat_table_count; i++) {
+		rc = resmon_d_churn_attach(tables_obj,
+					   resmon_stat_table_name(i),
+					   &tables[i]);
+		if (rc)
+			goto put_result_obj;
+	}
+
+	for (size_t i = 0; i < num_devs; i++) {
+		size_t num_top;
+
+		num_top = resmon_stat_redundant_top(devs[i].stat, top,
+						    max_top);
+		for (size_t j = 0; j < num_top; j++) {
+			rc = resmon_d_churn_attach_key(keys_obj, &devs[i],
+						       &top[j]);
+			if (rc)
+				goto put_result_obj;
+		}
+	}
+
+	rc = json_object_object_add(obj, "result", result_obj);
+	if (rc)
+		goto put_result_obj;
+
+	resmon_jrpc_send(peer, obj);
+	json_object_put(obj);
+	free(top);
+	return;
+
+put_result_obj:
+	json_object_put(result_obj);
+put_obj:
+	json_object_put(obj);
+free_top:
+	free(top);
+	resmon_d_respond_memerr(peer, id);
+}
+
+struct resmon_d_bursts_ctx {
+	const struct resmon_dev *dev;
+	struct json_object *bursts_obj;
+	/* CLOCK_REALTIME minus CLOCK_MONOTONIC. */
+	int64_t realtime_offset_ns;
+};
+
+static int64_t resmon_d_clock_ns(clockid_t clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int resmon_d_bursts_attach_regs(struct json_object *burst_obj,
+				       const struct resmon_stat_burst *burst)
+{
+	struct json_object *regs_obj;
+	struct json_object *reg_obj;
+
+	regs_obj = json_object_new_array();
+	if (regs_obj == NULL)
+		return -1;
+
+	for (int i = 0; i < resmon_reg_count; i++) {
+		if (burst->reg_emads[i] == 0)
+			continue;
+
+		reg_obj = json_object_new_object();
+		if (reg_obj == NULL)
+			goto put_regs_obj;
+
+		if (resmon_jrpc_object_add_str(reg_obj, "name",
+					       resmon_d_reg_names[i]) ||
+		    resmon_jrpc_object_add_int(reg_obj, "emads",
+					       burst->reg_emads[i]) ||
+		    json_object_array_add(regs_obj, reg_obj)) {
+			json_object_put(reg_obj);
+			goto put_regs_obj;
+		}
+	}
+
+	if (json_object_object_add(burst_obj, "registers", regs_obj))
+		goto put_regs_obj;
+
+	return 0;
+
+put_regs_obj:
+	json_object_put(regs_obj);
+	return -1;
+}
+
+static int resmon_d_bursts_attach_burst(const struct resmon_stat_burst *burst,
+					void *priv)
+{
+	struct resmon_d_bursts_ctx *ctx = priv;
+	struct json_object *burst_obj;
+	int rc;
+
+	burst_obj = json_object_new_object();
+	if (burst_obj == NULL)
+		return -1;
+
+	rc = resmon_d_attach_dev_name(burst_obj, ctx->dev);
+	if (rc != 0)
+		goto put_burst_obj;
+
+	rc = resmon_jrpc_object_add_int(burst_obj, "start_ns",
+					burst->start_ns +
+					ctx->realtime_offset_ns);
+	if (rc != 0)
+		goto put_burst_obj;
+
+	rc = resmon_jrpc_object_add_int(burst_obj, "duration_ns",
+					burst->duration_ns);
+	if (rc != 0)
+		goto put_burst_obj;
+
+	rc = resmon_jrpc_object_add_int(burst_obj, "emads", burst->emads);
+	if (rc != 0)
+		goto put_burst_obj;
+
+	rc = resmon_jrpc_object_add_int(burst_obj, "peak_rate",
+					burst->peak_rate);
+	if (rc != 0)
+		goto put_burst_obj;
+
+	rc = resmon_jrpc_object_add_bool(burst_obj, "ongoing", burst->ongoing);
+	if (rc != 0)
+		goto put_burst_obj;
+
+	rc = resmon_d_bursts_attach_regs(burst_obj, burst);
+	if (rc != 0)
+		goto put_burst_obj;
+
+	rc = json_object_array_add(ctx->bursts_obj, burst_obj);
+	if (rc)
+		goto put_burst_obj;
+
+	return 0;
+
+put_burst_obj:
+	json_object_put(burst_obj);
+	return -1;
+}
+
+static void resmon_d_handle_bursts(struct resmon_back *back,
+				   struct resmon_sock *peer,
+				   struct json_object *params_obj,
+				   struct json_object *id)
+{
+	struct resmon_d_bursts_ctx ctx;
+	struct json_object *bursts_obj;
+	struct json_object *result_obj;
+	int64_t realtime_offset_ns;
+	struct resmon_dev *devs;
+	struct json_object *obj;
+	const char *device;
+	size_t num_devs;
+	char *error;
+	int rc;
+
+	/* The request takes the same optional "device" selector as "stats".
+	 * Recent bursts of EMADs are listed per device, oldest first:
+	 *
+	 * {
+	 *     "id": ...,
+	 *     "result": {
+	 *         "bursts": [
+	 *             {
+	 *                 "device": "pci/0000:01:00.0",
+	 *                 "start_ns": UNIX time of the first EMAD in ns,
+	 *                 "duration_ns": time until the last EMAD,
+	 *                 "emads": number of EMADs in the burst,
+	 *                 "peak_rate": peak EMADs per second,
+	 *                 "ongoing": whether the burst may still grow,
+	 *                 "registers": [
+	 *                     { "name": "RALUE", "emads": number },
+	 *                     ...
+	 *                 ]
+	 *             },
+	 *             ....
+	 *         ]
+	 *     }
+	 * }
+	 */
+
+	rc = resmon_jrpc_dissect_params_device(params_obj, &device, &error);
+	if (rc) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		return;
+	}
+
+	rc = resmon_d_select_devs(back, device, &devs, &num_devs, &error);
+	if (rc) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		return;
+	}
+
+	obj = resmon_jrpc_new_object(id);
+	if (obj == NULL)
+		return;
+
+	result_obj = json_object_new_object();
+	if (result_obj == NULL)
+		goto put_obj;
+
+	bursts_obj = json_object_new_array();
+	if (bursts_obj == NULL)
+		goto put_result_obj;
+
+	realtime_offset_ns = resmon_d_clock_ns(CLOCK_REALTIME) -
+			     resmon_d_clock_ns(CLOCK_MONOTONIC);
+	for (size_t i = 0; i < num_devs; i++) {
+		ctx = (struct resmon_d_bursts_ctx) {
+			.dev = &devs[i],
+			.bursts_obj = bursts_obj,
+			.realtime_offset_ns = realtime_offset_ns,
+		};
+		rc = resmon_stat_burst_foreach(devs[i].stat,
+					       resmon_d_bursts_attach_burst,
+					       &ctx);
+		if (rc)
+			goto put_bursts_obj;
+	}
+
+	rc = json_object_object_add(result_obj, "bursts", bursts_obj);
+	if (rc)
+		goto put_bursts_obj;
+
+	rc = json_object_object_add(obj, "result", result_obj);
+	if (rc)
+		goto put_result_obj;
+
+	resmon_jrpc_send(peer, obj);
+	json_object_put(obj);
+	return;
+
+put_bursts_obj:
+	json_object_put(bursts_obj);
+put_result_obj:
+	json_object_put(result_obj);
+put_obj:
+	json_object_put(obj);
+	resmon_d_respond_memerr(peer, id);
+}
+
+static struct resmon_stat_kvd_alloc
+resmon_d_plan_item_kvd_alloc(const struct resmon_jrpc_plan_item *item)
+{
+	switch (item->type) {
+	case RESMON_JRPC_PLAN_ROUTE:
+		return resmon_reg_ralue_kvd_alloc(item->ipv6, item->prefix_len);
+	case RESMON_JRPC_PLAN_NEIGH:
+		return resmon_reg_rauht_kvd_alloc(item->ipv6);
+	case RESMON_JRPC_PLAN_ACL:
+		return resmon_reg_ptar_kvd_alloc(item->key_blocks);
+	case RESMON_JRPC_PLAN_ACTSET:
+		return resmon_reg_pefa_kvd_alloc();
+	case RESMON_JRPC_PLAN_ADJ:
+		return resmon_reg_ratr_kvd_alloc();
+	case RESMON_JRPC_PLAN_FDB:
+		break;
+	}
+	return resmon_reg_sfd_kvd_alloc();
+}
+
+static int resmon_d_plan_attach_counter(struct json_object *counters_obj,
+					const char *name, const char *descr,
+					int64_t value, int64_t needed)
+{
+	struct json_object *counter_obj;
+	int rc;
+
+	counter_obj = json_object_new_object();
+	if (counter_obj == NULL)
+		return -1;
+
+	rc = resmon_jrpc_object_add_str(counter_obj, "name", name);
+	if (rc != 0)
+		goto put_counter_obj;
+
+	rc = resmon_jrpc_object_add_str(counter_obj, "descr", descr);
+	if (rc != 0)
+		goto put_counter_obj;
+
+	rc = resmon_jrpc_object_add_int(counter_obj, "value", value);
+	if (rc != 0)
+		goto put_counter_obj;
+
+	rc = resmon_jrpc_object_add_int(counter_obj, "needed", needed);
+	if (rc != 0)
+		goto put_counter_obj;
+
+	rc = json_object_array_add(counters_obj, counter_obj);
+	if (rc)
+		goto put_counter_obj;
+
+	return 0;
+
+put_counter_obj:
+	json_object_put(counter_obj);
+	return -1;
+}
+
+static void resmon_d_handle_plan(struct resmon_back *back,
+				 struct resmon_sock *peer,
+				 struct json_object *params_obj,
+				 struct json_object *id)
+{
+	int64_t needed[resmon_counter_count] = {};
+	struct resmon_stat_counters counters;
+	struct resmon_jrpc_plan_item *items;
+	struct json_object *counters_obj;
+	struct json_object *result_obj;
+	int64_t total_needed = 0;
+	struct json_object *obj;
+	struct resmon_dev *devs;
+	const char *device;
+	uint64_t capacity;
+	size_t num_items;
+	int64_t headroom;
+	size_t num_devs;
+	char *error;
+	int rc;
+
+	/* The request describes a batch of entries to be written:
+	 *
+	 * {
+	 *     "device": optional, as with "stats",
+	 *     "items": [
+	 *         { "type": "route", "protocol": "ipv4" or "ipv6",
+	 *           "prefix_len": number, "count": number },
+	 *         { "type": "neigh", "protocol": ..., "count": ... },
+	 *         { "type": "acl", "key_blocks": number of flexible key
+	 *           blocks of the region, "count": number of rules },
+	 *         { "type": "actset" or "adj" or "fdb", "count": ... },
+	 *         ...
+	 *     ]
+	 * }
+	 *
+	 * The batch is costed with the same functions that account the
+	 * entries when they are written, and checked against the KVD of
+	 * the device:
+	 *
+	 * {
+	 *     "id": ...,
+	 *     "result": {
+	 *         "counters": [
+	 *             {
+	 *                 "name": symbolic counter enum name,
+	 *                 "descr": string with human-readable descr.,
+	 *                 "value": slots in use,
+	 *                 "needed": slots the batch needs
+	 *             },
+	 *             ....
+	 *         ],
+	 *         "capacity": KVD size,
+	 *         "used": slots in use in total,
+	 *         "needed": slots the batch needs in total,
+	 *         "headroom": slots left after the batch, may be negative,
+	 *         "fits": whether the batch fits
+	 *     }
+	 * }
+	 */
+
+	rc = resmon_jrpc_dissect_params_plan(params_obj, &device, &items,
+					     &num_items, &error);
+	if (rc) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		return;
+	}
+
+	rc = resmon_d_select_devs(back, device, &devs, &num_devs, &error);
+	if (rc) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		goto free_items;
+	}
+
+	/* Each device has a KVD of its own, so the plan is for one. */
+	if (num_devs != 1) {
+		resmon_d_respond_invalid_params(peer, id,
+				"A device needs to be selected");
+		goto free_items;
+	}
+
+	rc = back->cls->get_capacity(back, devs, &capacity, &error);
+	if (rc != 0) {
+		resmon_d_respond_error(peer, id, resmon_jrpc_e_capacity,
+				       "Issue while retrieving capacity",
+				       error);
+		free(error);
+		goto free_items;
+	}
+
+	/* Counts are only checked to be non-negative, so a batch can ask for
+	 * more slots than an int64_t holds.
+	 */
+	counters = resmon_stat_counters(devs->stat);
+	headroom = (int64_t) capacity - counters.total;
+	for (size_t i = 0; i < num_items; i++) {
+		struct resmon_stat_kvd_alloc kvd_alloc =
+			resmon_d_plan_item_kvd_alloc(&items[i]);
+		int64_t *counter_needed = &needed[kvd_alloc.counter];
+		int64_t slots;
+
+		if (__builtin_mul_overflow(items[i].count, kvd_alloc.slots,
+					   &slots) ||
+		    __builtin_add_overflow(*counter_needed, slots,
+					   counter_needed) ||
+		    __builtin_add_overflow(total_needed, slots,
+					   &total_needed) ||
+		    __builtin_sub_overflow(headroom, slots, &headroom)) {
+			resmon_d_respond_invalid_params(peer, id,
+					"The batch is too large to plan");
+			goto free_items;
+		}
+	}
+
+	obj = resmon_jrpc_new_object(id);
+	if (obj == NULL)
+		goto free_items;
+
+	result_obj = json_object_new_object();
+	if (result_obj == NULL)
+		goto put_obj;
+
+	counters_obj = json_object_new_array();
+	if (counters_obj == NULL)
+		goto put_result_obj;
+
+	for (int i = 0; i < ARRAY_SIZE(counters.values); i++) {
+		rc = resmon_d_plan_attach_counter(counters_obj,
+					    resmon_d_counter_names[i],
+					    resmon_d_counter_descriptions[i],
+					    counters.values[i], needed[i]);
+		if (rc)
+			goto put_counters_obj;
+	}
+
+	rc = json_object_object_add(result_obj, "counters", counters_obj);
+	if (rc != 0)
+		goto put_counters_obj;
+
+	if (resmon_jrpc_object_add_int(result_obj, "capacity", capacity) ||
+	    resmon_jrpc_object_add_int(result_obj, "used", counters.total) ||
+	    resmon_jrpc_object_add_int(result_obj, "needed", total_needed) ||
+	    resmon_jrpc_object_add_int(result_obj, "headroom", headroom) ||
+	    resmon_jrpc_object_add_bool(result_obj, "fits", headroom >= 0))
+		goto put_result_obj;
+
+	rc = json_object_object_add(obj, "result", result_obj);
+	if (rc != 0)
+		goto put_result_obj;
+
+	resmon_jrpc_send(peer, obj);
+	json_object_put(obj);
+	free(items);
+	return;
+
+put_counters_obj:
+	json_object_put(counters_obj);
+put_result_obj:
+	json_object_put(result_obj);
+put_obj:
+	json_object_put(obj);
+	resmon_d_respond_memerr(peer, id);
+free_items:
+	free(items);
+}
+
+static int resmon_d_kvdl_attach_dev(struct json_object *devices_obj,
+				    const struct resmon_dev *dev)
+{
+	struct resmon_stat_kvdl_frag frag;
+	struct json_object *dev_obj;
+	uint64_t free_slots;
+	double fragmentation;
+	int rc;
+
+	frag = resmon_stat_kvdl_frag(dev->stat);
+	free_slots = frag.size - frag.used;
+
+	/* 0 when all free slots form one run, approaching 1 as the free
+	 * space shatters into many small runs.
+	 */
+	fragmentation = 0;
+	if (free_slots != 0)
+		fragmentation = 1 - (double) frag.largest_free_run /
+				    free_slots;
+
+	dev_obj = json_object_new_object();
+	if (dev_obj == NULL)
+		return -1;
+
+	rc = resmon_d_attach_dev_name(dev_obj, dev);
+	if (rc != 0)
+		goto put_dev_obj;
+
+	rc = resmon_jrpc_object_add_int(dev_obj, "size", frag.size);
+	if (rc != 0)
+		goto put_dev_obj;
+
+	rc = resmon_jrpc_object_add_int(dev_obj, "used", frag.used);
+	if (rc != 0)
+		goto put_dev_obj;
+
+	rc = resmon_jrpc_object_add_int(dev_obj, "free", free_slots);
+	if (rc != 0)
+		goto put_dev_obj;
+
+	rc = resmon_jrpc_object_add_int(dev_obj, "largest_free_run",
+					frag.largest_free_run);
+	if (rc != 0)
+		goto put_dev_obj;
+
+	rc = resmon_jrpc_object_add_int(dev_obj, "free_runs",
+					frag.free_runs);
+	if (rc != 0)
+		goto put_dev_obj;
+
+	rc = resmon_jrpc_object_add_double(dev_obj, "fragmentation",
+					   fragmentation);
+	if (rc != 0)
+		goto put_dev_obj;
+
+	rc = resmon_jrpc_object_add_int_array(dev_obj, "run_hist",
+					      frag.run_hist,
+					      ARRAY_SIZE(frag.run_hist));
+	if (rc != 0)
+		goto put_dev_obj;
+
+	rc = json_object_array_add(devices_obj, dev_obj);
+	if (rc)
+		goto put_dev_obj;
+
+	return 0;
+
+put_dev_obj:
+	json_object_put(dev_obj);
+	return -1;
+}
+
+static void resmon_d_handle_kvdl(struct resmon_back *back,
+				 struct resmon_sock *peer,
+				 struct json_object *params_obj,
+				 struct json_object *id)
+{
+	struct json_object *devices_obj;
+	struct json_object *result_obj;
+	struct resmon_dev *devs;
+	struct json_object *obj;
+	const char *device;
+	size_t num_devs;
+	char *error;
+	int rc;
+
+	/* The request takes the same optional "device" selector as "stats".
+	 * The response describes the free space of KVD linear per device:
+	 *
+	 * {
+	 *     "id": ...,
+	 *     "result": {
+	 *         "devices": [
+	 *             {
+	 *                 "device": "pci/0000:01:00.0",
+	 *                 "size": number of slots tracked,
+	 *                 "used": number of slots in use,
+	 *                 "free": number of free slots,
+	 *                 "largest_free_run": longest run of free slots,
+	 *                 "free_runs": number of runs of free slots,
+	 *                 "fragmentation": 1 - largest_free_run / free,
+	 *                 "run_hist": [ runs of 1 slot, of 2-3 slots,
+	 *                               of 4-7 slots, ... ]
+	 *             },
+	 *             ....
+	 *         ]
+	 *     }
+	 * }
+	 */
+
+	rc = resmon_jrpc_dissect_params_device(params_obj, &device, &error);
+	if (rc) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		return;
+	}
+
+	rc = resmon_d_select_devs(back, device, &devs, &num_devs, &error);
+	if (rc) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		return;
+	}
+
+	obj = resmon_jrpc_new_object(id);
+	if (obj == NULL)
+		return;
+
+	result_obj = json_object_new_object();
+	if (result_obj == NULL)
+		goto put_obj;
+
+	devices_obj = json_object_new_array();
+	if (devices_obj == NULL)
+		goto put_result_obj;
+
+	for (size_t i = 0; i < num_devs; i++) {
+		rc = resmon_d_kvdl_attach_dev(devices_obj, &devs[i]);
+		if (rc)
+			goto put_devices_obj;
+	}
+
+	rc = json_object_object_add(result_obj, "devices", devices_obj);
+	if (rc)
+		goto put_devices_obj;
+
+	rc = json_object_object_add(obj, "result", result_obj);
+	if (rc)
+		goto put_result_obj;
+
+	resmon_jrpc_send(peer, obj);
+	json_object_put(obj);
+	return;
+
+put_devices_obj:
+	json_object_put(devices_obj);
+put_result_obj:
+	json_object_put(result_obj);
+put_obj:
+	json_object_put(obj);
+	resmon_d_respond_memerr(peer, id);
+}
+
+static int resmon_d_health_attach_hist(struct json_object *obj,
+				       const char *key,
+				       const struct resmon_stat_hist *hist)
+{
+	struct json_object *hist_obj;
+	int rc;
+
+	hist_obj = json_object_new_object();
+	if (hist_obj == NULL)
+		return -1;
+
+	rc = resmon_jrpc_object_add_int(hist_obj, "count", hist->count);
+	if (rc != 0)
+		goto put_hist_obj;
+
+	rc = resmon_jrpc_object_add_int(hist_obj, "sum", hist->sum);
+	if (rc != 0)
+		goto put_hist_obj;
+
+	rc = resmon_jrpc_object_add_int(hist_obj, "max", hist->max);
+	if (rc != 0)
+		goto put_hist_obj;
+
+	rc = resmon_jrpc_object_add_int_array(hist_obj, "bins", hist->bins,
+					      ARRAY_SIZE(hist->bins));
+	if (rc != 0)
+		goto put_hist_obj;
+
+	rc = json_object_object_add(obj, key, hist_obj);
+	if (rc)
+		goto put_hist_obj;
+
+	return 0;
+
+put_hist_obj:
+	json_object_put(hist_obj);
+	return -1;
+}
+
+static int resmon_d_health_attach_reg(struct json_object *regs_obj,
+				      enum resmon_reg reg,
+				      const struct resmon_stat_hist *time_hist)
+{
+	struct json_object *reg_obj;
+	int rc;
+
+	reg_obj = json_object_new_object();
+	if (reg_obj == NULL)
+		return -1;
+
+	rc = resmon_jrpc_object_add_str(reg_obj, "name",
+					resmon_d_reg_names[reg]);
+	if (rc != 0)
+		goto put_reg_obj;
+
+	rc = resmon_d_health_attach_hist(reg_obj, "time_ns", time_hist);
+	if (rc != 0)
+		goto put_reg_obj;
+
+	rc = json_object_array_add(regs_obj, reg_obj);
+	if (rc)
+		goto put_reg_obj;
+
+	return 0;
+
+put_reg_obj:
+	json_object_put(reg_obj);
+	return -1;
+}
+
+static void resmon_d_handle_health(struct resmon_back *back,
+				   struct resmon_sock *peer,
+				   struct json_object *params_obj,
+				   struct json_object *id)
+{
+	const struct resmon_back_health *health = &back->health;
+	struct resmon_stat_hist reg_hists[resmon_reg_count] = {};
+	struct json_object *result_obj;
+	struct json_object *regs_obj;
+	struct json_object *obj;
+	uint64_t uptime_ns;
+	char *error;
+	int rc;
+
+	/* The request has no parameters. The response tells how far behind
+	 * the device the accounting is, and what it costs:
+	 *
+	 * {
+	 *     "id": ...,
+	 *     "result": {
+	 *         "uptime_ns": time since the back end started,
+	 *         "cpu_ns": CPU time spent processing EMADs,
+	 *         "cpu_load": cpu_ns / uptime_ns,
+	 *         "process_cpu_ns": CPU time of the whole daemon,
+	 *         "delay_ns": histogram of the time from the tracepoint
+	 *                     hit to the EMAD having been processed,
+	 *         "batch": histogram of EMADs processed per wakeup,
+	 *         "registers": [
+	 *             {
+	 *                 "name": "RALUE",
+	 *                 "time_ns": histogram of processing times
+	 *             },
+	 *             ....
+	 *         ]
+	 *     }
+	 * }
+	 *
+	 * Each histogram is an object with "count", "sum" and "max" of the
+	 * values, and "bins", where bin i counts values of 2^i to
+	 * 2^(i+1)-1. Bin 0 counts zeroes as well.
+	 */
+
+	rc = resmon_jrpc_dissect_params_empty(params_obj, &error);
+	if (rc) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		return;
+	}
+
+	for (size_t i = 0; i < back->num_devs; i++) {
+		struct resmon_stat_reg_stats dev_reg_stats;
+
+		dev_reg_stats = resmon_stat_reg_stats(back->devs[i].stat);
+		for (size_t j = 0; j < resmon_reg_count; j++)
+			resmon_stat_hist_add(&reg_hists[j],
+					     &dev_reg_stats.regs[j].time_hist);
+	}
+
+	uptime_ns = resmon_back_clock_ns(CLOCK_MONOTONIC) - health->start_ns;
+
+	obj = resmon_jrpc_new_object(id);
+	if (obj == NULL)
+		return;
+
+	result_obj = json_object_new_object();
+	if (result_obj == NULL)
+		goto put_obj;
+
+	rc = resmon_jrpc_object_add_int(result_obj, "uptime_ns", uptime_ns);
+	if (rc != 0)
+		goto put_result_obj;
+
+	rc = resmon_jrpc_object_add_int(result_obj, "cpu_ns", health->cpu_ns);
+	if (rc != 0)
+		goto put_result_obj;
+
+	rc = resmon_jrpc_object_add_double(result_obj, "cpu_load",
+					   uptime_ns ? (double) health->cpu_ns /
+						       uptime_ns : 0);
+	if (rc != 0)
+		goto put_result_obj;
+
+	rc = resmon_jrpc_object_add_int(result_obj, "process_cpu_ns",
+			resmon_back_clock_ns(CLOCK_PROCESS_CPUTIME_ID));
+	if (rc != 0)
+		goto put_result_obj;
+
+	rc = resmon_d_health_attach_hist(result_obj, "delay_ns",
+					 &health->delay_ns);
+	if (rc != 0)
+		goto put_result_obj;
+
+	rc = resmon_d_health_attach_hist(result_obj, "batch", &health->batch);
+	if (rc != 0)
+		goto put_result_obj;
+
+	regs_obj = json_object_new_array();
+	if (regs_obj == NULL)
+		goto put_result_obj;
+
+	for (int i = 0; i < resmon_reg_count; i++) {
+		rc = resmon_d_health_attach_reg(regs_obj, i, &reg_hists[i]);
+		if (rc)
+			goto put_regs_obj;
+	}
+
+	rc = json_object_object_add(result_obj, "registers", regs_obj);
+	if (rc)
+		goto put_regs_obj;
+
+	rc = json_object_object_add(obj, "result", result_obj);
+	if (rc)
+		goto put_result_obj;
+
+	resmon_jrpc_send(peer, obj);
+	json_object_put(obj);
+	return;
+
+put_regs_obj:
+	json_object_put(regs_obj);
+put_result_obj:
+	json_object_put(result_obj);
+put_obj:
+	json_object_put(obj);
+	resmon_d_respond_memerr(peer, id);
+}
+
+#define RESMON_REG_ERROR_EXPAND_AS_NAME_STR(NAME, name, DESCRIPTION) \
+	[RESMON_REG_ERROR_ ## NAME] = #name,
+#define RESMON_REG_ERROR_EXPAND_AS_DESCR(NAME, name, DESCRIPTION) \
+	[RESMON_REG_ERROR_ ## NAME] = DESCRIPTION,
+
+static const char *const resmon_d_reg_error_names[] = {
+	RESMON_REG_ERRORS(RESMON_REG_ERROR_EXPAND_AS_NAME_STR)
+};
+
+static const char *const resmon_d_reg_error_descrs[] = {
+	RESMON_REG_ERRORS(RESMON_REG_ERROR_EXPAND_AS_DESCR)
+};
+
+#undef RESMON_REG_ERROR_EXPAND_AS_DESCR
+#undef RESMON_REG_ERROR_EXPAND_AS_NAME_STR
+
+static int resmon_d_errors_attach_classes(struct json_object *result_obj,
+				const struct resmon_stat_error_stats *stats)
+{
+	struct json_object *classes_obj;
+	struct json_object *class_obj;
+
+	classes_obj = json_object_new_array();
+	if (classes_obj == NULL)
+		return -1;
+
+	for (int i = 0; i < resmon_reg_error_count; i++) {
+		class_obj = json_object_new_object();
+		if (class_obj == NULL)
+			goto put_classes_obj;
+
+		if (resmon_jrpc_object_add_str(class_obj, "name",
+					       resmon_d_reg_error_names[i]) ||
+		    resmon_jrpc_object_add_str(class_obj, "descr",
+					       resmon_d_reg_error_descrs[i]) ||
+		    resmon_jrpc_object_add_int(class_obj, "count",
+					       stats->counts[i]) ||
+		    json_object_array_add(classes_obj, class_obj)) {
+			json_object_put(class_obj);
+			goto put_classes_obj;
+		}
+	}
+
+	if (json_object_object_add(result_obj, "classes", classes_obj))
+		goto put_classes_obj;
+
+	return 0;
+
+put_classes_obj:
+	json_object_put(classes_obj);
+	return -1;
+}
+
+struct resmon_d_errors_ctx {
+	const struct resmon_dev *dev;
+	struct json_object *samples_obj;
+	/* CLOCK_REALTIME minus CLOCK_MONOTONIC. */
+	int64_t realtime_offset_ns;
+};
+
+static int
+resmon_d_errors_attach_sample(enum resmon_reg_error error,
+			      const struct resmon_stat_error_sample *sample,
+			      void *priv)
+{
+	struct resmon_d_errors_ctx *ctx = priv;
+	struct json_object *sample_obj;
+	int rc;
+
+	sample_obj = json_object_new_object();
+	if (sample_obj == NULL)
+		return -1;
+
+	rc = resmon_d_attach_dev_name(sample_obj, ctx->dev);
+	if (rc != 0)
+		goto put_sample_obj;
+
+	rc = resmon_jrpc_object_add_str(sample_obj, "class",
+					resmon_d_reg_error_names[error]);
+	if (rc != 0)
+		goto put_sample_obj;
+
+	rc = resmon_jrpc_object_add_int(sample_obj, "time_ns",
+					sample->time_ns +
+					ctx->realtime_offset_ns);
+	if (rc != 0)
+		goto put_sample_obj;
+
+	rc = resmon_jrpc_object_add_str(sample_obj, "message",
+					sample->message);
+	if (rc != 0)
+		goto put_sample_obj;
+
+	rc = resmon_jrpc_object_add_int(sample_obj, "len", sample->len);
+	if (rc != 0)
+		goto put_sample_obj;
+
+	rc = resmon_jrpc_object_add_hex(sample_obj, "emad", sample->emad,
+					sample->kept_len);
+	if (rc != 0)
+		goto put_sample_obj;
+
+	rc = json_object_array_add(ctx->samples_obj, sample_obj);
+	if (rc)
+		goto put_sample_obj;
+
+	return 0;
+
+put_sample_obj:
+	json_object_put(sample_obj);
+	return -1;
+}
+
+static void resmon_d_handle_errors(struct resmon_back *back,
+				   struct resmon_sock *peer,
+				   struct json_object *params_obj,
+				   struct json_object *id)
+{
+	struct resmon_stat_error_stats stats = {};
+	struct json_object *samples_obj;
+	struct resmon_d_errors_ctx ctx;
+	struct json_object *result_obj;
+	int64_t realtime_offset_ns;
+	struct resmon_dev *devs;
+	struct json_object *obj;
+	const char *device;
+	size_t num_devs;
+	char *error;
+	int rc;
+
+	/* The request takes the same optional "device" selector as "stats".
+	 * The response has the EMAD processing errors by class, and samples
+	 * of the offending EMADs, oldest first within a class:
+	 *
+	 * {
+	 *     "id": ...,
+	 *     "result": {
+	 *         "classes": [
+	 *             {
+	 *                 "name": "truncated",
+	 *                 "descr": "Payload truncated",
+	 *                 "count": number
+	 *             },
+	 *             ....
+	 *         ],
+	 *         "samples": [
+	 *             {
+	 *                 "device": "pci/0000:01:00.0",
+	 *                 "class": "truncated",
+	 *                 "time_ns": UNIX time of the error in ns,
+	 *                 "message": what was wrong,
+	 *                 "len": length of the EMAD,
+	 *                 "emad": hexdump of the start of the EMAD
+	 *             },
+	 *             ....
+	 *         ],
+	 *         "logged": errors logged to syslog,
+	 *         "suppressed": errors not logged due to rate limiting
+	 *     }
+	 * }
+	 */
+
+	rc = resmon_jrpc_dissect_params_device(params_obj, &device, &error);
+	if (rc) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		return;
+	}
+
+	rc = resmon_d_select_devs(back, device, &devs, &num_devs, &error);
+	if (rc) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		return;
+	}
+
+	for (size_t i = 0; i < num_devs; i++) {
+		struct resmon_stat_error_stats dev_stats;
+
+		dev_stats = resmon_stat_error_stats(devs[i].stat);
+		for (int j = 0; j < resmon_reg_error_count; j++)
+			stats.counts[j] += dev_stats.counts[j];
+	}
+
+	obj = resmon_jrpc_new_object(id);
+	if (obj == NULL)
+		return;
+
+	result_obj = json_object_new_object();
+	if (result_obj == NULL)
+		goto put_obj;
+
+	rc = resmon_d_errors_attach_classes(result_obj, &stats);
+	if (rc != 0)
+		goto put_result_obj;
+
+	samples_obj = json_object_new_array();
+	if (samples_obj == NULL)
+		goto put_result_obj;
+
+	realtime_offset_ns = resmon_d_clock_ns(CLOCK_REALTIME) -
+			     resmon_d_clock_ns(CLOCK_MONOTONIC);
+	for (size_t i = 0; i < num_devs; i++) {
+		ctx = (struct resmon_d_errors_ctx) {
+			.dev = &devs[i],
+			.samples_obj = samples_obj,
+			.realtime_offset_ns = realtime_offset_ns,
+		};
+		rc = resmon_stat_error_sample_foreach(devs[i].stat,
+						resmon_d_errors_attach_sample,
+						&ctx);
+		if (rc)
+			goto put_samples_obj;
+	}
+
+	rc = json_object_object_add(result_obj, "samples", samples_obj);
+	if (rc)
+		goto put_samples_obj;
+
+	rc = resmon_jrpc_object_add_int(result_obj, "logged", back->log.logged);
+	if (rc != 0)
+		goto put_result_obj;
+
+	rc = resmon_jrpc_object_add_int(result_obj, "suppressed",
+					back->log.suppressed);
+	if (rc != 0)
+		goto put_result_obj;
+
+	rc = json_object_object_add(obj, "result", result_obj);
+	if (rc)
+		goto put_result_obj;
+
+	resmon_jrpc_send(peer, obj);
+	json_object_put(obj);
+	return;
+
+put_samples_obj:
+	json_object_put(samples_obj);
+put_result_obj:
+	json_object_put(result_obj);
+put_obj:
+	json_object_put(obj);
+	resmon_d_respond_memerr(peer, id);
+}
+
+static const char *const resmon_d_recon_actions[] = {
+	[RESMON_RECON_ACTION_FLAG] = "flag",
+	[RESMON_RECON_ACTION_REBASE] = "rebase",
+};
+
+static int resmon_d_recon_attach_resource(struct json_object *resources_obj,
+					  const struct resmon_dev *dev,
+					  enum resmon_recon_resource resource)
+{
+	const struct resmon_recon_state *state = &dev->recon[resource];
+	struct json_object *res_obj;
+	int rc;
+
+	res_obj = json_object_new_object();
+	if (res_obj == NULL)
+		return -1;
+
+	rc = resmon_d_attach_dev_name(res_obj, dev);
+	if (rc != 0)
+		goto put_res_obj;
+
+	if (resmon_jrpc_object_add_str(res_obj, "name",
+				resmon_recon_resource_name(resource)) ||
+	    resmon_jrpc_object_add_str(res_obj, "devlink_name",
+				resmon_recon_resource_devlink_name(resource)) ||
+	    resmon_jrpc_object_add_bool(res_obj, "present", state->present) ||
+	    resmon_jrpc_object_add_int(res_obj, "checks", state->checks) ||
+	    resmon_jrpc_object_add_int(res_obj, "failures", state->failures) ||
+	    resmon_jrpc_object_add_int(res_obj, "occupancy",
+				       state->occupancy) ||
+	    resmon_jrpc_object_add_int(res_obj, "accounted",
+				       state->accounted) ||
+	    resmon_jrpc_object_add_int(res_obj, "drift", state->drift) ||
+	    resmon_jrpc_object_add_bool(res_obj, "flagged", state->flagged) ||
+	    resmon_jrpc_object_add_int(res_obj, "rebases", state->rebases) ||
+	    resmon_jrpc_object_add_int(res_obj, "rebase_offset",
+				       state->rebase_offset))
+		goto put_res_obj;
+
+	rc = json_object_array_add(resources_obj, res_obj);
+	if (rc)
+		goto put_res_obj;
+
+	return 0;
+
+put_res_obj:
+	json_object_put(res_obj);
+	return -1;
+}
+
+static void resmon_d_handle_recon(struct resmon_back *back,
+				  struct resmon_sock *peer,
+				  struct json_object *params_obj,
+				  struct json_object *id)
+{
+	const struct resmon_recon_config *config = &back->recon.config;
+	struct json_object *resources_obj;
+	struct json_object *result_obj;
+	struct resmon_dev *devs;
+	struct json_object *obj;
+	const char *device;
+	size_t num_devs;
+	char *error;
+	bool check;
+	int rc;
+
+	/* The request takes the same optional "device" selector as "stats",
+	 * and "check": true to reconcile the devices before responding.
+	 * The response has the outcome of the last check of each resource:
+	 *
+	 * {
+	 *     "id": ...,
+	 *     "result": {
+	 *         "interval_ns": time between the periodic checks, or 0,
+	 *         "threshold": drift in entries that is acted upon,
+	 *         "persist": checks in a row that it takes,
+	 *         "action": "flag" or "rebase",
+	 *         "resources": [
+	 *             {
+	 *                 "device": "pci/0000:01:00.0",
+	 *                 "name": "kvd",
+	 *                 "devlink_name": "kvd",
+	 *                 "present": whether devlink reports occupancy,
+	 *                 "checks": number of checks,
+	 *                 "failures": failures to get the occupancy,
+	 *                 "occupancy": as devlink has it,
+	 *                 "accounted": as resmon has it,
+	 *                 "drift": accounted - occupancy,
+	 *                 "flagged": whether the drift was flagged,
+	 *                 "rebases": number of rebases,
+	 *                 "rebase_offset": sum of their corrections
+	 *             },
+	 *             ....
+	 *         ]
+	 *     }
+	 * }
+	 */
+
+	rc = resmon_jrpc_dissect_params_recon(params_obj, &device, &check,
+					      &error);
+	if (rc) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		return;
+	}
+
+	rc = resmon_d_select_devs(back, device, &devs, &num_devs, &error);
+	if (rc) {
+		resmon_d_respond_invalid_params(peer, id, error);
+		free(error);
+		return;
+	}
+
+	if (check) {
+		for (size_t i = 0; i < num_devs; i++)
+			resmon_recon_check(back, &devs[i]);
+	}
+
+	obj = resmon_jrpc_new_object(id);
+	if (obj == NULL)
+		return;
+
+	result_obj = json_object_new_object();
+	if (result_obj == NULL)
+		goto put_obj;
+
+	if (resmon_jrpc_object_add_int(result_obj, "interval_ns",
+				       config->interval_ns) ||
+	    resmon_jrpc_object_add_int(result_obj, "threshold",
+				       config->threshold) ||
+	    resmon_jrpc_object_add_int(result_obj, "persist",
+				       config->persist) ||
+	    resmon_jrpc_object_add_str(result_obj, "action",
+				resmon_d_recon_actions[config->action]))
+		goto put_result_obj;
+
+	resources_obj = json_object_new_array();
+	if (resources_obj == NULL)
+		goto put_result_obj;
+
+	for (size_t i = 0; i < num_devs; i++) {
+		for (int j = 0; j < resmon_recon_resource_count; j++) {
+			rc = resmon_d_recon_attach_resource(resources_obj,
+							    &devs[i], j);
+			if (rc)
+				goto put_resources_obj;
+		}
+	}
+
+	rc = json_object_object_add(result_obj, "resources", resources_obj);
+	if (rc)
+		goto put_resources_obj;
+
+	rc = json_object_object_add(obj, "result", result_obj);
+	if (rc)
+		goto put_result_obj;
+
+	resmon_jrpc_send(peer, obj);
+	json_object_put(obj);
+	return;
+
+put_resources_obj:
+	json_object_put(resources_obj);
+put_result_obj:
+	json_object_put(result_obj);
+put_obj:
+	json_object_put(obj);
+	resmon_d_respond_memerr(peer, id);
+}
+
+static int resmon_d_ages_attach_table(struct json_object *tables_obj,
+				      const struct resmon_dev *dev,
+				      enum resmon_stat_table table)
+{
+	struct resmon_stat_ages ages;
+	struct json_object *table_obj;
+	int rc;
+
+	ages = resmon_stat_table_ages(dev->stat, table);
+
+	table_obj = json_object_new_object();
+	if (table_obj == NULL)
+		return -1;
+
+	rc = resmon_d_attach_dev_name(table_obj, dev);
+	if (rc != 0)
+		goto put_table_obj;
+
+	rc = resmon_jrpc_object_add_str(table_obj, "name",
+					resmon_stat_table_name(table));
+	if (rc != 0)
+		goto put_table_obj;
+
+	rc = resmon_jrpc_object_add_int(table_obj, "entries", ages.entries);
+	if (rc != 0)
+		goto put_table_obj;
+
+	rc = resmon_jrpc_object_add_int_array(table_obj, "counts",
+					      ages.counts,
+					      ARRAY_SIZE(ages.counts));
+	if (rc != 0)
+		goto put_table_obj;
+
+	rc = json_object_array_add(tables_obj, table_obj);
+	if (rc)
+		goto put_table_obj;
+
+	return 0;
+
+put_table_obj:
+	json_object_put(table_obj);
+	return -1;
+}
+
+static int resmon_d_ages_attach_key(struct json_object *keys_obj,
+				    const struct resmon_dev *dev,
+				    const struct resmon_stat_aged_key *key)
 {
-	struct json_object *counter_obj;
+	struct json_object *key_obj;
+	char *key_str;
 	int rc;
 
-	counter_obj = json_object_new_object();
-	if (counter_obj == NULL)
+	key_str = resmon_d_key_str(key->key, key->key_size);
+	if (key_str == NULL)
 		return -1;
 
-	rc = resmon_jrpc_object_add_str(counter_obj, "name", name);
+	key_obj = json_object_new_object();
+	if (key_obj == NULL)
+		goto free_key_str;
+
+	rc = resmon_d_attach_dev_name(key_obj, dev);
 	if (rc != 0)
-		goto put_counter_obj;
+		goto put_key_obj;
 
-	rc = resmon_jrpc_object_add_str(counter_obj, "descr", descr);
+	rc = resmon_jrpc_object_add_str(key_obj, "table",
+					resmon_stat_table_name(key->table));
 	if (rc != 0)
-		goto put_counter_obj;
+		goto put_key_obj;
 
-	rc = resmon_jrpc_object_add_int(counter_obj, "value", value);
+	rc = resmon_jrpc_object_add_str(key_obj, "key", key_str);
 	if (rc != 0)
-		goto put_counter_obj;
+		goto put_key_obj;
 
-	rc = resmon_jrpc_object_add_int(counter_obj, "capacity", capacity);
+	rc = resmon_jrpc_object_add_int(key_obj, "age_s", key->age_s);
 	if (rc != 0)
-		goto put_counter_obj;
+		goto put_key_obj;
 
-	rc = json_object_array_add(counters_obj, counter_obj);
+	rc = resmon_jrpc_object_add_int(key_obj, "idle_s", key->idle_s);
+	if (rc != 0)
+		goto put_key_obj;
+
+	rc = resmon_jrpc_object_add_int(key_obj, "redundant", key->redundant);
+	if (rc != 0)
+		goto put_key_obj;
+
+	rc = json_object_array_add(keys_obj, key_obj);
 	if (rc)
-		goto put_counter_obj;
+		goto put_key_obj;
 
+	free(key_str);
 	return 0;
 
-put_counter_obj:
-	json_object_put(counter_obj);
+put_key_obj:
+	json_object_put(key_obj);
+free_key_str:
+	free(key_str);
 	return -1;
 }
 
-static void resmon_d_handle_stats(struct resmon_back *back,
-				  struct resmon_stat *stat,
-				  struct resmon_sock *peer,
-				  struct json_object *params_obj,
-				  struct json_object *id)
+static void resmon_d_handle_ages(struct resmon_back *back,
+				 struct resmon_sock *peer,
+				 struct json_object *params_obj,
+				 struct json_object *id)
 {
-	struct resmon_stat_counters counters;
-	struct json_object *counters_obj;
+	enum resmon_stat_table table = 0;
+	struct resmon_stat_aged_key *oldest;
 	struct json_object *result_obj;
+	struct json_object *tables_obj;
+	struct json_object *keys_obj;
+	struct resmon_dev *devs;
 	struct json_object *obj;
-	uint64_t capacity;
+	const char *table_name;
+	const char *device;
+	size_t num_devs;
+	int64_t max_top;
 	char *error;
+	bool by_idle;
 	int rc;
 
-	/* The response is as follows:
+	/* The request takes the optional "device" selector of "stats", an
+	 * optional "table" to limit the response to, e.g. "ptce3", and an
+	 * optional "top" with the number of oldest entries to list per
+	 * device, ten by default. The entries are the ones inserted the
+	 * longest ago, or with "by": "idle", the ones updated the longest
+	 * ago. The response is as follows:
 	 *
 	 * {
 	 *     "id": ...,
 	 *     "result": {
-	 *         "counters": [
+	 *         "max_age_s": [ 10, 60, 600, ... ],
+	 *         "tables": [
 	 *             {
-	 *                 "name": symbolic counter enum name,
-	 *                 "description": string with human-readable descr.,
-	 *                 "value": integer, value of the counter
+	 *                 "device": "pci/0000:01:00.0",
+	 *                 "name": "ralue",
+	 *                 "entries": number of entries,
+	 *                 "counts": [ entries up to 10s old, 10-60s old,
+	 *                             ..., older than the last bound ]
+	 *             },
+	 *             ....
+	 *         ],
+	 *         "oldest": [
+	 *             {
+	 *                 "device": "pci/0000:01:00.0",
+	 *                 "table": "ralue",
+	 *                 "key": hex dump of the table key,
+	 *                 "age_s": seconds since the insertion,
+	 *                 "idle_s": seconds since the last update,
+	 *                 "redundant": number of redundant writes
 	 *             },
 	 *             ....
 	 *         ]
 	 *     }
 	 * }
+	 *
+	 * The histograms put entries inserted within the same minute, hour
+	 * or day, as their age goes, in the bin of the oldest of them.
 	 */
 
-	rc = resmon_jrpc_dissect_params_empty(params_obj, &error);
+	rc = resmon_jrpc_dissect_params_ages(params_obj, &device, &table_name,
+					     &max_top, &by_idle, &error);
 	if (rc) {
 		resmon_d_respond_invalid_params(peer, id, error);
 		free(error);
 		return;
 	}
 
-	rc = back->cls->get_capacity(back, &capacity, &error);
-	if (rc != 0) {
-		resmon_d_respond_error(peer, id, resmon_jrpc_e_capacity,
-				       "Issue while retrieving capacity", error);
+	if (!back->stat_config.track_ages) {
+		resmon_d_respond_invalid_params(peer, id,
+			    "Entry ages are not tracked, start resmon with \"ages on\"");
+		return;
+	}
+
+	if (table_name != NULL &&
+	    resmon_stat_table_parse(table_name, &table)) {
+		resmon_d_respond_invalid_params(peer, id, "Unknown table");
+		return;
+	}
+
+	rc = resmon_d_select_devs(back, device, &devs, &num_devs, &error);
+	if (rc) {
+		resmon_d_respond_invalid_params(peer, id, error);
 		free(error);
 		return;
 	}
 
+	oldest = calloc(max_top, sizeof(*oldest));
+	if (oldest == NULL && max_top != 0) {
+		resmon_d_respond_memerr(peer, id);
+		return;
+	}
+
 	obj = resmon_jrpc_new_object(id);
 	if (obj == NULL)
-		return;
+		goto free_oldest;
 
 	result_obj = json_object_new_object();
 	if (result_obj == NULL)
 		goto put_obj;
 
-	counters_obj = json_object_new_array();
-	if (counters_obj == NULL)
+	rc = resmon_jrpc_object_add_int_array(result_obj, "max_age_s",
+					      resmon_stat_age_max_s,
+					      ARRAY_SIZE(resmon_stat_age_max_s));
+	if (rc)
 		goto put_result_obj;
 
-	counters = resmon_stat_counters(stat);
-	for (int i = 0; i < ARRAY_SIZE(counters.values); i++) {
-		rc = resmon_d_stats_attach_counter(counters_obj,
-					    resmon_d_counter_names[i],
-					    resmon_d_counter_descriptions[i],
-					    counters.values[i],
-					    capacity);
-		if (rc)
-			goto put_counters_obj;
-	}
+	/* The arrays are owned by result_obj as soon as they are added. */
+	tables_obj = json_object_new_array();
+	if (resmon_d_object_add_array(result_obj, "tables", tables_obj))
+		goto put_result_obj;
 
-	rc = resmon_d_stats_attach_counter(counters_obj, "TOTAL", "Total",
-					   counters.total, capacity);
-	if (rc)
-		goto put_counters_obj;
+	keys_obj = json_object_new_array();
+	if (resmon_d_object_add_array(result_obj, "oldest", keys_obj))
+		goto put_result_obj;
 
-	rc = json_object_object_add(result_obj, "counters", counters_obj);
-	if (rc != 0)
-		goto put_counters_obj;
+	for (size_t i = 0; i < num_devs; i++) {
+		size_t num_oldest = 0;
+
+		for (int j = 0; j < resmon_stat_table_count; j++) {
+			if (table_name != NULL && j != table)
+				continue;
+
+			rc = resmon_d_ages_attach_table(tables_obj, &devs[i],
+							j);
+			if (rc)
+				goto put_result_obj;
+
+			num_oldest = resmon_stat_oldest(devs[i].stat, j,
+							by_idle, oldest,
+							num_oldest, max_top);
+		}
+
+		for (size_t j = 0; j < num_oldest; j++) {
+			rc = resmon_d_ages_attach_key(keys_obj, &devs[i],
+						      &oldest[j]);
+			if (rc)
+				goto put_result_obj;
+		}
+	}
 
 	rc = json_object_object_add(obj, "result", result_obj);
-	if (rc != 0)
+	if (rc)
 		goto put_result_obj;
 
 	resmon_jrpc_send(peer, obj);
 	json_object_put(obj);
+	free(oldest);
 	return;
 
-put_counters_obj:
-	json_object_put(counters_obj);
 put_result_obj:
 	json_object_put(result_obj);
 put_obj:
 	json_object_put(obj);
+free_oldest:
+	free(oldest);
 	resmon_d_respond_memerr(peer, id);
 }
 
 static void resmon_d_handle_method(struct resmon_back *back,
-				   struct resmon_stat *stat,
 				   struct resmon_sock *peer,
 				   const char *method,
 				   struct json_object *params_obj,
@@ -303,10 +2742,43 @@ static void resmon_d_handle_method(struct resmon_back *back,
 		resmon_d_handle_ping(peer, params_obj, id);
 		return;
 	} else if (strcmp(method, "stats") == 0) {
-		resmon_d_handle_stats(back, stat, peer, params_obj, id);
+		resmon_d_handle_stats(back, peer, params_obj, id);
+		return;
+	} else if (strcmp(method, "regs") == 0) {
+		resmon_d_handle_regs(back, peer, params_obj, id);
+		return;
+	} else if (strcmp(method, "acl") == 0) {
+		resmon_d_handle_acl(back, peer, params_obj, id);
+		return;
+	} else if (strcmp(method, "lpm") == 0) {
+		resmon_d_handle_lpm(back, peer, params_obj, id);
+		return;
+	} else if (strcmp(method, "churn") == 0) {
+		resmon_d_handle_churn(back, peer, params_obj, id);
+		return;
+	} else if (strcmp(method, "bursts") == 0) {
+		resmon_d_handle_bursts(back, peer, params_obj, id);
+		return;
+	} else if (strcmp(method, "plan") == 0) {
+		resmon_d_handle_plan(back, peer, params_obj, id);
+		return;
+	} else if (strcmp(method, "kvdl") == 0) {
+		resmon_d_handle_kvdl(back, peer, params_obj, id);
+		return;
+	} else if (strcmp(method, "health") == 0) {
+		resmon_d_handle_health(back, peer, params_obj, id);
+		return;
+	} else if (strcmp(method, "errors") == 0) {
+		resmon_d_handle_errors(back, peer, params_obj, id);
+		return;
+	} else if (strcmp(method, "recon") == 0) {
+		resmon_d_handle_recon(back, peer, params_obj, id);
+		return;
+	} else if (strcmp(method, "ages") == 0) {
+		resmon_d_handle_ages(back, peer, params_obj, id);
 		return;
 	} else if (back->cls->handle_method != NULL &&
-		   back->cls->handle_method(back, stat, method, peer,
+		   back->cls->handle_method(back, method, peer,
 					    params_obj, id)) {
 		return;
 	}
@@ -316,7 +2788,6 @@ static void resmon_d_handle_method(struct resmon_back *back,
 }
 
 static int resmon_d_ctl_activity(struct resmon_back *back,
-				 struct resmon_stat *stat,
 				 struct resmon_sock *ctl)
 {
 	struct json_object *request_obj;
@@ -348,22 +2819,25 @@ static int resmon_d_ctl_activity(struct resmon_back *back,
 		goto put_req_obj;
 	}
 
-	resmon_d_handle_method(back, stat, &peer, method, params, id);
+	resmon_d_handle_method(back, &peer, method, params, id);
 
 put_req_obj:
 	json_object_put(request_obj);
 free_req:
+	if (peer.msg_fd >= 0)
+		close(peer.msg_fd);
 	free(request);
 	return 0;
 }
 
-static int resmon_d_loop_sock(struct resmon_back *back, struct resmon_stat *stat,
+static int resmon_d_loop_sock(struct resmon_back *back,
 			      struct resmon_sock *ctl)
 {
 	int err = 0;
 	enum {
 		pollfd_ctl,
 		pollfd_back,
+		pollfd_recon,
 	};
 	struct pollfd pollfds[] = {
 		[pollfd_ctl] = {
@@ -374,6 +2848,10 @@ static int resmon_d_loop_sock(struct resmon_back *back, struct resmon_stat *stat
 			.fd = back->cls->pollfd(back),
 			.events = POLLIN,
 		},
+		[pollfd_recon] = {
+			.fd = resmon_recon_pollfd(back),
+			.events = POLLIN,
+		},
 	};
 
 	if (env.verbosity > 0)
@@ -403,13 +2881,17 @@ static int resmon_d_loop_sock(struct resmon_back *back, struct resmon_stat *stat
 			if (pollfd->revents & POLLIN) {
 				switch (i) {
 				case pollfd_ctl:
-					err = resmon_d_ctl_activity(back, stat,
-								    ctl);
+					err = resmon_d_ctl_activity(back, ctl);
 					if (err != 0)
 						goto out;
 					break;
 				case pollfd_back:
-					err = back->cls->activity(back, stat);
+					err = back->cls->activity(back);
+					if (err != 0)
+						goto out;
+					break;
+				case pollfd_recon:
+					err = resmon_recon_activity(back);
 					if (err != 0)
 						goto out;
 					break;
@@ -422,7 +2904,7 @@ out:
 	return err;
 }
 
-static int resmon_d_loop(struct resmon_back *back, struct resmon_stat *stat)
+static int resmon_d_loop(struct resmon_back *back)
 {
 	struct resmon_sock ctl;
 	int err;
@@ -437,51 +2919,108 @@ static int resmon_d_loop(struct resmon_back *back, struct resmon_stat *stat)
 
 	sd_notify(0, "READY=1");
 
-	err = resmon_d_loop_sock(back, stat, &ctl);
+	err = resmon_d_loop_sock(back, &ctl);
 
 	resmon_sock_close_d(&ctl);
 	return err;
 }
 
-static int resmon_d_do_start(const struct resmon_back_cls *back_cls)
+static int resmon_d_do_start(const struct resmon_back_cls *back_cls,
+			     const struct resmon_back_args *back_args)
 {
 	struct resmon_back *back;
-	struct resmon_stat *stat;
 	int err = 0;
 
-	stat = resmon_stat_create();
-	if (stat == NULL)
+	back = back_cls->init(back_args);
+	if (back == NULL)
 		return -1;
 
-	back = back_cls->init();
-	if (back == NULL)
-		goto destroy_stat;
+	err = resmon_recon_init(back, &back_args->recon_config);
+	if (err != 0)
+		goto fini_back;
 
 	openlog("resmon", LOG_PID | LOG_CONS, LOG_USER);
 
-	err = resmon_d_loop(back, stat);
+	err = resmon_d_loop(back);
 
 	closelog();
+	resmon_recon_fini(back);
+fini_back:
 	back_cls->fini(back);
-destroy_stat:
-	resmon_stat_destroy(stat);
 	return err;
 }
 
 static void resmon_d_start_help(void)
 {
 	fprintf(stderr,
-		"Usage: resmon start [mode {hw | mock}]\n"
+		"Usage: resmon start [mode {hw | mock | replay}] [devices NUM]\n"
+		"                    [kvdl-size NUM]\n"
+		"                    [burst-gap MS] [clock {real | manual}]\n"
+		"                    [file FILE] [speed {max | FACTOR}]\n"
+		"                    [kvd-size NUM] [reconcile SECONDS]\n"
+		"                    [drift-threshold NUM] [drift-persist NUM]\n"
+		"                    [drift-action {flag | rebase}]\n"
+		"                    [ages {on | off}]\n"
+		"\n"
+		"  devices: number of devices to simulate in mock mode\n"
+		"  kvdl-size: in mock mode, KVD linear size of the devices\n"
+		"  burst-gap: idle time that ends a burst of EMADs (default 100)\n"
+		"  clock: in mock mode, \"manual\" advances time only with the\n"
+		"         time given with injected EMADs\n"
+		"  file: in replay mode, emadump capture to replay\n"
+		"  speed: in replay mode, replay as fast as possible (default),\n"
+		"         or FACTOR times faster than captured\n"
+		"  kvd-size: in replay mode, KVD size of the captured device\n"
+		"  reconcile: time between reconciliations of the accounting\n"
+		"             with devlink occupancy, 0 to disable (default 5)\n"
+		"  drift-threshold: drift in entries that is acted upon\n"
+		"                   (default 16)\n"
+		"  drift-persist: reconciliations in a row that the drift has\n"
+		"                 to be seen in (default 3)\n"
+		"  drift-action: log the drift, or rebase the accounting onto\n"
+		"                the occupancy (default flag)\n"
+		"  ages: keep the insertion and last update time of each\n"
+		"        table entry, for \"resmon ages\" (default off)\n"
 		"\n"
 	);
 }
 
+static int resmon_d_parse_speed(const char *arg, double *speed)
+{
+	char *endptr;
+
+	if (strcmp(arg, "max") == 0) {
+		*speed = 0;
+		return 0;
+	}
+
+	*speed = strtod(arg, &endptr);
+	if (*endptr != '\0' || !(*speed > 0)) {
+		fprintf(stderr, "Invalid replay speed: %s\n", arg);
+		return -1;
+	}
+	return 0;
+}
+
 int resmon_d_start(int argc, char **argv)
 {
+	struct resmon_back_args back_args = {
+		.num_devs = 1,
+		.stat_config = {
+			.burst_gap_ns = 100000000ULL,
+		},
+		.recon_config = {
+			.interval_ns = 5000000000ULL,
+			.threshold = 16,
+			.persist = 3,
+			.action = RESMON_RECON_ACTION_FLAG,
+		},
+	};
 	const struct resmon_back_cls *back_cls;
 	enum {
 		mode_hw,
-		mode_mock
+		mode_mock,
+		mode_replay,
 	} mode = mode_hw;
 
 	while (argc > 0) {
@@ -491,12 +3030,145 @@ int resmon_d_start(int argc, char **argv)
 				mode = mode_hw;
 			} else if (strcmp(*argv, "mock") == 0) {
 				mode = mode_mock;
+			} else if (strcmp(*argv, "replay") == 0) {
+				mode = mode_replay;
 			} else {
 				fprintf(stderr, "Unrecognized mode: %s\n", *argv);
 				return -1;
 			}
 			NEXT_ARG_FWD();
-			break;
+		} else if (strcmp(*argv, "devices") == 0) {
+			char *endptr;
+
+			NEXT_ARG();
+			back_args.num_devs = strtoul(*argv, &endptr, 10);
+			if (*endptr != '\0' || back_args.num_devs == 0) {
+				fprintf(stderr, "Invalid number of devices: %s\n",
+					*argv);
+				return -1;
+			}
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "kvdl-size") == 0) {
+			char *endptr;
+
+			NEXT_ARG();
+			back_args.mock_kvdl_size = strtoull(*argv, &endptr, 10);
+			if (*endptr != '\0' || back_args.mock_kvdl_size == 0 ||
+			    back_args.mock_kvdl_size > RESMON_STAT_KVDL_MAX_SIZE) {
+				fprintf(stderr, "Invalid KVD linear size: %s\n",
+					*argv);
+				return -1;
+			}
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "burst-gap") == 0) {
+			unsigned long gap_ms;
+			char *endptr;
+
+			NEXT_ARG();
+			gap_ms = strtoul(*argv, &endptr, 10);
+			if (*endptr != '\0' || gap_ms == 0) {
+				fprintf(stderr, "Invalid burst gap: %s\n",
+					*argv);
+				return -1;
+			}
+			back_args.stat_config.burst_gap_ns = gap_ms * 1000000ULL;
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "clock") == 0) {
+			NEXT_ARG();
+			if (strcmp(*argv, "real") == 0) {
+				back_args.stat_config.manual_clock = false;
+			} else if (strcmp(*argv, "manual") == 0) {
+				back_args.stat_config.manual_clock = true;
+			} else {
+				fprintf(stderr, "Unrecognized clock: %s\n", *argv);
+				return -1;
+			}
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "file") == 0) {
+			NEXT_ARG();
+			back_args.replay_file = *argv;
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "speed") == 0) {
+			NEXT_ARG();
+			if (resmon_d_parse_speed(*argv, &back_args.replay_speed))
+				return -1;
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "kvd-size") == 0) {
+			char *endptr;
+
+			NEXT_ARG();
+			back_args.replay_kvd_size = strtoull(*argv, &endptr, 10);
+			if (*endptr != '\0' || back_args.replay_kvd_size == 0) {
+				fprintf(stderr, "Invalid KVD size: %s\n",
+					*argv);
+				return -1;
+			}
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "reconcile") == 0) {
+			unsigned long interval_s;
+			char *endptr;
+
+			NEXT_ARG();
+			interval_s = strtoul(*argv, &endptr, 10);
+			if (*endptr != '\0') {
+				fprintf(stderr, "Invalid reconciliation interval: %s\n",
+					*argv);
+				return -1;
+			}
+			back_args.recon_config.interval_ns =
+				interval_s * 1000000000ULL;
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "drift-threshold") == 0) {
+			char *endptr;
+
+			NEXT_ARG();
+			back_args.recon_config.threshold =
+				strtoull(*argv, &endptr, 10);
+			if (*endptr != '\0') {
+				fprintf(stderr, "Invalid drift threshold: %s\n",
+					*argv);
+				return -1;
+			}
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "drift-persist") == 0) {
+			char *endptr;
+
+			NEXT_ARG();
+			back_args.recon_config.persist =
+				strtoul(*argv, &endptr, 10);
+			if (*endptr != '\0' ||
+			    back_args.recon_config.persist == 0) {
+				fprintf(stderr, "Invalid drift persistence: %s\n",
+					*argv);
+				return -1;
+			}
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "drift-action") == 0) {
+			NEXT_ARG();
+			if (strcmp(*argv, "flag") == 0) {
+				back_args.recon_config.action =
+					RESMON_RECON_ACTION_FLAG;
+			} else if (strcmp(*argv, "rebase") == 0) {
+				back_args.recon_config.action =
+					RESMON_RECON_ACTION_REBASE;
+			} else {
+				fprintf(stderr, "Unrecognized drift action: %s\n",
+					*argv);
+				return -1;
+			}
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "ages") == 0) {
+			NEXT_ARG();
+			if (strcmp(*argv, "on") == 0) {
+				back_args.stat_config.track_ages = true;
+			} else if (strcmp(*argv, "off") == 0) {
+				back_args.stat_config.track_ages = false;
+			} else {
+				fprintf(stderr, "Unrecognized ages setting: %s\n",
+					*argv);
+				return -1;
+			}
+			NEXT_ARG_FWD();
 		} else if (strcmp(*argv, "help") == 0) {
 			resmon_d_start_help();
 			return 0;
@@ -511,6 +3183,16 @@ incomplete_command:
 		return -1;
 	}
 
+	if (mode != mode_mock && back_args.stat_config.manual_clock) {
+		fprintf(stderr, "The manual clock is only available in mock mode\n");
+		return -1;
+	}
+
+	if ((mode == mode_replay) != (back_args.replay_file != NULL)) {
+		fprintf(stderr, "Replay mode needs a file, and only it takes one\n");
+		return -1;
+	}
+
 	switch (mode) {
 	case mode_hw:
 		back_cls = &resmon_back_cls_hw;
@@ -518,7 +3200,135 @@ incomplete_command:
 	case mode_mock:
 		back_cls = &resmon_back_cls_mock;
 		break;
+	case mode_replay:
+		back_cls = &resmon_back_cls_replay;
+		break;
+	}
+
+	return resmon_d_do_start(back_cls, &back_args);
+}
+
+static void resmon_d_replay_help(void)
+{
+	fprintf(stderr,
+		"Usage: resmon replay file FILE [speed {max | FACTOR}]\n"
+		"\n"
+		"  file: emadump capture to replay\n"
+		"  speed: replay as fast as possible (default), or FACTOR\n"
+		"         times faster than captured\n"
+		"\n"
+	);
+}
+
+static int resmon_d_replay_run(struct resmon_back *back)
+{
+	const struct resmon_back_replay_stats *stats;
+	struct pollfd pollfd = {
+		.fd = back->cls->pollfd(back),
+		.events = POLLIN,
+	};
+	int err;
+
+	stats = resmon_back_replay_stats(back);
+	while (!stats->done && !should_quit) {
+		err = poll(&pollfd, 1, -1);
+		if (err < 0 && errno != EINTR) {
+			fprintf(stderr, "Failed to poll: %m\n");
+			return -1;
+		}
+		if (err <= 0)
+			continue;
+
+		err = back->cls->activity(back);
+		if (err != 0)
+			return err;
+	}
+
+	return 0;
+}
+
+static void resmon_d_replay_print(struct resmon_back *back)
+{
+	const struct resmon_back_replay_stats *stats;
+	struct resmon_stat_counters counters;
+	double elapsed_s;
+
+	counters = resmon_stat_counters(back->devs[0].stat);
+	fprintf(stderr, "%-30s%s\n", "Resource", "Usage");
+	for (int i = 0; i < resmon_counter_count; i++)
+		fprintf(stderr, "%-30s%" PRId64 "\n",
+			resmon_d_counter_descriptions[i], counters.values[i]);
+	fprintf(stderr, "%-30s%" PRId64 "\n", "Total", counters.total);
+
+	stats = resmon_back_replay_stats(back);
+	elapsed_s = stats->elapsed_ns / 1e9;
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Frames: %" PRIu64 ", EMADs: %" PRIu64
+		", errors: %" PRIu64 "\n",
+		stats->frames, stats->emads, stats->errors);
+	fprintf(stderr, "Replayed in %.3f s", elapsed_s);
+	if (stats->elapsed_ns != 0)
+		fprintf(stderr, ", %.0f EMADs/s, %.2f MB/s",
+			stats->emads / elapsed_s,
+			stats->bytes / elapsed_s / 1e6);
+	fprintf(stderr, "\n");
+}
+
+int resmon_d_replay(int argc, char **argv)
+{
+	struct resmon_back_args back_args = {
+		.num_devs = 1,
+		.stat_config = {
+			.burst_gap_ns = 100000000ULL,
+		},
+	};
+	struct resmon_back *back;
+	int err;
+
+	while (argc > 0) {
+		if (strcmp(*argv, "file") == 0) {
+			NEXT_ARG();
+			back_args.replay_file = *argv;
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "speed") == 0) {
+			NEXT_ARG();
+			if (resmon_d_parse_speed(*argv, &back_args.replay_speed))
+				return -1;
+			NEXT_ARG_FWD();
+		} else if (strcmp(*argv, "help") == 0) {
+			resmon_d_replay_help();
+			return 0;
+		} else {
+			fprintf(stderr, "What is \"%s\"?\n", *argv);
+			return -1;
+		}
+		continue;
+
+incomplete_command:
+		fprintf(stderr, "Command line is not complete. Try option \"help\"\n");
+		return -1;
+	}
+
+	if (back_args.replay_file == NULL) {
+		fprintf(stderr, "No file given. Try option \"help\"\n");
+		return -1;
 	}
 
-	return resmon_d_do_start(back_cls);
+	err = resmon_d_setup_signals();
+	if (err < 0)
+		return -1;
+
+	back = resmon_back_cls_replay.init(&back_args);
+	if (back == NULL)
+		return -1;
+
+	openlog("resmon", LOG_PID | LOG_CONS | LOG_PERROR, LOG_USER);
+
+	err = resmon_d_replay_run(back);
+	if (err == 0)
+		resmon_d_replay_print(back);
+
+	closelog();
+	resmon_back_cls_replay.fini(back);
+	return err;
 }
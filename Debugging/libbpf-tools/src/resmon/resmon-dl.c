@@ -14,9 +14,9 @@
 #include "../trace_helpers.h"
 
 struct cb_args {
-	char **devname;
-	char **busname;
-	int err;
+	int (*cb)(const char *bus_name, const char *dev_name, void *priv);
+	void *priv;
+	int err; /* -1: nothing found, 0: found, 1: callback failed */
 };
 
 enum devlink_multicast_groups {
@@ -27,6 +27,7 @@ static const struct nla_policy devlink_nl_policy[DEVLINK_ATTR_MAX + 1] = {
 	[DEVLINK_ATTR_BUS_NAME] = { .type = NLA_NUL_STRING },
 	[DEVLINK_ATTR_DEV_NAME] = { .type = NLA_NUL_STRING },
 	[DEVLINK_ATTR_RESOURCE_SIZE] = { .type = NLA_U64},
+	[DEVLINK_ATTR_RESOURCE_OCC] = { .type = NLA_U64},
 };
 
 static int resmon_dl_netlink_init(struct nl_sock *sk, int *family, char **error)
@@ -64,9 +65,7 @@ static int resmon_dl_dev_info_parser(struct nl_msg *msg, void *arg)
 	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
 	struct cb_args *args = (struct cb_args *) arg;
 	struct nlattr *attrs[DEVLINK_ATTR_MAX + 1];
-	size_t busname_len, devname_len;
 	char *attr_driver_name;
-	bool set = false;
 	char *attr_bus;
 	char *attr_dev;
 	int err;
@@ -76,40 +75,31 @@ static int resmon_dl_dev_info_parser(struct nl_msg *msg, void *arg)
 	if (err < 0)
 		return NL_SKIP;
 
-	if (attrs[DEVLINK_ATTR_BUS_NAME] &&
-	    attrs[DEVLINK_ATTR_DEV_NAME] &&
-	    attrs[DEVLINK_ATTR_INFO_DRIVER_NAME]) {
-		attr_driver_name = nla_get_string(attrs[DEVLINK_ATTR_INFO_DRIVER_NAME]);
-
-		if (strstr(attr_driver_name, "mlxsw_spectrum") != NULL) {
-			attr_bus = nla_get_string(attrs[DEVLINK_ATTR_BUS_NAME]);
-			attr_dev = nla_get_string(attrs[DEVLINK_ATTR_DEV_NAME]);
-			busname_len = strlen(attr_bus) + 1;
-			devname_len = strlen(attr_dev) + 1;
-
-			*args->busname = (char *) malloc(busname_len*sizeof(char));
-			*args->devname = (char *) malloc(devname_len*sizeof(char));
-			if (args->busname == NULL || args->devname == NULL)
-				return NL_SKIP;
-
-			memcpy(*args->busname, attr_bus, busname_len);
-			memcpy(*args->devname, attr_dev, devname_len);
-			args->err = 0;
-			set = true;
-		}
-	}
+	if (!attrs[DEVLINK_ATTR_BUS_NAME] ||
+	    !attrs[DEVLINK_ATTR_DEV_NAME] ||
+	    !attrs[DEVLINK_ATTR_INFO_DRIVER_NAME])
+		return NL_SKIP;
 
-	if (!set)
+	attr_driver_name = nla_get_string(attrs[DEVLINK_ATTR_INFO_DRIVER_NAME]);
+	if (strstr(attr_driver_name, "mlxsw_spectrum") == NULL)
 		return NL_SKIP;
 
+	attr_bus = nla_get_string(attrs[DEVLINK_ATTR_BUS_NAME]);
+	attr_dev = nla_get_string(attrs[DEVLINK_ATTR_DEV_NAME]);
+	err = args->cb(attr_bus, attr_dev, args->priv);
+	if (err != 0) {
+		args->err = 1;
+		return NL_STOP;
+	}
+
+	if (args->err < 0)
+		args->err = 0;
 	return 0;
 }
 
-static int resmon_dl_netlink_get_dev(struct nl_sock *sk, int family,
-				     char **busname, char **devname,
-				     char **error)
+static int resmon_dl_netlink_get_devs(struct nl_sock *sk, int family,
+				      struct cb_args *args, char **error)
 {
-	struct cb_args args;
 	struct nl_cb *cb;
 	int err;
 
@@ -119,37 +109,54 @@ static int resmon_dl_netlink_get_dev(struct nl_sock *sk, int family,
 		return err;
 	}
 
-	args.devname = devname;
-	args.busname = busname;
-	args.err = -1;
-
 	cb = nl_cb_alloc(NL_CB_DEFAULT);
-	if (cb == NULL)
+	if (cb == NULL) {
+		resmon_fmterr(error, "Failed to allocate netlink callback");
 		return -NLE_NOMEM;
+	}
 
-	err = nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, resmon_dl_dev_info_parser, &args);
+	err = nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, resmon_dl_dev_info_parser,
+			args);
 	if (err < 0) {
 		resmon_fmterr(error, "Failed to set devlink info parser");
-		return err;
+		goto put_cb;
 	}
 
 	err = nl_recvmsgs(sk, cb);
-	if (err < 0 || args.err < 0) {
+	if (err < 0) {
 		resmon_fmterr(error, "Failed to receive messages from netlink");
-		return -1;
+		err = -1;
+		goto put_cb;
+	}
+	if (args->err < 0) {
+		resmon_fmterr(error, "No mlxsw_spectrum devlink instance found");
+		err = -1;
+		goto put_cb;
+	}
+	if (args->err > 0) {
+		resmon_fmterr(error, "Failed to record devlink instance");
+		err = -1;
+		goto put_cb;
 	}
 
-	nl_cb_put(cb);
+	err = 0;
 
-	return 0;
+put_cb:
+	nl_cb_put(cb);
+	return err;
 }
 
+/* Look up attribute attr_type, e.g. the size, of the named resource. Not
+ * every resource has every attribute, in which case *found stays false.
+ */
 static int resmon_dl_netlink_resources_get(struct nlattr **attrs,
 					   struct nlattr *nla_resources,
-					   uint64_t *size)
+					   const char *resource_name,
+					   int attr_type, uint64_t *value,
+					   bool *found)
 {
 	struct nlattr *nla_resource[DEVLINK_ATTR_MAX + 1];
-	struct nlattr *attr_name, *attr_size;
+	struct nlattr *attr_name;
 	struct nlattr *resource;
 	int rem, err;
 	char *name;
@@ -160,31 +167,37 @@ static int resmon_dl_netlink_resources_get(struct nlattr **attrs,
 		return err;
 
 	attr_name = nla_resource[DEVLINK_ATTR_RESOURCE_NAME];
-	attr_size = nla_resource[DEVLINK_ATTR_RESOURCE_SIZE];
-
-	if (attr_name && attr_size) {
+	if (attr_name) {
 		name = nla_get_string(attr_name);
-		if (strcmp(name, "kvd") == 0) {
-			*size = nla_get_u64(attr_size);
+		if (strcmp(name, resource_name) == 0) {
+			if (nla_resource[attr_type]) {
+				*value = nla_get_u64(nla_resource[attr_type]);
+				*found = true;
+			}
 			return 0;
 		}
 	}
 
 	nla_for_each_nested(resource, nla_resources, rem) {
+		if (*found)
+			break;
 		if (nla_resource[DEVLINK_ATTR_RESOURCE] ||
 		    nla_resource[DEVLINK_ATTR_RESOURCE_LIST])
 			resmon_dl_netlink_resources_get(nla_resource, resource,
-							size);
+							resource_name,
+							attr_type, value,
+							found);
 	}
-	if (!(*size))
-		return -1;
 
 	return 0;
 }
 
-static int resmon_dl_netlink_get_kvd_size(struct nl_sock *sk, int family,
-					  char *busname, char *devname,
-					  uint64_t *size, char **error)
+static int resmon_dl_netlink_get_resource_attr(struct nl_sock *sk, int family,
+					       const char *busname,
+					       const char *devname,
+					       const char *resource_name,
+					       int attr_type, uint64_t *value,
+					       bool *found, char **error)
 {
 	struct nlattr *attrs[DEVLINK_ATTR_MAX + 1];
 	struct sockaddr_nl nla;
@@ -223,59 +236,145 @@ static int resmon_dl_netlink_get_kvd_size(struct nl_sock *sk, int family,
 	err = genlmsg_parse((void *) buf, 0, attrs, DEVLINK_ATTR_MAX,
 			    devlink_nl_policy);
 	if (err < 0)
-		return err;
+		goto err_parse;
 
 	err = resmon_dl_netlink_resources_get(attrs,
 					      attrs[DEVLINK_ATTR_RESOURCE_LIST],
-					      size);
+					      resource_name, attr_type, value,
+					      found);
 	if (err < 0)
-		return err;
+		goto err_parse;
 
-	nl_socket_free(sk);
 	free(buf);
 	return 0;
 
+err_parse:
+	free(buf);
+	resmon_fmterr(error, "Failed to parse devlink resources from netlink");
+	return err;
+
 nla_put_failure:
 genlmsg_put_failure:
 	nlmsg_free(msg);
+	resmon_fmterr(error, "Failed to form devlink resource get command");
 	return -EMSGSIZE;
 }
 
-int resmon_dl_get_kvd_size(uint64_t *size, char **error)
+static struct nl_sock *resmon_dl_open(int *family, char **error)
 {
-	char *busname, *devname = NULL;
 	struct nl_sock *sk;
-	int family, err;
+	int err;
 
 	sk = nl_socket_alloc();
 	if (!sk) {
 		resmon_fmterr(error, "Failed to allocate data socket");
-		return -1;
+		return NULL;
 	}
 
 	nl_socket_disable_auto_ack(sk);
 
-	err = resmon_dl_netlink_init(sk, &family, error);
-	if (err < 0) {
-		resmon_fmterr(error, "Failed to open netlink socket");
+	/* On failure, resmon_dl_netlink_init() frees the socket. */
+	err = resmon_dl_netlink_init(sk, family, error);
+	if (err < 0)
+		return NULL;
+
+	return sk;
+}
+
+int resmon_dl_get_devs(int (*cb)(const char *bus_name, const char *dev_name,
+				 void *priv),
+		       void *priv, char **error)
+{
+	struct cb_args args = {
+		.cb = cb,
+		.priv = priv,
+		.err = -1,
+	};
+	struct nl_sock *sk;
+	int family, err;
+
+	sk = resmon_dl_open(&family, error);
+	if (sk == NULL)
 		return -1;
-	}
 
-	err = resmon_dl_netlink_get_dev(sk, family, &busname, &devname, error);
-	if (err < 0) {
-		resmon_fmterr(error, "Failed to get devlink dev from netlink");
+	err = resmon_dl_netlink_get_devs(sk, family, &args, error);
+	nl_socket_free(sk);
+	if (err < 0)
 		return -1;
-	}
 
-	err = resmon_dl_netlink_get_kvd_size(sk, family, busname, devname,
-					     size, error);
-	if (err < 0) {
+	return 0;
+}
+
+static int resmon_dl_get_resource_attr(const char *bus_name,
+				       const char *dev_name,
+				       const char *resource_name,
+				       int attr_type, uint64_t *value,
+				       bool *found, char **error)
+{
+	struct nl_sock *sk;
+	int family, err;
+
+	sk = resmon_dl_open(&family, error);
+	if (sk == NULL)
+		return -1;
+
+	*found = false;
+	err = resmon_dl_netlink_get_resource_attr(sk, family, bus_name,
+						  dev_name, resource_name,
+						  attr_type, value, found,
+						  error);
+	nl_socket_free(sk);
+	if (err < 0)
+		return -1;
+
+	return 0;
+}
+
+static int resmon_dl_get_resource_size(const char *bus_name,
+				       const char *dev_name,
+				       const char *resource_name,
+				       uint64_t *size, char **error)
+{
+	bool found;
+	int err;
+
+	err = resmon_dl_get_resource_attr(bus_name, dev_name, resource_name,
+					  DEVLINK_ATTR_RESOURCE_SIZE, size,
+					  &found, error);
+	if (err < 0)
+		return -1;
+
+	if (!found || *size == 0) {
 		resmon_fmterr(error, "Failed to get devlink resource size from netlink");
 		return -1;
 	}
 
-	free(busname);
-	free(devname);
 	return 0;
 }
 
+int resmon_dl_get_kvd_size(const char *bus_name, const char *dev_name,
+			   uint64_t *size, char **error)
+{
+	return resmon_dl_get_resource_size(bus_name, dev_name, "kvd",
+					   size, error);
+}
+
+/* Only Spectrum-1 partitions the KVD and exposes the linear part. */
+int resmon_dl_get_kvdl_size(const char *bus_name, const char *dev_name,
+			    uint64_t *size, char **error)
+{
+	return resmon_dl_get_resource_size(bus_name, dev_name, "linear",
+					   size, error);
+}
+
+/* The driver reports occupancy of only some resources. Where it does not,
+ * *present is set to false.
+ */
+int resmon_dl_get_resource_occ(const char *bus_name, const char *dev_name,
+			       const char *resource_name, bool *present,
+			       uint64_t *occ, char **error)
+{
+	return resmon_dl_get_resource_attr(bus_name, dev_name, resource_name,
+					   DEVLINK_ATTR_RESOURCE_OCC, occ,
+					   present, error);
+}
@@ -0,0 +1,212 @@
+// SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+#include <endian.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "resmon.h"
+
+/* Synthesis of the EMADs that the driver issues for the tracked registers,
+ * for the load generator and the microbenchmark. Each EMAD carries a
+ * successful response to a write of the register. The i-th entry of each
+ * kind is distinct from the others.
+ */
+
+#define RESMON_GEN_OP_TLV_LEN		16
+#define RESMON_GEN_TLV_HEAD_LEN		4
+
+/* Register lengths as the device has them, which resmon only needs part of. */
+#define RESMON_GEN_RALUE_LEN		0x38
+#define RESMON_GEN_RAUHT_LEN		0x74
+#define RESMON_GEN_PTAR_LEN		0x50
+#define RESMON_GEN_PTCE3_LEN		0xf0
+#define RESMON_GEN_PEFA_LEN		0xb0
+#define RESMON_GEN_IEDR_LEN		0x210
+
+#define RESMON_GEN_EXPAND_AS_REG_ID(NAME, name, ID) \
+	RESMON_GEN_REG_ID_ ## NAME = ID,
+
+enum {
+	RESMON_REGS(RESMON_GEN_EXPAND_AS_REG_ID)
+};
+
+#undef RESMON_GEN_EXPAND_AS_REG_ID
+
+static void resmon_gen_put_be16(uint8_t *p, uint16_t val)
+{
+	val = htobe16(val);
+	memcpy(p, &val, sizeof(val));
+}
+
+static void resmon_gen_put_be32(uint8_t *p, uint32_t val)
+{
+	val = htobe32(val);
+	memcpy(p, &val, sizeof(val));
+}
+
+static uint16_t resmon_gen_tl(int type, size_t len)
+{
+	return type << 11 | len / 4;
+}
+
+static size_t resmon_gen_emad_len(size_t reg_len)
+{
+	return RESMON_GEN_OP_TLV_LEN + RESMON_GEN_TLV_HEAD_LEN + reg_len +
+	       RESMON_GEN_TLV_HEAD_LEN;
+}
+
+/* Lay out the TLVs and return the register payload to fill in. */
+static uint8_t *resmon_gen_emad(uint8_t *buf, uint16_t reg_id,
+				size_t reg_len)
+{
+	uint8_t *p = buf;
+
+	memset(buf, 0, resmon_gen_emad_len(reg_len));
+
+	resmon_gen_put_be16(p, resmon_gen_tl(MLXSW_EMAD_TLV_TYPE_OP,
+					     RESMON_GEN_OP_TLV_LEN));
+	resmon_gen_put_be16(p + 4, reg_id);
+	p[6] = 0x82;	/* Response to a write. */
+	p[7] = 0x01;	/* Register access class. */
+	p += RESMON_GEN_OP_TLV_LEN;
+
+	resmon_gen_put_be16(p, resmon_gen_tl(MLXSW_EMAD_TLV_TYPE_REG,
+					     RESMON_GEN_TLV_HEAD_LEN +
+					     reg_len));
+	p += RESMON_GEN_TLV_HEAD_LEN;
+
+	resmon_gen_put_be16(p + reg_len,
+			    resmon_gen_tl(MLXSW_EMAD_TLV_TYPE_END,
+					  RESMON_GEN_TLV_HEAD_LEN));
+	return p;
+}
+
+/* Mostly /24 and /48 prefixes with some shorter ones, as in a full
+ * Internet table.
+ */
+size_t resmon_gen_ralue(uint8_t *buf, bool ipv6, uint32_t i, bool delete)
+{
+	uint8_t *reg;
+
+	reg = resmon_gen_emad(buf, RESMON_GEN_REG_ID_RALUE,
+			      RESMON_GEN_RALUE_LEN);
+
+	reg[0] = ipv6 ? MLXSW_REG_RALXX_PROTOCOL_IPV6
+		      : MLXSW_REG_RALXX_PROTOCOL_IPV4;
+	reg[1] = (delete ? MLXSW_REG_RALUE_OP_WRITE_DELETE
+			 : MLXSW_REG_RALUE_OP_WRITE_WRITE) << 4;
+	if (ipv6) {
+		reg[11] = i % 8 == 0 ? 64 : 48;
+		reg[12] = 0x20;
+		reg[13] = 0x01;
+		resmon_gen_put_be32(reg + 14, i);
+	} else {
+		reg[11] = i % 10 < 6 ? 24 : 16 + i % 8;
+		resmon_gen_put_be32(reg + 24, (i + 0x10000) << 8);
+	}
+
+	return resmon_gen_emad_len(RESMON_GEN_RALUE_LEN);
+}
+
+/* Every fourth neighbour is IPv6. */
+size_t resmon_gen_rauht(uint8_t *buf, uint32_t i, bool delete)
+{
+	bool ipv6 = i % 4 == 3;
+	uint8_t *reg;
+
+	reg = resmon_gen_emad(buf, RESMON_GEN_REG_ID_RAUHT,
+			      RESMON_GEN_RAUHT_LEN);
+
+	reg[0] = ipv6 ? MLXSW_REG_RALXX_PROTOCOL_IPV6
+		      : MLXSW_REG_RALXX_PROTOCOL_IPV4;
+	reg[1] = (delete ? MLXSW_REG_RAUHT_OP_WRITE_DELETE
+			 : MLXSW_REG_RAUHT_OP_WRITE_ADD) << 4;
+	if (ipv6) {
+		reg[16] = 0xfe;
+		reg[17] = 0x80;
+		resmon_gen_put_be32(reg + 28, i);
+	} else {
+		resmon_gen_put_be32(reg + 28, 0x0a000000 | i);
+	}
+
+	return resmon_gen_emad_len(RESMON_GEN_RAUHT_LEN);
+}
+
+static void resmon_gen_tcam_region_info(uint8_t *p, uint32_t region)
+{
+	p[0] = 0x10;
+	resmon_gen_put_be32(p + 12, region);
+}
+
+/* Regions use six key blocks, which takes two KVD slots per rule. */
+size_t resmon_gen_ptar(uint8_t *buf, uint32_t region, uint16_t size,
+		       bool release)
+{
+	uint8_t *reg;
+
+	reg = resmon_gen_emad(buf, RESMON_GEN_REG_ID_PTAR,
+			      RESMON_GEN_PTAR_LEN);
+
+	reg[0] = (release ? MLXSW_REG_PTAR_OP_FREE
+			  : MLXSW_REG_PTAR_OP_ALLOC) << 4;
+	reg[3] = MLXSW_REG_PTAR_KEY_TYPE_FLEX2;
+	resmon_gen_put_be16(reg + 6, size);
+	resmon_gen_put_be16(reg + 10, region);
+	resmon_gen_tcam_region_info(reg + 16, region);
+	for (int i = 0; i < 6; i++)
+		reg[32 + i] = 0x10 + i;
+
+	return resmon_gen_emad_len(RESMON_GEN_PTAR_LEN);
+}
+
+/* The rule is keyed by its flex2 key blocks. The rules are spread over a
+ * few eRPs and deltas.
+ */
+size_t resmon_gen_ptce3(uint8_t *buf, uint32_t region, uint32_t rule,
+			bool valid)
+{
+	uint8_t *reg;
+
+	reg = resmon_gen_emad(buf, RESMON_GEN_REG_ID_PTCE3,
+			      RESMON_GEN_PTCE3_LEN);
+
+	reg[0] = valid << 7;
+	reg[1] = MLXSW_REG_PTCE3_OP_WRITE_WRITE << 4;
+	resmon_gen_put_be32(reg + 4, rule);
+	resmon_gen_tcam_region_info(reg + 16, region);
+	resmon_gen_put_be32(reg + 32, rule);
+	reg[131] = rule % 4;
+	resmon_gen_put_be16(reg + 134, rule % 3 * 8);
+	reg[137] = rule % 3 ? 0x0f : 0;
+	reg[139] = rule % 3 ? rule & 0x0f : 0;
+
+	return resmon_gen_emad_len(RESMON_GEN_PTCE3_LEN);
+}
+
+size_t resmon_gen_pefa(uint8_t *buf, uint32_t index)
+{
+	uint8_t *reg;
+
+	reg = resmon_gen_emad(buf, RESMON_GEN_REG_ID_PEFA,
+			      RESMON_GEN_PEFA_LEN);
+
+	resmon_gen_put_be32(reg, index & 0xffffff);
+
+	return resmon_gen_emad_len(RESMON_GEN_PEFA_LEN);
+}
+
+/* Deletes the action set that resmon_gen_pefa() writes at the index. */
+size_t resmon_gen_iedr(uint8_t *buf, uint32_t index)
+{
+	uint8_t *reg;
+
+	reg = resmon_gen_emad(buf, RESMON_GEN_REG_ID_IEDR,
+			      RESMON_GEN_IEDR_LEN);
+
+	reg[3] = 1;
+	reg[16] = 0x23;
+	resmon_gen_put_be16(reg + 18, 1);
+	resmon_gen_put_be32(reg + 20, index & 0xffffff);
+
+	return resmon_gen_emad_len(RESMON_GEN_IEDR_LEN);
+}
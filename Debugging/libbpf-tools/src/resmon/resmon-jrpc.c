@@ -1,5 +1,7 @@
 // SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+#define _GNU_SOURCE
 #include <assert.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/socket.h>
@@ -10,6 +12,20 @@
 
 #include "resmon.h"
 
+int resmon_fmterr(char **strp, const char *fmt, ...)
+{
+	va_list ap;
+	int rc;
+
+	va_start(ap, fmt);
+	rc = vasprintf(strp, fmt, ap);
+	va_end(ap);
+
+	if (rc < 0)
+		*strp = NULL;
+	return rc;
+}
+
 static int __resmon_jrpc_object_add(struct json_object *obj,
 				    const char *key,
 				    struct json_object *val_obj)
@@ -48,6 +64,64 @@ int resmon_jrpc_object_add_bool(struct json_object *obj,
 	return __resmon_jrpc_object_add(obj, key, json_object_new_boolean(val));
 }
 
+int resmon_jrpc_object_add_double(struct json_object *obj,
+				  const char *key, double val)
+{
+	return __resmon_jrpc_object_add(obj, key, json_object_new_double(val));
+}
+
+/* Add a hexdump of the buffer, as the "emad" method takes it. */
+int resmon_jrpc_object_add_hex(struct json_object *obj, const char *key,
+			       const uint8_t *buf, size_t len)
+{
+	static const char digits[] = "0123456789abcdef";
+	char *hex;
+	int rc;
+
+	hex = malloc(2 * len + 1);
+	if (hex == NULL)
+		return -1;
+
+	for (size_t i = 0; i < len; i++) {
+		hex[2 * i] = digits[buf[i] >> 4];
+		hex[2 * i + 1] = digits[buf[i] & 0xf];
+	}
+	hex[2 * len] = '\0';
+
+	rc = resmon_jrpc_object_add_str(obj, key, hex);
+	free(hex);
+	return rc;
+}
+
+int resmon_jrpc_object_add_int_array(struct json_object *obj,
+				     const char *key,
+				     const uint64_t *vals, size_t num_vals)
+{
+	struct json_object *array_obj;
+	struct json_object *val_obj;
+
+	array_obj = json_object_new_array();
+	if (array_obj == NULL)
+		return -1;
+
+	for (size_t i = 0; i < num_vals; i++) {
+		val_obj = json_object_new_int64(vals[i]);
+		if (val_obj == NULL)
+			goto err_put_array_obj;
+
+		if (json_object_array_add(array_obj, val_obj)) {
+			json_object_put(val_obj);
+			goto err_put_array_obj;
+		}
+	}
+
+	return __resmon_jrpc_object_add(obj, key, array_obj);
+
+err_put_array_obj:
+	json_object_put(array_obj);
+	return -1;
+}
+
 static int resmon_jrpc_object_add_error(struct json_object *obj,
 					int code, const char *message,
 					const char *data)
@@ -413,14 +487,20 @@ int resmon_jrpc_dissect_params_empty(struct json_object *obj,
 int resmon_jrpc_dissect_params_emad(struct json_object *obj,
 				    const char **payload,
 				    size_t *payload_len,
+				    const char **device,
+				    int64_t *time_ns,
 				    char **error)
 {
 	enum {
 		pol_payload,
+		pol_device,
+		pol_time_ns,
 	};
 	struct resmon_jrpc_policy policy[] = {
 		[pol_payload] = { .key = "payload", .type = json_type_string,
 				  .required = true },
+		[pol_device] =  { .key = "device", .type = json_type_string },
+		[pol_time_ns] = { .key = "time_ns", .type = json_type_int },
 	};
 	struct json_object *values[ARRAY_SIZE(policy)] = {};
 	bool seen[ARRAY_SIZE(policy)] = {};
@@ -433,6 +513,336 @@ int resmon_jrpc_dissect_params_emad(struct json_object *obj,
 
 	*payload = json_object_get_string(values[pol_payload]);
 	*payload_len = json_object_get_string_len(values[pol_payload]);
+	*device = seen[pol_device] ?
+		  json_object_get_string(values[pol_device]) : NULL;
+	*time_ns = -1;
+	if (seen[pol_time_ns]) {
+		*time_ns = json_object_get_int64(values[pol_time_ns]);
+		if (*time_ns < 0) {
+			resmon_fmterr(error, "The member time_ns is expected to be non-negative");
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int resmon_jrpc_dissect_params_emads(struct json_object *obj,
+				     const char **device,
+				     struct json_object **emads,
+				     enum resmon_jrpc_encoding *encoding,
+				     char **error)
+{
+	enum {
+		pol_device,
+		pol_emads,
+		pol_encoding,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_device] =	 { .key = "device", .type = json_type_string },
+		[pol_emads] =	 { .key = "emads", .type = json_type_array },
+		[pol_encoding] = { .key = "encoding",
+				   .type = json_type_string },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	const char *encoding_str;
+	int err;
+
+	*device = NULL;
+	*emads = NULL;
+	*encoding = RESMON_JRPC_ENCODING_BASE64;
+	if (obj == NULL)
+		return 0;
+
+	err = resmon_jrpc_dissect(obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	if (seen[pol_device])
+		*device = json_object_get_string(values[pol_device]);
+	if (seen[pol_emads])
+		*emads = values[pol_emads];
+	if (!seen[pol_encoding])
+		return 0;
+
+	encoding_str = json_object_get_string(values[pol_encoding]);
+	if (strcmp(encoding_str, "base64") == 0) {
+		*encoding = RESMON_JRPC_ENCODING_BASE64;
+	} else if (strcmp(encoding_str, "hex") == 0) {
+		*encoding = RESMON_JRPC_ENCODING_HEX;
+	} else {
+		resmon_fmterr(error, "The member encoding is expected to be \"base64\" or \"hex\"");
+		return -1;
+	}
+	return 0;
+}
+
+int resmon_jrpc_dissect_params_device(struct json_object *obj,
+				     const char **device,
+				     char **error)
+{
+	enum {
+		pol_device,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_device] = { .key = "device", .type = json_type_string },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	*device = NULL;
+	if (obj == NULL)
+		return 0;
+
+	err = resmon_jrpc_dissect(obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	if (seen[pol_device])
+		*device = json_object_get_string(values[pol_device]);
+	return 0;
+}
+
+int resmon_jrpc_dissect_params_stats(struct json_object *obj,
+				     const char **device,
+				     bool *forecast,
+				     char **error)
+{
+	enum {
+		pol_device,
+		pol_forecast,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_device] = { .key = "device", .type = json_type_string },
+		[pol_forecast] = { .key = "forecast",
+				   .type = json_type_boolean },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	*device = NULL;
+	*forecast = false;
+	if (obj == NULL)
+		return 0;
+
+	err = resmon_jrpc_dissect(obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	if (seen[pol_device])
+		*device = json_object_get_string(values[pol_device]);
+	if (seen[pol_forecast])
+		*forecast = json_object_get_boolean(values[pol_forecast]);
+	return 0;
+}
+
+int resmon_jrpc_dissect_params_churn(struct json_object *obj,
+				     const char **device,
+				     int64_t *top,
+				     char **error)
+{
+	enum {
+		pol_device,
+		pol_top,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_device] = { .key = "device", .type = json_type_string },
+		[pol_top] = { .key = "top", .type = json_type_int },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	*device = NULL;
+	*top = 10;
+	if (obj == NULL)
+		return 0;
+
+	err = resmon_jrpc_dissect(obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	if (seen[pol_device])
+		*device = json_object_get_string(values[pol_device]);
+	if (seen[pol_top]) {
+		*top = json_object_get_int64(values[pol_top]);
+		if (*top < 0) {
+			resmon_fmterr(error, "The member top is expected to be non-negative");
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int resmon_jrpc_dissect_params_recon(struct json_object *obj,
+				     const char **device,
+				     bool *check,
+				     char **error)
+{
+	enum {
+		pol_device,
+		pol_check,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_device] = { .key = "device", .type = json_type_string },
+		[pol_check] = { .key = "check", .type = json_type_boolean },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	*device = NULL;
+	*check = false;
+	if (obj == NULL)
+		return 0;
+
+	err = resmon_jrpc_dissect(obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	if (seen[pol_device])
+		*device = json_object_get_string(values[pol_device]);
+	if (seen[pol_check])
+		*check = json_object_get_boolean(values[pol_check]);
+	return 0;
+}
+
+int resmon_jrpc_dissect_params_ages(struct json_object *obj,
+				    const char **device,
+				    const char **table,
+				    int64_t *top,
+				    bool *by_idle,
+				    char **error)
+{
+	enum {
+		pol_device,
+		pol_table,
+		pol_top,
+		pol_by,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_device] = { .key = "device", .type = json_type_string },
+		[pol_table] = { .key = "table", .type = json_type_string },
+		[pol_top] = { .key = "top", .type = json_type_int },
+		[pol_by] = { .key = "by", .type = json_type_string },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	*device = NULL;
+	*table = NULL;
+	*top = 10;
+	*by_idle = false;
+	if (obj == NULL)
+		return 0;
+
+	err = resmon_jrpc_dissect(obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	if (seen[pol_device])
+		*device = json_object_get_string(values[pol_device]);
+	if (seen[pol_table])
+		*table = json_object_get_string(values[pol_table]);
+	if (seen[pol_top]) {
+		*top = json_object_get_int64(values[pol_top]);
+		if (*top < 0) {
+			resmon_fmterr(error, "The member top is expected to be non-negative");
+			return -1;
+		}
+	}
+	if (seen[pol_by]) {
+		const char *by = json_object_get_string(values[pol_by]);
+
+		if (strcmp(by, "idle") == 0) {
+			*by_idle = true;
+		} else if (strcmp(by, "age") != 0) {
+			resmon_fmterr(error, "The member by is expected to be \"age\" or \"idle\"");
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int resmon_jrpc_dissect_params_occupancy(struct json_object *obj,
+					 const char **device,
+					 const char **resource,
+					 int64_t *occupancy,
+					 char **error)
+{
+	enum {
+		pol_device,
+		pol_resource,
+		pol_occupancy,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_device] =	  { .key = "device", .type = json_type_string },
+		[pol_resource] =  { .key = "resource",
+				    .type = json_type_string,
+				    .required = true },
+		[pol_occupancy] = { .key = "occupancy", .type = json_type_int,
+				    .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	err = resmon_jrpc_dissect(obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	*device = seen[pol_device] ?
+		  json_object_get_string(values[pol_device]) : NULL;
+	*resource = json_object_get_string(values[pol_resource]);
+	*occupancy = json_object_get_int64(values[pol_occupancy]);
+	return 0;
+}
+
+static int
+resmon_jrpc_dissect_stats_forecast(struct json_object *forecast_obj,
+				   struct resmon_jrpc_counter *counter,
+				   char **error)
+{
+	enum {
+		pol_ew_slope,
+		pol_window_slope,
+		pol_exhaustion_s,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_ew_slope] =     { .key = "ew_slope",
+				       .type = json_type_double,
+				       .required = true },
+		[pol_window_slope] = { .key = "window_slope",
+				       .type = json_type_double,
+				       .required = true },
+		[pol_exhaustion_s] = { .key = "exhaustion_s",
+				       .type = json_type_int },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	err = resmon_jrpc_dissect(forecast_obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	counter->has_forecast = true;
+	counter->ew_slope = json_object_get_double(values[pol_ew_slope]);
+	counter->window_slope =
+		json_object_get_double(values[pol_window_slope]);
+	counter->exhaustion_s = seen[pol_exhaustion_s] ?
+		json_object_get_int64(values[pol_exhaustion_s]) : -1;
 	return 0;
 }
 
@@ -446,6 +856,7 @@ resmon_jrpc_dissect_stats_counter(struct json_object *counter_obj,
 		pol_descr,
 		pol_value,
 		pol_capacity,
+		pol_forecast,
 	};
 	struct resmon_jrpc_policy policy[] = {
 		[pol_id] =	 { .key = "name", .type = json_type_string,
@@ -456,6 +867,7 @@ resmon_jrpc_dissect_stats_counter(struct json_object *counter_obj,
 				   .required = true },
 		[pol_capacity] = { .key = "capacity", .type = json_type_int,
 				   .required = true },
+		[pol_forecast] = { .key = "forecast", .type = json_type_object },
 	};
 	struct json_object *values[ARRAY_SIZE(policy)] = {};
 	bool seen[ARRAY_SIZE(policy)] = {};
@@ -477,7 +889,12 @@ resmon_jrpc_dissect_stats_counter(struct json_object *counter_obj,
 		.descr = json_object_get_string(values[pol_descr]),
 		.value = json_object_get_int64(values[pol_value]),
 		.capacity = capacity,
+		.exhaustion_s = -1,
 	};
+
+	if (seen[pol_forecast])
+		return resmon_jrpc_dissect_stats_forecast(values[pol_forecast],
+							  pcounter, error);
 	return 0;
 }
 
@@ -524,10 +941,13 @@ int resmon_jrpc_dissect_stats(struct json_object *obj,
 	/* Result for query with "stats" method is supposed to look like:
 	 *
 	 * { { "counters": [ { "id": a, "descr": "b",
-	 *                     "value": c, "capacity": d },
+	 *                     "value": c, "capacity": d,
+	 *                     "forecast": { ... } },
 	 *                   { "id": e, "descr": "u", ... },
 	 *                   ...
 	 *                 ] } }
+	 *
+	 * The "forecast" object is only present if it was requested.
 	 */
 	enum {
 		pol_counters,
@@ -550,18 +970,1867 @@ int resmon_jrpc_dissect_stats(struct json_object *obj,
 						  error);
 }
 
-int resmon_jrpc_send(struct resmon_sock *sock, struct json_object *obj)
+static int resmon_jrpc_dissect_regs_reg(struct json_object *reg_obj,
+					struct resmon_jrpc_reg *preg,
+					char **error)
 {
-	const char *str;
-	size_t len;
-	int rc;
+	enum {
+		pol_name,
+		pol_id,
+		pol_processed,
+		pol_ignored,
+		pol_errors,
+		pol_time_ns,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_name] =	  { .key = "name", .type = json_type_string,
+				    .required = true },
+		[pol_id] =	  { .key = "id", .type = json_type_int,
+				    .required = true },
+		[pol_processed] = { .key = "processed", .type = json_type_int,
+				    .required = true },
+		[pol_ignored] =	  { .key = "ignored", .type = json_type_int,
+				    .required = true },
+		[pol_errors] =	  { .key = "errors", .type = json_type_int,
+				    .required = true },
+		[pol_time_ns] =	  { .key = "time_ns", .type = json_type_int,
+				    .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
 
-	str = json_object_to_json_string(obj);
-	if (str == NULL)
+	err = resmon_jrpc_dissect(reg_obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	*preg = (struct resmon_jrpc_reg) {
+		.name = json_object_get_string(values[pol_name]),
+		.id = json_object_get_int64(values[pol_id]),
+		.processed = json_object_get_int64(values[pol_processed]),
+		.ignored = json_object_get_int64(values[pol_ignored]),
+		.errors = json_object_get_int64(values[pol_errors]),
+		.time_ns = json_object_get_int64(values[pol_time_ns]),
+	};
+	return 0;
+}
+
+int resmon_jrpc_dissect_regs(struct json_object *obj,
+			     struct resmon_jrpc_reg **pregs,
+			     size_t *pnum_regs,
+			     int64_t *unknown,
+			     char **error)
+{
+	/* Result for query with "regs" method is supposed to look like:
+	 *
+	 * { "registers": [ { "name": "a", "id": b, "processed": c,
+	 *                    "ignored": d, "errors": e, "time_ns": f },
+	 *                  ...
+	 *                ],
+	 *   "unknown": g }
+	 */
+	enum {
+		pol_registers,
+		pol_unknown,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_registers] = { .key = "registers", .type = json_type_array,
+				    .required = true },
+		[pol_unknown] =	  { .key = "unknown", .type = json_type_int,
+				    .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	struct resmon_jrpc_reg *regs;
+	size_t num_regs;
+	int err;
+
+	err = resmon_jrpc_dissect(obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	num_regs = json_object_array_length(values[pol_registers]);
+	regs = calloc(num_regs, sizeof(*regs));
+	if (regs == NULL) {
+		resmon_fmterr(error, "Couldn't allocate registers: %m");
 		return -1;
+	}
 
-	len = strlen(str);
-	rc = sendto(sock->fd, str, len, 0,
-		    (struct sockaddr *) &sock->sa, sock->len);
-	return rc == len ? 0 : -1;
+	for (size_t i = 0; i < num_regs; i++) {
+		struct json_object *reg_obj =
+			json_object_array_get_idx(values[pol_registers], i);
+
+		err = resmon_jrpc_dissect_regs_reg(reg_obj, &regs[i], error);
+		if (err != 0)
+			goto free_regs;
+	}
+
+	*pregs = regs;
+	*pnum_regs = num_regs;
+	*unknown = json_object_get_int64(values[pol_unknown]);
+	return 0;
+
+free_regs:
+	free(regs);
+	return -1;
+}
+
+static int resmon_jrpc_dissect_int_array(struct json_object *array_obj,
+					 const char *key,
+					 int64_t *vals, size_t num_vals,
+					 char **error)
+{
+	if (json_object_array_length(array_obj) != num_vals) {
+		resmon_fmterr(error, "The member %s is expected to have %zd elements",
+			      key, num_vals);
+		return -1;
+	}
+
+	for (size_t i = 0; i < num_vals; i++) {
+		struct json_object *val_obj =
+			json_object_array_get_idx(array_obj, i);
+		enum json_type type = json_object_get_type(val_obj);
+
+		if (type != json_type_int) {
+			resmon_fmterr(error, "Elements of %s are expected to be int, but one is %s",
+				      key, json_type_to_name(type));
+			return -1;
+		}
+		vals[i] = json_object_get_int64(val_obj);
+	}
+
+	return 0;
+}
+
+static int
+resmon_jrpc_dissect_acl_region(struct json_object *region_obj,
+			       struct resmon_jrpc_acl_region *pregion,
+			       char **error)
+{
+	enum {
+		pol_device,
+		pol_region_id,
+		pol_tcam_region_info,
+		pol_capacity,
+		pol_used,
+		pol_kvd_slots,
+		pol_resizes,
+		pol_erps,
+		pol_deltas,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_device] =		 { .key = "device",
+					   .type = json_type_string,
+					   .required = true },
+		[pol_region_id] =	 { .key = "region_id",
+					   .type = json_type_int,
+					   .required = true },
+		[pol_tcam_region_info] = { .key = "tcam_region_info",
+					   .type = json_type_string,
+					   .required = true },
+		[pol_capacity] =	 { .key = "capacity",
+					   .type = json_type_int,
+					   .required = true },
+		[pol_used] =		 { .key = "used",
+					   .type = json_type_int,
+					   .required = true },
+		[pol_kvd_slots] =	 { .key = "kvd_slots",
+					   .type = json_type_int,
+					   .required = true },
+		[pol_resizes] =		 { .key = "resizes",
+					   .type = json_type_int,
+					   .required = true },
+		[pol_erps] =		 { .key = "erps",
+					   .type = json_type_array,
+					   .required = true },
+		[pol_deltas] =		 { .key = "deltas",
+					   .type = json_type_array,
+					   .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	err = resmon_jrpc_dissect(region_obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	*pregion = (struct resmon_jrpc_acl_region) {
+		.device = json_object_get_string(values[pol_device]),
+		.region_id = json_object_get_int64(values[pol_region_id]),
+		.tcam_region_info =
+			json_object_get_string(values[pol_tcam_region_info]),
+		.capacity = json_object_get_int64(values[pol_capacity]),
+		.used = json_object_get_int64(values[pol_used]),
+		.kvd_slots = json_object_get_int64(values[pol_kvd_slots]),
+		.resizes = json_object_get_int64(values[pol_resizes]),
+	};
+
+	err = resmon_jrpc_dissect_int_array(values[pol_erps], "erps",
+					    pregion->erps,
+					    ARRAY_SIZE(pregion->erps), error);
+	if (err)
+		return err;
+
+	return resmon_jrpc_dissect_int_array(values[pol_deltas], "deltas",
+					     pregion->deltas,
+					     ARRAY_SIZE(pregion->deltas),
+					     error);
+}
+
+int resmon_jrpc_dissect_acl(struct json_object *obj,
+			    struct resmon_jrpc_acl_region **pregions,
+			    size_t *pnum_regions,
+			    char **error)
+{
+	/* Result for query with "acl" method is supposed to look like:
+	 *
+	 * { "regions": [ { "device": "a", "region_id": b,
+	 *                  "tcam_region_info": "c", "capacity": d,
+	 *                  "used": e, "kvd_slots": f, "resizes": g,
+	 *                  "erps": [ h, ... ], "deltas": [ i, ... ] },
+	 *                ...
+	 *              ] }
+	 */
+	enum {
+		pol_regions,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_regions] = { .key = "regions", .type = json_type_array,
+				  .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	struct resmon_jrpc_acl_region *regions;
+	bool seen[ARRAY_SIZE(policy)] = {};
+	size_t num_regions;
+	int err;
+
+	err = resmon_jrpc_dissect(obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	num_regions = json_object_array_length(values[pol_regions]);
+	regions = calloc(num_regions, sizeof(*regions));
+	if (regions == NULL && num_regions != 0) {
+		resmon_fmterr(error, "Couldn't allocate regions: %m");
+		return -1;
+	}
+
+	for (size_t i = 0; i < num_regions; i++) {
+		struct json_object *region_obj =
+			json_object_array_get_idx(values[pol_regions], i);
+
+		err = resmon_jrpc_dissect_acl_region(region_obj, &regions[i],
+						     error);
+		if (err != 0)
+			goto free_regions;
+	}
+
+	*pregions = regions;
+	*pnum_regions = num_regions;
+	return 0;
+
+free_regions:
+	free(regions);
+	return -1;
+}
+
+static int resmon_jrpc_dissect_lpm_vr(struct json_object *vr_obj,
+				      struct resmon_jrpc_lpm_vr *pvr,
+				      char **error)
+{
+	enum {
+		pol_device,
+		pol_protocol,
+		pol_virtual_router,
+		pol_routes,
+		pol_prefix_lens,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_device] =		{ .key = "device",
+					  .type = json_type_string,
+					  .required = true },
+		[pol_protocol] =	{ .key = "protocol",
+					  .type = json_type_string,
+					  .required = true },
+		[pol_virtual_router] =	{ .key = "virtual_router",
+					  .type = json_type_int,
+					  .required = true },
+		[pol_routes] =		{ .key = "routes",
+					  .type = json_type_int,
+					  .required = true },
+		[pol_prefix_lens] =	{ .key = "prefix_lens",
+					  .type = json_type_array,
+					  .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	size_t num_prefix_lens;
+	int err;
+
+	err = resmon_jrpc_dissect(vr_obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	num_prefix_lens = json_object_array_length(values[pol_prefix_lens]);
+	if (num_prefix_lens > ARRAY_SIZE(pvr->prefix_lens)) {
+		resmon_fmterr(error, "The member prefix_lens is expected to have at most %zd elements",
+			      ARRAY_SIZE(pvr->prefix_lens));
+		return -1;
+	}
+
+	*pvr = (struct resmon_jrpc_lpm_vr) {
+		.device = json_object_get_string(values[pol_device]),
+		.protocol = json_object_get_string(values[pol_protocol]),
+		.virtual_router =
+			json_object_get_int64(values[pol_virtual_router]),
+		.routes = json_object_get_int64(values[pol_routes]),
+		.num_prefix_lens = num_prefix_lens,
+	};
+
+	return resmon_jrpc_dissect_int_array(values[pol_prefix_lens],
+					     "prefix_lens", pvr->prefix_lens,
+					     num_prefix_lens, error);
+}
+
+int resmon_jrpc_dissect_lpm(struct json_object *obj,
+			    struct resmon_jrpc_lpm_vr **pvrs,
+			    size_t *pnum_vrs,
+			    char **error)
+{
+	/* Result for query with "lpm" method is supposed to look like:
+	 *
+	 * { "vrs": [ { "device": "a", "protocol": "b",
+	 *              "virtual_router": c, "routes": d,
+	 *              "prefix_lens": [ e, ... ] },
+	 *            ...
+	 *          ] }
+	 */
+	enum {
+		pol_vrs,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_vrs] = { .key = "vrs", .type = json_type_array,
+			      .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	struct resmon_jrpc_lpm_vr *vrs;
+	size_t num_vrs;
+	int err;
+
+	err = resmon_jrpc_dissect(obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	num_vrs = json_object_array_length(values[pol_vrs]);
+	vrs = calloc(num_vrs, sizeof(*vrs));
+	if (vrs == NULL && num_vrs != 0) {
+		resmon_fmterr(error, "Couldn't allocate VRs: %m");
+		return -1;
+	}
+
+	for (size_t i = 0; i < num_vrs; i++) {
+		struct json_object *vr_obj =
+			json_object_array_get_idx(values[pol_vrs], i);
+
+		err = resmon_jrpc_dissect_lpm_vr(vr_obj, &vrs[i], error);
+		if (err != 0)
+			goto free_vrs;
+	}
+
+	*pvrs = vrs;
+	*pnum_vrs = num_vrs;
+	return 0;
+
+free_vrs:
+	free(vrs);
+	return -1;
+}
+
+/* Dissect each element of an array with the given callback into a newly
+ * allocated array of elements of elem_size bytes.
+ */
+static int
+resmon_jrpc_dissect_array(struct json_object *array_obj, size_t elem_size,
+			  int (*dissect_cb)(struct json_object *elem_obj,
+					    void *elem, char **error),
+			  void **pelems, size_t *pnum_elems, char **error)
+{
+	size_t num_elems = json_object_array_length(array_obj);
+	char *elems;
+	int err;
+
+	elems = calloc(num_elems, elem_size);
+	if (elems == NULL && num_elems != 0) {
+		resmon_fmterr(error, "Couldn't allocate array: %m");
+		return -1;
+	}
+
+	for (size_t i = 0; i < num_elems; i++) {
+		struct json_object *elem_obj =
+			json_object_array_get_idx(array_obj, i);
+
+		err = dissect_cb(elem_obj, elems + i * elem_size, error);
+		if (err != 0)
+			goto free_elems;
+	}
+
+	*pelems = elems;
+	*pnum_elems = num_elems;
+	return 0;
+
+free_elems:
+	free(elems);
+	return -1;
+}
+
+static int resmon_jrpc_dissect_churn_item(struct json_object *item_obj,
+					  void *elem, char **error)
+{
+	enum {
+		pol_name,
+		pol_adds,
+		pol_deletes,
+		pol_redundant,
+		pol_add_rate,
+		pol_delete_rate,
+		pol_redundant_rate,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_name] =		{ .key = "name",
+					  .type = json_type_string,
+					  .required = true },
+		[pol_adds] =		{ .key = "adds",
+					  .type = json_type_int,
+					  .required = true },
+		[pol_deletes] =		{ .key = "deletes",
+					  .type = json_type_int,
+					  .required = true },
+		[pol_redundant] =	{ .key = "redundant",
+					  .type = json_type_int,
+					  .required = true },
+		[pol_add_rate] =	{ .key = "add_rate",
+					  .type = json_type_double,
+					  .required = true },
+		[pol_delete_rate] =	{ .key = "delete_rate",
+					  .type = json_type_double,
+					  .required = true },
+		[pol_redundant_rate] =	{ .key = "redundant_rate",
+					  .type = json_type_double,
+					  .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	struct resmon_jrpc_churn *churn = elem;
+	int err;
+
+	err = resmon_jrpc_dissect(item_obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	*churn = (struct resmon_jrpc_churn) {
+		.name = json_object_get_string(values[pol_name]),
+		.adds = json_object_get_int64(values[pol_adds]),
+		.deletes = json_object_get_int64(values[pol_deletes]),
+		.redundant = json_object_get_int64(values[pol_redundant]),
+		.add_rate = json_object_get_double(values[pol_add_rate]),
+		.delete_rate = json_object_get_double(values[pol_delete_rate]),
+		.redundant_rate =
+			json_object_get_double(values[pol_redundant_rate]),
+	};
+	return 0;
+}
+
+static int resmon_jrpc_dissect_churn_key(struct json_object *key_obj,
+					 void *elem, char **error)
+{
+	enum {
+		pol_device,
+		pol_table,
+		pol_key,
+		pol_redundant,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_device] =	  { .key = "device", .type = json_type_string,
+				    .required = true },
+		[pol_table] =	  { .key = "table", .type = json_type_string,
+				    .required = true },
+		[pol_key] =	  { .key = "key", .type = json_type_string,
+				    .required = true },
+		[pol_redundant] = { .key = "redundant", .type = json_type_int,
+				    .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	struct resmon_jrpc_churn_key *key = elem;
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	err = resmon_jrpc_dissect(key_obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	*key = (struct resmon_jrpc_churn_key) {
+		.device = json_object_get_string(values[pol_device]),
+		.table = json_object_get_string(values[pol_table]),
+		.key = json_object_get_string(values[pol_key]),
+		.redundant = json_object_get_int64(values[pol_redundant]),
+	};
+	return 0;
+}
+
+int resmon_jrpc_dissect_churn(struct json_object *obj,
+			      struct resmon_jrpc_churn **pregs,
+			      size_t *pnum_regs,
+			      struct resmon_jrpc_churn **ptables,
+			      size_t *pnum_tables,
+			      struct resmon_jrpc_churn_key **pkeys,
+			      size_t *pnum_keys,
+			      char **error)
+{
+	/* Result for query with "churn" method is supposed to look like:
+	 *
+	 * { "registers": [ { "name": "a", "adds": b, "deletes": c,
+	 *                    "redundant": d, "add_rate": e,
+	 *                    "delete_rate": f, "redundant_rate": g },
+	 *                  ...
+	 *                ],
+	 *   "tables": [ same as registers ],
+	 *   "top": [ { "device": "h", "table": "i", "key": "j",
+	 *              "redundant": k },
+	 *            ...
+	 *          ] }
+	 */
+	enum {
+		pol_registers,
+		pol_tables,
+		pol_top,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_registers] = { .key = "registers", .type = json_type_array,
+				    .required = true },
+		[pol_tables] =	  { .key = "tables", .type = json_type_array,
+				    .required = true },
+		[pol_top] =	  { .key = "top", .type = json_type_array,
+				    .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	err = resmon_jrpc_dissect(obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	err = resmon_jrpc_dissect_array(values[pol_registers],
+					sizeof(**pregs),
+					resmon_jrpc_dissect_churn_item,
+					(void **) pregs, pnum_regs, error);
+	if (err)
+		return err;
+
+	err = resmon_jrpc_dissect_array(values[pol_tables],
+					sizeof(**ptables),
+					resmon_jrpc_dissect_churn_item,
+					(void **) ptables, pnum_tables, error);
+	if (err)
+		goto free_regs;
+
+	err = resmon_jrpc_dissect_array(values[pol_top], sizeof(**pkeys),
+					resmon_jrpc_dissect_churn_key,
+					(void **) pkeys, pnum_keys, error);
+	if (err)
+		goto free_tables;
+
+	return 0;
+
+free_tables:
+	free(*ptables);
+free_regs:
+	free(*pregs);
+	return -1;
+}
+
+static int resmon_jrpc_dissect_burst_reg(struct json_object *reg_obj,
+					 void *elem, char **error)
+{
+	enum {
+		pol_name,
+		pol_emads,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_name] =  { .key = "name", .type = json_type_string,
+				.required = true },
+		[pol_emads] = { .key = "emads", .type = json_type_int,
+				.required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	struct resmon_jrpc_burst_reg *reg = elem;
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	err = resmon_jrpc_dissect(reg_obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	*reg = (struct resmon_jrpc_burst_reg) {
+		.name = json_object_get_string(values[pol_name]),
+		.emads = json_object_get_int64(values[pol_emads]),
+	};
+	return 0;
+}
+
+static int resmon_jrpc_dissect_burst(struct json_object *burst_obj,
+				     void *elem, char **error)
+{
+	enum {
+		pol_device,
+		pol_start_ns,
+		pol_duration_ns,
+		pol_emads,
+		pol_peak_rate,
+		pol_ongoing,
+		pol_registers,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_device] =	    { .key = "device",
+				      .type = json_type_string,
+				      .required = true },
+		[pol_start_ns] =    { .key = "start_ns",
+				      .type = json_type_int,
+				      .required = true },
+		[pol_duration_ns] = { .key = "duration_ns",
+				      .type = json_type_int,
+				      .required = true },
+		[pol_emads] =	    { .key = "emads",
+				      .type = json_type_int,
+				      .required = true },
+		[pol_peak_rate] =   { .key = "peak_rate",
+				      .type = json_type_int,
+				      .required = true },
+		[pol_ongoing] =	    { .key = "ongoing",
+				      .type = json_type_boolean,
+				      .required = true },
+		[pol_registers] =   { .key = "registers",
+				      .type = json_type_array,
+				      .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	struct resmon_jrpc_burst *burst = elem;
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	err = resmon_jrpc_dissect(burst_obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	*burst = (struct resmon_jrpc_burst) {
+		.device = json_object_get_string(values[pol_device]),
+		.start_ns = json_object_get_int64(values[pol_start_ns]),
+		.duration_ns = json_object_get_int64(values[pol_duration_ns]),
+		.emads = json_object_get_int64(values[pol_emads]),
+		.peak_rate = json_object_get_int64(values[pol_peak_rate]),
+		.ongoing = json_object_get_boolean(values[pol_ongoing]),
+	};
+
+	return resmon_jrpc_dissect_array(values[pol_registers],
+					 sizeof(*burst->regs),
+					 resmon_jrpc_dissect_burst_reg,
+					 (void **) &burst->regs,
+					 &burst->num_regs, error);
+}
+
+void resmon_jrpc_bursts_free(struct resmon_jrpc_burst *bursts,
+			     size_t num_bursts)
+{
+	for (size_t i = 0; i < num_bursts; i++)
+		free(bursts[i].regs);
+	free(bursts);
+}
+
+int resmon_jrpc_dissect_bursts(struct json_object *obj,
+			       struct resmon_jrpc_burst **pbursts,
+			       size_t *pnum_bursts,
+			       char **error)
+{
+	/* Result for query with "bursts" method is supposed to look like:
+	 *
+	 * { "bursts": [ { "device": "a", "start_ns": b, "duration_ns": c,
+	 *                 "emads": d, "peak_rate": e, "ongoing": f,
+	 *                 "registers": [ { "name": "g", "emads": h },
+	 *                                ...
+	 *                              ] },
+	 *               ...
+	 *             ] }
+	 */
+	enum {
+		pol_bursts,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_bursts] = { .key = "bursts", .type = json_type_array,
+				 .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	struct json_object *bursts_obj;
+	struct resmon_jrpc_burst *bursts;
+	size_t num_bursts;
+	size_t i;
+	int err;
+
+	err = resmon_jrpc_dissect(obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	bursts_obj = values[pol_bursts];
+	num_bursts = json_object_array_length(bursts_obj);
+	bursts = calloc(num_bursts, sizeof(*bursts));
+	if (bursts == NULL && num_bursts != 0) {
+		resmon_fmterr(error, "Couldn't allocate bursts: %m");
+		return -1;
+	}
+
+	for (i = 0; i < num_bursts; i++) {
+		err = resmon_jrpc_dissect_burst(
+				json_object_array_get_idx(bursts_obj, i),
+				&bursts[i], error);
+		if (err != 0)
+			goto free_bursts;
+	}
+
+	*pbursts = bursts;
+	*pnum_bursts = num_bursts;
+	return 0;
+
+free_bursts:
+	/* The failed burst has no registers allocated. */
+	resmon_jrpc_bursts_free(bursts, i);
+	return -1;
+}
+
+static const char *const resmon_jrpc_plan_type_names[] = {
+	[RESMON_JRPC_PLAN_ROUTE] = "route",
+	[RESMON_JRPC_PLAN_NEIGH] = "neigh",
+	[RESMON_JRPC_PLAN_ACL] = "acl",
+	[RESMON_JRPC_PLAN_ACTSET] = "actset",
+	[RESMON_JRPC_PLAN_ADJ] = "adj",
+	[RESMON_JRPC_PLAN_FDB] = "fdb",
+};
+
+const char *resmon_jrpc_plan_type_name(enum resmon_jrpc_plan_type type)
+{
+	return resmon_jrpc_plan_type_names[type];
+}
+
+static int resmon_jrpc_dissect_plan_protocol(struct json_object *obj,
+					     bool *ipv6, char **error)
+{
+	const char *protocol = json_object_get_string(obj);
+
+	if (strcmp(protocol, "ipv4") == 0) {
+		*ipv6 = false;
+	} else if (strcmp(protocol, "ipv6") == 0) {
+		*ipv6 = true;
+	} else {
+		resmon_fmterr(error, "Unknown protocol %s", protocol);
+		return -1;
+	}
+	return 0;
+}
+
+static int resmon_jrpc_dissect_plan_item(struct json_object *item_obj,
+					 void *elem, char **error)
+{
+	enum {
+		pol_type,
+		pol_count,
+		pol_protocol,
+		pol_prefix_len,
+		pol_key_blocks,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_type] =	   { .key = "type", .type = json_type_string,
+				     .required = true },
+		[pol_count] =	   { .key = "count", .type = json_type_int,
+				     .required = true },
+		[pol_protocol] =   { .key = "protocol",
+				     .type = json_type_string },
+		[pol_prefix_len] = { .key = "prefix_len",
+				     .type = json_type_int },
+		[pol_key_blocks] = { .key = "key_blocks",
+				     .type = json_type_int },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	struct resmon_jrpc_plan_item *item = elem;
+	bool seen[ARRAY_SIZE(policy)] = {};
+	const char *type;
+	size_t i;
+	int err;
+
+	err = resmon_jrpc_dissect(item_obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	type = json_object_get_string(values[pol_type]);
+	for (i = 0; i < ARRAY_SIZE(resmon_jrpc_plan_type_names); i++)
+		if (strcmp(type, resmon_jrpc_plan_type_names[i]) == 0)
+			break;
+	if (i == ARRAY_SIZE(resmon_jrpc_plan_type_names)) {
+		resmon_fmterr(error, "Unknown item type %s", type);
+		return -1;
+	}
+
+	*item = (struct resmon_jrpc_plan_item) {
+		.type = i,
+		.count = json_object_get_int64(values[pol_count]),
+	};
+	if (item->count < 0) {
+		resmon_fmterr(error, "The member count is expected to be non-negative");
+		return -1;
+	}
+
+	switch (item->type) {
+	case RESMON_JRPC_PLAN_ROUTE:
+		if (!seen[pol_prefix_len]) {
+			resmon_fmterr(error, "A route item requires prefix_len");
+			return -1;
+		}
+		item->prefix_len = json_object_get_int64(values[pol_prefix_len]);
+		/* Fall through. */
+	case RESMON_JRPC_PLAN_NEIGH:
+		if (!seen[pol_protocol]) {
+			resmon_fmterr(error, "Item type %s requires protocol",
+				      type);
+			return -1;
+		}
+		err = resmon_jrpc_dissect_plan_protocol(values[pol_protocol],
+							&item->ipv6, error);
+		if (err)
+			return err;
+		if (item->prefix_len < 0 ||
+		    item->prefix_len > (item->ipv6 ? 128 : 32)) {
+			resmon_fmterr(error, "Invalid prefix length %" PRId64,
+				      item->prefix_len);
+			return -1;
+		}
+		break;
+	case RESMON_JRPC_PLAN_ACL:
+		if (!seen[pol_key_blocks]) {
+			resmon_fmterr(error, "An acl item requires key_blocks");
+			return -1;
+		}
+		item->key_blocks = json_object_get_int64(values[pol_key_blocks]);
+		if (item->key_blocks < 0 ||
+		    item->key_blocks > RESMON_REG_PTAR_KEY_BLOCK_COUNT) {
+			resmon_fmterr(error, "Invalid number of key blocks %" PRId64,
+				      item->key_blocks);
+			return -1;
+		}
+		break;
+	case RESMON_JRPC_PLAN_ACTSET:
+	case RESMON_JRPC_PLAN_ADJ:
+	case RESMON_JRPC_PLAN_FDB:
+		break;
+	}
+
+	return 0;
+}
+
+int resmon_jrpc_dissect_params_plan(struct json_object *obj,
+				    const char **device,
+				    struct resmon_jrpc_plan_item **pitems,
+				    size_t *pnum_items,
+				    char **error)
+{
+	enum {
+		pol_device,
+		pol_items,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_device] = { .key = "device", .type = json_type_string },
+		[pol_items] =  { .key = "items", .type = json_type_array,
+				 .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	if (obj == NULL) {
+		resmon_fmterr(error, "Parameters expected");
+		return -1;
+	}
+
+	err = resmon_jrpc_dissect(obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	*device = seen[pol_device] ?
+		  json_object_get_string(values[pol_device]) : NULL;
+	return resmon_jrpc_dissect_array(values[pol_items], sizeof(**pitems),
+					 resmon_jrpc_dissect_plan_item,
+					 (void **) pitems, pnum_items, error);
+}
+
+static int resmon_jrpc_dissect_plan_counter(struct json_object *counter_obj,
+					    void *elem, char **error)
+{
+	enum {
+		pol_name,
+		pol_descr,
+		pol_value,
+		pol_needed,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_name] =   { .key = "name", .type = json_type_string,
+				 .required = true },
+		[pol_descr] =  { .key = "descr", .type = json_type_string,
+				 .required = true },
+		[pol_value] =  { .key = "value", .type = json_type_int,
+				 .required = true },
+		[pol_needed] = { .key = "needed", .type = json_type_int,
+				 .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	struct resmon_jrpc_plan_counter *counter = elem;
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	err = resmon_jrpc_dissect(counter_obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	*counter = (struct resmon_jrpc_plan_counter) {
+		.descr = json_object_get_string(values[pol_descr]),
+		.value = json_object_get_int64(values[pol_value]),
+		.needed = json_object_get_int64(values[pol_needed]),
+	};
+	return 0;
+}
+
+int resmon_jrpc_dissect_plan(struct json_object *obj,
+			     struct resmon_jrpc_plan *plan,
+			     char **error)
+{
+	/* Result for query with "plan" method is supposed to look like:
+	 *
+	 * { "counters": [ { "name": a, "descr": "b",
+	 *                   "value": c, "needed": d },
+	 *                 ...
+	 *               ],
+	 *   "capacity": e, "used": f, "needed": g,
+	 *   "headroom": h, "fits": i }
+	 */
+	enum {
+		pol_counters,
+		pol_capacity,
+		pol_used,
+		pol_needed,
+		pol_headroom,
+		pol_fits,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_counters] = { .key = "counters", .type = json_type_array,
+				   .required = true },
+		[pol_capacity] = { .key = "capacity", .type = json_type_int,
+				   .required = true },
+		[pol_used] =	 { .key = "used", .type = json_type_int,
+				   .required = true },
+		[pol_needed] =	 { .key = "needed", .type = json_type_int,
+				   .required = true },
+		[pol_headroom] = { .key = "headroom", .type = json_type_int,
+				   .required = true },
+		[pol_fits] =	 { .key = "fits", .type = json_type_boolean,
+				   .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	err = resmon_jrpc_dissect(obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	*plan = (struct resmon_jrpc_plan) {
+		.capacity = json_object_get_int64(values[pol_capacity]),
+		.used = json_object_get_int64(values[pol_used]),
+		.needed = json_object_get_int64(values[pol_needed]),
+		.headroom = json_object_get_int64(values[pol_headroom]),
+		.fits = json_object_get_boolean(values[pol_fits]),
+	};
+	return resmon_jrpc_dissect_array(values[pol_counters],
+					 sizeof(*plan->counters),
+					 resmon_jrpc_dissect_plan_counter,
+					 (void **) &plan->counters,
+					 &plan->num_counters, error);
+}
+
+static int resmon_jrpc_dissect_kvdl_dev(struct json_object *dev_obj,
+					void *elem, char **error)
+{
+	enum {
+		pol_device,
+		pol_size,
+		pol_used,
+		pol_free,
+		pol_largest_free_run,
+		pol_free_runs,
+		pol_fragmentation,
+		pol_run_hist,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_device] =		 { .key = "device",
+					   .type = json_type_string,
+					   .required = true },
+		[pol_size] =		 { .key = "size",
+					   .type = json_type_int,
+					   .required = true },
+		[pol_used] =		 { .key = "used",
+					   .type = json_type_int,
+					   .required = true },
+		[pol_free] =		 { .key = "free",
+					   .type = json_type_int,
+					   .required = true },
+		[pol_largest_free_run] = { .key = "largest_free_run",
+					   .type = json_type_int,
+					   .required = true },
+		[pol_free_runs] =	 { .key = "free_runs",
+					   .type = json_type_int,
+					   .required = true },
+		[pol_fragmentation] =	 { .key = "fragmentation",
+					   .type = json_type_double,
+					   .required = true },
+		[pol_run_hist] =	 { .key = "run_hist",
+					   .type = json_type_array,
+					   .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	struct resmon_jrpc_kvdl *dev = elem;
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	err = resmon_jrpc_dissect(dev_obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	*dev = (struct resmon_jrpc_kvdl) {
+		.device = json_object_get_string(values[pol_device]),
+		.size = json_object_get_int64(values[pol_size]),
+		.used = json_object_get_int64(values[pol_used]),
+		.free = json_object_get_int64(values[pol_free]),
+		.largest_free_run =
+			json_object_get_int64(values[pol_largest_free_run]),
+		.free_runs = json_object_get_int64(values[pol_free_runs]),
+		.fragmentation =
+			json_object_get_double(values[pol_fragmentation]),
+	};
+
+	return resmon_jrpc_dissect_int_array(values[pol_run_hist], "run_hist",
+					     dev->run_hist,
+					     ARRAY_SIZE(dev->run_hist), error);
+}
+
+int resmon_jrpc_dissect_kvdl(struct json_object *obj,
+			     struct resmon_jrpc_kvdl **pdevs,
+			     size_t *pnum_devs,
+			     char **error)
+{
+	/* Result for query with "kvdl" method is supposed to look like:
+	 *
+	 * { "devices": [ { "device": "a", "size": b, "used": c, "free": d,
+	 *                  "largest_free_run": e, "free_runs": f,
+	 *                  "fragmentation": g, "run_hist": [ h, ... ] },
+	 *                ...
+	 *              ] }
+	 */
+	enum {
+		pol_devices,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_devices] = { .key = "devices", .type = json_type_array,
+				  .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	err = resmon_jrpc_dissect(obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	return resmon_jrpc_dissect_array(values[pol_devices], sizeof(**pdevs),
+					 resmon_jrpc_dissect_kvdl_dev,
+					 (void **) pdevs, pnum_devs, error);
+}
+
+static int resmon_jrpc_dissect_hist(struct json_object *hist_obj,
+				    struct resmon_jrpc_hist *hist,
+				    char **error)
+{
+	enum {
+		pol_count,
+		pol_sum,
+		pol_max,
+		pol_bins,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_count] = { .key = "count", .type = json_type_int,
+				.required = true },
+		[pol_sum] =   { .key = "sum", .type = json_type_int,
+				.required = true },
+		[pol_max] =   { .key = "max", .type = json_type_int,
+				.required = true },
+		[pol_bins] =  { .key = "bins", .type = json_type_array,
+				.required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	err = resmon_jrpc_dissect(hist_obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	*hist = (struct resmon_jrpc_hist) {
+		.count = json_object_get_int64(values[pol_count]),
+		.sum = json_object_get_int64(values[pol_sum]),
+		.max = json_object_get_int64(values[pol_max]),
+	};
+	return resmon_jrpc_dissect_int_array(values[pol_bins], "bins",
+					     hist->bins,
+					     ARRAY_SIZE(hist->bins), error);
+}
+
+static int resmon_jrpc_dissect_health_reg(struct json_object *reg_obj,
+					  void *elem, char **error)
+{
+	enum {
+		pol_name,
+		pol_time_ns,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_name] =	{ .key = "name", .type = json_type_string,
+				  .required = true },
+		[pol_time_ns] = { .key = "time_ns", .type = json_type_object,
+				  .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	struct resmon_jrpc_health_reg *reg = elem;
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	err = resmon_jrpc_dissect(reg_obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	reg->name = json_object_get_string(values[pol_name]);
+	return resmon_jrpc_dissect_hist(values[pol_time_ns], &reg->time_ns,
+					error);
+}
+
+int resmon_jrpc_dissect_health(struct json_object *obj,
+			       struct resmon_jrpc_health *health,
+			       char **error)
+{
+	/* Result for query with "health" method is supposed to look like:
+	 *
+	 * { "uptime_ns": a, "cpu_ns": b, "cpu_load": c, "process_cpu_ns": d,
+	 *   "delay_ns": hist, "batch": hist,
+	 *   "registers": [ { "name": "e", "time_ns": hist },
+	 *                  ...
+	 *                ] }
+	 *
+	 * Where hist is { "count": f, "sum": g, "max": h, "bins": [ i, ... ] }
+	 */
+	enum {
+		pol_uptime_ns,
+		pol_cpu_ns,
+		pol_cpu_load,
+		pol_process_cpu_ns,
+		pol_delay_ns,
+		pol_batch,
+		pol_registers,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_uptime_ns] =      { .key = "uptime_ns",
+					 .type = json_type_int,
+					 .required = true },
+		[pol_cpu_ns] =	       { .key = "cpu_ns",
+					 .type = json_type_int,
+					 .required = true },
+		[pol_cpu_load] =       { .key = "cpu_load",
+					 .type = json_type_double,
+					 .required = true },
+		[pol_process_cpu_ns] = { .key = "process_cpu_ns",
+					 .type = json_type_int,
+					 .required = true },
+		[pol_delay_ns] =       { .key = "delay_ns",
+					 .type = json_type_object,
+					 .required = true },
+		[pol_batch] =	       { .key = "batch",
+					 .type = json_type_object,
+					 .required = true },
+		[pol_registers] =      { .key = "registers",
+					 .type = json_type_array,
+					 .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	err = resmon_jrpc_dissect(obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	*health = (struct resmon_jrpc_health) {
+		.uptime_ns = json_object_get_int64(values[pol_uptime_ns]),
+		.cpu_ns = json_object_get_int64(values[pol_cpu_ns]),
+		.cpu_load = json_object_get_double(values[pol_cpu_load]),
+		.process_cpu_ns =
+			json_object_get_int64(values[pol_process_cpu_ns]),
+	};
+
+	err = resmon_jrpc_dissect_hist(values[pol_delay_ns],
+				       &health->delay_ns, error);
+	if (err)
+		return err;
+
+	err = resmon_jrpc_dissect_hist(values[pol_batch], &health->batch,
+				       error);
+	if (err)
+		return err;
+
+	return resmon_jrpc_dissect_array(values[pol_registers],
+					 sizeof(*health->regs),
+					 resmon_jrpc_dissect_health_reg,
+					 (void **) &health->regs,
+					 &health->num_regs, error);
+}
+
+static int resmon_jrpc_dissect_error_class(struct json_object *class_obj,
+					   void *elem, char **error)
+{
+	enum {
+		pol_name,
+		pol_descr,
+		pol_count,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_name] =  { .key = "name", .type = json_type_string,
+				.required = true },
+		[pol_descr] = { .key = "descr", .type = json_type_string,
+				.required = true },
+		[pol_count] = { .key = "count", .type = json_type_int,
+				.required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	struct resmon_jrpc_error_class *cls = elem;
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	err = resmon_jrpc_dissect(class_obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	*cls = (struct resmon_jrpc_error_class) {
+		.name = json_object_get_string(values[pol_name]),
+		.descr = json_object_get_string(values[pol_descr]),
+		.count = json_object_get_int64(values[pol_count]),
+	};
+	return 0;
+}
+
+static int resmon_jrpc_dissect_error_sample(struct json_object *sample_obj,
+					    void *elem, char **error)
+{
+	enum {
+		pol_device,
+		pol_class,
+		pol_time_ns,
+		pol_message,
+		pol_len,
+		pol_emad,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_device] =	{ .key = "device", .type = json_type_string,
+				  .required = true },
+		[pol_class] =	{ .key = "class", .type = json_type_string,
+				  .required = true },
+		[pol_time_ns] = { .key = "time_ns", .type = json_type_int,
+				  .required = true },
+		[pol_message] = { .key = "message", .type = json_type_string,
+				  .required = true },
+		[pol_len] =	{ .key = "len", .type = json_type_int,
+				  .required = true },
+		[pol_emad] =	{ .key = "emad", .type = json_type_string,
+				  .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	struct resmon_jrpc_error_sample *sample = elem;
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	err = resmon_jrpc_dissect(sample_obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	*sample = (struct resmon_jrpc_error_sample) {
+		.device = json_object_get_string(values[pol_device]),
+		.cls = json_object_get_string(values[pol_class]),
+		.time_ns = json_object_get_int64(values[pol_time_ns]),
+		.message = json_object_get_string(values[pol_message]),
+		.len = json_object_get_int64(values[pol_len]),
+		.emad = json_object_get_string(values[pol_emad]),
+	};
+	return 0;
+}
+
+int resmon_jrpc_dissect_errors(struct json_object *obj,
+			       struct resmon_jrpc_errors *errors,
+			       char **error)
+{
+	/* Result for query with "errors" method is supposed to look like:
+	 *
+	 * { "classes": [ { "name": "a", "descr": "b", "count": c },
+	 *                ...
+	 *              ],
+	 *   "samples": [ { "device": "d", "class": "e", "time_ns": f,
+	 *                  "message": "g", "len": h, "emad": "i" },
+	 *                ...
+	 *              ],
+	 *   "logged": j, "suppressed": k }
+	 */
+	enum {
+		pol_classes,
+		pol_samples,
+		pol_logged,
+		pol_suppressed,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_classes] =	   { .key = "classes",
+				     .type = json_type_array,
+				     .required = true },
+		[pol_samples] =	   { .key = "samples",
+				     .type = json_type_array,
+				     .required = true },
+		[pol_logged] =	   { .key = "logged",
+				     .type = json_type_int,
+				     .required = true },
+		[pol_suppressed] = { .key = "suppressed",
+				     .type = json_type_int,
+				     .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	err = resmon_jrpc_dissect(obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	*errors = (struct resmon_jrpc_errors) {
+		.logged = json_object_get_int64(values[pol_logged]),
+		.suppressed = json_object_get_int64(values[pol_suppressed]),
+	};
+
+	err = resmon_jrpc_dissect_array(values[pol_classes],
+					sizeof(*errors->classes),
+					resmon_jrpc_dissect_error_class,
+					(void **) &errors->classes,
+					&errors->num_classes, error);
+	if (err)
+		return err;
+
+	err = resmon_jrpc_dissect_array(values[pol_samples],
+					sizeof(*errors->samples),
+					resmon_jrpc_dissect_error_sample,
+					(void **) &errors->samples,
+					&errors->num_samples, error);
+	if (err) {
+		free(errors->classes);
+		return err;
+	}
+
+	return 0;
+}
+
+static int resmon_jrpc_dissect_recon_resource(struct json_object *res_obj,
+					      void *elem, char **error)
+{
+	enum {
+		pol_device,
+		pol_name,
+		pol_devlink_name,
+		pol_present,
+		pol_checks,
+		pol_failures,
+		pol_occupancy,
+		pol_accounted,
+		pol_drift,
+		pol_flagged,
+		pol_rebases,
+		pol_rebase_offset,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_device] =	      { .key = "device",
+					.type = json_type_string,
+					.required = true },
+		[pol_name] =	      { .key = "name",
+					.type = json_type_string,
+					.required = true },
+		[pol_devlink_name] =  { .key = "devlink_name",
+					.type = json_type_string,
+					.required = true },
+		[pol_present] =	      { .key = "present",
+					.type = json_type_boolean,
+					.required = true },
+		[pol_checks] =	      { .key = "checks",
+					.type = json_type_int,
+					.required = true },
+		[pol_failures] =      { .key = "failures",
+					.type = json_type_int,
+					.required = true },
+		[pol_occupancy] =     { .key = "occupancy",
+					.type = json_type_int,
+					.required = true },
+		[pol_accounted] =     { .key = "accounted",
+					.type = json_type_int,
+					.required = true },
+		[pol_drift] =	      { .key = "drift",
+					.type = json_type_int,
+					.required = true },
+		[pol_flagged] =	      { .key = "flagged",
+					.type = json_type_boolean,
+					.required = true },
+		[pol_rebases] =	      { .key = "rebases",
+					.type = json_type_int,
+					.required = true },
+		[pol_rebase_offset] = { .key = "rebase_offset",
+					.type = json_type_int,
+					.required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	struct resmon_jrpc_recon_resource *res = elem;
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	err = resmon_jrpc_dissect(res_obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	*res = (struct resmon_jrpc_recon_resource) {
+		.device = json_object_get_string(values[pol_device]),
+		.name = json_object_get_string(values[pol_name]),
+		.devlink_name =
+			json_object_get_string(values[pol_devlink_name]),
+		.present = json_object_get_boolean(values[pol_present]),
+		.checks = json_object_get_int64(values[pol_checks]),
+		.failures = json_object_get_int64(values[pol_failures]),
+		.occupancy = json_object_get_int64(values[pol_occupancy]),
+		.accounted = json_object_get_int64(values[pol_accounted]),
+		.drift = json_object_get_int64(values[pol_drift]),
+		.flagged = json_object_get_boolean(values[pol_flagged]),
+		.rebases = json_object_get_int64(values[pol_rebases]),
+		.rebase_offset =
+			json_object_get_int64(values[pol_rebase_offset]),
+	};
+	return 0;
+}
+
+int resmon_jrpc_dissect_recon(struct json_object *obj,
+			      struct resmon_jrpc_recon *recon,
+			      char **error)
+{
+	/* Result for query with "recon" method is supposed to look like:
+	 *
+	 * { "interval_ns": a, "threshold": b, "persist": c, "action": "d",
+	 *   "resources": [ { "device": "e", "name": "f", "devlink_name": "g",
+	 *                    "present": h, "checks": i, "failures": j,
+	 *                    "occupancy": k, "accounted": l, "drift": m,
+	 *                    "flagged": n, "rebases": o,
+	 *                    "rebase_offset": p },
+	 *                  ...
+	 *                ] }
+	 */
+	enum {
+		pol_interval_ns,
+		pol_threshold,
+		pol_persist,
+		pol_action,
+		pol_resources,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_interval_ns] = { .key = "interval_ns",
+				      .type = json_type_int,
+				      .required = true },
+		[pol_threshold] =   { .key = "threshold",
+				      .type = json_type_int,
+				      .required = true },
+		[pol_persist] =	    { .key = "persist",
+				      .type = json_type_int,
+				      .required = true },
+		[pol_action] =	    { .key = "action",
+				      .type = json_type_string,
+				      .required = true },
+		[pol_resources] =   { .key = "resources",
+				      .type = json_type_array,
+				      .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	err = resmon_jrpc_dissect(obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	*recon = (struct resmon_jrpc_recon) {
+		.interval_ns = json_object_get_int64(values[pol_interval_ns]),
+		.threshold = json_object_get_int64(values[pol_threshold]),
+		.persist = json_object_get_int64(values[pol_persist]),
+		.action = json_object_get_string(values[pol_action]),
+	};
+
+	return resmon_jrpc_dissect_array(values[pol_resources],
+					 sizeof(*recon->resources),
+					 resmon_jrpc_dissect_recon_resource,
+					 (void **) &recon->resources,
+					 &recon->num_resources, error);
+}
+
+/* Decoding tables mark valid characters with a flag bit above the value. */
+static const uint8_t resmon_jrpc_hex_table[256] = {
+	['0'] = 0x10, ['1'] = 0x11, ['2'] = 0x12, ['3'] = 0x13, ['4'] = 0x14,
+	['5'] = 0x15, ['6'] = 0x16, ['7'] = 0x17, ['8'] = 0x18, ['9'] = 0x19,
+	['a'] = 0x1a, ['b'] = 0x1b, ['c'] = 0x1c, ['d'] = 0x1d, ['e'] = 0x1e,
+	['f'] = 0x1f, ['A'] = 0x1a, ['B'] = 0x1b, ['C'] = 0x1c, ['D'] = 0x1d,
+	['E'] = 0x1e, ['F'] = 0x1f,
+};
+
+static const uint8_t resmon_jrpc_base64_table[256] = {
+	['A'] = 0x40, ['B'] = 0x41, ['C'] = 0x42, ['D'] = 0x43, ['E'] = 0x44,
+	['F'] = 0x45, ['G'] = 0x46, ['H'] = 0x47, ['I'] = 0x48, ['J'] = 0x49,
+	['K'] = 0x4a, ['L'] = 0x4b, ['M'] = 0x4c, ['N'] = 0x4d, ['O'] = 0x4e,
+	['P'] = 0x4f, ['Q'] = 0x50, ['R'] = 0x51, ['S'] = 0x52, ['T'] = 0x53,
+	['U'] = 0x54, ['V'] = 0x55, ['W'] = 0x56, ['X'] = 0x57, ['Y'] = 0x58,
+	['Z'] = 0x59, ['a'] = 0x5a, ['b'] = 0x5b, ['c'] = 0x5c, ['d'] = 0x5d,
+	['e'] = 0x5e, ['f'] = 0x5f, ['g'] = 0x60, ['h'] = 0x61, ['i'] = 0x62,
+	['j'] = 0x63, ['k'] = 0x64, ['l'] = 0x65, ['m'] = 0x66, ['n'] = 0x67,
+	['o'] = 0x68, ['p'] = 0x69, ['q'] = 0x6a, ['r'] = 0x6b, ['s'] = 0x6c,
+	['t'] = 0x6d, ['u'] = 0x6e, ['v'] = 0x6f, ['w'] = 0x70, ['x'] = 0x71,
+	['y'] = 0x72, ['z'] = 0x73, ['0'] = 0x74, ['1'] = 0x75, ['2'] = 0x76,
+	['3'] = 0x77, ['4'] = 0x78, ['5'] = 0x79, ['6'] = 0x7a, ['7'] = 0x7b,
+	['8'] = 0x7c, ['9'] = 0x7d, ['+'] = 0x7e, ['/'] = 0x7f,
+};
+
+int resmon_jrpc_dissect_emads(struct json_object *obj,
+			      struct resmon_jrpc_emads *emads,
+			      char **error)
+{
+	/* Result for query with "emads" method is supposed to look like:
+	 *
+	 * { "emads": a, "errors": b, "error": "c" }
+	 *
+	 * Where "error" is only present if some EMADs failed.
+	 */
+	enum {
+		pol_emads,
+		pol_errors,
+		pol_error,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_emads] =  { .key = "emads",
+				 .type = json_type_int,
+				 .required = true },
+		[pol_errors] = { .key = "errors",
+				 .type = json_type_int,
+				 .required = true },
+		[pol_error] =  { .key = "error",
+				 .type = json_type_string },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	err = resmon_jrpc_dissect(obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	*emads = (struct resmon_jrpc_emads) {
+		.emads = json_object_get_int64(values[pol_emads]),
+		.errors = json_object_get_int64(values[pol_errors]),
+		.error = seen[pol_error] ?
+			 json_object_get_string(values[pol_error]) : NULL,
+	};
+	return 0;
+}
+
+/* Decode enc_len hex digits into enc_len / 2 bytes at dec. */
+int resmon_jrpc_decode_hex(uint8_t *dec, const char *enc, size_t enc_len)
+{
+	const uint8_t *in = (const uint8_t *) enc;
+
+	if (enc_len % 2 != 0)
+		return -1;
+
+	for (size_t i = 0; i < enc_len / 2; i++) {
+		uint8_t hi = resmon_jrpc_hex_table[in[2 * i]];
+		uint8_t lo = resmon_jrpc_hex_table[in[2 * i + 1]];
+
+		if (!(hi & lo & 0x10))
+			return -1;
+		dec[i] = (hi & 0xf) << 4 | (lo & 0xf);
+	}
+	return 0;
+}
+
+/* Decode padded base64 at enc into at most enc_len / 4 * 3 bytes at dec. */
+int resmon_jrpc_decode_base64(uint8_t *dec, size_t *dec_len,
+			      const char *enc, size_t enc_len)
+{
+	const uint8_t *in = (const uint8_t *) enc;
+	size_t pad = 0;
+	size_t n = 0;
+
+	if (enc_len % 4 != 0)
+		return -1;
+	if (enc_len != 0 && in[enc_len - 1] == '=')
+		pad++;
+	if (enc_len > 1 && in[enc_len - 2] == '=')
+		pad++;
+
+	for (size_t i = 0; i < enc_len; i += 4) {
+		uint8_t a = resmon_jrpc_base64_table[in[i]];
+		uint8_t b = resmon_jrpc_base64_table[in[i + 1]];
+		uint8_t c = resmon_jrpc_base64_table[in[i + 2]];
+		uint8_t d = resmon_jrpc_base64_table[in[i + 3]];
+		uint32_t v;
+
+		/* Padding only ever appears in the last quantum. */
+		if (i + 4 == enc_len) {
+			if (pad > 0)
+				d = 0x40;
+			if (pad > 1)
+				c = 0x40;
+		}
+		if (!(a & b & c & d & 0x40))
+			return -1;
+
+		v = (a & 0x3f) << 18 | (b & 0x3f) << 12 |
+		    (c & 0x3f) << 6 | (d & 0x3f);
+		dec[n++] = v >> 16;
+		dec[n++] = v >> 8;
+		dec[n++] = v;
+	}
+
+	*dec_len = n - pad;
+	return 0;
+}
+
+int resmon_jrpc_send(struct resmon_sock *sock, struct json_object *obj)
+{
+	const char *str;
+	size_t len;
+	int rc;
+
+	str = json_object_to_json_string(obj);
+	if (str == NULL)
+		return -1;
+
+	len = strlen(str);
+	rc = sendto(sock->fd, str, len, 0,
+		    (struct sockaddr *) &sock->sa, sock->len);
+	return rc == len ? 0 : -1;
+}
+
+int resmon_jrpc_send_fd(struct resmon_sock *sock, struct json_object *obj,
+			int fd)
+{
+	const char *str;
+
+	str = json_object_to_json_string(obj);
+	if (str == NULL)
+		return -1;
+
+	return resmon_sock_send_fd(sock, str, strlen(str), fd);
+}
+
+static int resmon_jrpc_dissect_ages_table(struct json_object *table_obj,
+					  void *elem, char **error)
+{
+	enum {
+		pol_device,
+		pol_name,
+		pol_entries,
+		pol_counts,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_device] =	{ .key = "device", .type = json_type_string,
+				  .required = true },
+		[pol_name] =	{ .key = "name", .type = json_type_string,
+				  .required = true },
+		[pol_entries] =	{ .key = "entries", .type = json_type_int,
+				  .required = true },
+		[pol_counts] =	{ .key = "counts", .type = json_type_array,
+				  .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	struct resmon_jrpc_ages_table *table = elem;
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	err = resmon_jrpc_dissect(table_obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	*table = (struct resmon_jrpc_ages_table) {
+		.device = json_object_get_string(values[pol_device]),
+		.name = json_object_get_string(values[pol_name]),
+		.entries = json_object_get_int64(values[pol_entries]),
+	};
+
+	return resmon_jrpc_dissect_int_array(values[pol_counts], "counts",
+					     table->counts,
+					     ARRAY_SIZE(table->counts), error);
+}
+
+static int resmon_jrpc_dissect_aged_key(struct json_object *key_obj,
+					void *elem, char **error)
+{
+	enum {
+		pol_device,
+		pol_table,
+		pol_key,
+		pol_age_s,
+		pol_idle_s,
+		pol_redundant,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_device] =	  { .key = "device", .type = json_type_string,
+				    .required = true },
+		[pol_table] =	  { .key = "table", .type = json_type_string,
+				    .required = true },
+		[pol_key] =	  { .key = "key", .type = json_type_string,
+				    .required = true },
+		[pol_age_s] =	  { .key = "age_s", .type = json_type_int,
+				    .required = true },
+		[pol_idle_s] =	  { .key = "idle_s", .type = json_type_int,
+				    .required = true },
+		[pol_redundant] = { .key = "redundant", .type = json_type_int,
+				    .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	struct resmon_jrpc_aged_key *key = elem;
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	err = resmon_jrpc_dissect(key_obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	*key = (struct resmon_jrpc_aged_key) {
+		.device = json_object_get_string(values[pol_device]),
+		.table = json_object_get_string(values[pol_table]),
+		.key = json_object_get_string(values[pol_key]),
+		.age_s = json_object_get_int64(values[pol_age_s]),
+		.idle_s = json_object_get_int64(values[pol_idle_s]),
+		.redundant = json_object_get_int64(values[pol_redundant]),
+	};
+	return 0;
+}
+
+int resmon_jrpc_dissect_ages(struct json_object *obj,
+			     struct resmon_jrpc_ages *ages,
+			     char **error)
+{
+	/* Result for query with "ages" method is supposed to look like:
+	 *
+	 * { "max_age_s": [ a, ... ],
+	 *   "tables": [ { "device": "b", "name": "c", "entries": d,
+	 *                 "counts": [ e, ... ] },
+	 *               ...
+	 *             ],
+	 *   "oldest": [ { "device": "f", "table": "g", "key": "h",
+	 *                 "age_s": i, "idle_s": j, "redundant": k },
+	 *               ...
+	 *             ] }
+	 */
+	enum {
+		pol_max_age_s,
+		pol_tables,
+		pol_oldest,
+	};
+	struct resmon_jrpc_policy policy[] = {
+		[pol_max_age_s] = { .key = "max_age_s", .type = json_type_array,
+				    .required = true },
+		[pol_tables] =	  { .key = "tables", .type = json_type_array,
+				    .required = true },
+		[pol_oldest] =	  { .key = "oldest", .type = json_type_array,
+				    .required = true },
+	};
+	struct json_object *values[ARRAY_SIZE(policy)] = {};
+	bool seen[ARRAY_SIZE(policy)] = {};
+	int err;
+
+	err = resmon_jrpc_dissect(obj, policy, seen, values,
+				  ARRAY_SIZE(policy), error);
+	if (err)
+		return err;
+
+	*ages = (struct resmon_jrpc_ages) {};
+	err = resmon_jrpc_dissect_int_array(values[pol_max_age_s],
+					    "max_age_s", ages->max_age_s,
+					    ARRAY_SIZE(ages->max_age_s), error);
+	if (err)
+		return err;
+
+	err = resmon_jrpc_dissect_array(values[pol_tables],
+					sizeof(*ages->tables),
+					resmon_jrpc_dissect_ages_table,
+					(void **) &ages->tables,
+					&ages->num_tables, error);
+	if (err)
+		return err;
+
+	err = resmon_jrpc_dissect_array(values[pol_oldest],
+					sizeof(*ages->oldest),
+					resmon_jrpc_dissect_aged_key,
+					(void **) &ages->oldest,
+					&ages->num_oldest, error);
+	if (err)
+		goto free_tables;
+
+	return 0;
+
+free_tables:
+	free(ages->tables);
+	return -1;
 }
@@ -0,0 +1,748 @@
+// SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+#include <endian.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <pcap/pcap.h>
+#include <pcap/dlt.h>
+
+#include "resmon.h"
+
+/* The load generator synthesizes the EMADs that the driver issues when a
+ * switch takes a full routing table, neighbour churn, ACL rule bursts and
+ * action set updates. The stream is either injected into a daemon running
+ * in mock mode, or written to a capture to be replayed.
+ */
+
+/* The replay backend skips this many bytes of each frame, as emadump
+ * captures them.
+ */
+static const uint8_t resmon_load_eth_hdr[0x10] = {
+	0x01, 0x02, 0xc9, 0x00, 0x00, 0x01, 0x00, 0x02,
+	0xc9, 0x01, 0x02, 0x03, 0x89, 0x32, 0x81, 0x00,
+};
+
+/* Distinct KVD linear indices cycled through by the PEFA / IEDR pairs. */
+#define RESMON_LOAD_ACTSET_WINDOW	4096
+
+#define RESMON_LOAD_PROBES_MAX		100000
+
+struct resmon_load_args {
+	const char *device;
+	const char *pcap_file;
+	pid_t pid;
+	uint32_t routes4;
+	uint32_t routes6;
+	uint32_t neighs;
+	uint32_t regions;
+	uint32_t rules;
+	uint32_t actions;
+	uint32_t batch;
+	uint32_t interval_ms;
+};
+
+struct resmon_load_lat {
+	uint64_t *ns;
+	size_t count;
+	size_t size;
+};
+
+struct resmon_load_phase {
+	const char *name;
+	uint64_t emads;
+	uint64_t errors;
+	uint64_t time_ns;
+};
+
+struct resmon_load {
+	const struct resmon_load_args *args;
+
+	/* Pending EMADs as records of a big-endian length and the EMAD. */
+	uint8_t *buf;
+	size_t buf_len;
+	size_t buf_size;
+	uint32_t pending;
+	int fd;
+	struct resmon_client *client;
+
+	pcap_t *pcap;
+	pcap_dumper_t *dumper;
+	uint64_t pcap_ts_us;
+
+	struct resmon_load_phase *phase;
+	struct resmon_load_lat batch_lat;
+	struct resmon_load_lat emad_lat;
+	char *first_error;
+};
+
+/* Stats queries issued by a prober process while the load runs. */
+struct resmon_load_probe {
+	size_t count;
+	uint64_t ns[RESMON_LOAD_PROBES_MAX];
+};
+
+static volatile sig_atomic_t resmon_load_probe_quit;
+
+static uint64_t resmon_load_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void resmon_load_put_be32(uint8_t *p, uint32_t val)
+{
+	val = htobe32(val);
+	memcpy(p, &val, sizeof(val));
+}
+
+static int resmon_load_lat_push(struct resmon_load_lat *lat, uint64_t ns)
+{
+	if (lat->count == lat->size) {
+		size_t size = lat->size ? lat->size * 2 : 1024;
+		uint64_t *new_ns;
+
+		new_ns = realloc(lat->ns, size * sizeof(*new_ns));
+		if (new_ns == NULL)
+			return -ENOMEM;
+		lat->ns = new_ns;
+		lat->size = size;
+	}
+
+	lat->ns[lat->count++] = ns;
+	return 0;
+}
+
+static int resmon_load_cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a;
+	uint64_t y = *(const uint64_t *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Sorts the samples in place. */
+static uint64_t resmon_load_percentile(uint64_t *ns, size_t count, int pct)
+{
+	if (count == 0)
+		return 0;
+
+	qsort(ns, count, sizeof(*ns), resmon_load_cmp_u64);
+	return ns[(count - 1) * pct / 100];
+}
+
+static int resmon_load_flush_fd(struct resmon_load *load)
+{
+	struct resmon_jrpc_emads result;
+	uint64_t emads = load->pending;
+	uint64_t start, ns;
+	char *error;
+	int rc;
+
+	if (ftruncate(load->fd, 0) != 0 ||
+	    pwrite(load->fd, load->buf, load->buf_len, 0) != load->buf_len) {
+		fprintf(stderr, "Failed to write EMADs: %m\n");
+		return -1;
+	}
+
+	start = resmon_load_now_ns();
+	rc = resmon_client_emads(load->client, load->args->device, load->fd,
+				 &result, &error);
+	ns = resmon_load_now_ns() - start;
+	if (rc != 0) {
+		fprintf(stderr, "%s\n", error);
+		free(error);
+		return rc;
+	}
+
+	load->phase->errors += result.errors;
+	if (result.error != NULL && load->first_error == NULL)
+		load->first_error = strdup(result.error);
+
+	rc = resmon_load_lat_push(&load->batch_lat, ns);
+	if (rc == 0)
+		rc = resmon_load_lat_push(&load->emad_lat, ns / emads);
+	if (rc != 0)
+		fprintf(stderr, "Failed to record latency\n");
+
+	return rc;
+}
+
+static int resmon_load_flush(struct resmon_load *load)
+{
+	uint64_t start;
+	int rc = 0;
+
+	if (load->pending == 0)
+		return 0;
+
+	start = resmon_load_now_ns();
+	if (load->dumper == NULL)
+		rc = resmon_load_flush_fd(load);
+	load->phase->time_ns += resmon_load_now_ns() - start;
+	load->phase->emads += load->pending;
+
+	load->buf_len = 0;
+	load->pending = 0;
+	return rc;
+}
+
+static void resmon_load_dump(struct resmon_load *load, const uint8_t *emad,
+			     size_t len)
+{
+	uint8_t frame[sizeof(resmon_load_eth_hdr) + RESMON_GEN_EMAD_MAX_LEN];
+	struct pcap_pkthdr hdr = {
+		.ts = {
+			.tv_sec = load->pcap_ts_us / 1000000,
+			.tv_usec = load->pcap_ts_us % 1000000,
+		},
+		.caplen = sizeof(resmon_load_eth_hdr) + len,
+		.len = sizeof(resmon_load_eth_hdr) + len,
+	};
+
+	memcpy(frame, resmon_load_eth_hdr, sizeof(resmon_load_eth_hdr));
+	memcpy(frame + sizeof(resmon_load_eth_hdr), emad, len);
+	pcap_dump((unsigned char *) load->dumper, &hdr, frame);
+	load->pcap_ts_us++;
+}
+
+/* The buffer always has room for one more EMAD, which goes here. */
+static uint8_t *resmon_load_next(struct resmon_load *load)
+{
+	return load->buf + load->buf_len + sizeof(uint32_t);
+}
+
+static int resmon_load_emad(struct resmon_load *load, size_t len)
+{
+	size_t need;
+
+	resmon_load_put_be32(load->buf + load->buf_len, len);
+	load->buf_len += sizeof(uint32_t) + len;
+	load->pending++;
+
+	/* When writing a capture, the buffer only ever holds this EMAD. */
+	if (load->dumper != NULL) {
+		resmon_load_dump(load, load->buf + sizeof(uint32_t), len);
+		load->buf_len = 0;
+	}
+
+	need = load->buf_len + sizeof(uint32_t) + RESMON_GEN_EMAD_MAX_LEN;
+	if (need > load->buf_size) {
+		size_t size = load->buf_size * 2;
+		uint8_t *new_buf;
+
+		while (size < need)
+			size *= 2;
+		new_buf = realloc(load->buf, size);
+		if (new_buf == NULL)
+			return -ENOMEM;
+		load->buf = new_buf;
+		load->buf_size = size;
+	}
+
+	if (load->pending < load->args->batch)
+		return 0;
+	return resmon_load_flush(load);
+}
+
+/* Append an EMAD that resmon_gen_<name>() generates. */
+#define RESMON_LOAD_EMAD(load, name, ...)				\
+	resmon_load_emad(load,						\
+			 resmon_gen_ ## name(resmon_load_next(load),	\
+					     __VA_ARGS__))
+
+static int resmon_load_begin(struct resmon_load *load,
+			     struct resmon_load_phase *phase)
+{
+	int rc;
+
+	rc = resmon_load_flush(load);
+	load->phase = phase;
+	return rc;
+}
+
+enum {
+	RESMON_LOAD_PHASE_ROUTES4,
+	RESMON_LOAD_PHASE_ROUTES6,
+	RESMON_LOAD_PHASE_NEIGHS,
+	RESMON_LOAD_PHASE_ACL,
+	RESMON_LOAD_PHASE_ACTIONS,
+	RESMON_LOAD_PHASE_WITHDRAW,
+	RESMON_LOAD_PHASE_COUNT,
+};
+
+static int resmon_load_run(struct resmon_load *load,
+			   struct resmon_load_phase *phases)
+{
+	const struct resmon_load_args *args = load->args;
+	int rc;
+
+	rc = resmon_load_begin(load, &phases[RESMON_LOAD_PHASE_ROUTES4]);
+	for (uint32_t i = 0; rc == 0 && i < args->routes4; i++)
+		rc = RESMON_LOAD_EMAD(load, ralue, false, i, false);
+	if (rc != 0)
+		return rc;
+
+	rc = resmon_load_begin(load, &phases[RESMON_LOAD_PHASE_ROUTES6]);
+	for (uint32_t i = 0; rc == 0 && i < args->routes6; i++)
+		rc = RESMON_LOAD_EMAD(load, ralue, true, i, false);
+	if (rc != 0)
+		return rc;
+
+	/* Neighbours come and go in waves. */
+	rc = resmon_load_begin(load, &phases[RESMON_LOAD_PHASE_NEIGHS]);
+	for (uint32_t i = 0; rc == 0 && i < args->neighs; i++)
+		rc = RESMON_LOAD_EMAD(load, rauht, i, false);
+	for (uint32_t i = 0; rc == 0 && i < args->neighs; i++)
+		rc = RESMON_LOAD_EMAD(load, rauht, i, true);
+	for (uint32_t i = 0; rc == 0 && i < args->neighs / 2; i++)
+		rc = RESMON_LOAD_EMAD(load, rauht, i, false);
+	if (rc != 0)
+		return rc;
+
+	rc = resmon_load_begin(load, &phases[RESMON_LOAD_PHASE_ACL]);
+	for (uint32_t r = 0; rc == 0 && r < args->regions; r++) {
+		rc = RESMON_LOAD_EMAD(load, ptar, r, args->rules, false);
+		for (uint32_t i = 0; rc == 0 && i < args->rules; i++)
+			rc = RESMON_LOAD_EMAD(load, ptce3, r, i, true);
+	}
+	if (rc != 0)
+		return rc;
+
+	rc = resmon_load_begin(load, &phases[RESMON_LOAD_PHASE_ACTIONS]);
+	for (uint32_t i = 0; rc == 0 && i < args->actions; i++) {
+		uint32_t index = i % RESMON_LOAD_ACTSET_WINDOW;
+
+		rc = RESMON_LOAD_EMAD(load, pefa, index);
+		if (rc == 0)
+			rc = RESMON_LOAD_EMAD(load, iedr, index);
+	}
+	if (rc != 0)
+		return rc;
+
+	rc = resmon_load_begin(load, &phases[RESMON_LOAD_PHASE_WITHDRAW]);
+	for (uint32_t i = 0; rc == 0 && i < args->routes4; i++)
+		rc = RESMON_LOAD_EMAD(load, ralue, false, i, true);
+	for (uint32_t i = 0; rc == 0 && i < args->routes6; i++)
+		rc = RESMON_LOAD_EMAD(load, ralue, true, i, true);
+	for (uint32_t r = 0; rc == 0 && r < args->regions; r++) {
+		for (uint32_t i = 0; rc == 0 && i < args->rules; i++)
+			rc = RESMON_LOAD_EMAD(load, ptce3, r, i, false);
+		if (rc == 0)
+			rc = RESMON_LOAD_EMAD(load, ptar, r, args->rules, true);
+	}
+	if (rc != 0)
+		return rc;
+
+	return resmon_load_flush(load);
+}
+
+static void resmon_load_probe_sig(int signo)
+{
+	resmon_load_probe_quit = 1;
+}
+
+static int resmon_load_probe_query(struct resmon_client *client,
+				   const char *device)
+{
+	struct resmon_jrpc_counter *counters;
+	size_t num_counters;
+	char *error;
+	int rc;
+
+	rc = resmon_client_stats(client, device, false, &counters,
+				 &num_counters, &error);
+	if (rc != 0) {
+		fprintf(stderr, "%s\n", error);
+		free(error);
+		return rc;
+	}
+
+	free(counters);
+	return 0;
+}
+
+/* Runs in a process of its own, with a client of its own. */
+static void resmon_load_probe_run(struct resmon_load_probe *probe,
+				  const struct resmon_load_args *args)
+{
+	struct resmon_client *client;
+	uint64_t start;
+	char *error;
+
+	signal(SIGTERM, resmon_load_probe_sig);
+
+	client = resmon_client_open(env.sockdir, &error);
+	if (client == NULL) {
+		fprintf(stderr, "%s\n", error);
+		free(error);
+		return;
+	}
+
+	while (!resmon_load_probe_quit &&
+	       probe->count < ARRAY_SIZE(probe->ns)) {
+		start = resmon_load_now_ns();
+		if (resmon_load_probe_query(client, args->device) != 0)
+			break;
+		probe->ns[probe->count++] = resmon_load_now_ns() - start;
+		usleep(args->interval_ms * 1000);
+	}
+
+	resmon_client_close(client);
+}
+
+static pid_t resmon_load_probe_start(struct resmon_load_probe *probe,
+				     const struct resmon_load_args *args)
+{
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0) {
+		fprintf(stderr, "Failed to fork the stats prober: %m\n");
+		return -1;
+	}
+	if (pid == 0) {
+		resmon_load_probe_run(probe, args);
+		_exit(0);
+	}
+
+	return pid;
+}
+
+static void resmon_load_probe_stop(pid_t pid)
+{
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+}
+
+struct resmon_load_rss {
+	int64_t rss_kb;
+	int64_t hwm_kb;
+};
+
+static int resmon_load_rss_get(pid_t pid, struct resmon_load_rss *rss)
+{
+	size_t line_size = 0;
+	char *line = NULL;
+	char path[64];
+	FILE *f;
+
+	*rss = (struct resmon_load_rss) { -1, -1 };
+
+	snprintf(path, sizeof(path), "/proc/%d/status", pid);
+	f = fopen(path, "r");
+	if (f == NULL) {
+		fprintf(stderr, "Failed to open %s: %m\n", path);
+		return -1;
+	}
+
+	while (getline(&line, &line_size, f) >= 0) {
+		sscanf(line, "VmRSS: %" SCNd64, &rss->rss_kb);
+		sscanf(line, "VmHWM: %" SCNd64, &rss->hwm_kb);
+	}
+
+	free(line);
+	fclose(f);
+	return 0;
+}
+
+static void resmon_load_print_lat(const char *what, uint64_t *ns,
+				  size_t count, const char *unit,
+				  uint64_t div)
+{
+	uint64_t p50 = resmon_load_percentile(ns, count, 50);
+	uint64_t p99 = resmon_load_percentile(ns, count, 99);
+	uint64_t max = count ? ns[count - 1] : 0;
+
+	fprintf(stderr, "%-30s%12zd%12.1f%12.1f%12.1f %s\n", what, count,
+		(double) p50 / div, (double) p99 / div, (double) max / div,
+		unit);
+}
+
+static void resmon_load_print(struct resmon_load *load,
+			      const struct resmon_load_phase *phases,
+			      struct resmon_load_probe *probe)
+{
+	uint64_t emads = 0, errors = 0, time_ns = 0;
+
+	fprintf(stderr, "%-30s%12s%12s%12s%12s\n",
+		"Phase", "EMADs", "Errors", "Time [s]", "EMADs/s");
+	for (int i = 0; i < RESMON_LOAD_PHASE_COUNT; i++) {
+		const struct resmon_load_phase *phase = &phases[i];
+
+		fprintf(stderr, "%-30s%12" PRIu64 "%12" PRIu64 "%12.3f%12.0f\n",
+			phase->name, phase->emads, phase->errors,
+			phase->time_ns / 1e9,
+			phase->time_ns ? phase->emads * 1e9 / phase->time_ns
+				       : 0);
+		emads += phase->emads;
+		errors += phase->errors;
+		time_ns += phase->time_ns;
+	}
+	fprintf(stderr, "%-30s%12" PRIu64 "%12" PRIu64 "%12.3f%12.0f\n",
+		"Total", emads, errors, time_ns / 1e9,
+		time_ns ? emads * 1e9 / time_ns : 0);
+
+	if (load->first_error != NULL)
+		fprintf(stderr, "First failure: %s\n", load->first_error);
+
+	fprintf(stderr, "\n%-30s%12s%12s%12s%12s\n",
+		"Latency", "Samples", "p50", "p99", "Max");
+	resmon_load_print_lat("Batch round trip", load->batch_lat.ns,
+			      load->batch_lat.count, "us", 1000);
+	resmon_load_print_lat("EMAD processing", load->emad_lat.ns,
+			      load->emad_lat.count, "ns", 1);
+	resmon_load_print_lat("Stats query under load", probe->ns,
+			      probe->count, "us", 1000);
+}
+
+static int resmon_load_pcap(struct resmon_load *load,
+			    struct resmon_load_phase *phases)
+{
+	const char *file = load->args->pcap_file;
+	uint64_t emads = 0;
+	int rc;
+
+	load->pcap = pcap_open_dead(DLT_EN10MB, sizeof(resmon_load_eth_hdr) +
+						RESMON_GEN_EMAD_MAX_LEN);
+	if (load->pcap == NULL) {
+		fprintf(stderr, "Failed to open a capture\n");
+		return -1;
+	}
+
+	load->dumper = pcap_dump_open(load->pcap, file);
+	if (load->dumper == NULL) {
+		fprintf(stderr, "Failed to open %s: %s\n", file,
+			pcap_geterr(load->pcap));
+		rc = -1;
+		goto close_pcap;
+	}
+
+	rc = resmon_load_run(load, phases);
+	if (rc != 0)
+		goto close_dumper;
+
+	for (int i = 0; i < RESMON_LOAD_PHASE_COUNT; i++)
+		emads += phases[i].emads;
+	fprintf(stderr, "Wrote %" PRIu64 " EMADs to %s\n", emads, file);
+
+close_dumper:
+	pcap_dump_close(load->dumper);
+close_pcap:
+	pcap_close(load->pcap);
+	return rc;
+}
+
+static int resmon_load_inject(struct resmon_load *load,
+			      struct resmon_load_phase *phases)
+{
+	const struct resmon_load_args *args = load->args;
+	struct resmon_load_rss rss_before, rss_after;
+	struct resmon_load_probe *probe;
+	pid_t probe_pid;
+	char *error;
+	FILE *tmp;
+	int rc;
+
+	load->client = resmon_client_open(env.sockdir, &error);
+	if (load->client == NULL) {
+		fprintf(stderr, "%s\n", error);
+		free(error);
+		return -1;
+	}
+
+	/* The EMADs go to the daemon a batch at a time in a file that is
+	 * passed along with the request.
+	 */
+	tmp = tmpfile();
+	if (tmp == NULL) {
+		fprintf(stderr, "Failed to create a temporary file: %m\n");
+		rc = -1;
+		goto close_client;
+	}
+	load->fd = fileno(tmp);
+
+	probe = mmap(NULL, sizeof(*probe), PROT_READ | PROT_WRITE,
+		     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (probe == MAP_FAILED) {
+		fprintf(stderr, "Failed to map the probe buffer: %m\n");
+		rc = -1;
+		goto close_tmp;
+	}
+
+	if (args->pid != 0)
+		resmon_load_rss_get(args->pid, &rss_before);
+
+	probe_pid = resmon_load_probe_start(probe, args);
+	if (probe_pid < 0) {
+		rc = -1;
+		goto unmap_probe;
+	}
+
+	rc = resmon_load_run(load, phases);
+	resmon_load_probe_stop(probe_pid);
+	if (rc != 0)
+		goto unmap_probe;
+
+	resmon_load_print(load, phases, probe);
+
+	if (args->pid != 0 &&
+	    resmon_load_rss_get(args->pid, &rss_after) == 0 &&
+	    rss_before.rss_kb >= 0 && rss_after.rss_kb >= 0)
+		fprintf(stderr, "\nDaemon RSS: %" PRId64 " kB before, %" PRId64
+			" kB after (%+" PRId64 " kB), peak %" PRId64 " kB\n",
+			rss_before.rss_kb, rss_after.rss_kb,
+			rss_after.rss_kb - rss_before.rss_kb,
+			rss_after.hwm_kb);
+
+unmap_probe:
+	munmap(probe, sizeof(*probe));
+close_tmp:
+	fclose(tmp);
+close_client:
+	resmon_client_close(load->client);
+	return rc;
+}
+
+static void resmon_load_help(void)
+{
+	fprintf(stderr,
+		"Usage: resmon load [dev DEV] [routes4 N] [routes6 N] [neighs N]\n"
+		"                   [regions N] [rules N] [actions N] [batch N]\n"
+		"                   [interval MS] [pid PID] [pcap FILE]\n"
+		"\n"
+		"  routes4, routes6: IPv4 and IPv6 routes to add and withdraw\n"
+		"  neighs: neighbours to add, delete and add again\n"
+		"  regions: ACL regions to allocate, each with a burst of\n"
+		"           rules rules\n"
+		"  actions: action sets to write and delete\n"
+		"  batch: EMADs to inject at a time\n"
+		"  interval: milliseconds between stats queries issued under load\n"
+		"  pid: PID of the daemon, whose RSS growth to report\n"
+		"  pcap: write the EMADs to a capture for \"resmon replay\"\n"
+		"        instead of injecting them\n"
+		"\n"
+	);
+}
+
+static int resmon_load_parse_u32(const char *arg, uint32_t *pval)
+{
+	unsigned long val;
+	char *end;
+
+	errno = 0;
+	val = strtoul(arg, &end, 0);
+	if (errno != 0 || *end != '\0' || *arg == '\0' || val > UINT32_MAX) {
+		fprintf(stderr, "Invalid number: \"%s\"\n", arg);
+		return -1;
+	}
+
+	*pval = val;
+	return 0;
+}
+
+int resmon_load(int argc, char **argv)
+{
+	struct resmon_load_args args = {
+		.routes4 = 100000,
+		.routes6 = 20000,
+		.neighs = 10000,
+		.regions = 16,
+		.rules = 1000,
+		.actions = 10000,
+		.batch = 1000,
+		.interval_ms = 10,
+	};
+	struct resmon_load_phase phases[RESMON_LOAD_PHASE_COUNT] = {
+		[RESMON_LOAD_PHASE_ROUTES4] = { .name = "IPv4 routes" },
+		[RESMON_LOAD_PHASE_ROUTES6] = { .name = "IPv6 routes" },
+		[RESMON_LOAD_PHASE_NEIGHS] = { .name = "Neighbour churn" },
+		[RESMON_LOAD_PHASE_ACL] = { .name = "ACL rule bursts" },
+		[RESMON_LOAD_PHASE_ACTIONS] = { .name = "Action sets" },
+		[RESMON_LOAD_PHASE_WITHDRAW] = { .name = "Withdrawals" },
+	};
+	struct resmon_load load = {
+		.args = &args,
+		.fd = -1,
+	};
+	uint32_t pid = 0;
+	int rc;
+
+	while (argc > 0) {
+		uint32_t *num = NULL;
+
+		if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+			args.device = *argv;
+		} else if (strcmp(*argv, "pcap") == 0) {
+			NEXT_ARG();
+			args.pcap_file = *argv;
+		} else if (strcmp(*argv, "routes4") == 0) {
+			num = &args.routes4;
+		} else if (strcmp(*argv, "routes6") == 0) {
+			num = &args.routes6;
+		} else if (strcmp(*argv, "neighs") == 0) {
+			num = &args.neighs;
+		} else if (strcmp(*argv, "regions") == 0) {
+			num = &args.regions;
+		} else if (strcmp(*argv, "rules") == 0) {
+			num = &args.rules;
+		} else if (strcmp(*argv, "actions") == 0) {
+			num = &args.actions;
+		} else if (strcmp(*argv, "batch") == 0) {
+			num = &args.batch;
+		} else if (strcmp(*argv, "interval") == 0) {
+			num = &args.interval_ms;
+		} else if (strcmp(*argv, "pid") == 0) {
+			num = &pid;
+		} else if (strcmp(*argv, "help") == 0) {
+			resmon_load_help();
+			return 0;
+		} else {
+			fprintf(stderr, "What is \"%s\"?\n", *argv);
+			return -1;
+		}
+		if (num != NULL) {
+			NEXT_ARG();
+			if (resmon_load_parse_u32(*argv, num))
+				return -1;
+		}
+		NEXT_ARG_FWD();
+		continue;
+
+incomplete_command:
+		fprintf(stderr, "Command line is not complete. Try option \"help\"\n");
+		return -1;
+	}
+
+	if (args.batch == 0 || args.rules > UINT16_MAX) {
+		fprintf(stderr, "Batch must be non-zero and rules at most %d\n",
+			UINT16_MAX);
+		return -1;
+	}
+	args.pid = pid;
+
+	load.buf_size = 1 << 16;
+	load.buf = malloc(load.buf_size);
+	if (load.buf == NULL)
+		return -1;
+
+	if (args.pcap_file != NULL)
+		rc = resmon_load_pcap(&load, phases);
+	else
+		rc = resmon_load_inject(&load, phases);
+
+	free(load.batch_lat.ns);
+	free(load.emad_lat.ns);
+	free(load.first_error);
+	free(load.buf);
+	return rc;
+}
@@ -0,0 +1,519 @@
+// SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+#include <argp.h>
+#include <endian.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+#include "resmon.h"
+
+/* Runs EMADs through resmon_reg_process_emad(), and entries through the
+ * resmon_stat_* calls directly, without a daemon in the way. Each
+ * benchmark runs at each table size: the untimed setup fills the table,
+ * then the timed operation runs once per entry.
+ */
+
+/* Operations are generated this many at a time, outside of the timing. */
+#define RESMON_MB_CHUNK			4096
+
+static struct {
+	const char *bench;
+	uint32_t sizes[16];
+	size_t num_sizes;
+} mb_env = {
+	.sizes = { 1000, 10000, 100000, 1000000, 10000000 },
+	.num_sizes = 5,
+};
+
+const char *argp_program_version = "resmon-microbench 0.0";
+const char *argp_program_bug_address = "<mlxsw@nvidia.com>";
+const char argp_program_doc[] =
+"Measure the cost of resmon EMAD processing and accounting.\n"
+"\n"
+"USAGE: resmon-microbench [--help] [-b BENCH] [-s SIZES]\n"
+"\n"
+"EXAMPLES:\n"
+"    resmon-microbench                 # all benchmarks at 1k to 10M entries\n"
+"    resmon-microbench -b ralue4       # IPv4 route benchmarks only\n"
+"    resmon-microbench -s 1000,100000  # at 1k and 100k entries\n";
+
+static const struct argp_option opts[] = {
+	{ "bench", 'b', "BENCH", 0, "Run benchmarks whose name starts with BENCH" },
+	{ "sizes", 's', "SIZES", 0, "Comma-separated list of table sizes" },
+	{},
+};
+
+struct resmon_mb_op {
+	/* Generate the i-th operation into buf and return its length. */
+	size_t (*gen)(uint8_t *buf, uint32_t i);
+	int (*run)(struct resmon_stat *stat, const uint8_t *buf, size_t len);
+};
+
+struct resmon_mb_bench {
+	const char *name;
+	const struct resmon_mb_op *init;	/* Once, untimed. */
+	const struct resmon_mb_op *setup;	/* Per entry, untimed. */
+	const struct resmon_mb_op *op;		/* Per entry, timed. */
+};
+
+static int resmon_mb_run_emad(struct resmon_stat *stat, const uint8_t *buf,
+			      size_t len)
+{
+	char *error;
+	int rc;
+
+	rc = resmon_reg_process_emad(stat, buf, len, &error);
+	if (rc != 0)
+		free(error);
+	return rc;
+}
+
+#define RESMON_MB_EMAD_OP(name, gen_expr)				\
+	static size_t resmon_mb_gen_ ## name(uint8_t *buf, uint32_t i)	\
+	{								\
+		return gen_expr;					\
+	}								\
+	static const struct resmon_mb_op resmon_mb_op_ ## name = {	\
+		.gen = resmon_mb_gen_ ## name,				\
+		.run = resmon_mb_run_emad,				\
+	};
+
+RESMON_MB_EMAD_OP(ralue4_add, resmon_gen_ralue(buf, false, i, false))
+RESMON_MB_EMAD_OP(ralue4_del, resmon_gen_ralue(buf, false, i, true))
+RESMON_MB_EMAD_OP(ralue6_add, resmon_gen_ralue(buf, true, i, false))
+RESMON_MB_EMAD_OP(ralue6_del, resmon_gen_ralue(buf, true, i, true))
+RESMON_MB_EMAD_OP(rauht_add, resmon_gen_rauht(buf, i, false))
+RESMON_MB_EMAD_OP(rauht_del, resmon_gen_rauht(buf, i, true))
+RESMON_MB_EMAD_OP(ptar_alloc, resmon_gen_ptar(buf, 0, UINT16_MAX, false))
+RESMON_MB_EMAD_OP(ptce3_add, resmon_gen_ptce3(buf, 0, i, true))
+RESMON_MB_EMAD_OP(ptce3_del, resmon_gen_ptce3(buf, 0, i, false))
+RESMON_MB_EMAD_OP(pefa, resmon_gen_pefa(buf, i))
+RESMON_MB_EMAD_OP(iedr, resmon_gen_iedr(buf, i))
+
+#undef RESMON_MB_EMAD_OP
+
+/* The direct resmon_stat_* operations take the same entries as the EMADs
+ * above, so that the difference is the cost of decoding.
+ */
+struct resmon_mb_route {
+	uint8_t prefix_len;
+	struct resmon_stat_dip dip;
+};
+
+static size_t resmon_mb_gen_route(uint8_t *buf, uint32_t i)
+{
+	struct resmon_mb_route route = {
+		.prefix_len = i % 10 < 6 ? 24 : 16 + i % 8,
+	};
+	uint32_t dip = htobe32((i + 0x10000) << 8);
+
+	memcpy(route.dip.dip, &dip, sizeof(dip));
+	memcpy(buf, &route, sizeof(route));
+	return sizeof(route);
+}
+
+static int resmon_mb_run_route_update(struct resmon_stat *stat,
+				      const uint8_t *buf, size_t len)
+{
+	struct resmon_mb_route route;
+
+	memcpy(&route, buf, sizeof(route));
+	return resmon_stat_ralue_update(stat, MLXSW_REG_RALXX_PROTOCOL_IPV4,
+					route.prefix_len, 0, route.dip,
+					resmon_reg_ralue_kvd_alloc(false,
+							route.prefix_len));
+}
+
+static int resmon_mb_run_route_delete(struct resmon_stat *stat,
+				      const uint8_t *buf, size_t len)
+{
+	struct resmon_mb_route route;
+
+	memcpy(&route, buf, sizeof(route));
+	return resmon_stat_ralue_delete(stat, MLXSW_REG_RALXX_PROTOCOL_IPV4,
+					route.prefix_len, 0, route.dip);
+}
+
+static size_t resmon_mb_gen_index(uint8_t *buf, uint32_t i)
+{
+	memcpy(buf, &i, sizeof(i));
+	return sizeof(i);
+}
+
+static int resmon_mb_run_kvdl_alloc(struct resmon_stat *stat,
+				    const uint8_t *buf, size_t len)
+{
+	uint32_t index;
+
+	memcpy(&index, buf, sizeof(index));
+	return resmon_stat_kvdl_alloc(stat, index,
+				      resmon_reg_pefa_kvd_alloc());
+}
+
+static int resmon_mb_run_kvdl_free(struct resmon_stat *stat,
+				   const uint8_t *buf, size_t len)
+{
+	uint32_t index;
+
+	memcpy(&index, buf, sizeof(index));
+	return resmon_stat_kvdl_free(stat, index,
+				     resmon_reg_pefa_kvd_alloc());
+}
+
+static const struct resmon_mb_op resmon_mb_op_route_update = {
+	.gen = resmon_mb_gen_route,
+	.run = resmon_mb_run_route_update,
+};
+
+static const struct resmon_mb_op resmon_mb_op_route_delete = {
+	.gen = resmon_mb_gen_route,
+	.run = resmon_mb_run_route_delete,
+};
+
+static const struct resmon_mb_op resmon_mb_op_kvdl_alloc = {
+	.gen = resmon_mb_gen_index,
+	.run = resmon_mb_run_kvdl_alloc,
+};
+
+static const struct resmon_mb_op resmon_mb_op_kvdl_free = {
+	.gen = resmon_mb_gen_index,
+	.run = resmon_mb_run_kvdl_free,
+};
+
+static const struct resmon_mb_bench resmon_mb_benches[] = {
+	{
+		.name = "ralue4-add",
+		.op = &resmon_mb_op_ralue4_add,
+	}, {
+		.name = "ralue4-update",
+		.setup = &resmon_mb_op_ralue4_add,
+		.op = &resmon_mb_op_ralue4_add,
+	}, {
+		.name = "ralue4-delete",
+		.setup = &resmon_mb_op_ralue4_add,
+		.op = &resmon_mb_op_ralue4_del,
+	}, {
+		.name = "ralue6-add",
+		.op = &resmon_mb_op_ralue6_add,
+	}, {
+		.name = "ralue6-delete",
+		.setup = &resmon_mb_op_ralue6_add,
+		.op = &resmon_mb_op_ralue6_del,
+	}, {
+		.name = "rauht-add",
+		.op = &resmon_mb_op_rauht_add,
+	}, {
+		.name = "rauht-delete",
+		.setup = &resmon_mb_op_rauht_add,
+		.op = &resmon_mb_op_rauht_del,
+	}, {
+		.name = "ptce3-add",
+		.init = &resmon_mb_op_ptar_alloc,
+		.op = &resmon_mb_op_ptce3_add,
+	}, {
+		.name = "ptce3-delete",
+		.init = &resmon_mb_op_ptar_alloc,
+		.setup = &resmon_mb_op_ptce3_add,
+		.op = &resmon_mb_op_ptce3_del,
+	}, {
+		.name = "pefa-add",
+		.op = &resmon_mb_op_pefa,
+	}, {
+		.name = "iedr-delete",
+		.setup = &resmon_mb_op_pefa,
+		.op = &resmon_mb_op_iedr,
+	}, {
+		.name = "stat-ralue-update",
+		.op = &resmon_mb_op_route_update,
+	}, {
+		.name = "stat-ralue-delete",
+		.setup = &resmon_mb_op_route_update,
+		.op = &resmon_mb_op_route_delete,
+	}, {
+		.name = "stat-kvdl-alloc",
+		.op = &resmon_mb_op_kvdl_alloc,
+	}, {
+		.name = "stat-kvdl-free",
+		.setup = &resmon_mb_op_kvdl_alloc,
+		.op = &resmon_mb_op_kvdl_free,
+	},
+};
+
+/* Cycles and cache misses of user space, counted as a group so that both
+ * cover the same stretches of time.
+ */
+struct resmon_mb_perf {
+	int cycles_fd;
+	int misses_fd;
+};
+
+struct resmon_mb_perf_read {
+	uint64_t nr;
+	uint64_t values[2];
+};
+
+static int resmon_mb_perf_open_1(uint64_t config, int group_fd)
+{
+	struct perf_event_attr attr = {
+		.type = PERF_TYPE_HARDWARE,
+		.size = sizeof(attr),
+		.config = config,
+		.disabled = group_fd < 0,
+		.exclude_kernel = 1,
+		.exclude_hv = 1,
+		.read_format = PERF_FORMAT_GROUP,
+	};
+
+	return syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+static void resmon_mb_perf_open(struct resmon_mb_perf *perf)
+{
+	*perf = (struct resmon_mb_perf) { -1, -1 };
+
+	perf->cycles_fd = resmon_mb_perf_open_1(PERF_COUNT_HW_CPU_CYCLES, -1);
+	if (perf->cycles_fd < 0) {
+		fprintf(stderr, "Hardware counters not available: %m\n");
+		return;
+	}
+
+	perf->misses_fd = resmon_mb_perf_open_1(PERF_COUNT_HW_CACHE_MISSES,
+						perf->cycles_fd);
+	if (perf->misses_fd < 0) {
+		fprintf(stderr, "Cache miss counter not available: %m\n");
+		close(perf->cycles_fd);
+		perf->cycles_fd = -1;
+	}
+}
+
+static void resmon_mb_perf_close(struct resmon_mb_perf *perf)
+{
+	if (perf->cycles_fd < 0)
+		return;
+	close(perf->misses_fd);
+	close(perf->cycles_fd);
+}
+
+static void resmon_mb_perf_ioctl(struct resmon_mb_perf *perf,
+				 unsigned long request)
+{
+	if (perf->cycles_fd >= 0)
+		ioctl(perf->cycles_fd, request, PERF_IOC_FLAG_GROUP);
+}
+
+static bool resmon_mb_perf_read(struct resmon_mb_perf *perf,
+				uint64_t *cycles, uint64_t *misses)
+{
+	struct resmon_mb_perf_read data;
+
+	if (perf->cycles_fd < 0)
+		return false;
+	if (read(perf->cycles_fd, &data, sizeof(data)) != sizeof(data))
+		return false;
+
+	*cycles = data.values[0];
+	*misses = data.values[1];
+	return true;
+}
+
+static uint64_t resmon_mb_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct resmon_mb_chunk {
+	uint8_t *buf;
+	size_t offs[RESMON_MB_CHUNK + 1];
+};
+
+static size_t resmon_mb_chunk_gen(struct resmon_mb_chunk *chunk,
+				  const struct resmon_mb_op *op,
+				  uint32_t start, uint32_t n)
+{
+	size_t count = n - start < RESMON_MB_CHUNK ? n - start
+						   : RESMON_MB_CHUNK;
+
+	chunk->offs[0] = 0;
+	for (size_t i = 0; i < count; i++)
+		chunk->offs[i + 1] = chunk->offs[i] +
+				     op->gen(chunk->buf + chunk->offs[i],
+					     start + i);
+	return count;
+}
+
+static uint64_t resmon_mb_chunk_run(struct resmon_mb_chunk *chunk,
+				    const struct resmon_mb_op *op,
+				    struct resmon_stat *stat, size_t count)
+{
+	uint64_t errors = 0;
+
+	for (size_t i = 0; i < count; i++)
+		if (op->run(stat, chunk->buf + chunk->offs[i],
+			    chunk->offs[i + 1] - chunk->offs[i]))
+			errors++;
+	return errors;
+}
+
+static uint64_t resmon_mb_untimed(struct resmon_mb_chunk *chunk,
+				  const struct resmon_mb_op *op,
+				  struct resmon_stat *stat, uint32_t n)
+{
+	uint64_t errors = 0;
+	size_t count;
+
+	for (uint32_t i = 0; i < n; i += count) {
+		count = resmon_mb_chunk_gen(chunk, op, i, n);
+		errors += resmon_mb_chunk_run(chunk, op, stat, count);
+	}
+	return errors;
+}
+
+static int resmon_mb_bench_run(const struct resmon_mb_bench *bench,
+			       struct resmon_mb_chunk *chunk,
+			       struct resmon_mb_perf *perf, uint32_t n)
+{
+	struct resmon_stat_config config = {
+		.burst_gap_ns = 100000000ULL,
+	};
+	uint64_t cycles, misses;
+	uint64_t errors = 0;
+	uint64_t time_ns = 0;
+	struct resmon_stat *stat;
+	uint64_t start;
+	size_t count;
+
+	stat = resmon_stat_create(&config);
+	if (stat == NULL) {
+		fprintf(stderr, "Failed to create the statistics\n");
+		return -1;
+	}
+
+	if (bench->init != NULL)
+		errors += resmon_mb_untimed(chunk, bench->init, stat, 1);
+	if (bench->setup != NULL)
+		errors += resmon_mb_untimed(chunk, bench->setup, stat, n);
+
+	resmon_mb_perf_ioctl(perf, PERF_EVENT_IOC_RESET);
+	for (uint32_t i = 0; i < n; i += count) {
+		count = resmon_mb_chunk_gen(chunk, bench->op, i, n);
+
+		resmon_mb_perf_ioctl(perf, PERF_EVENT_IOC_ENABLE);
+		start = resmon_mb_now_ns();
+		errors += resmon_mb_chunk_run(chunk, bench->op, stat, count);
+		time_ns += resmon_mb_now_ns() - start;
+		resmon_mb_perf_ioctl(perf, PERF_EVENT_IOC_DISABLE);
+	}
+
+	printf("%-20s%10" PRIu32 "%12.1f", bench->name, n,
+	       (double) time_ns / n);
+	if (resmon_mb_perf_read(perf, &cycles, &misses))
+		printf("%12.1f%12.2f", (double) cycles / n,
+		       (double) misses / n);
+	else
+		printf("%12s%12s", "-", "-");
+	if (errors != 0)
+		printf("  (%" PRIu64 " failed)", errors);
+	printf("\n");
+
+	resmon_stat_destroy(stat);
+	return 0;
+}
+
+static int resmon_mb_parse_sizes(char *arg)
+{
+	char *saveptr;
+	char *tok;
+
+	mb_env.num_sizes = 0;
+	for (tok = strtok_r(arg, ",", &saveptr); tok != NULL;
+	     tok = strtok_r(NULL, ",", &saveptr)) {
+		unsigned long size;
+		char *end;
+
+		if (mb_env.num_sizes == ARRAY_SIZE(mb_env.sizes))
+			return -1;
+
+		errno = 0;
+		size = strtoul(tok, &end, 0);
+		if (errno != 0 || *end != '\0' || size == 0 ||
+		    size > UINT32_MAX)
+			return -1;
+		mb_env.sizes[mb_env.num_sizes++] = size;
+	}
+
+	return mb_env.num_sizes != 0 ? 0 : -1;
+}
+
+static error_t parse_arg(int key, char *arg, struct argp_state *state)
+{
+	switch (key) {
+	case 'b':
+		mb_env.bench = arg;
+		break;
+	case 's':
+		if (resmon_mb_parse_sizes(arg)) {
+			fprintf(stderr, "Invalid sizes\n");
+			argp_usage(state);
+		}
+		break;
+	default:
+		return ARGP_ERR_UNKNOWN;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static const struct argp argp = {
+		.options = opts,
+		.parser = parse_arg,
+		.doc = argp_program_doc,
+	};
+	struct resmon_mb_chunk chunk;
+	struct resmon_mb_perf perf;
+	int err;
+
+	err = argp_parse(&argp, argc, argv, 0, NULL, NULL);
+	if (err)
+		return err;
+
+	chunk.buf = malloc(RESMON_MB_CHUNK * RESMON_GEN_EMAD_MAX_LEN);
+	if (chunk.buf == NULL) {
+		fprintf(stderr, "Failed to allocate the operation buffer\n");
+		return 1;
+	}
+
+	resmon_mb_perf_open(&perf);
+
+	printf("%-20s%10s%12s%12s%12s\n",
+	       "Benchmark", "Size", "ns/op", "cycles/op", "misses/op");
+	for (size_t i = 0; i < ARRAY_SIZE(resmon_mb_benches); i++) {
+		const struct resmon_mb_bench *bench = &resmon_mb_benches[i];
+
+		if (mb_env.bench != NULL &&
+		    strncmp(bench->name, mb_env.bench, strlen(mb_env.bench)) != 0)
+			continue;
+
+		for (size_t j = 0; j < mb_env.num_sizes; j++) {
+			err = resmon_mb_bench_run(bench, &chunk, &perf,
+						  mb_env.sizes[j]);
+			if (err != 0)
+				goto out;
+		}
+	}
+
+out:
+	resmon_mb_perf_close(&perf);
+	free(chunk.buf);
+	return err != 0;
+}
@@ -0,0 +1,229 @@
+// SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <sys/timerfd.h>
+
+#include "resmon.h"
+
+/* resmon infers its accounting from the EMADs that it sees, and misses
+ * whatever the device did before resmon started or while EMADs were lost.
+ * Reconciliation compares the accounting with the occupancy that devlink
+ * reports, and publishes the difference as drift. Drift beyond a
+ * threshold that persists for a number of checks is either flagged, or
+ * the accounting is rebased onto the occupancy.
+ */
+
+#define RESMON_RECON_EXPAND_AS_NAME_STR(NAME, name, DEVLINK_NAME) \
+	[RESMON_RECON_RESOURCE_ ## NAME] = #name,
+#define RESMON_RECON_EXPAND_AS_DEVLINK_NAME(NAME, name, DEVLINK_NAME) \
+	[RESMON_RECON_RESOURCE_ ## NAME] = DEVLINK_NAME,
+
+static const char *const resmon_recon_resource_names[] = {
+	RESMON_RECON_RESOURCES(RESMON_RECON_EXPAND_AS_NAME_STR)
+};
+
+static const char *const resmon_recon_resource_devlink_names[] = {
+	RESMON_RECON_RESOURCES(RESMON_RECON_EXPAND_AS_DEVLINK_NAME)
+};
+
+#undef RESMON_RECON_EXPAND_AS_DEVLINK_NAME
+#undef RESMON_RECON_EXPAND_AS_NAME_STR
+
+const char *resmon_recon_resource_name(enum resmon_recon_resource resource)
+{
+	return resmon_recon_resource_names[resource];
+}
+
+const char *
+resmon_recon_resource_devlink_name(enum resmon_recon_resource resource)
+{
+	return resmon_recon_resource_devlink_names[resource];
+}
+
+int resmon_recon_resource_parse(const char *name,
+				enum resmon_recon_resource *resource)
+{
+	for (int i = 0; i < resmon_recon_resource_count; i++) {
+		if (strcmp(name, resmon_recon_resource_names[i]) == 0) {
+			*resource = i;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+static bool resmon_recon_enabled(const struct resmon_back *back)
+{
+	return back->cls->get_occupancy != NULL &&
+	       back->recon.config.interval_ns != 0;
+}
+
+int resmon_recon_init(struct resmon_back *back,
+		      const struct resmon_recon_config *config)
+{
+	struct resmon_recon *recon = &back->recon;
+	struct itimerspec its;
+
+	*recon = (struct resmon_recon) {
+		.config = *config,
+		.timerfd = -1,
+	};
+	if (!resmon_recon_enabled(back))
+		return 0;
+
+	recon->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+	if (recon->timerfd < 0) {
+		fprintf(stderr, "Failed to create reconciliation timer: %m\n");
+		return -1;
+	}
+
+	its.it_value.tv_sec = config->interval_ns / 1000000000;
+	its.it_value.tv_nsec = config->interval_ns % 1000000000;
+	its.it_interval = its.it_value;
+	if (timerfd_settime(recon->timerfd, 0, &its, NULL)) {
+		fprintf(stderr, "Failed to arm reconciliation timer: %m\n");
+		goto close_timerfd;
+	}
+
+	return 0;
+
+close_timerfd:
+	close(recon->timerfd);
+	recon->timerfd = -1;
+	return -1;
+}
+
+void resmon_recon_fini(struct resmon_back *back)
+{
+	if (back->recon.timerfd >= 0)
+		close(back->recon.timerfd);
+}
+
+int resmon_recon_pollfd(struct resmon_back *back)
+{
+	return back->recon.timerfd;
+}
+
+static int64_t resmon_recon_accounted(struct resmon_stat *stat,
+				      enum resmon_recon_resource resource)
+{
+	switch (resource) {
+	case RESMON_RECON_RESOURCE_KVD:
+		return resmon_stat_counters(stat).total;
+	case RESMON_RECON_RESOURCE_KVDL:
+		break;
+	}
+	return resmon_stat_kvdl_frag(stat).used;
+}
+
+/* Only the KVD total can be rebased. Fragmentation of KVD linear follows
+ * from where the entries are, which an offset can not express.
+ */
+static bool resmon_recon_can_rebase(enum resmon_recon_resource resource)
+{
+	return resource == RESMON_RECON_RESOURCE_KVD;
+}
+
+static void resmon_recon_act(const struct resmon_recon_config *config,
+			     struct resmon_dev *dev,
+			     enum resmon_recon_resource resource)
+{
+	struct resmon_recon_state *state = &dev->recon[resource];
+
+	if (config->action == RESMON_RECON_ACTION_REBASE &&
+	    resmon_recon_can_rebase(resource)) {
+		syslog(LOG_NOTICE, "%s/%s: Rebasing %s by %" PRId64 " entries to the devlink occupancy of %" PRIu64,
+		       dev->bus_name, dev->dev_name,
+		       resmon_recon_resource_names[resource], -state->drift,
+		       state->occupancy);
+		resmon_stat_counters_rebase(dev->stat, -state->drift);
+		state->rebases++;
+		state->rebase_offset -= state->drift;
+		state->accounted = state->occupancy;
+		state->drift = 0;
+		state->over = 0;
+		return;
+	}
+
+	if (state->flagged)
+		return;
+
+	syslog(LOG_WARNING, "%s/%s: %s accounting drifted by %" PRId64 " entries from the devlink occupancy of %" PRIu64,
+	       dev->bus_name, dev->dev_name,
+	       resmon_recon_resource_names[resource], state->drift,
+	       state->occupancy);
+	state->flagged = true;
+}
+
+static void resmon_recon_check_resource(struct resmon_back *back,
+					struct resmon_dev *dev,
+					enum resmon_recon_resource resource)
+{
+	const struct resmon_recon_config *config = &back->recon.config;
+	struct resmon_recon_state *state = &dev->recon[resource];
+	uint64_t occupancy;
+	bool present;
+	char *error;
+	int rc;
+
+	rc = back->cls->get_occupancy(back, dev, resource, &present,
+				      &occupancy, &error);
+	if (rc != 0) {
+		/* Log only the first of a streak of failures. */
+		if (state->present || state->failures == 0)
+			syslog(LOG_ERR, "%s/%s: Failed to get %s occupancy: %s",
+			       dev->bus_name, dev->dev_name,
+			       resmon_recon_resource_names[resource], error);
+		free(error);
+		state->failures++;
+		state->present = false;
+		return;
+	}
+
+	state->checks++;
+	state->present = present;
+	if (!present)
+		return;
+
+	state->occupancy = occupancy;
+	state->accounted = resmon_recon_accounted(dev->stat, resource);
+	state->drift = state->accounted - (int64_t) occupancy;
+
+	if (llabs(state->drift) <= config->threshold) {
+		state->over = 0;
+		state->flagged = false;
+		return;
+	}
+
+	if (++state->over >= config->persist)
+		resmon_recon_act(config, dev, resource);
+}
+
+void resmon_recon_check(struct resmon_back *back, struct resmon_dev *dev)
+{
+	if (back->cls->get_occupancy == NULL)
+		return;
+
+	for (int i = 0; i < resmon_recon_resource_count; i++)
+		resmon_recon_check_resource(back, dev, i);
+}
+
+int resmon_recon_activity(struct resmon_back *back)
+{
+	uint64_t expirations;
+
+	if (read(back->recon.timerfd, &expirations,
+		 sizeof(expirations)) < 0 && errno != EAGAIN) {
+		fprintf(stderr, "Failed to read reconciliation timer: %m\n");
+		return -1;
+	}
+
+	for (size_t i = 0; i < back->num_devs; i++)
+		resmon_recon_check(back, &back->devs[i]);
+	return 0;
+}
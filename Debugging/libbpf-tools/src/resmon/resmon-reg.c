@@ -1,9 +1,11 @@
 // SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
 #include <assert.h>
 #include <endian.h>
+#include <errno.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <time.h>
 
 #include "resmon.h"
 
@@ -30,6 +32,11 @@ struct resmon_reg_emad_tl {
 	int length;
 };
 
+#define RESMON_REG_OP_TLV_R		0x80
+#define RESMON_REG_OP_TLV_METHOD_MASK	0x7F
+#define RESMON_REG_OP_TLV_METHOD_WRITE	2
+#define RESMON_REG_OP_TLV_STATUS_MASK	0x7F
+
 struct resmon_reg_op_tlv {
 	uint16_be_t type_len;
 	uint8_t status;
@@ -83,15 +90,19 @@ struct resmon_reg_ptar {
 	uint16_be_t resv2;
 	uint16_be_t __region_size;
 
+#define resmon_reg_ptar_region_size(reg) (uint16_be_toh((reg)->__region_size))
+
 	uint16_be_t resv3;
 	uint16_be_t __region_id;
 
+#define resmon_reg_ptar_region_id(reg) (uint16_be_toh((reg)->__region_id))
+
 	uint16_be_t resv4;
 	uint8_t __dup_opt;
 	uint8_t __packet_rate;
 
 	uint8_t tcam_region_info[16];
-	uint8_t flexible_keys[16];
+	uint8_t flexible_keys[RESMON_REG_PTAR_KEY_BLOCK_COUNT];
 };
 
 struct resmon_reg_ptce3 {
@@ -188,6 +199,66 @@ struct resmon_reg_rauht {
 	};
 };
 
+struct resmon_reg_ratr {
+	uint8_t __op_v;
+	uint8_t __a;
+	uint16_be_t resv1;
+
+#define resmon_reg_ratr_op(reg) ((reg)->__op_v >> 4)
+
+	uint16_be_t __type;
+	uint16_be_t __adjacency_index_low;
+
+	uint16_be_t resv2;
+	uint16_be_t __egress_rif;
+
+	uint8_t __trap_action;
+	uint8_t adjacency_index_high;
+	uint8_t resv3;
+	uint8_t trap_id;
+
+#define resmon_reg_ratr_adjacency_index(reg) \
+	((uint32_t) (reg)->adjacency_index_high << 16 | \
+	 uint16_be_toh((reg)->__adjacency_index_low))
+
+	uint16_be_t resv4;
+	uint8_t eth_destination_mac[6];
+
+	uint8_t resv5[16];
+
+	uint32_be_t __counter;
+};
+
+struct resmon_reg_sfd_record {
+	uint8_t swid;
+	uint8_t __type_policy_a;
+	uint8_t mac[6];
+
+	uint16_be_t __sub_port;
+	uint16_be_t __fid;
+
+#define resmon_reg_sfd_record_fid(rec) (uint16_be_toh((rec)->__fid))
+
+	uint32_be_t __action_port;
+};
+
+struct resmon_reg_sfd {
+	uint8_t swid;
+	uint8_t resv1[3];
+
+	uint8_t __op;
+	uint8_t __record_locator[3];
+
+#define resmon_reg_sfd_op(reg) ((reg)->__op >> 6)
+
+	uint8_t resv2[3];
+	uint8_t num_rec;
+
+	uint32_be_t resv3;
+
+	struct resmon_reg_sfd_record records[64];
+};
+
 static struct resmon_reg_emad_tl
 resmon_reg_emad_decode_tl(uint16_be_t type_len_be)
 {
@@ -216,32 +287,107 @@ resmon_reg_emad_decode_tl(uint16_be_t type_len_be)
 		RESMON_REG_PULL(size, __payload, __payload_len);	\
 	})
 
-static void resmon_reg_err_payload_truncated(char **error)
+/* Errors are reported both as a message and as one of the classes in
+ * RESMON_REG_ERRORS, which resmon_stat accounts.
+ */
+static void resmon_reg_err_payload_truncated(enum resmon_reg_error *perr,
+					     char **error)
 {
+	*perr = RESMON_REG_ERROR_TRUNCATED;
 	resmon_fmterr(error, "EMAD malformed: Payload truncated");
 }
 
-static int resmon_reg_insert_rc(int rc, char **error)
+static void resmon_reg_err_inconsistent(enum resmon_reg_error *perr,
+					char **error)
+{
+	*perr = RESMON_REG_ERROR_MALFORMED;
+	resmon_fmterr(error, "EMAD malformed: Inconsistent register");
+}
+
+static enum resmon_reg_outcome resmon_reg_insert_rc(int rc,
+						    enum resmon_reg_error *perr,
+						    char **error)
 {
 	if (rc != 0) {
+		*perr = RESMON_REG_ERROR_INSERT_FAILED;
 		resmon_fmterr(error, "Insert failed");
-		return -1;
+		return RESMON_REG_OUTCOME_ERROR;
 	}
-	return 0;
+	return RESMON_REG_OUTCOME_PROCESSED;
 }
 
-static int resmon_reg_delete_rc(int rc, char **error)
+/* Deletes only fail for entries that resmon does not know about. */
+static enum resmon_reg_outcome resmon_reg_delete_rc(int rc,
+						    enum resmon_reg_error *perr,
+						    char **error)
 {
 	if (rc != 0) {
+		*perr = RESMON_REG_ERROR_DELETE_MISSING;
 		resmon_fmterr(error, "Delete failed");
-		return -1;
+		return RESMON_REG_OUTCOME_ERROR;
 	}
-	return 0;
+	return RESMON_REG_OUTCOME_PROCESSED;
+}
+
+/* KVD cost of the entries that the registers write. The "plan" RPC uses
+ * the same functions to estimate the cost of entries yet to be written.
+ */
+
+struct resmon_stat_kvd_alloc resmon_reg_ralue_kvd_alloc(bool ipv6,
+							uint8_t prefix_len)
+{
+	return (struct resmon_stat_kvd_alloc) {
+		.slots = prefix_len <= 64 ? 1 : 2,
+		.counter = ipv6 ? RESMON_COUNTER_LPM_IPV6
+				: RESMON_COUNTER_LPM_IPV4,
+	};
+}
+
+struct resmon_stat_kvd_alloc resmon_reg_ptar_kvd_alloc(size_t nkeys)
+{
+	return (struct resmon_stat_kvd_alloc) {
+		.slots = nkeys >= 12 ? 4 :
+			 nkeys >= 4  ? 2 : 1,
+		.counter = RESMON_COUNTER_ATCAM,
+	};
+}
+
+struct resmon_stat_kvd_alloc resmon_reg_pefa_kvd_alloc(void)
+{
+	return (struct resmon_stat_kvd_alloc) {
+		.slots = 1,
+		.counter = RESMON_COUNTER_ACTSET,
+	};
+}
+
+struct resmon_stat_kvd_alloc resmon_reg_rauht_kvd_alloc(bool ipv6)
+{
+	return (struct resmon_stat_kvd_alloc) {
+		.slots = ipv6 ? 2 : 1,
+		.counter = ipv6 ? RESMON_COUNTER_HOSTTAB_IPV6
+				: RESMON_COUNTER_HOSTTAB_IPV4,
+	};
+}
+
+struct resmon_stat_kvd_alloc resmon_reg_ratr_kvd_alloc(void)
+{
+	return (struct resmon_stat_kvd_alloc) {
+		.slots = 1,
+		.counter = RESMON_COUNTER_ADJ,
+	};
 }
 
-static int resmon_reg_handle_ralue(struct resmon_stat *stat,
-				   const uint8_t *payload, size_t payload_len,
-				   char **error)
+struct resmon_stat_kvd_alloc resmon_reg_sfd_kvd_alloc(void)
+{
+	return (struct resmon_stat_kvd_alloc) {
+		.slots = 1,
+		.counter = RESMON_COUNTER_FDB,
+	};
+}
+
+static enum resmon_reg_outcome
+resmon_reg_handle_ralue(struct resmon_stat *stat, const void *payload,
+			enum resmon_reg_error *perr, char **error)
 {
 	enum mlxsw_reg_ralxx_protocol protocol;
 	const struct resmon_reg_ralue *reg;
@@ -252,13 +398,19 @@ static int resmon_reg_handle_ralue(struct resmon_stat *stat,
 	bool ipv6;
 	int rc;
 
-	reg = RESMON_REG_READ(sizeof(*reg), payload, payload_len);
+	reg = payload;
 
 	protocol = resmon_reg_ralue_protocol(reg);
 	prefix_len = reg->prefix_len;
 	virtual_router = resmon_reg_ralue_virtual_router(reg);
 
 	ipv6 = protocol == MLXSW_REG_RALXX_PROTOCOL_IPV6;
+	if (prefix_len > (ipv6 ? 128 : 32)) {
+		*perr = RESMON_REG_ERROR_MALFORMED;
+		resmon_fmterr(error, "Invalid prefix length %d", prefix_len);
+		return RESMON_REG_OUTCOME_ERROR;
+	}
+
 	if (ipv6)
 		memcpy(dip.dip, reg->dip6, sizeof(reg->dip6));
 	else
@@ -267,21 +419,13 @@ static int resmon_reg_handle_ralue(struct resmon_stat *stat,
 	if (resmon_reg_ralue_op(reg) == MLXSW_REG_RALUE_OP_WRITE_DELETE) {
 		rc = resmon_stat_ralue_delete(stat, protocol, prefix_len,
 					      virtual_router, dip);
-		return resmon_reg_delete_rc(rc, error);
+		return resmon_reg_delete_rc(rc, perr, error);
 	}
 
-	kvda = (struct resmon_stat_kvd_alloc) {
-		.slots = prefix_len <= 64 ? 1 : 2,
-		.counter = ipv6 ? RESMON_COUNTER_LPM_IPV6
-				: RESMON_COUNTER_LPM_IPV4,
-	};
+	kvda = resmon_reg_ralue_kvd_alloc(ipv6, prefix_len);
 	rc = resmon_stat_ralue_update(stat, protocol, prefix_len,
 				      virtual_router, dip, kvda);
-	return resmon_reg_insert_rc(rc, error);
-
-oob:
-	resmon_reg_err_payload_truncated(error);
-	return -1;
+	return resmon_reg_insert_rc(rc, perr, error);
 }
 
 static struct resmon_stat_kvd_alloc
@@ -293,57 +437,82 @@ resmon_reg_ptar_get_kvd_alloc(const struct resmon_reg_ptar *reg)
 		if (reg->flexible_keys[i])
 			nkeys++;
 
-	return (struct resmon_stat_kvd_alloc) {
-		.slots = nkeys >= 12 ? 4 :
-			 nkeys >= 4  ? 2 : 1,
-		.counter = RESMON_COUNTER_ATCAM,
-	};
+	return resmon_reg_ptar_kvd_alloc(nkeys);
 }
 
-static int resmon_reg_handle_ptar(struct resmon_stat *stat,
-				  const uint8_t *payload, size_t payload_len,
-				  char **error)
+static enum resmon_reg_outcome
+resmon_reg_handle_ptar(struct resmon_stat *stat, const void *payload,
+		       enum resmon_reg_error *perr, char **error)
 {
 	struct resmon_stat_tcam_region_info tcam_region_info;
 	struct resmon_stat_kvd_alloc kvd_alloc;
 	const struct resmon_reg_ptar *reg;
 	int rc;
 
-	reg = RESMON_REG_READ(sizeof(*reg), payload, payload_len);
+	reg = payload;
 
 	switch (reg->key_type) {
 	case MLXSW_REG_PTAR_KEY_TYPE_FLEX:
 	case MLXSW_REG_PTAR_KEY_TYPE_FLEX2:
 		break;
 	default:
-		return 0;
+		return RESMON_REG_OUTCOME_IGNORED;
 	}
 
 	memcpy(tcam_region_info.tcam_region_info, reg->tcam_region_info,
 	       sizeof(tcam_region_info.tcam_region_info));
 
+	/* The EMAD is a response, so region size is the actual size of the
+	 * region, which may be larger than the requested one.
+	 */
 	switch (resmon_reg_ptar_op(reg)) {
-	case MLXSW_REG_PTAR_OP_RESIZE:
 	case MLXSW_REG_PTAR_OP_TEST:
 	default:
-		return 0;
+		return RESMON_REG_OUTCOME_IGNORED;
 	case MLXSW_REG_PTAR_OP_ALLOC:
 		kvd_alloc = resmon_reg_ptar_get_kvd_alloc(reg);
-		rc = resmon_stat_ptar_alloc(stat, tcam_region_info, kvd_alloc);
-		return resmon_reg_insert_rc(rc, error);
+		rc = resmon_stat_ptar_alloc(stat, tcam_region_info,
+					    resmon_reg_ptar_region_id(reg),
+					    resmon_reg_ptar_region_size(reg),
+					    kvd_alloc);
+		return resmon_reg_insert_rc(rc, perr, error);
+	case MLXSW_REG_PTAR_OP_RESIZE:
+		rc = resmon_stat_ptar_resize(stat, tcam_region_info,
+					     resmon_reg_ptar_region_size(reg));
+		return resmon_reg_insert_rc(rc, perr, error);
 	case MLXSW_REG_PTAR_OP_FREE:
 		rc = resmon_stat_ptar_free(stat, tcam_region_info);
-		return resmon_reg_delete_rc(rc, error);
+		return resmon_reg_delete_rc(rc, perr, error);
 	}
+}
 
-oob:
-	resmon_reg_err_payload_truncated(error);
-	return -1;
+static enum resmon_reg_outcome
+resmon_reg_ptce3_rc(int rc, bool insert, enum resmon_reg_error *perr,
+		    char **error)
+{
+	switch (rc) {
+	case -EINVAL:
+		*perr = RESMON_REG_ERROR_MALFORMED;
+		resmon_fmterr(error, "EMAD malformed: eRP ID out of range");
+		return RESMON_REG_OUTCOME_ERROR;
+	case -ENOENT:
+		*perr = RESMON_REG_ERROR_UNKNOWN_REGION;
+		resmon_fmterr(error, "Rule in an unknown TCAM region");
+		return RESMON_REG_OUTCOME_ERROR;
+	case -ERANGE:
+		*perr = RESMON_REG_ERROR_REGION_UNDERFLOW;
+		resmon_fmterr(error, "TCAM region usage underflow");
+		return RESMON_REG_OUTCOME_ERROR;
+	}
+
+	if (insert)
+		return resmon_reg_insert_rc(rc, perr, error);
+	return resmon_reg_delete_rc(rc, perr, error);
 }
 
-static int resmon_reg_handle_ptce3(struct resmon_stat *stat,
-				   const uint8_t *payload, size_t payload_len,
-				   char **error)
+static enum resmon_reg_outcome
+resmon_reg_handle_ptce3(struct resmon_stat *stat, const void *payload,
+			enum resmon_reg_error *perr, char **error)
 {
 	struct resmon_stat_tcam_region_info tcam_region_info;
 	struct resmon_stat_flex2_key_blocks key_blocks;
@@ -351,14 +520,14 @@ static int resmon_reg_handle_ptce3(struct resmon_stat *stat,
 	const struct resmon_reg_ptce3 *reg;
 	int rc;
 
-	reg = RESMON_REG_READ(sizeof(*reg), payload, payload_len);
+	reg = payload;
 
 	switch (resmon_reg_ptce3_op(reg)) {
 	case MLXSW_REG_PTCE3_OP_WRITE_WRITE:
 	case MLXSW_REG_PTCE3_OP_WRITE_UPDATE:
 		break;
 	default:
-		return 0;
+		return RESMON_REG_OUTCOME_IGNORED;
 	}
 
 	memcpy(tcam_region_info.tcam_region_info, reg->tcam_region_info,
@@ -369,7 +538,7 @@ static int resmon_reg_handle_ptce3(struct resmon_stat *stat,
 	if (resmon_reg_ptce3_v(reg)) {
 		rc = resmon_stat_ptar_get(stat, tcam_region_info, &kvd_alloc);
 		if (rc != 0)
-			return resmon_reg_insert_rc(rc, error);
+			return resmon_reg_ptce3_rc(-ENOENT, true, perr, error);
 
 		rc = resmon_stat_ptce3_alloc(stat, tcam_region_info,
 					     &key_blocks, reg->delta_mask,
@@ -377,7 +546,7 @@ static int resmon_reg_handle_ptce3(struct resmon_stat *stat,
 					     resmon_reg_ptce3_delta_start(reg),
 					     resmon_reg_ptce3_erp_id(reg),
 					     kvd_alloc);
-		return resmon_reg_insert_rc(rc, error);
+		return resmon_reg_ptce3_rc(rc, true, perr, error);
 	}
 
 	rc = resmon_stat_ptce3_free(stat, tcam_region_info,
@@ -385,33 +554,22 @@ static int resmon_reg_handle_ptce3(struct resmon_stat *stat,
 				    reg->delta_value,
 				    resmon_reg_ptce3_delta_start(reg),
 				    resmon_reg_ptce3_erp_id(reg));
-	return resmon_reg_delete_rc(rc, error);
-
-oob:
-	resmon_reg_err_payload_truncated(error);
-	return -1;
+	return resmon_reg_ptce3_rc(rc, false, perr, error);
 }
 
-static int resmon_reg_handle_pefa(struct resmon_stat *stat,
-				  const uint8_t *payload, size_t payload_len,
-				  char **error)
+static enum resmon_reg_outcome
+resmon_reg_handle_pefa(struct resmon_stat *stat, const void *payload,
+		       enum resmon_reg_error *perr, char **error)
 {
-	struct resmon_stat_kvd_alloc kvd_alloc = {
-		.slots = 1,
-		.counter = RESMON_COUNTER_ACTSET,
-	};
+	struct resmon_stat_kvd_alloc kvd_alloc = resmon_reg_pefa_kvd_alloc();
 	const struct resmon_reg_pefa *reg;
 	int rc;
 
-	reg = RESMON_REG_READ(sizeof(*reg), payload, payload_len);
+	reg = payload;
 
 	rc = resmon_stat_kvdl_alloc(stat, resmon_reg_pefa_index(reg),
 				    kvd_alloc);
-	return resmon_reg_insert_rc(rc, error);
-
-oob:
-	resmon_reg_err_payload_truncated(error);
-	return -1;
+	return resmon_reg_insert_rc(rc, perr, error);
 }
 
 static int resmon_reg_handle_iedr_record(struct resmon_stat *stat,
@@ -422,6 +580,9 @@ static int resmon_reg_handle_iedr_record(struct resmon_stat *stat,
 	uint32_t size;
 
 	switch (record.type) {
+	case 0x21:
+		counter = RESMON_COUNTER_ADJ;
+		break;
 	case 0x23:
 		counter = RESMON_COUNTER_ACTSET;
 		break;
@@ -438,19 +599,19 @@ static int resmon_reg_handle_iedr_record(struct resmon_stat *stat,
 				     });
 }
 
-static int resmon_reg_handle_iedr(struct resmon_stat *stat,
-				  const uint8_t *payload, size_t payload_len,
-				  char **error)
+static enum resmon_reg_outcome
+resmon_reg_handle_iedr(struct resmon_stat *stat, const void *payload,
+		       enum resmon_reg_error *perr, char **error)
 {
 	const struct resmon_reg_iedr *reg;
 	int rc = 0;
 	int rc_1;
 
-	reg = RESMON_REG_READ(sizeof(*reg), payload, payload_len);
+	reg = payload;
 
 	if (reg->num_rec > ARRAY_SIZE(reg->records)) {
-		resmon_fmterr(error, "EMAD malformed: Inconsistent register");
-		return -1;
+		resmon_reg_err_inconsistent(perr, error);
+		return RESMON_REG_OUTCOME_ERROR;
 	}
 
 	for (size_t i = 0; i < reg->num_rec; i++) {
@@ -459,16 +620,12 @@ static int resmon_reg_handle_iedr(struct resmon_stat *stat,
 			rc = rc_1;
 	}
 
-	return resmon_reg_delete_rc(rc, error);
-
-oob:
-	resmon_reg_err_payload_truncated(error);
-	return -1;
+	return resmon_reg_delete_rc(rc, perr, error);
 }
 
-static int resmon_reg_handle_rauht(struct resmon_stat *stat,
-				   const uint8_t *payload, size_t payload_len,
-				   char **error)
+static enum resmon_reg_outcome
+resmon_reg_handle_rauht(struct resmon_stat *stat, const void *payload,
+			enum resmon_reg_error *perr, char **error)
 {
 	enum mlxsw_reg_ralxx_protocol protocol;
 	const struct resmon_reg_rauht *reg;
@@ -478,7 +635,7 @@ static int resmon_reg_handle_rauht(struct resmon_stat *stat,
 	bool ipv6;
 	int rc;
 
-	reg = RESMON_REG_READ(sizeof(*reg), payload, payload_len);
+	reg = payload;
 
 	protocol = resmon_reg_rauht_type(reg);
 	rif = resmon_reg_rauht_rif(reg);
@@ -491,28 +648,145 @@ static int resmon_reg_handle_rauht(struct resmon_stat *stat,
 
 	if (resmon_reg_rauht_op(reg) == MLXSW_REG_RAUHT_OP_WRITE_DELETE) {
 		rc = resmon_stat_rauht_delete(stat, protocol, rif, dip);
-		return resmon_reg_delete_rc(rc, error);
+		return resmon_reg_delete_rc(rc, perr, error);
 	}
 
-	kvda = (struct resmon_stat_kvd_alloc) {
-		.slots = ipv6 ? 2 : 1,
-		.counter = ipv6 ? RESMON_COUNTER_HOSTTAB_IPV6
-				: RESMON_COUNTER_HOSTTAB_IPV4,
-	};
+	kvda = resmon_reg_rauht_kvd_alloc(ipv6);
 	rc = resmon_stat_rauht_update(stat, protocol, rif, dip, kvda);
-	return resmon_reg_insert_rc(rc, error);
+	return resmon_reg_insert_rc(rc, perr, error);
+}
+
+static enum resmon_reg_outcome
+resmon_reg_handle_ratr(struct resmon_stat *stat, const void *payload,
+		       enum resmon_reg_error *perr, char **error)
+{
+	struct resmon_stat_kvd_alloc kvd_alloc = resmon_reg_ratr_kvd_alloc();
+	const struct resmon_reg_ratr *reg;
+	int rc;
+
+	reg = payload;
+
+	switch (resmon_reg_ratr_op(reg)) {
+	case MLXSW_REG_RATR_OP_WRITE_WRITE_ENTRY:
+	case MLXSW_REG_RATR_OP_WRITE_WRITE_ENTRY_ON_ACTIVITY:
+		break;
+	default:
+		return RESMON_REG_OUTCOME_IGNORED;
+	}
+
+	/* Adjacency entries, including the ones that make up ECMP groups,
+	 * are allocated in KVD linear by the driver and only become visible
+	 * here when written. They are released through IEDR.
+	 */
+	rc = resmon_stat_kvdl_alloc(stat, resmon_reg_ratr_adjacency_index(reg),
+				    kvd_alloc);
+	return resmon_reg_insert_rc(rc, perr, error);
+}
+
+static enum resmon_reg_outcome
+resmon_reg_handle_sfd(struct resmon_stat *stat, const void *payload,
+		      enum resmon_reg_error *perr, char **error)
+{
+	struct resmon_stat_kvd_alloc kvd_alloc = resmon_reg_sfd_kvd_alloc();
+	const struct resmon_reg_sfd *reg;
+	bool remove;
+	int rc = 0;
+	int rc_1;
+
+	reg = payload;
+
+	switch (resmon_reg_sfd_op(reg)) {
+	case MLXSW_REG_SFD_OP_WRITE_EDIT:
+		remove = false;
+		break;
+	case MLXSW_REG_SFD_OP_WRITE_REMOVE:
+		remove = true;
+		break;
+	default:
+		return RESMON_REG_OUTCOME_IGNORED;
+	}
+
+	if (reg->num_rec > ARRAY_SIZE(reg->records)) {
+		resmon_reg_err_inconsistent(perr, error);
+		return RESMON_REG_OUTCOME_ERROR;
+	}
+
+	/* Learned and aged-out entries are confirmed by the driver through
+	 * SFD writes as well, so SFD alone covers the whole FDB. The
+	 * response only lists the records that the device accepted.
+	 */
+	for (size_t i = 0; i < reg->num_rec; i++) {
+		const struct resmon_reg_sfd_record *rec = &reg->records[i];
+		uint16_t fid = resmon_reg_sfd_record_fid(rec);
+		struct resmon_stat_mac mac;
+
+		memcpy(mac.mac, rec->mac, sizeof(mac.mac));
+		if (remove)
+			rc_1 = resmon_stat_fdb_delete(stat, mac, fid);
+		else
+			rc_1 = resmon_stat_fdb_update(stat, mac, fid,
+						      kvd_alloc);
+		if (rc_1 != 0)
+			rc = rc_1;
+	}
+
+	if (remove)
+		return resmon_reg_delete_rc(rc, perr, error);
+	return resmon_reg_insert_rc(rc, perr, error);
+}
+
+struct resmon_reg_desc {
+	size_t min_len;
+	enum resmon_reg_outcome (*handle)(struct resmon_stat *stat,
+					  const void *payload,
+					  enum resmon_reg_error *perr,
+					  char **error);
+};
+
+#define RESMON_REG_EXPAND_AS_DESC(NAME, name, ID)			\
+	[RESMON_REG_ ## NAME] = {					\
+		.min_len = sizeof(struct resmon_reg_ ## name),		\
+		.handle = resmon_reg_handle_ ## name,			\
+	},
+
+static const struct resmon_reg_desc resmon_reg_descs[] = {
+	RESMON_REGS(RESMON_REG_EXPAND_AS_DESC)
+};
+
+#undef RESMON_REG_EXPAND_AS_DESC
+
+#define RESMON_REG_EXPAND_AS_CASE(NAME, name, ID)			\
+	case ID:							\
+		return RESMON_REG_ ## NAME;
+
+static int resmon_reg_lookup(uint16_t reg_id)
+{
+	switch (reg_id) {
+	RESMON_REGS(RESMON_REG_EXPAND_AS_CASE)
+	}
 
-oob:
-	resmon_reg_err_payload_truncated(error);
 	return -1;
 }
 
-int resmon_reg_process_emad(struct resmon_stat *stat,
-			    const uint8_t *buf, size_t len, char **error)
+#undef RESMON_REG_EXPAND_AS_CASE
+
+static uint64_t resmon_reg_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int resmon_reg_emad_payload(const uint8_t **pbuf, size_t *plen,
+				   uint16_t *preg_id,
+				   enum resmon_reg_error *perr, char **error)
 {
 	const struct resmon_reg_reg_tlv_head *reg_tlv;
 	const struct resmon_reg_op_tlv *op_tlv;
 	struct resmon_reg_emad_tl tl;
+	const uint8_t *buf = *pbuf;
+	size_t len = *plen;
 
 	op_tlv = RESMON_REG_READ(sizeof(*op_tlv), buf, len);
 	tl = resmon_reg_emad_decode_tl(op_tlv->type_len);
@@ -529,6 +803,7 @@ int resmon_reg_process_emad(struct resmon_stat *stat,
 	}
 
 	if (tl.type != MLXSW_EMAD_TLV_TYPE_REG) {
+		*perr = RESMON_REG_ERROR_MALFORMED;
 		resmon_fmterr(error, "EMAD malformed: No register");
 		return -1;
 	}
@@ -536,25 +811,81 @@ int resmon_reg_process_emad(struct resmon_stat *stat,
 	/* Get to the register payload. */
 	RESMON_REG_PULL(sizeof(*reg_tlv), buf, len);
 
-	switch (uint16_be_toh(op_tlv->reg_id)) {
-	case MLXSW_REG_RALUE_ID:
-		return resmon_reg_handle_ralue(stat, buf, len, error);
-	case MLXSW_REG_PTAR_ID:
-		return resmon_reg_handle_ptar(stat, buf, len, error);
-	case MLXSW_REG_PTCE3_ID:
-		return resmon_reg_handle_ptce3(stat, buf, len, error);
-	case MLXSW_REG_PEFA_ID:
-		return resmon_reg_handle_pefa(stat, buf, len, error);
-	case MLXSW_REG_IEDR_ID:
-		return resmon_reg_handle_iedr(stat, buf, len, error);
-	case MLXSW_REG_RAUHT_ID:
-		return resmon_reg_handle_rauht(stat, buf, len, error);
-	}
+	*preg_id = uint16_be_toh(op_tlv->reg_id);
+	*pbuf = buf;
+	*plen = len;
+	return 0;
 
-	resmon_fmterr(error, "EMAD malformed: Unknown register");
+oob:
+	resmon_reg_err_payload_truncated(perr, error);
 	return -1;
+}
+
+/* The BPF program only passes on successful responses to writes of the
+ * tracked registers. EMADs from other sources, such as a capture, which
+ * has both directions and all registers, go through the same filter.
+ */
+bool resmon_reg_emad_is_tracked(const uint8_t *buf, size_t len)
+{
+	const struct resmon_reg_op_tlv *op_tlv;
+
+	op_tlv = RESMON_REG_READ(sizeof(*op_tlv), buf, len);
+	if (!(op_tlv->r_method & RESMON_REG_OP_TLV_R))
+		return false;
+	if ((op_tlv->r_method & RESMON_REG_OP_TLV_METHOD_MASK) !=
+	    RESMON_REG_OP_TLV_METHOD_WRITE)
+		return false;
+	if (op_tlv->status & RESMON_REG_OP_TLV_STATUS_MASK)
+		return false;
+
+	return resmon_reg_lookup(uint16_be_toh(op_tlv->reg_id)) >= 0;
 
 oob:
-	resmon_reg_err_payload_truncated(error);
+	return false;
+}
+
+int resmon_reg_process_emad(struct resmon_stat *stat,
+			    const uint8_t *buf, size_t len, char **error)
+{
+	const struct resmon_reg_desc *desc;
+	enum resmon_reg_outcome outcome;
+	const uint8_t *emad = buf;
+	enum resmon_reg_error err;
+	size_t emad_len = len;
+	uint16_t reg_id;
+	uint64_t start;
+	int reg;
+	int rc;
+
+	rc = resmon_reg_emad_payload(&buf, &len, &reg_id, &err, error);
+	if (rc != 0)
+		goto err_unknown;
+
+	reg = resmon_reg_lookup(reg_id);
+	if (reg < 0) {
+		err = RESMON_REG_ERROR_UNKNOWN_REG;
+		resmon_fmterr(error, "EMAD malformed: Unknown register");
+		goto err_unknown;
+	}
+	desc = &resmon_reg_descs[reg];
+
+	start = resmon_reg_now_ns();
+	if (len < desc->min_len) {
+		resmon_reg_err_payload_truncated(&err, error);
+		outcome = RESMON_REG_OUTCOME_ERROR;
+	} else {
+		outcome = desc->handle(stat, buf, &err, error);
+	}
+	resmon_stat_reg_account(stat, reg, outcome,
+				resmon_reg_now_ns() - start);
+	if (outcome != RESMON_REG_OUTCOME_ERROR)
+		return 0;
+
+	resmon_stat_error_account(stat, err, emad, emad_len, *error);
+	return -1;
+
+err_unknown:
+	resmon_stat_reg_account_unknown(stat);
+	resmon_stat_error_account(stat, err, emad, emad_len, *error);
 	return -1;
 }
@@ -36,12 +36,14 @@ static int resmon_ctl_sockaddr(const char *sockdir, struct sockaddr_un *ctl_sa)
 	return resmon_sock_sockaddr(sockdir, "resmon.ctl", ctl_sa);
 }
 
+/* A process may have several clients open, each needs a socket of its own. */
 static int resmon_cli_sockaddr(const char *sockdir, struct sockaddr_un *cli_sa)
 {
+	static unsigned int seq;
 	char *sockname;
 	int rc;
 
-	rc = asprintf(&sockname, "resmon.cli.%d", getpid());
+	rc = asprintf(&sockname, "resmon.cli.%d.%u", getpid(), seq++);
 	if (rc < 0)
 		return rc;
 
@@ -55,7 +57,7 @@ static int resmon_sock_open(struct sockaddr_un sa, struct resmon_sock *sock)
 	int fd;
 	int rc;
 
-	*sock = (struct resmon_sock) { .fd = -1 };
+	*sock = (struct resmon_sock) { .fd = -1, .msg_fd = -1 };
 
 	fd = socket(AF_LOCAL, SOCK_DGRAM, 0);
 	if (fd < 0) {
@@ -76,6 +78,7 @@ static int resmon_sock_open(struct sockaddr_un sa, struct resmon_sock *sock)
 		.fd = fd,
 		.sa = sa,
 		.len = sizeof(sa),
+		.msg_fd = -1,
 	};
 	return 0;
 
@@ -131,6 +134,7 @@ int resmon_sock_open_c(struct resmon_sock *cli,
 		.fd = cli->fd,
 		.sa = ctl_sa,
 		.len = sizeof(peer->sa),
+		.msg_fd = -1,
 	};
 	rc = connect(cli->fd, (struct sockaddr *) &peer->sa, peer->len);
 	if (rc != 0) {
@@ -152,9 +156,19 @@ void resmon_sock_close_c(struct resmon_sock *cli)
 	resmon_sock_close(cli);
 }
 
+/* A descriptor passed along with a message is stored in peer->msg_fd, or -1
+ * if there is none. The caller owns it.
+ */
 int resmon_sock_recv(struct resmon_sock *sock, struct resmon_sock *peer,
 		     char **bufp)
 {
+	union {
+		char buf[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr align;
+	} control;
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	struct iovec iov;
 	ssize_t msgsz;
 	char *buf;
 	ssize_t n;
@@ -164,6 +178,7 @@ int resmon_sock_recv(struct resmon_sock *sock, struct resmon_sock *peer,
 	*peer = (struct resmon_sock) {
 		.fd = sock->fd,
 		.len = sizeof(peer->sa),
+		.msg_fd = -1,
 	};
 	msgsz = recvfrom(sock->fd, NULL, 0, MSG_PEEK | MSG_TRUNC,
 			 (struct sockaddr *) &peer->sa, &peer->len);
@@ -178,7 +193,17 @@ int resmon_sock_recv(struct resmon_sock *sock, struct resmon_sock *peer,
 		return -1;
 	}
 
-	n = recv(sock->fd, buf, msgsz, 0);
+	iov = (struct iovec) {
+		.iov_base = buf,
+		.iov_len = msgsz,
+	};
+	msg = (struct msghdr) {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = control.buf,
+		.msg_controllen = sizeof(control.buf),
+	};
+	n = recvmsg(sock->fd, &msg, MSG_CMSG_CLOEXEC);
 	if (n < 0) {
 		fprintf(stderr, "Failed to receive data on control socket: %m\n");
 		rc = -1;
@@ -186,6 +211,14 @@ int resmon_sock_recv(struct resmon_sock *sock, struct resmon_sock *peer,
 	}
 	buf[n] = '\0';
 
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+	     cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET &&
+		    cmsg->cmsg_type == SCM_RIGHTS &&
+		    cmsg->cmsg_len == CMSG_LEN(sizeof(int)))
+			memcpy(&peer->msg_fd, CMSG_DATA(cmsg), sizeof(int));
+	}
+
 	*bufp = buf;
 	buf = NULL;
 	rc = 0;
@@ -194,3 +227,36 @@ out:
 	free(buf);
 	return rc;
 }
+
+/* Send a message, passing the descriptor fd along with it. */
+int resmon_sock_send_fd(struct resmon_sock *sock, const char *buf,
+			size_t len, int fd)
+{
+	union {
+		char buf[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr align;
+	} control = {};
+	struct iovec iov = {
+		.iov_base = (void *) buf,
+		.iov_len = len,
+	};
+	struct msghdr msg = {
+		.msg_name = &sock->sa,
+		.msg_namelen = sock->len,
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = control.buf,
+		.msg_controllen = sizeof(control.buf),
+	};
+	struct cmsghdr *cmsg;
+	ssize_t n;
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+	n = sendmsg(sock->fd, &msg, 0);
+	return n == len ? 0 : -1;
+}
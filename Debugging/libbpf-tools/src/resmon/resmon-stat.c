@@ -1,7 +1,10 @@
 // SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
 #include <assert.h>
 #include <errno.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <json-c/linkhash.h>
 
 #include "resmon.h"
@@ -26,6 +29,9 @@ static uint64_t resmon_stat_fnv_1(const void *ptr, size_t len)
 	return hash;
 }
 
+/* Keys are hashed and compared as bytes. Padding is therefore spelled out
+ * in each key, so that the compound literals below zero it.
+ */
 struct resmon_stat_key {};
 
 static struct resmon_stat_key *
@@ -57,6 +63,7 @@ struct resmon_stat_ralue_key {
 	struct resmon_stat_key base;
 	enum mlxsw_reg_ralxx_protocol protocol;
 	uint8_t prefix_len;
+	uint8_t resv;
 	uint16_t virtual_router;
 	struct resmon_stat_dip dip;
 };
@@ -78,6 +85,26 @@ resmon_stat_ralue_key(enum mlxsw_reg_ralxx_protocol protocol,
 RESMON_STAT_KEY_HASH_FN(resmon_stat_ralue_hash, struct resmon_stat_ralue_key);
 RESMON_STAT_KEY_EQ_FN(resmon_stat_ralue_eq, struct resmon_stat_ralue_key);
 
+struct resmon_stat_lpm_key {
+	struct resmon_stat_key base;
+	enum mlxsw_reg_ralxx_protocol protocol;
+	uint16_t virtual_router;
+	uint16_t resv;
+};
+
+static struct resmon_stat_lpm_key
+resmon_stat_lpm_key(enum mlxsw_reg_ralxx_protocol protocol,
+		    uint16_t virtual_router)
+{
+	return (struct resmon_stat_lpm_key) {
+		.protocol = protocol,
+		.virtual_router = virtual_router,
+	};
+}
+
+RESMON_STAT_KEY_HASH_FN(resmon_stat_lpm_hash, struct resmon_stat_lpm_key);
+RESMON_STAT_KEY_EQ_FN(resmon_stat_lpm_eq, struct resmon_stat_lpm_key);
+
 struct resmon_stat_ptar_key {
 	struct resmon_stat_key base;
 	struct resmon_stat_tcam_region_info tcam_region_info;
@@ -102,6 +129,7 @@ struct resmon_stat_ptce3_key {
 	uint8_t delta_value;
 	uint16_t delta_start;
 	uint8_t erp_id;
+	uint8_t resv;
 };
 
 static struct resmon_stat_ptce3_key
@@ -147,6 +175,7 @@ struct resmon_stat_rauht_key {
 	struct resmon_stat_key base;
 	enum mlxsw_reg_ralxx_protocol protocol;
 	uint16_t rif;
+	uint16_t resv;
 	struct resmon_stat_dip dip;
 };
 
@@ -165,151 +194,1022 @@ resmon_stat_rauht_key(enum mlxsw_reg_ralxx_protocol protocol,
 RESMON_STAT_KEY_HASH_FN(resmon_stat_rauht_hash, struct resmon_stat_rauht_key);
 RESMON_STAT_KEY_EQ_FN(resmon_stat_rauht_eq, struct resmon_stat_rauht_key);
 
+struct resmon_stat_fdb_key {
+	struct resmon_stat_key base;
+	struct resmon_stat_mac mac;
+	uint16_t fid;
+};
+
+static struct resmon_stat_fdb_key
+resmon_stat_fdb_key(struct resmon_stat_mac mac, uint16_t fid)
+{
+	return (struct resmon_stat_fdb_key) {
+		.mac = mac,
+		.fid = fid,
+	};
+}
+
+RESMON_STAT_KEY_HASH_FN(resmon_stat_fdb_hash, struct resmon_stat_fdb_key);
+RESMON_STAT_KEY_EQ_FN(resmon_stat_fdb_eq, struct resmon_stat_fdb_key);
+
+/* Churn rates are sampled over intervals of one second. Each interval
+ * contributes a fifth of the average, which thus follows changes of rate
+ * within a couple of seconds.
+ */
+#define RESMON_STAT_RATE_INTERVAL_NS	1000000000ULL
+#define RESMON_STAT_RATE_WEIGHT		0.2
+
+struct resmon_stat_churn_meter {
+	struct resmon_stat_churn churn;
+	/* Counts and time at the start of the current interval. */
+	struct resmon_stat_churn_counts mark;
+	uint64_t mark_ns;
+};
+
+/* With age tracking, entries are counted in the age histograms by the
+ * second they were inserted in. Recent seconds have a bucket each, older
+ * ones share buckets of a minute, an hour and a day, and entries older
+ * than that are only counted. Buckets that time moves past the end of
+ * their level are folded into the next level, so the histograms are kept
+ * up to date without visiting the entries.
+ */
+struct resmon_stat_age_level {
+	uint32_t unit_s;
+	uint32_t size;
+	/* Index of the first bucket of the level. */
+	uint32_t first;
+};
+
+static const struct resmon_stat_age_level resmon_stat_age_levels[] = {
+	{ .unit_s = 1,		.size = 60,	.first = 0 },
+	{ .unit_s = 60,		.size = 60,	.first = 60 },
+	{ .unit_s = 3600,	.size = 24,	.first = 120 },
+	{ .unit_s = 86400,	.size = 64,	.first = 144 },
+};
+
+#define RESMON_STAT_AGE_BUCKETS		208
+
+const uint64_t resmon_stat_age_max_s[RESMON_STAT_AGE_BIN_COUNT - 1] = {
+	10, 60, 600, 3600, 6 * 3600, 86400, 7 * 86400, 64 * 86400,
+};
+
+struct resmon_stat_age_hist {
+	/* Each level is a ring of buckets, indexed by the time divided by
+	 * the unit of the level.
+	 */
+	uint64_t buckets[RESMON_STAT_AGE_BUCKETS];
+	uint64_t older;
+	/* The second that the rings are positioned at. */
+	uint32_t now_s;
+};
+
+struct resmon_stat_tab {
+	struct lh_table *lh;
+	struct resmon_stat_churn_meter meter;
+	struct resmon_stat_age_hist ages;
+};
+
+struct resmon_stat_table_desc {
+	const char *name;
+	size_t key_size;
+	lh_hash_fn *hash_fn;
+	lh_equal_fn *equal_fn;
+};
+
+#define RESMON_STAT_TABLE_EXPAND_AS_DESC(NAME, tab)			\
+	[RESMON_STAT_TABLE_ ## NAME] = {				\
+		.name = #tab,						\
+		.key_size = sizeof(struct resmon_stat_ ## tab ## _key),	\
+		.hash_fn = resmon_stat_ ## tab ## _hash,		\
+		.equal_fn = resmon_stat_ ## tab ## _eq,			\
+	},
+
+static const struct resmon_stat_table_desc resmon_stat_table_descs[] = {
+	RESMON_STAT_TABLES(RESMON_STAT_TABLE_EXPAND_AS_DESC)
+};
+
+/* Usage trends are sampled at the rate intervals. The slope of a trend is
+ * both averaged like the churn rates, and fitted by least squares to the
+ * last minute of samples. The fit keeps running sums over the window. The
+ * sums are of times and values relative to an origin that moves to each
+ * new sample, so that they stay small whatever the uptime and usage. They
+ * are recomputed from the window each time it wraps around, so that
+ * rounding errors do not build up either.
+ */
+#define RESMON_STAT_TREND_WINDOW	60
+
+struct resmon_stat_trend_sample {
+	uint64_t time_ns;
+	int64_t value;
+};
+
+struct resmon_stat_trend_meter {
+	struct resmon_stat_trend trend;
+	int64_t mark_value;
+	uint64_t mark_ns;
+	struct resmon_stat_trend_sample samples[RESMON_STAT_TREND_WINDOW];
+	size_t head;
+	size_t count;
+	/* Sums of x, y, x^2 and x*y over the window, where x is the time in
+	 * seconds and y the value, both relative to the origin.
+	 */
+	uint64_t origin_ns;
+	int64_t origin_value;
+	double sx;
+	double sy;
+	double sxx;
+	double sxy;
+};
+
+/* Slots of KVD linear are tracked in a segment tree. Each node describes
+ * the free slots in its range: the run at its start, the run at its end
+ * and the longest run anywhere in it. Leaves past the size of the space
+ * are never free.
+ */
+struct resmon_stat_kvdl_node {
+	uint32_t pre;
+	uint32_t suf;
+	uint32_t best;
+};
+
+struct resmon_stat_kvdl_space {
+	struct resmon_stat_kvdl_node *nodes;
+	/* Number of entries that hold each slot. Entries are keyed by index
+	 * and resource, but all resources share the one index space.
+	 */
+	uint8_t *refs;
+	/* Number of leaves, a power of two. Leaf i is nodes[cap + i]. */
+	uint32_t cap;
+	uint32_t size;
+	/* The size is that of the device, and slots past it are invalid. */
+	bool sized;
+	uint32_t used;
+	uint64_t free_runs;
+	uint64_t run_hist[RESMON_STAT_KVDL_RUN_HIST_COUNT];
+};
+
+#define RESMON_STAT_BURST_LOG_SIZE	64
+/* Peak EMAD rates of bursts are measured over windows of 10ms. */
+#define RESMON_STAT_BURST_WINDOW_NS	10000000ULL
+
+struct resmon_stat_burst_log {
+	/* Closed bursts, the oldest one at head if the log is full. */
+	struct resmon_stat_burst bursts[RESMON_STAT_BURST_LOG_SIZE];
+	size_t head;
+	size_t count;
+	/* The burst in progress, if any. */
+	struct resmon_stat_burst cur;
+	uint64_t last_ns;
+	uint64_t window_start_ns;
+	uint64_t window_emads;
+};
+
+struct resmon_stat_error_ring {
+	/* The oldest sample is at head if the ring is full. */
+	struct resmon_stat_error_sample samples[RESMON_STAT_ERROR_RING_SIZE];
+	size_t head;
+	size_t count;
+};
+
 struct resmon_stat {
+	struct resmon_stat_config config;
+	/* Current time under the manual clock. */
+	uint64_t clock_ns;
 	struct resmon_stat_counters counters;
-	struct lh_table *ralue;
+	/* Correction of the total from reconciliation with devlink. */
+	int64_t total_offset;
+	struct resmon_stat_trend_meter value_trends[resmon_counter_count];
+	struct resmon_stat_trend_meter total_trend;
+	struct resmon_stat_reg_stats reg_stats;
+	struct resmon_stat_churn_meter reg_meters[resmon_reg_count];
+	/* Churn of the EMAD being processed, not yet attributed to its
+	 * register.
+	 */
+	struct resmon_stat_churn_counts pending;
+	struct resmon_stat_tab tables[resmon_stat_table_count];
+	struct lh_table *lpm;
 	struct lh_table *ptar;
-	struct lh_table *ptce3;
-	struct lh_table *kvdl;
-	struct lh_table *rauht;
+	struct resmon_stat_kvdl_space kvdl_space;
+	struct resmon_stat_burst_log burst_log;
+	struct resmon_stat_error_stats error_stats;
+	struct resmon_stat_error_ring error_rings[resmon_reg_error_count];
 };
 
-static struct resmon_stat_kvd_alloc *
-resmon_stat_kvd_alloc_copy(struct resmon_stat_kvd_alloc kvd_alloc)
+/* Times are kept in seconds of the stat clock, which keeps them small. */
+struct resmon_stat_entry_times {
+	uint32_t inserted_s;
+	uint32_t updated_s;
+};
+
+/* Value of the entries in the tables listed in RESMON_STAT_TABLES. */
+struct resmon_stat_entry {
+	struct resmon_stat_kvd_alloc kvd_alloc;
+	uint64_t redundant;
+	/* Only allocated with age tracking. */
+	struct resmon_stat_entry_times times[];
+};
+
+static struct resmon_stat_entry *
+resmon_stat_entry_create(struct resmon_stat_kvd_alloc kvd_alloc, bool timed)
 {
-	struct resmon_stat_kvd_alloc *copy;
+	struct resmon_stat_entry *entry;
 
-	copy = malloc(sizeof(*copy));
-	if (copy == NULL)
+	entry = malloc(sizeof(*entry) +
+		       (timed ? sizeof(entry->times[0]) : 0));
+	if (entry == NULL)
 		return NULL;
 
-	*copy = kvd_alloc;
-	return copy;
+	*entry = (struct resmon_stat_entry) {
+		.kvd_alloc = kvd_alloc,
+	};
+	return entry;
 }
 
-struct resmon_stat *resmon_stat_create(void)
+struct resmon_stat *resmon_stat_create(const struct resmon_stat_config *config)
 {
-	struct lh_table *ralue_tab;
-	struct lh_table *ptce3_tab;
+	struct lh_table *lpm_tab;
 	struct lh_table *ptar_tab;
-	struct lh_table *kvdl_tab;
-	struct lh_table *rauht_tab;
 	struct resmon_stat *stat;
+	int i;
 
-	stat = malloc(sizeof(*stat));
+	stat = calloc(1, sizeof(*stat));
 	if (stat == NULL)
 		return NULL;
 
-	ralue_tab = lh_table_new(1, resmon_stat_entry_free,
-				 resmon_stat_ralue_hash,
-				 resmon_stat_ralue_eq);
-	if (ralue_tab == NULL)
-		goto free_stat;
+	for (i = 0; i < resmon_stat_table_count; i++) {
+		const struct resmon_stat_table_desc *desc =
+			&resmon_stat_table_descs[i];
+
+		stat->tables[i].lh = lh_table_new(1, resmon_stat_entry_free,
+						  desc->hash_fn,
+						  desc->equal_fn);
+		if (stat->tables[i].lh == NULL)
+			goto free_tables;
+	}
+
+	lpm_tab = lh_table_new(1, resmon_stat_entry_free,
+			       resmon_stat_lpm_hash,
+			       resmon_stat_lpm_eq);
+	if (lpm_tab == NULL)
+		goto free_tables;
 
 	ptar_tab = lh_table_new(1, resmon_stat_entry_free,
 				resmon_stat_ptar_hash,
 				resmon_stat_ptar_eq);
 	if (ptar_tab == NULL)
-		goto free_ralue_tab;
-
-	ptce3_tab = lh_table_new(1, resmon_stat_entry_free,
-				 resmon_stat_ptce3_hash,
-				 resmon_stat_ptce3_eq);
-	if (ptce3_tab == NULL)
-		goto free_ptar_tab;
-
-	kvdl_tab = lh_table_new(1, resmon_stat_entry_free,
-				resmon_stat_kvdl_hash,
-				resmon_stat_kvdl_eq);
-	if (kvdl_tab == NULL)
-		goto free_ptce3_tab;
-
-	rauht_tab = lh_table_new(1, resmon_stat_entry_free,
-				 resmon_stat_rauht_hash,
-				 resmon_stat_rauht_eq);
-	if (rauht_tab == NULL)
-		goto free_kvdl_tab;
-
-	*stat = (struct resmon_stat){
-		.ralue = ralue_tab,
-		.ptar = ptar_tab,
-		.ptce3 = ptce3_tab,
-		.kvdl = kvdl_tab,
-		.rauht = rauht_tab,
-	};
+		goto free_lpm_tab;
+
+	stat->config = *config;
+	stat->lpm = lpm_tab;
+	stat->ptar = ptar_tab;
 	return stat;
 
-free_kvdl_tab:
-	lh_table_free(kvdl_tab);
-free_ptce3_tab:
-	lh_table_free(ptce3_tab);
-free_ptar_tab:
-	lh_table_free(ptar_tab);
-free_ralue_tab:
-	lh_table_free(ralue_tab);
-free_stat:
+free_lpm_tab:
+	lh_table_free(lpm_tab);
+free_tables:
+	while (i-- > 0)
+		lh_table_free(stat->tables[i].lh);
 	free(stat);
 	return NULL;
 }
 
 void resmon_stat_destroy(struct resmon_stat *stat)
 {
-	lh_table_free(stat->rauht);
-	lh_table_free(stat->kvdl);
-	lh_table_free(stat->ptce3);
+	free(stat->kvdl_space.refs);
+	free(stat->kvdl_space.nodes);
 	lh_table_free(stat->ptar);
-	lh_table_free(stat->ralue);
+	lh_table_free(stat->lpm);
+	for (int i = resmon_stat_table_count - 1; i >= 0; i--)
+		lh_table_free(stat->tables[i].lh);
 	free(stat);
 }
 
-struct resmon_stat_counters resmon_stat_counters(struct resmon_stat *stat)
+int resmon_stat_clock_set(struct resmon_stat *stat, uint64_t now_ns)
 {
-	struct resmon_stat_counters counters = stat->counters;
+	if (!stat->config.manual_clock || now_ns < stat->clock_ns)
+		return -1;
+
+	stat->clock_ns = now_ns;
+	return 0;
+}
+
+static uint64_t resmon_stat_now_ns(struct resmon_stat *stat)
+{
+	struct timespec ts;
+
+	if (stat->config.manual_clock)
+		return stat->clock_ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t resmon_stat_now_s(struct resmon_stat *stat)
+{
+	return resmon_stat_now_ns(stat) / 1000000000ULL;
+}
+
+static uint64_t *resmon_stat_age_bucket(struct resmon_stat_age_hist *hist,
+					uint32_t inserted_s)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(resmon_stat_age_levels); i++) {
+		const struct resmon_stat_age_level *level =
+			&resmon_stat_age_levels[i];
+		uint64_t k = inserted_s / level->unit_s;
+
+		if (k + level->size > hist->now_s / level->unit_s)
+			return &hist->buckets[level->first + k % level->size];
+	}
+	return &hist->older;
+}
+
+static void resmon_stat_age_advance(struct resmon_stat_age_hist *hist,
+				    uint32_t now_s)
+{
+	uint32_t then_s = hist->now_s;
+
+	if (now_s <= then_s)
+		return;
+	hist->now_s = now_s;
+
+	/* Coarser levels go first, so that the buckets that a finer level
+	 * folds into them are already vacated.
+	 */
+	for (size_t i = ARRAY_SIZE(resmon_stat_age_levels); i-- > 0; ) {
+		const struct resmon_stat_age_level *level =
+			&resmon_stat_age_levels[i];
+		int64_t then_k = then_s / level->unit_s;
+		int64_t now_k = now_s / level->unit_s;
+		int64_t first_k = then_k + 1 - level->size;
+
+		if (first_k < 0)
+			first_k = 0;
+		for (int64_t k = first_k;
+		     k <= then_k && k <= now_k - level->size; k++) {
+			uint64_t *bucket;
+			uint64_t count;
+
+			bucket = &hist->buckets[level->first + k % level->size];
+			count = *bucket;
+			*bucket = 0;
+			if (count != 0)
+				*resmon_stat_age_bucket(hist,
+							k * level->unit_s) +=
+					count;
+		}
+	}
+}
+
+static void resmon_stat_age_insert(struct resmon_stat_age_hist *hist,
+				   uint32_t now_s)
+{
+	resmon_stat_age_advance(hist, now_s);
+	(*resmon_stat_age_bucket(hist, now_s))++;
+}
+
+static void resmon_stat_age_delete(struct resmon_stat_age_hist *hist,
+				   uint32_t now_s, uint32_t inserted_s)
+{
+	resmon_stat_age_advance(hist, now_s);
+	(*resmon_stat_age_bucket(hist, inserted_s))--;
+}
+
+static int64_t resmon_stat_counters_total(const struct resmon_stat *stat)
+{
+	int64_t total = stat->total_offset;
 
 	for (size_t i = 0; i < resmon_counter_count; i++)
-		counters.total += counters.values[i];
+		total += stat->counters.values[i];
 
+	return total;
+}
+
+struct resmon_stat_counters resmon_stat_counters(struct resmon_stat *stat)
+{
+	struct resmon_stat_counters counters = stat->counters;
+
+	counters.total = resmon_stat_counters_total(stat);
 	return counters;
 }
 
-static void resmon_stat_counter_inc(struct resmon_stat *stat,
-				    struct resmon_stat_kvd_alloc kvd_alloc)
+/* Fold a change observed over num_intervals intervals into a rate
+ * average. The change is taken to be spread evenly.
+ */
+static double resmon_stat_rate_update(double rate, double delta,
+				      uint64_t num_intervals)
 {
-	stat->counters.values[kvd_alloc.counter] += kvd_alloc.slots;
+	double sample = delta / num_intervals;
+	double keep = 1;
+
+	for (uint64_t i = 0; i < num_intervals && keep > 1e-9; i++)
+		keep *= 1 - RESMON_STAT_RATE_WEIGHT;
+
+	return sample + (rate - sample) * keep;
 }
 
-static void resmon_stat_counter_dec(struct resmon_stat *stat,
-				    struct resmon_stat_kvd_alloc kvd_alloc)
+static void resmon_stat_meter_tick(struct resmon_stat_churn_meter *meter,
+				   uint64_t now_ns)
 {
-	stat->counters.values[kvd_alloc.counter] -= kvd_alloc.slots;
+	struct resmon_stat_churn_counts *counts = &meter->churn.counts;
+	struct resmon_stat_churn *churn = &meter->churn;
+	uint64_t num_intervals;
+
+	if (meter->mark_ns == 0) {
+		meter->mark_ns = now_ns;
+		return;
+	}
+	if (now_ns - meter->mark_ns < RESMON_STAT_RATE_INTERVAL_NS)
+		return;
+
+	num_intervals = (now_ns - meter->mark_ns) /
+			RESMON_STAT_RATE_INTERVAL_NS;
+	churn->add_rate = resmon_stat_rate_update(churn->add_rate,
+				counts->adds - meter->mark.adds,
+				num_intervals);
+	churn->delete_rate = resmon_stat_rate_update(churn->delete_rate,
+				counts->deletes - meter->mark.deletes,
+				num_intervals);
+	churn->redundant_rate = resmon_stat_rate_update(churn->redundant_rate,
+				counts->redundant - meter->mark.redundant,
+				num_intervals);
+
+	meter->mark = *counts;
+	meter->mark_ns += num_intervals * RESMON_STAT_RATE_INTERVAL_NS;
 }
 
-static int resmon_stat_lh_get(struct lh_table *tab,
-			      const struct resmon_stat_key *orig_key,
-			      struct resmon_stat_kvd_alloc *ret_kvd_alloc)
+static double
+resmon_stat_trend_fit(const struct resmon_stat_trend_meter *meter)
 {
-	const struct resmon_stat_kvd_alloc *kvd_alloc;
-	struct lh_entry *e;
-	long hash;
+	double n = meter->count;
+	double sxx, sxy;
 
-	hash = tab->hash_fn(orig_key);
-	e = lh_table_lookup_entry_w_hash(tab, orig_key, hash);
-	if (e == NULL)
-		return -1;
+	if (meter->count < 2)
+		return 0;
+
+	sxx = meter->sxx - meter->sx * meter->sx / n;
+	sxy = meter->sxy - meter->sx * meter->sy / n;
+	return sxx > 0 ? sxy / sxx : 0;
+}
+
+/* Move the origin of the sums to a later sample. */
+static void resmon_stat_trend_reorigin(struct resmon_stat_trend_meter *meter,
+				       uint64_t origin_ns,
+				       int64_t origin_value)
+{
+	double dx = (double) (origin_ns - meter->origin_ns) / 1e9;
+	double dy = origin_value - meter->origin_value;
+	double n = meter->count;
+
+	meter->sxy += -dx * meter->sy - dy * meter->sx + n * dx * dy;
+	meter->sxx += -2 * dx * meter->sx + n * dx * dx;
+	meter->sx -= n * dx;
+	meter->sy -= n * dy;
+	meter->origin_ns = origin_ns;
+	meter->origin_value = origin_value;
+}
+
+static void resmon_stat_trend_resum(struct resmon_stat_trend_meter *meter)
+{
+	meter->sx = meter->sy = meter->sxx = meter->sxy = 0;
+	for (size_t i = 0; i < meter->count; i++) {
+		const struct resmon_stat_trend_sample *sample;
+		double x, y;
+
+		sample = &meter->samples[(meter->head + i) %
+					 RESMON_STAT_TREND_WINDOW];
+		x = -((double) (meter->origin_ns - sample->time_ns) / 1e9);
+		y = sample->value - meter->origin_value;
+		meter->sx += x;
+		meter->sy += y;
+		meter->sxx += x * x;
+		meter->sxy += x * y;
+	}
+}
+
+static void resmon_stat_trend_push(struct resmon_stat_trend_meter *meter,
+				   uint64_t now_ns, int64_t value)
+{
+	struct resmon_stat_trend_sample *slot;
+
+	/* The new sample is at the origin, and adds nothing to the sums. */
+	resmon_stat_trend_reorigin(meter, now_ns, value);
+
+	if (meter->count == RESMON_STAT_TREND_WINDOW) {
+		const struct resmon_stat_trend_sample *oldest;
+		double x, y;
+
+		oldest = &meter->samples[meter->head];
+		x = -((double) (now_ns - oldest->time_ns) / 1e9);
+		y = oldest->value - value;
+		meter->sx -= x;
+		meter->sy -= y;
+		meter->sxx -= x * x;
+		meter->sxy -= x * y;
+
+		meter->head = (meter->head + 1) % RESMON_STAT_TREND_WINDOW;
+		meter->count--;
+	}
+
+	slot = &meter->samples[(meter->head + meter->count) %
+			       RESMON_STAT_TREND_WINDOW];
+	*slot = (struct resmon_stat_trend_sample) {
+		.time_ns = now_ns,
+		.value = value,
+	};
+	meter->count++;
+
+	if (meter->head == 0 && meter->count == RESMON_STAT_TREND_WINDOW)
+		resmon_stat_trend_resum(meter);
+	meter->trend.window_slope = resmon_stat_trend_fit(meter);
+}
+
+static void resmon_stat_trend_tick(struct resmon_stat_trend_meter *meter,
+				   uint64_t now_ns, int64_t value)
+{
+	uint64_t num_intervals;
+
+	if (meter->count == 0) {
+		meter->mark_ns = now_ns;
+		meter->mark_value = value;
+		resmon_stat_trend_push(meter, now_ns, value);
+		return;
+	}
+	if (now_ns - meter->mark_ns < RESMON_STAT_RATE_INTERVAL_NS)
+		return;
+
+	num_intervals = (now_ns - meter->mark_ns) /
+			RESMON_STAT_RATE_INTERVAL_NS;
+	meter->trend.ew_slope = resmon_stat_rate_update(meter->trend.ew_slope,
+					value - meter->mark_value,
+					num_intervals);
+	resmon_stat_trend_push(meter, now_ns, value);
+
+	meter->mark_value = value;
+	meter->mark_ns += num_intervals * RESMON_STAT_RATE_INTERVAL_NS;
+}
+
+static void resmon_stat_tick(struct resmon_stat *stat, uint64_t now_ns)
+{
+	for (int i = 0; i < resmon_reg_count; i++)
+		resmon_stat_meter_tick(&stat->reg_meters[i], now_ns);
+	for (int i = 0; i < resmon_stat_table_count; i++)
+		resmon_stat_meter_tick(&stat->tables[i].meter, now_ns);
+	for (int i = 0; i < resmon_counter_count; i++)
+		resmon_stat_trend_tick(&stat->value_trends[i], now_ns,
+				       stat->counters.values[i]);
+	resmon_stat_trend_tick(&stat->total_trend, now_ns,
+			       resmon_stat_counters_total(stat));
+}
+
+struct resmon_stat_forecast resmon_stat_forecast(struct resmon_stat *stat)
+{
+	struct resmon_stat_forecast forecast;
+
+	resmon_stat_tick(stat, resmon_stat_now_ns(stat));
+	for (int i = 0; i < resmon_counter_count; i++)
+		forecast.values[i] = stat->value_trends[i].trend;
+	forecast.total = stat->total_trend.trend;
+
+	return forecast;
+}
+
+/* Shift the history of a trend along with a step in its value, so that the
+ * step does not read as usage growing or shrinking.
+ */
+static void resmon_stat_trend_shift(struct resmon_stat_trend_meter *meter,
+				    int64_t offset)
+{
+	meter->mark_value += offset;
+	meter->origin_value += offset;
+	for (size_t i = 0; i < meter->count; i++)
+		meter->samples[(meter->head + i) %
+			       RESMON_STAT_TREND_WINDOW].value += offset;
+}
+
+/* The entries that the offset accounts for are not known, so only the
+ * total is corrected, the individual counters are left as they are. The
+ * trend of the total is brought up to date first, and then shifted by the
+ * offset.
+ */
+void resmon_stat_counters_rebase(struct resmon_stat *stat, int64_t offset)
+{
+	resmon_stat_tick(stat, resmon_stat_now_ns(stat));
+	stat->total_offset += offset;
+	resmon_stat_trend_shift(&stat->total_trend, offset);
+}
+
+static void resmon_stat_burst_close(struct resmon_stat_burst_log *log)
+{
+	size_t tail = (log->head + log->count) % RESMON_STAT_BURST_LOG_SIZE;
+
+	log->cur.ongoing = false;
+	log->bursts[tail] = log->cur;
+	if (log->count < RESMON_STAT_BURST_LOG_SIZE)
+		log->count++;
+	else
+		log->head = (log->head + 1) % RESMON_STAT_BURST_LOG_SIZE;
+}
+
+/* Close the burst in progress if it has been idle for the burst gap. */
+static void resmon_stat_burst_expire(struct resmon_stat *stat,
+				     uint64_t now_ns)
+{
+	struct resmon_stat_burst_log *log = &stat->burst_log;
+
+	if (log->cur.ongoing &&
+	    now_ns - log->last_ns > stat->config.burst_gap_ns)
+		resmon_stat_burst_close(log);
+}
+
+/* Account an EMAD of a register reg, or of no known register if reg is
+ * negative, to the current burst.
+ */
+static void resmon_stat_burst_account(struct resmon_stat *stat, int reg,
+				      uint64_t now_ns)
+{
+	struct resmon_stat_burst_log *log = &stat->burst_log;
+	struct resmon_stat_burst *cur = &log->cur;
+	uint64_t rate;
+
+	resmon_stat_burst_expire(stat, now_ns);
+	if (!cur->ongoing) {
+		*cur = (struct resmon_stat_burst) {
+			.start_ns = now_ns,
+			.ongoing = true,
+		};
+		log->window_start_ns = now_ns;
+		log->window_emads = 0;
+	}
+
+	if (now_ns - log->window_start_ns >= RESMON_STAT_BURST_WINDOW_NS) {
+		log->window_start_ns = now_ns;
+		log->window_emads = 0;
+	}
+	log->window_emads++;
+	rate = log->window_emads * (1000000000ULL /
+				    RESMON_STAT_BURST_WINDOW_NS);
+	if (rate > cur->peak_rate)
+		cur->peak_rate = rate;
+
+	cur->emads++;
+	if (reg >= 0)
+		cur->reg_emads[reg]++;
+	cur->duration_ns = now_ns - cur->start_ns;
+	log->last_ns = now_ns;
+}
+
+int resmon_stat_burst_foreach(struct resmon_stat *stat,
+			      int (*cb)(const struct resmon_stat_burst *,
+					void *priv),
+			      void *priv)
+{
+	struct resmon_stat_burst_log *log = &stat->burst_log;
+	int rc;
+
+	resmon_stat_burst_expire(stat, resmon_stat_now_ns(stat));
+
+	for (size_t i = 0; i < log->count; i++) {
+		rc = cb(&log->bursts[(log->head + i) %
+				     RESMON_STAT_BURST_LOG_SIZE], priv);
+		if (rc != 0)
+			return rc;
+	}
+
+	if (log->cur.ongoing)
+		return cb(&log->cur, priv);
+	return 0;
+}
+
+void resmon_stat_reg_account(struct resmon_stat *stat, enum resmon_reg reg,
+			     enum resmon_reg_outcome outcome,
+			     uint64_t time_ns)
+{
+	struct resmon_stat_reg_stat *reg_stat = &stat->reg_stats.regs[reg];
+	struct resmon_stat_churn_counts *counts =
+		&stat->reg_meters[reg].churn.counts;
+	uint64_t now_ns = resmon_stat_now_ns(stat);
+
+	resmon_stat_tick(stat, now_ns);
+	resmon_stat_burst_account(stat, reg, now_ns);
+	counts->adds += stat->pending.adds;
+	counts->deletes += stat->pending.deletes;
+	counts->redundant += stat->pending.redundant;
+	stat->pending = (struct resmon_stat_churn_counts) {};
+
+	switch (outcome) {
+	case RESMON_REG_OUTCOME_PROCESSED:
+		reg_stat->processed++;
+		break;
+	case RESMON_REG_OUTCOME_IGNORED:
+		reg_stat->ignored++;
+		break;
+	case RESMON_REG_OUTCOME_ERROR:
+		reg_stat->errors++;
+		break;
+	}
+	reg_stat->time_ns += time_ns;
+	resmon_stat_hist_record(&reg_stat->time_hist, time_ns);
+}
+
+void resmon_stat_reg_account_unknown(struct resmon_stat *stat)
+{
+	stat->reg_stats.unknown++;
+	stat->pending = (struct resmon_stat_churn_counts) {};
+	resmon_stat_burst_account(stat, -1, resmon_stat_now_ns(stat));
+}
+
+struct resmon_stat_reg_stats resmon_stat_reg_stats(struct resmon_stat *stat)
+{
+	struct resmon_stat_reg_stats reg_stats = stat->reg_stats;
+
+	resmon_stat_tick(stat, resmon_stat_now_ns(stat));
+	for (int i = 0; i < resmon_reg_count; i++)
+		reg_stats.regs[i].churn = stat->reg_meters[i].churn;
+
+	return reg_stats;
+}
+
+void resmon_stat_error_account(struct resmon_stat *stat,
+			       enum resmon_reg_error error,
+			       const uint8_t *emad, size_t len,
+			       const char *message)
+{
+	struct resmon_stat_error_ring *ring = &stat->error_rings[error];
+	uint64_t count = ++stat->error_stats.counts[error];
+	struct resmon_stat_error_sample *sample;
+	size_t tail;
+
+	if (count > RESMON_STAT_ERROR_RING_SIZE &&
+	    count % RESMON_STAT_ERROR_SAMPLE_RATE != 0)
+		return;
+
+	tail = (ring->head + ring->count) % RESMON_STAT_ERROR_RING_SIZE;
+	if (ring->count < RESMON_STAT_ERROR_RING_SIZE)
+		ring->count++;
+	else
+		ring->head = (ring->head + 1) % RESMON_STAT_ERROR_RING_SIZE;
+
+	sample = &ring->samples[tail];
+	sample->time_ns = resmon_stat_now_ns(stat);
+	sample->len = len;
+	sample->kept_len = len < sizeof(sample->emad) ?
+			   len : sizeof(sample->emad);
+	memcpy(sample->emad, emad, sample->kept_len);
+	snprintf(sample->message, sizeof(sample->message), "%s",
+		 message != NULL ? message : "");
+}
+
+struct resmon_stat_error_stats resmon_stat_error_stats(struct resmon_stat *stat)
+{
+	return stat->error_stats;
+}
+
+int resmon_stat_error_sample_foreach(struct resmon_stat *stat,
+		int (*cb)(enum resmon_reg_error error,
+			  const struct resmon_stat_error_sample *sample,
+			  void *priv),
+		void *priv)
+{
+	for (int i = 0; i < resmon_reg_error_count; i++) {
+		struct resmon_stat_error_ring *ring = &stat->error_rings[i];
+		int rc;
+
+		for (size_t j = 0; j < ring->count; j++) {
+			rc = cb(i, &ring->samples[(ring->head + j) %
+						  RESMON_STAT_ERROR_RING_SIZE],
+				priv);
+			if (rc != 0)
+				return rc;
+		}
+	}
 
-	kvd_alloc = e->v;
-	*ret_kvd_alloc = *kvd_alloc;
 	return 0;
 }
 
+void resmon_stat_hist_record(struct resmon_stat_hist *hist, uint64_t val)
+{
+	size_t bin;
+
+	bin = val > 1 ? 63 - __builtin_clzll(val) : 0;
+	if (bin >= RESMON_STAT_HIST_COUNT)
+		bin = RESMON_STAT_HIST_COUNT - 1;
+	hist->bins[bin]++;
+	hist->count++;
+	hist->sum += val;
+	if (val > hist->max)
+		hist->max = val;
+}
+
+void resmon_stat_hist_add(struct resmon_stat_hist *sum,
+			  const struct resmon_stat_hist *hist)
+{
+	for (size_t i = 0; i < RESMON_STAT_HIST_COUNT; i++)
+		sum->bins[i] += hist->bins[i];
+	sum->count += hist->count;
+	sum->sum += hist->sum;
+	if (hist->max > sum->max)
+		sum->max = hist->max;
+}
+
+void resmon_stat_churn_add(struct resmon_stat_churn *sum,
+			   const struct resmon_stat_churn *churn)
+{
+	sum->counts.adds += churn->counts.adds;
+	sum->counts.deletes += churn->counts.deletes;
+	sum->counts.redundant += churn->counts.redundant;
+	sum->add_rate += churn->add_rate;
+	sum->delete_rate += churn->delete_rate;
+	sum->redundant_rate += churn->redundant_rate;
+}
+
+const char *resmon_stat_table_name(enum resmon_stat_table table)
+{
+	return resmon_stat_table_descs[table].name;
+}
+
+int resmon_stat_table_parse(const char *name, enum resmon_stat_table *table)
+{
+	for (int i = 0; i < resmon_stat_table_count; i++) {
+		if (strcmp(name, resmon_stat_table_descs[i].name) == 0) {
+			*table = i;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+struct resmon_stat_churn resmon_stat_table_churn(struct resmon_stat *stat,
+						 enum resmon_stat_table table)
+{
+	resmon_stat_tick(stat, resmon_stat_now_ns(stat));
+	return stat->tables[table].meter.churn;
+}
+
+/* Keep the max_keys most redundantly written entries in top, sorted by
+ * the number of redundant writes, and return how many were found.
+ */
+size_t resmon_stat_redundant_top(struct resmon_stat *stat,
+				 struct resmon_stat_redundant_key *top,
+				 size_t max_keys)
+{
+	size_t num_keys = 0;
+
+	for (int i = 0; i < resmon_stat_table_count; i++) {
+		struct lh_entry *e;
+
+		lh_foreach(stat->tables[i].lh, e) {
+			const struct resmon_stat_entry *entry = lh_entry_v(e);
+			size_t pos;
+
+			if (entry->redundant == 0)
+				continue;
+			if (num_keys == max_keys &&
+			    (num_keys == 0 ||
+			     entry->redundant <= top[num_keys - 1].redundant))
+				continue;
+
+			if (num_keys < max_keys)
+				num_keys++;
+			for (pos = num_keys - 1;
+			     pos > 0 && top[pos - 1].redundant < entry->redundant;
+			     pos--)
+				top[pos] = top[pos - 1];
+
+			top[pos] = (struct resmon_stat_redundant_key) {
+				.table = i,
+				.key = lh_entry_k(e),
+				.key_size = resmon_stat_table_descs[i].key_size,
+				.redundant = entry->redundant,
+			};
+		}
+	}
+
+	return num_keys;
+}
+
+bool resmon_stat_ages_tracked(const struct resmon_stat *stat)
+{
+	return stat->config.track_ages;
+}
+
+/* A bucket is binned by the age of its oldest possible entry. */
+struct resmon_stat_ages resmon_stat_table_ages(struct resmon_stat *stat,
+					       enum resmon_stat_table table)
+{
+	struct resmon_stat_age_hist *hist = &stat->tables[table].ages;
+	struct resmon_stat_ages ages = {
+		.entries = lh_table_length(stat->tables[table].lh),
+	};
+	size_t bin;
+
+	resmon_stat_age_advance(hist, resmon_stat_now_s(stat));
+
+	for (size_t i = 0; i < ARRAY_SIZE(resmon_stat_age_levels); i++) {
+		const struct resmon_stat_age_level *level =
+			&resmon_stat_age_levels[i];
+		int64_t now_k = hist->now_s / level->unit_s;
+
+		for (int64_t k = now_k; k > now_k - level->size && k >= 0;
+		     k--) {
+			uint64_t count;
+			uint64_t age_s;
+
+			count = hist->buckets[level->first + k % level->size];
+			if (count == 0)
+				continue;
+
+			age_s = hist->now_s - k * level->unit_s;
+			for (bin = 0; bin < ARRAY_SIZE(resmon_stat_age_max_s);
+			     bin++)
+				if (age_s <= resmon_stat_age_max_s[bin])
+					break;
+			ages.counts[bin] += count;
+		}
+	}
+	ages.counts[RESMON_STAT_AGE_BIN_COUNT - 1] += hist->older;
+
+	return ages;
+}
+
+static uint64_t
+resmon_stat_aged_key_age(const struct resmon_stat_aged_key *key, bool by_idle)
+{
+	return by_idle ? key->idle_s : key->age_s;
+}
+
+/* Merge the max_keys entries of the table that were inserted, or with
+ * by_idle last updated, the longest ago into the num_keys that oldest
+ * already holds, sorted from the oldest, and return how many it holds
+ * then.
+ */
+size_t resmon_stat_oldest(struct resmon_stat *stat,
+			  enum resmon_stat_table table, bool by_idle,
+			  struct resmon_stat_aged_key *oldest,
+			  size_t num_keys, size_t max_keys)
+{
+	uint32_t now_s = resmon_stat_now_s(stat);
+	struct lh_entry *e;
+
+	if (!stat->config.track_ages)
+		return num_keys;
+
+	lh_foreach(stat->tables[table].lh, e) {
+		const struct resmon_stat_entry *entry = lh_entry_v(e);
+		struct resmon_stat_aged_key aged = {
+			.table = table,
+			.key = lh_entry_k(e),
+			.key_size = resmon_stat_table_descs[table].key_size,
+			.age_s = now_s - entry->times[0].inserted_s,
+			.idle_s = now_s - entry->times[0].updated_s,
+			.redundant = entry->redundant,
+		};
+		uint64_t age_s = resmon_stat_aged_key_age(&aged, by_idle);
+		size_t pos;
+
+		if (num_keys == max_keys &&
+		    (num_keys == 0 ||
+		     age_s <= resmon_stat_aged_key_age(&oldest[num_keys - 1],
+						       by_idle)))
+			continue;
+
+		if (num_keys < max_keys)
+			num_keys++;
+		for (pos = num_keys - 1;
+		     pos > 0 &&
+		     resmon_stat_aged_key_age(&oldest[pos - 1], by_idle) < age_s;
+		     pos--)
+			oldest[pos] = oldest[pos - 1];
+
+		oldest[pos] = aged;
+	}
+
+	return num_keys;
+}
+
+static void resmon_stat_counter_inc(struct resmon_stat *stat,
+				    struct resmon_stat_kvd_alloc kvd_alloc)
+{
+	stat->counters.values[kvd_alloc.counter] += kvd_alloc.slots;
+}
+
+static void resmon_stat_counter_dec(struct resmon_stat *stat,
+				    struct resmon_stat_kvd_alloc kvd_alloc)
+{
+	stat->counters.values[kvd_alloc.counter] -= kvd_alloc.slots;
+}
+
 static int
 resmon_stat_lh_update_nostats(struct resmon_stat *stat,
-			      struct lh_table *tab,
+			      enum resmon_stat_table table,
 			      const struct resmon_stat_key *orig_key,
 			      size_t orig_key_size,
 			      struct resmon_stat_kvd_alloc orig_kvd_alloc)
 {
-	struct resmon_stat_kvd_alloc *kvd_alloc;
+	struct resmon_stat_churn_counts *counts =
+		&stat->tables[table].meter.churn.counts;
+	struct lh_table *tab = stat->tables[table].lh;
+	struct resmon_stat_entry *entry;
 	struct resmon_stat_key *key;
 	struct lh_entry *e;
 	long hash;
@@ -317,40 +1217,60 @@ resmon_stat_lh_update_nostats(struct resmon_stat *stat,
 
 	hash = tab->hash_fn(orig_key);
 	e = lh_table_lookup_entry_w_hash(tab, orig_key, hash);
-	if (e != NULL)
+	if (e != NULL) {
+		entry = lh_entry_v(e);
+		entry->redundant++;
+		if (stat->config.track_ages)
+			entry->times[0].updated_s = resmon_stat_now_s(stat);
+		counts->redundant++;
+		stat->pending.redundant++;
 		return 1;
+	}
 
 	key = resmon_stat_key_copy(orig_key, orig_key_size);
 	if (key == NULL)
 		return -ENOMEM;
 
-	kvd_alloc = resmon_stat_kvd_alloc_copy(orig_kvd_alloc);
-	if (kvd_alloc == NULL)
+	entry = resmon_stat_entry_create(orig_kvd_alloc,
+					 stat->config.track_ages);
+	if (entry == NULL)
 		goto free_key;
 
-	rc = lh_table_insert_w_hash(tab, key, kvd_alloc, hash, 0);
+	rc = lh_table_insert_w_hash(tab, key, entry, hash, 0);
 	if (rc)
-		goto free_kvd_alloc;
+		goto free_entry;
 
+	if (stat->config.track_ages) {
+		uint32_t now_s = resmon_stat_now_s(stat);
+
+		entry->times[0] = (struct resmon_stat_entry_times) {
+			.inserted_s = now_s,
+			.updated_s = now_s,
+		};
+		resmon_stat_age_insert(&stat->tables[table].ages, now_s);
+	}
+
+	counts->adds++;
+	stat->pending.adds++;
 	return 0;
 
-free_kvd_alloc:
-	free(kvd_alloc);
+free_entry:
+	free(entry);
 free_key:
 	free(key);
 	return -1;
 }
 
 static int resmon_stat_lh_update(struct resmon_stat *stat,
-				 struct lh_table *tab,
+				 enum resmon_stat_table table,
 				 const struct resmon_stat_key *orig_key,
 				 size_t orig_key_size,
 				 struct resmon_stat_kvd_alloc orig_kvd_alloc)
 {
 	int err;
 
-	err = resmon_stat_lh_update_nostats(stat, tab, orig_key, orig_key_size,
-					    orig_kvd_alloc);
+	err = resmon_stat_lh_update_nostats(stat, table, orig_key,
+					    orig_key_size, orig_kvd_alloc);
 	if (err == 1)
 		return 0;
 	if (err != 0)
@@ -361,11 +1281,12 @@ static int resmon_stat_lh_update(struct resmon_stat *stat,
 }
 
 static int resmon_stat_lh_delete_nostats(struct resmon_stat *stat,
-					 struct lh_table *tab,
+					 enum resmon_stat_table table,
 					 const struct resmon_stat_key *orig_key,
 					 struct resmon_stat_kvd_alloc *kvd_alloc)
 {
-	const struct resmon_stat_kvd_alloc *vp;
+	struct lh_table *tab = stat->tables[table].lh;
+	const struct resmon_stat_entry *entry;
 	struct lh_entry *e;
 	long hash;
 	int rc;
@@ -375,21 +1296,28 @@ static int resmon_stat_lh_delete_nostats(struct resmon_stat *stat,
 	if (e == NULL)
 		return -1;
 
-	vp = e->v;
-	*kvd_alloc = *vp;
+	entry = e->v;
+	*kvd_alloc = entry->kvd_alloc;
+	if (stat->config.track_ages)
+		resmon_stat_age_delete(&stat->tables[table].ages,
+				       resmon_stat_now_s(stat),
+				       entry->times[0].inserted_s);
 	rc = lh_table_delete_entry(tab, e);
 	assert(rc == 0);
+
+	stat->tables[table].meter.churn.counts.deletes++;
+	stat->pending.deletes++;
 	return 0;
 }
 
 static int resmon_stat_lh_delete(struct resmon_stat *stat,
-				 struct lh_table *tab,
+				 enum resmon_stat_table table,
 				 const struct resmon_stat_key *orig_key)
 {
 	struct resmon_stat_kvd_alloc kvd_alloc;
 	int err;
 
-	err = resmon_stat_lh_delete_nostats(stat, tab, orig_key, &kvd_alloc);
+	err = resmon_stat_lh_delete_nostats(stat, table, orig_key, &kvd_alloc);
 	if (err != 0)
 		return err;
 
@@ -397,6 +1325,67 @@ static int resmon_stat_lh_delete(struct resmon_stat *stat,
 	return 0;
 }
 
+static struct resmon_stat_lpm_vr *
+resmon_stat_lpm_vr_get(struct resmon_stat *stat,
+		       enum mlxsw_reg_ralxx_protocol protocol,
+		       uint16_t virtual_router)
+{
+	struct resmon_stat_lpm_key key =
+		resmon_stat_lpm_key(protocol, virtual_router);
+	struct resmon_stat_key *key_copy;
+	struct resmon_stat_lpm_vr *vr;
+	struct lh_entry *e;
+	long hash;
+	int rc;
+
+	hash = stat->lpm->hash_fn(&key);
+	e = lh_table_lookup_entry_w_hash(stat->lpm, &key, hash);
+	if (e != NULL)
+		return lh_entry_v(e);
+
+	key_copy = resmon_stat_key_copy(&key.base, sizeof(key));
+	if (key_copy == NULL)
+		return NULL;
+
+	vr = calloc(1, sizeof(*vr));
+	if (vr == NULL)
+		goto free_key;
+
+	vr->protocol = protocol;
+	vr->virtual_router = virtual_router;
+
+	rc = lh_table_insert_w_hash(stat->lpm, key_copy, vr, hash, 0);
+	if (rc)
+		goto free_vr;
+
+	return vr;
+
+free_vr:
+	free(vr);
+free_key:
+	free(key_copy);
+	return NULL;
+}
+
+/* Drop the VR once its last route is gone. */
+static void resmon_stat_lpm_vr_put(struct resmon_stat *stat,
+				   const struct resmon_stat_lpm_vr *vr)
+{
+	struct resmon_stat_lpm_key key =
+		resmon_stat_lpm_key(vr->protocol, vr->virtual_router);
+	struct lh_entry *e;
+	int rc;
+
+	if (vr->routes != 0)
+		return;
+
+	e = lh_table_lookup_entry_w_hash(stat->lpm, &key,
+					 stat->lpm->hash_fn(&key));
+	assert(e != NULL);
+	rc = lh_table_delete_entry(stat->lpm, e);
+	assert(rc == 0);
+}
+
 int resmon_stat_ralue_update(struct resmon_stat *stat,
 			     enum mlxsw_reg_ralxx_protocol protocol,
 			     uint8_t prefix_len,
@@ -407,9 +1396,31 @@ int resmon_stat_ralue_update(struct resmon_stat *stat,
 	struct resmon_stat_ralue_key key =
 		resmon_stat_ralue_key(protocol, prefix_len, virtual_router,
 				      dip);
+	struct resmon_stat_lpm_vr *vr;
+	int rc;
 
-	return resmon_stat_lh_update(stat, stat->ralue,
-				     &key.base, sizeof(key), kvd_alloc);
+	assert(prefix_len < RESMON_STAT_PREFIX_LEN_COUNT);
+
+	/* Get the VR first, so that a failure leaves the route untracked
+	 * rather than missing from the histogram.
+	 */
+	vr = resmon_stat_lpm_vr_get(stat, protocol, virtual_router);
+	if (vr == NULL)
+		return -ENOMEM;
+
+	rc = resmon_stat_lh_update_nostats(stat, RESMON_STAT_TABLE_RALUE,
+					   &key.base, sizeof(key), kvd_alloc);
+	if (rc == 1)
+		return 0;
+	if (rc != 0) {
+		resmon_stat_lpm_vr_put(stat, vr);
+		return rc;
+	}
+
+	resmon_stat_counter_inc(stat, kvd_alloc);
+	vr->prefix_lens[prefix_len]++;
+	vr->routes++;
+	return 0;
 }
 
 int resmon_stat_ralue_delete(struct resmon_stat *stat,
@@ -421,19 +1432,128 @@ int resmon_stat_ralue_delete(struct resmon_stat *stat,
 	struct resmon_stat_ralue_key key =
 		resmon_stat_ralue_key(protocol, prefix_len, virtual_router,
 				      dip);
+	struct resmon_stat_lpm_vr *vr;
+	int rc;
+
+	rc = resmon_stat_lh_delete(stat, RESMON_STAT_TABLE_RALUE, &key.base);
+	if (rc != 0)
+		return rc;
+
+	/* Each tracked route is accounted in its VR, which thus exists. */
+	vr = resmon_stat_lpm_vr_get(stat, protocol, virtual_router);
+	assert(vr != NULL && vr->routes > 0);
+
+	vr->prefix_lens[prefix_len]--;
+	vr->routes--;
+	resmon_stat_lpm_vr_put(stat, vr);
+	return 0;
+}
+
+int resmon_stat_lpm_foreach(struct resmon_stat *stat,
+			    int (*cb)(const struct resmon_stat_lpm_vr *,
+				      void *priv),
+			    void *priv)
+{
+	struct lh_entry *e;
+	int rc;
+
+	lh_foreach(stat->lpm, e) {
+		rc = cb(lh_entry_v(e), priv);
+		if (rc != 0)
+			return rc;
+	}
+
+	return 0;
+}
 
-	return resmon_stat_lh_delete(stat, stat->ralue, &key.base);
+static struct lh_entry *
+resmon_stat_ptar_lookup(struct resmon_stat *stat,
+			const struct resmon_stat_ptar_key *key)
+{
+	return lh_table_lookup_entry_w_hash(stat->ptar, key,
+					    stat->ptar->hash_fn(key));
+}
+
+static struct resmon_stat_ptar_region *
+resmon_stat_ptar_region(struct resmon_stat *stat,
+			struct resmon_stat_tcam_region_info tcam_region_info)
+{
+	struct resmon_stat_ptar_key key =
+		resmon_stat_ptar_key(tcam_region_info);
+	struct lh_entry *e;
+
+	e = resmon_stat_ptar_lookup(stat, &key);
+	if (e == NULL)
+		return NULL;
+
+	return lh_entry_v(e);
 }
 
 int resmon_stat_ptar_alloc(struct resmon_stat *stat,
 			   struct resmon_stat_tcam_region_info tcam_region_info,
+			   uint16_t region_id,
+			   uint16_t region_size,
 			   struct resmon_stat_kvd_alloc kvd_alloc)
 {
 	struct resmon_stat_ptar_key key =
 		resmon_stat_ptar_key(tcam_region_info);
+	struct resmon_stat_ptar_region *region;
+	struct resmon_stat_key *key_copy;
+	int rc;
+
+	region = resmon_stat_ptar_region(stat, tcam_region_info);
+	if (region != NULL) {
+		/* The region is known already. Refresh its parameters, but
+		 * keep the rule count, the rules are still there.
+		 */
+		region->region_id = region_id;
+		region->size = region_size;
+		region->kvd_alloc = kvd_alloc;
+		return 0;
+	}
+
+	key_copy = resmon_stat_key_copy(&key.base, sizeof(key));
+	if (key_copy == NULL)
+		return -ENOMEM;
 
-	return resmon_stat_lh_update_nostats(stat, stat->ptar,
-					     &key.base, sizeof(key), kvd_alloc);
+	region = malloc(sizeof(*region));
+	if (region == NULL)
+		goto free_key;
+
+	*region = (struct resmon_stat_ptar_region) {
+		.tcam_region_info = tcam_region_info,
+		.kvd_alloc = kvd_alloc,
+		.region_id = region_id,
+		.size = region_size,
+	};
+
+	rc = lh_table_insert_w_hash(stat->ptar, key_copy, region,
+				    stat->ptar->hash_fn(&key), 0);
+	if (rc)
+		goto free_region;
+
+	return 0;
+
+free_region:
+	free(region);
+free_key:
+	free(key_copy);
+	return -1;
+}
+
+int resmon_stat_ptar_resize(struct resmon_stat *stat,
+			    struct resmon_stat_tcam_region_info tcam_region_info,
+			    uint16_t region_size)
+{
+	struct resmon_stat_ptar_region *region;
+
+	region = resmon_stat_ptar_region(stat, tcam_region_info);
+	if (region == NULL)
+		return -1;
+
+	region->size = region_size;
+	region->resizes++;
+	return 0;
 }
 
 int resmon_stat_ptar_free(struct resmon_stat *stat,
@@ -441,20 +1561,47 @@ int resmon_stat_ptar_free(struct resmon_stat *stat,
 {
 	struct resmon_stat_ptar_key key =
 		resmon_stat_ptar_key(tcam_region_info);
-	struct resmon_stat_kvd_alloc kvd_alloc;
+	struct lh_entry *e;
+	int rc;
+
+	e = resmon_stat_ptar_lookup(stat, &key);
+	if (e == NULL)
+		return -1;
 
-	return resmon_stat_lh_delete_nostats(stat, stat->ptar, &key.base,
-					     &kvd_alloc);
+	rc = lh_table_delete_entry(stat->ptar, e);
+	assert(rc == 0);
+	return 0;
 }
 
 int resmon_stat_ptar_get(struct resmon_stat *stat,
 			 struct resmon_stat_tcam_region_info tcam_region_info,
 			 struct resmon_stat_kvd_alloc *ret_kvd_alloc)
 {
-	struct resmon_stat_ptar_key key =
-		resmon_stat_ptar_key(tcam_region_info);
+	struct resmon_stat_ptar_region *region;
+
+	region = resmon_stat_ptar_region(stat, tcam_region_info);
+	if (region == NULL)
+		return -1;
+
+	*ret_kvd_alloc = region->kvd_alloc;
+	return 0;
+}
+
+int resmon_stat_ptar_foreach(struct resmon_stat *stat,
+			     int (*cb)(const struct resmon_stat_ptar_region *,
+				       void *priv),
+			     void *priv)
+{
+	struct lh_entry *e;
+	int rc;
 
-	return resmon_stat_lh_get(stat->ptar, &key.base, ret_kvd_alloc);
+	lh_foreach(stat->ptar, e) {
+		rc = cb(lh_entry_v(e), priv);
+		if (rc != 0)
+			return rc;
+	}
+
+	return 0;
 }
 
 int
@@ -470,9 +1617,38 @@ resmon_stat_ptce3_alloc(struct resmon_stat *stat,
 	struct resmon_stat_ptce3_key key =
 		resmon_stat_ptce3_key(tcam_region_info, key_blocks, delta_mask,
 				      delta_value, delta_start, erp_id);
+	struct resmon_stat_ptar_region *region;
+	int rc;
 
-	return resmon_stat_lh_update(stat, stat->ptce3,
-				     &key.base, sizeof(key), kvd_alloc);
+	if (erp_id >= RESMON_STAT_ERP_COUNT)
+		return -EINVAL;
+
+	/* Rules are only accounted in regions that resmon knows. */
+	region = resmon_stat_ptar_region(stat, tcam_region_info);
+	if (region == NULL)
+		return -ENOENT;
+
+	rc = resmon_stat_lh_update_nostats(stat, RESMON_STAT_TABLE_PTCE3,
+					   &key.base, sizeof(key), kvd_alloc);
+	if (rc == 1)
+		return 0;
+	if (rc != 0)
+		return rc;
+
+	resmon_stat_counter_inc(stat, kvd_alloc);
+
+	region->used++;
+	region->erps[erp_id]++;
+	region->deltas[__builtin_popcount(delta_mask)]++;
+	return 0;
+}
+
+static bool resmon_stat_region_count_dec(uint64_t *count)
+{
+	if (*count == 0)
+		return false;
+	(*count)--;
+	return true;
 }
 
 int
@@ -487,8 +1663,29 @@ resmon_stat_ptce3_free(struct resmon_stat *stat,
 	struct resmon_stat_ptce3_key key =
 		resmon_stat_ptce3_key(tcam_region_info, key_blocks, delta_mask,
 				      delta_value, delta_start, erp_id);
+	struct resmon_stat_ptar_region *region;
+	bool consistent;
+	int rc;
 
-	return resmon_stat_lh_delete(stat, stat->ptce3, &key.base);
+	if (erp_id >= RESMON_STAT_ERP_COUNT)
+		return -EINVAL;
+
+	rc = resmon_stat_lh_delete(stat, RESMON_STAT_TABLE_PTCE3, &key.base);
+	if (rc != 0)
+		return rc;
+
+	/* The rule is gone either way. The errors below only report that
+	 * the region accounting did not match it.
+	 */
+	region = resmon_stat_ptar_region(stat, tcam_region_info);
+	if (region == NULL)
+		return -ENOENT;
+
+	consistent = resmon_stat_region_count_dec(&region->used);
+	consistent &= resmon_stat_region_count_dec(&region->erps[erp_id]);
+	consistent &= resmon_stat_region_count_dec(
+			&region->deltas[__builtin_popcount(delta_mask)]);
+	return consistent ? 0 : -ERANGE;
 }
 
 int resmon_stat_rauht_update(struct resmon_stat *stat,
@@ -500,7 +1697,7 @@ int resmon_stat_rauht_update(struct resmon_stat *stat,
 	struct resmon_stat_rauht_key key =
 		resmon_stat_rauht_key(protocol, rif, dip);
 
-	return resmon_stat_lh_update(stat, stat->rauht,
+	return resmon_stat_lh_update(stat, RESMON_STAT_TABLE_RAUHT,
 				     &key.base, sizeof(key), kvd_alloc);
 }
 
@@ -512,21 +1709,299 @@ int resmon_stat_rauht_delete(struct resmon_stat *stat,
 	struct resmon_stat_rauht_key key =
 		resmon_stat_rauht_key(protocol, rif, dip);
 
-	return resmon_stat_lh_delete(stat, stat->rauht, &key.base);
+	return resmon_stat_lh_delete(stat, RESMON_STAT_TABLE_RAUHT, &key.base);
+}
+
+int resmon_stat_fdb_update(struct resmon_stat *stat,
+			   struct resmon_stat_mac mac,
+			   uint16_t fid,
+			   struct resmon_stat_kvd_alloc kvda)
+{
+	struct resmon_stat_fdb_key key = resmon_stat_fdb_key(mac, fid);
+
+	return resmon_stat_lh_update(stat, RESMON_STAT_TABLE_FDB,
+				     &key.base, sizeof(key), kvda);
+}
+
+int resmon_stat_fdb_delete(struct resmon_stat *stat,
+			   struct resmon_stat_mac mac,
+			   uint16_t fid)
+{
+	struct resmon_stat_fdb_key key = resmon_stat_fdb_key(mac, fid);
+
+	return resmon_stat_lh_delete(stat, RESMON_STAT_TABLE_FDB, &key.base);
+}
+
+static uint32_t resmon_stat_kvdl_max(uint32_t a, uint32_t b)
+{
+	return a > b ? a : b;
+}
+
+/* Recompute inner node n, whose children cover half slots each. */
+static void resmon_stat_kvdl_pull(struct resmon_stat_kvdl_space *space,
+				  uint32_t n, uint32_t half)
+{
+	const struct resmon_stat_kvdl_node *l = &space->nodes[2 * n];
+	const struct resmon_stat_kvdl_node *r = &space->nodes[2 * n + 1];
+	struct resmon_stat_kvdl_node *node = &space->nodes[n];
+
+	node->pre = l->pre == half ? half + r->pre : l->pre;
+	node->suf = r->suf == half ? half + l->suf : r->suf;
+	node->best = resmon_stat_kvdl_max(resmon_stat_kvdl_max(l->best,
+							       r->best),
+					  l->suf + r->pre);
+}
+
+static void resmon_stat_kvdl_leaf_set(struct resmon_stat_kvdl_space *space,
+				      uint32_t index, bool free)
+{
+	uint32_t n = space->cap + index;
+	uint32_t half = 1;
+
+	space->nodes[n] = (struct resmon_stat_kvdl_node) {
+		.pre = free,
+		.suf = free,
+		.best = free,
+	};
+	for (n /= 2; n > 0; n /= 2, half *= 2)
+		resmon_stat_kvdl_pull(space, n, half);
+}
+
+/* Length of the free run that ends at slot index. */
+static uint32_t
+resmon_stat_kvdl_run_to(const struct resmon_stat_kvdl_space *space,
+			uint32_t index)
+{
+	uint32_t n = space->cap + index;
+	uint32_t len = 1;
+	uint32_t run;
+
+	if (!space->nodes[n].best)
+		return 0;
+
+	/* The run covers the whole range of n up to index. Whenever n is a
+	 * right child, extend it by the free end of its left sibling.
+	 */
+	for (run = 1; n > 1; n /= 2, len *= 2) {
+		if (n % 2 == 0)
+			continue;
+		run += space->nodes[n - 1].suf;
+		if (space->nodes[n - 1].suf < len)
+			break;
+	}
+	return run;
+}
+
+/* Length of the free run that starts at slot index. */
+static uint32_t
+resmon_stat_kvdl_run_from(const struct resmon_stat_kvdl_space *space,
+			  uint32_t index)
+{
+	uint32_t n = space->cap + index;
+	uint32_t len = 1;
+	uint32_t run;
+
+	if (!space->nodes[n].best)
+		return 0;
+
+	for (run = 1; n > 1; n /= 2, len *= 2) {
+		if (n % 2 == 1)
+			continue;
+		run += space->nodes[n + 1].pre;
+		if (space->nodes[n + 1].pre < len)
+			break;
+	}
+	return run;
+}
+
+static void resmon_stat_kvdl_run_account(struct resmon_stat_kvdl_space *space,
+					 uint32_t len, int delta)
+{
+	size_t bucket;
+
+	if (len == 0)
+		return;
+
+	bucket = 31 - __builtin_clz(len);
+	if (bucket >= RESMON_STAT_KVDL_RUN_HIST_COUNT)
+		bucket = RESMON_STAT_KVDL_RUN_HIST_COUNT - 1;
+	space->run_hist[bucket] += delta;
+	space->free_runs += delta;
+}
+
+/* Extend the space to size free slots, merging them with a free run at
+ * the end of the space.
+ */
+static int resmon_stat_kvdl_grow(struct resmon_stat_kvdl_space *space,
+				 uint32_t size)
+{
+	struct resmon_stat_kvdl_node *nodes;
+	uint32_t tail = 0;
+	uint8_t *refs;
+	uint32_t cap;
+
+	if (space->size != 0)
+		tail = resmon_stat_kvdl_run_to(space, space->size - 1);
+
+	if (size <= space->cap) {
+		for (uint32_t i = space->size; i < size; i++)
+			resmon_stat_kvdl_leaf_set(space, i, true);
+		goto account;
+	}
+
+	for (cap = space->cap ?: 1; cap < size; cap *= 2)
+		;
+	nodes = calloc(2 * cap, sizeof(*nodes));
+	if (nodes == NULL)
+		return -ENOMEM;
+	refs = realloc(space->refs, cap * sizeof(*refs));
+	if (refs == NULL) {
+		free(nodes);
+		return -ENOMEM;
+	}
+	memset(&refs[space->cap], 0, (cap - space->cap) * sizeof(*refs));
+	space->refs = refs;
+
+	for (uint32_t i = 0; i < space->size; i++)
+		nodes[cap + i] = space->nodes[space->cap + i];
+	for (uint32_t i = space->size; i < size; i++)
+		nodes[cap + i] = (struct resmon_stat_kvdl_node) { 1, 1, 1 };
+
+	free(space->nodes);
+	space->nodes = nodes;
+	space->cap = cap;
+	for (uint32_t n = cap - 1; n > 0; n--)
+		resmon_stat_kvdl_pull(space, n,
+				      cap >> (32 - __builtin_clz(n)));
+
+account:
+	resmon_stat_kvdl_run_account(space, tail, -1);
+	resmon_stat_kvdl_run_account(space, tail + size - space->size, 1);
+	space->size = size;
+	return 0;
 }
 
+/* Take a reference to a slot, and mark it as used if it was free. Slots
+ * past the maximum size are not tracked.
+ */
+static int resmon_stat_kvdl_take(struct resmon_stat_kvdl_space *space,
+				 uint32_t index)
+{
+	uint32_t before = 0;
+	uint32_t after = 0;
+	int rc;
+
+	if (space->sized && index >= space->size)
+		return -ERANGE;
+	if (index >= RESMON_STAT_KVDL_MAX_SIZE)
+		return 0;
+	if (index >= space->size) {
+		rc = resmon_stat_kvdl_grow(space, index + 1);
+		if (rc != 0)
+			return rc;
+	}
+	if (space->refs[index] == UINT8_MAX)
+		return -EOVERFLOW;
+	if (space->refs[index]++ != 0)
+		return 0;
+
+	if (index > 0)
+		before = resmon_stat_kvdl_run_to(space, index - 1);
+	if (index + 1 < space->size)
+		after = resmon_stat_kvdl_run_from(space, index + 1);
+
+	resmon_stat_kvdl_run_account(space, before + 1 + after, -1);
+	resmon_stat_kvdl_run_account(space, before, 1);
+	resmon_stat_kvdl_run_account(space, after, 1);
+	resmon_stat_kvdl_leaf_set(space, index, false);
+	space->used++;
+	return 0;
+}
+
+static void resmon_stat_kvdl_release(struct resmon_stat_kvdl_space *space,
+				     uint32_t index)
+{
+	uint32_t before = 0;
+	uint32_t after = 0;
+
+	if (index >= space->size || space->refs[index] == 0)
+		return;
+	if (--space->refs[index] != 0)
+		return;
+
+	if (index > 0)
+		before = resmon_stat_kvdl_run_to(space, index - 1);
+	if (index + 1 < space->size)
+		after = resmon_stat_kvdl_run_from(space, index + 1);
+
+	resmon_stat_kvdl_run_account(space, before, -1);
+	resmon_stat_kvdl_run_account(space, after, -1);
+	resmon_stat_kvdl_run_account(space, before + 1 + after, 1);
+	resmon_stat_kvdl_leaf_set(space, index, true);
+	space->used--;
+}
+
+int resmon_stat_kvdl_size_set(struct resmon_stat *stat, uint64_t size)
+{
+	struct resmon_stat_kvdl_space *space = &stat->kvdl_space;
+	int rc;
+
+	if (size > RESMON_STAT_KVDL_MAX_SIZE)
+		return -1;
+	if (size > space->size) {
+		rc = resmon_stat_kvdl_grow(space, size);
+		if (rc != 0)
+			return rc;
+	}
+
+	space->sized = true;
+	return 0;
+}
+
+struct resmon_stat_kvdl_frag resmon_stat_kvdl_frag(struct resmon_stat *stat)
+{
+	const struct resmon_stat_kvdl_space *space = &stat->kvdl_space;
+	struct resmon_stat_kvdl_frag frag = {
+		.size = space->size,
+		.used = space->used,
+		.largest_free_run = space->cap ? space->nodes[1].best : 0,
+		.free_runs = space->free_runs,
+	};
+
+	memcpy(frag.run_hist, space->run_hist, sizeof(frag.run_hist));
+	return frag;
+}
+
+/* Only an entry that is new holds a reference to its slot, and *inserted
+ * tells whether it was.
+ */
 static int resmon_stat_kvdl_alloc_1(struct resmon_stat *stat,
 				    uint32_t index,
-				    enum resmon_counter resource)
+				    enum resmon_counter resource,
+				    bool *inserted)
 {
 	struct resmon_stat_kvdl_key key = resmon_stat_kvdl_key(index, resource);
 	struct resmon_stat_kvd_alloc kvd_alloc = {
 		.slots = 1,
 		.counter = resource,
 	};
+	int rc;
 
-	return resmon_stat_lh_update(stat, stat->kvdl,
-				     &key.base, sizeof(key), kvd_alloc);
+	*inserted = false;
+	rc = resmon_stat_kvdl_take(&stat->kvdl_space, index);
+	if (rc < 0)
+		return rc;
+
+	rc = resmon_stat_lh_update_nostats(stat, RESMON_STAT_TABLE_KVDL,
+					   &key.base, sizeof(key), kvd_alloc);
+	if (rc != 0) {
+		resmon_stat_kvdl_release(&stat->kvdl_space, index);
+		return rc == 1 ? 0 : rc;
+	}
+
+	resmon_stat_counter_inc(stat, kvd_alloc);
+	*inserted = true;
+	return 0;
 }
 
 static int resmon_stat_kvdl_free_1(struct resmon_stat *stat,
@@ -534,29 +2009,48 @@ static int resmon_stat_kvdl_free_1(struct resmon_stat *stat,
 				   enum resmon_counter resource)
 {
 	struct resmon_stat_kvdl_key key = resmon_stat_kvdl_key(index, resource);
+	int rc;
 
-	return resmon_stat_lh_delete(stat, stat->kvdl, &key.base);
+	rc = resmon_stat_lh_delete(stat, RESMON_STAT_TABLE_KVDL, &key.base);
+	if (rc == 0)
+		resmon_stat_kvdl_release(&stat->kvdl_space, index);
+	return rc;
 }
 
+/* The slots of an entry that are already allocated stay as they are. If a
+ * slot can not be allocated, only the slots that this call allocated are
+ * freed again. These are kept in a bitmap, which bounds the slots of an
+ * entry.
+ */
 int resmon_stat_kvdl_alloc(struct resmon_stat *stat,
 			   uint32_t index,
 			   struct resmon_stat_kvd_alloc kvd_alloc)
 {
+	uint64_t inserted = 0;
 	uint32_t i;
 	int rc;
 
+	if (kvd_alloc.slots > 64)
+		return -EINVAL;
+
 	for (i = 0; i < kvd_alloc.slots; i++) {
+		bool inserted_1;
+
 		rc = resmon_stat_kvdl_alloc_1(stat, index + i,
-					      kvd_alloc.counter);
+					      kvd_alloc.counter, &inserted_1);
 		if (rc != 0)
 			goto unroll;
+		if (inserted_1)
+			inserted |= 1ULL << i;
 	}
 
 	return 0;
 
 unroll:
 	while (i-- > 0)
-		resmon_stat_kvdl_free_1(stat, index + i, kvd_alloc.counter);
+		if (inserted & (1ULL << i))
+			resmon_stat_kvdl_free_1(stat, index + i,
+						kvd_alloc.counter);
 	return rc;
 }
 
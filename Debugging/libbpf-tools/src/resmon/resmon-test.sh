@@ -29,6 +29,21 @@ resmon_stats_no_change_test()
 	rm /tmp/before /tmp/after
 }
 
+resmon_stats_get()
+{
+	local counter_name=$1; shift
+	local device=$1; shift
+	local params=""
+
+	if [[ -n $device ]]; then
+		params=", \"params\": { \"device\": \"$device\" }"
+	fi
+
+	(echo -n "{ \"jsonrpc\": \"2.0\", \"id\": 1, \"method\": \"stats\"$params }"; \
+		sleep 0.2) | nc -U --udp resmon.ctl | \
+		jq ".result.counters[] | select(.name == \"$counter_name\")".value
+}
+
 resmon_stats_test()
 {
 	local payload=$1; shift
@@ -38,15 +53,11 @@ resmon_stats_test()
 	local val_before
 	local val_after
 
-	val_before=$((echo -n '{ "jsonrpc": "2.0", "id": 1, "method": "stats" }'; \
-		sleep 0.2) | nc -U --udp resmon.ctl | \
-		jq ".result.counters[] | select(.name == \"$counter_name\")".value)
+	val_before=$(resmon_stats_get $counter_name)
 
 	$RESMON emad string "$payload"
 
-	val_after=$((echo -n '{ "jsonrpc": "2.0", "id": 1, "method": "stats" }'; \
-		sleep 0.2) | nc -U --udp resmon.ctl | \
-		jq ".result.counters[] | select(.name == \"$counter_name\")".value)
+	val_after=$(resmon_stats_get $counter_name)
 
 	expected_val=$((val_before + $num_entries))
 
@@ -56,6 +67,173 @@ resmon_stats_test()
 	fi
 }
 
+resmon_stats_dev_test()
+{
+	local payload=$1; shift
+	local counter_name=$1; shift
+	local num_entries=$1; shift
+	local device=$1; shift
+	local other=$1; shift
+	local other_before
+	local other_after
+	local expected_val
+	local val_before
+	local val_after
+
+	val_before=$(resmon_stats_get $counter_name $device)
+	other_before=$(resmon_stats_get $counter_name $other)
+
+	$RESMON emad dev $device string "$payload"
+
+	val_after=$(resmon_stats_get $counter_name $device)
+	other_after=$(resmon_stats_get $counter_name $other)
+
+	expected_val=$((val_before + $num_entries))
+
+	if [[ $expected_val -ne $val_after ]]; then
+		echo "$counter_name of $device is $val_after, but should be $expected_val"
+		EXIT_STATUS=1
+	fi
+
+	if [[ $other_before -ne $other_after ]]; then
+		echo "$counter_name of $other changed from $other_before to $other_after"
+		EXIT_STATUS=1
+	fi
+}
+
+resmon_regs_get()
+{
+	local reg_name=$1; shift
+	local field=$1; shift
+	local method=${1-regs}
+
+	(echo -n '{ "jsonrpc": "2.0", "id": 1, "method": "'$method'" }'; \
+		sleep 0.2) | nc -U --udp resmon.ctl | \
+		jq ".result.registers[] | select(.name == \"$reg_name\")".$field
+}
+
+resmon_regs_test()
+{
+	local payload=$1; shift
+	local reg_name=$1; shift
+	local field=$1; shift
+	local method=${1-regs}
+	local expected_val
+	local val_before
+	local val_after
+
+	val_before=$(resmon_regs_get $reg_name $field $method)
+
+	$RESMON emad string "$payload" 2>/dev/null
+
+	val_after=$(resmon_regs_get $reg_name $field $method)
+
+	expected_val=$((val_before + 1))
+
+	if [[ $expected_val -ne $val_after ]]; then
+		echo "$reg_name $field is $val_after, but should be $expected_val"
+		EXIT_STATUS=1
+	fi
+}
+
+resmon_acl_test()
+{
+	local field=$1; shift
+	local expected_val=$1; shift
+	local val
+
+	val=$((echo -n '{ "jsonrpc": "2.0", "id": 1, "method": "acl" }'; \
+		sleep 0.2) | nc -U --udp resmon.ctl | \
+		jq ".result.regions[0].$field")
+
+	if [[ $expected_val -ne $val ]]; then
+		echo "ACL region $field is $val, but should be $expected_val"
+		EXIT_STATUS=1
+	fi
+}
+
+resmon_lpm_test()
+{
+	local filter=$1; shift
+	local expected_val=$1; shift
+	local val
+
+	val=$((echo -n '{ "jsonrpc": "2.0", "id": 1, "method": "lpm" }'; \
+		sleep 0.2) | nc -U --udp resmon.ctl | \
+		jq ".result.vrs$filter")
+
+	if [[ $expected_val -ne $val ]]; then
+		echo "LPM VRs$filter is $val, but should be $expected_val"
+		EXIT_STATUS=1
+	fi
+}
+
+resmon_bursts_test()
+{
+	local val
+
+	val=$((echo -n '{ "jsonrpc": "2.0", "id": 1, "method": "bursts" }'; \
+		sleep 0.2) | nc -U --udp resmon.ctl | \
+		jq ".result.bursts | length")
+
+	if [[ $val -eq 0 ]]; then
+		echo "No EMAD bursts were recorded"
+		EXIT_STATUS=1
+	fi
+}
+
+resmon_forecast_test()
+{
+	local name=$1; shift
+	local field=$1; shift
+	local expected_val=$1; shift
+	local val
+
+	val=$((echo -n '{ "jsonrpc": "2.0", "id": 1, "method": "stats",
+			  "params": { "forecast": true } }'; \
+		sleep 0.2) | nc -U --udp resmon.ctl | \
+		jq ".result.counters[] | select(.name == \"$name\").forecast.$field | round")
+
+	if [[ "$expected_val" != "$val" ]]; then
+		echo "$name forecast $field is $val, but should be $expected_val"
+		EXIT_STATUS=1
+	fi
+}
+
+resmon_plan_test()
+{
+	local items=$1; shift
+	local filter=$1; shift
+	local expected_val=$1; shift
+	local val
+
+	val=$((echo -n '{ "jsonrpc": "2.0", "id": 1, "method": "plan",
+			  "params": { "items": '"$items"' } }'; \
+		sleep 0.2) | nc -U --udp resmon.ctl | \
+		jq ".result$filter")
+
+	if [[ "$expected_val" != "$val" ]]; then
+		echo "Plan$filter is $val, but should be $expected_val"
+		EXIT_STATUS=1
+	fi
+}
+
+resmon_kvdl_test()
+{
+	local field=$1; shift
+	local expected_val=$1; shift
+	local val
+
+	val=$((echo -n '{ "jsonrpc": "2.0", "id": 1, "method": "kvdl" }'; \
+		sleep 0.2) | nc -U --udp resmon.ctl | \
+		jq ".result.devices[0].$field")
+
+	if [[ $expected_val -ne $val ]]; then
+		echo "KVD linear $field is $val, but should be $expected_val"
+		EXIT_STATUS=1
+	fi
+}
+
 ####################### Common TLVs #######################
 
 string_tlv="10210000\
@@ -80,7 +258,7 @@ end_tlv="00010000"
 
 ####################### Start resmon #######################
 
-$RESMON start mode mock&> /dev/null &
+$RESMON start mode mock devices 2 &> /dev/null &
 sleep 1
 
 ################## RALUE - add IPv4 route ##################
@@ -103,10 +281,14 @@ c6010203\
 00000000\
 00000000"
 
+ralue_ipv4_payload=$ralue_payload
 reg_tlv=$ralue_type_len$a_op_protocol$ralue_payload
 
 resmon_stats_test $(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv LPM_IPV4 1
 
+resmon_lpm_test "[0].routes" 1
+resmon_lpm_test "[0].prefix_lens[32]" 1
+
 ################ RALUE - delete IPv4 route ################
 reg_id=8013
 
@@ -115,6 +297,8 @@ reg_tlv=$ralue_type_len$a_op_protocol$ralue_payload
 
 resmon_stats_test $(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv LPM_IPV4 -1
 
+resmon_lpm_test " | length" 0
+
 ################## RALUE - add IPv6 route ##################
 reg_id=8013
 
@@ -137,6 +321,9 @@ reg_tlv=$ralue_type_len$a_op_protocol$ralue_payload
 
 resmon_stats_test $(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv LPM_IPV6 1
 
+resmon_lpm_test "[0].virtual_router" 1
+resmon_lpm_test "[0].prefix_lens[64]" 1
+
 ################ RALUE - delete IPv6 route ################
 reg_id=8013
 
@@ -222,6 +409,34 @@ ptce_reg_tlv_get()
 resmon_stats_test \
 	$(op_tlv_get $reg_id)$string_tlv$(ptce_reg_tlv_get 8)$end_tlv ATCAM 2
 
+resmon_acl_test used 1
+resmon_acl_test capacity 16
+resmon_acl_test "erps[0]" 1
+resmon_acl_test "deltas[0]" 1
+
+################ PTAR - tcam region resize ################
+reg_id=3006
+
+reg_tlv="180d0000\
+10020051\
+00000020\
+00000002\
+00000000\
+00001002\
+14044101\
+02030506\
+11124400\
+3a139010\
+11121415\
+38399200\
+00000000"
+
+resmon_stats_no_change_test $(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv
+
+resmon_acl_test capacity 32
+resmon_acl_test resizes 1
+resmon_acl_test used 1
+
 ################# PTAR - tcam region free #################
 reg_id=3006
 
@@ -247,6 +462,10 @@ reg_id=3027
 resmon_stats_test \
 	$(op_tlv_get $reg_id)$string_tlv$(ptce_reg_tlv_get 0)$end_tlv ATCAM -2
 
+resmon_acl_test used 0
+resmon_acl_test "erps[0]" 0
+resmon_acl_test "deltas[0]" 0
+
 ######## PEFA - accesse to a flexible action entry ########
 reg_id=300f
 
@@ -274,10 +493,15 @@ action2_to_action4=$(printf '%*s' 191 | tr ' ' "0")
 type_next_goto_record="01000000024000000"
 
 reg_tlv=$type_len$index$pefa_payload$action2_to_action4$type_next_goto_record
+pefa_reg_tlv=$reg_tlv
 
 resmon_stats_test \
 	$(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv ACTSET 1
 
+resmon_kvdl_test used 1
+resmon_kvdl_test largest_free_run 1002
+resmon_kvdl_test free_runs 1
+
 ####### IEDR - delete the entry from the entry table #######
 reg_id=3804
 
@@ -293,10 +517,80 @@ index="0003ea"
 empty_records=$(printf '%*s' 1008 | tr ' ' "0")
 
 reg_tlv=$reg_tlv$index$empty_records
+iedr_actset_reg_tlv=$reg_tlv
 
 resmon_stats_test \
 	$(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv ACTSET -1
 
+resmon_kvdl_test used 0
+resmon_kvdl_test largest_free_run 1003
+
+############## RATR - write an adjacency entry ##############
+reg_id=8008
+
+reg_tlv="180c0000\
+11000000\
+000003ea\
+00000000\
+00010000"
+
+empty_fields=$(printf '%*s' 56 | tr ' ' "0")
+
+reg_tlv=$reg_tlv$empty_fields
+ratr_reg_tlv=$reg_tlv
+
+resmon_stats_test \
+	$(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv ADJ 1
+
+########### RATR - rewrite the same adjacency entry ###########
+resmon_stats_test \
+	$(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv ADJ 0
+
+######## IEDR - delete the adjacency from the entry table ########
+reg_id=3804
+
+reg_tlv="18850000\
+00000001\
+00000000\
+00000000\
+00000000\
+21000001\
+000103ea"
+
+reg_tlv=$reg_tlv$empty_records
+iedr_adj_reg_tlv=$reg_tlv
+
+resmon_stats_test \
+	$(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv ADJ -1
+
+######## RATR, PEFA - share an index of KVD linear ########
+# Move the action set to the index of the adjacency, 0x103ea, so that
+# both take the same slot. Deleting one of them leaves the slot taken by
+# the other.
+pefa_reg_tlv=${pefa_reg_tlv/0003ea/0103ea}
+iedr_actset_reg_tlv=${iedr_actset_reg_tlv/0003ea/0103ea}
+
+resmon_stats_test \
+	$(op_tlv_get 300f)$string_tlv$pefa_reg_tlv$end_tlv ACTSET 1
+resmon_stats_test \
+	$(op_tlv_get 8008)$string_tlv$ratr_reg_tlv$end_tlv ADJ 1
+
+resmon_kvdl_test used 1
+
+resmon_stats_test \
+	$(op_tlv_get 3804)$string_tlv$iedr_adj_reg_tlv$end_tlv ADJ -1
+
+resmon_kvdl_test used 1
+resmon_kvdl_test largest_free_run 66538
+resmon_kvdl_test free_runs 1
+
+resmon_stats_test \
+	$(op_tlv_get 3804)$string_tlv$iedr_actset_reg_tlv$end_tlv ACTSET -1
+
+resmon_kvdl_test used 0
+resmon_kvdl_test largest_free_run 66539
+resmon_kvdl_test free_runs 1
+
 ############## RAUHT - add IPv4 host table ################
 reg_id=8014
 
@@ -359,6 +653,484 @@ reg_tlv=$reg_tlv$ipv6_dip$empty_fields$mac
 resmon_stats_test \
 	$(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv HOSTTAB_IPV6 -2
 
+############ RALUE - add IPv4 route on second device ############
+reg_id=8013
+
+a_op_protocol="00010000"
+reg_tlv=$ralue_type_len$a_op_protocol$ralue_ipv4_payload
+
+resmon_stats_dev_test $(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv \
+	LPM_IPV4 1 mock/1 mock/0
+
+########## RALUE - delete IPv4 route on second device ##########
+reg_id=8013
+
+a_op_protocol="00310000"
+reg_tlv=$ralue_type_len$a_op_protocol$ralue_ipv4_payload
+
+resmon_stats_dev_test $(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv \
+	LPM_IPV4 -1 mock/1 mock/0
+
+################## SFD - add an FDB entry ##################
+reg_id=200a
+
+sfd_header="19050000\
+00000000"
+
+sfd_records="00000001\
+00000000\
+000c0011\
+22334455\
+00000064\
+00000001"
+
+empty_records=$(printf '%*s' 2016 | tr ' ' "0")
+
+reg_tlv=$sfd_header"40000000"$sfd_records$empty_records
+
+resmon_stats_test \
+	$(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv FDB 1
+
+################ SFD - remove the FDB entry ################
+reg_id=200a
+
+reg_tlv=$sfd_header"80000000"$sfd_records$empty_records
+
+resmon_stats_test \
+	$(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv FDB -1
+
+############### RALUE - per-register statistics ###############
+reg_id=8013
+
+a_op_protocol="00010000"
+reg_tlv=$ralue_type_len$a_op_protocol$ralue_ipv4_payload
+
+resmon_regs_test $(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv \
+	RALUE processed
+
+# Cut the payload short of the RALUE register length.
+resmon_regs_test $(op_tlv_get $reg_id)$string_tlv$ralue_type_len \
+	RALUE errors
+
+# Writing the route again is redundant.
+resmon_regs_test $(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv \
+	RALUE redundant churn
+
+a_op_protocol="00310000"
+reg_tlv=$ralue_type_len$a_op_protocol$ralue_ipv4_payload
+
+resmon_stats_test $(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv LPM_IPV4 -1
+
+####################### Bursts #######################
+resmon_bursts_test
+
+############## Forecast - add a route per second ##############
+$RESMON stop &> /dev/null
+$RESMON start mode mock clock manual &> /dev/null &
+sleep 1
+
+reg_id=8013
+a_op_protocol="00010000"
+
+for i in 1 2 3 4 5; do
+	ralue_payload=${ralue_ipv4_payload/c6010203/c601020$i}
+	reg_tlv=$ralue_type_len$a_op_protocol$ralue_payload
+	$RESMON emad time ${i}000000000 \
+		string $(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv
+done
+
+# The mock capacity is 10000, five routes are in use.
+resmon_forecast_test LPM_IPV4 window_slope 1
+resmon_forecast_test TOTAL exhaustion_s 9995
+
+####################### Plan #######################
+plan_items='[ { "type": "route", "protocol": "ipv6", "prefix_len": 128,
+		"count": 10 },
+	      { "type": "neigh", "protocol": "ipv6", "count": 3 },
+	      { "type": "acl", "key_blocks": 12, "count": 2 } ]'
+
+resmon_plan_test "$plan_items" \
+	'.counters[] | select(.name == "LPM_IPV6").needed' 20
+resmon_plan_test "$plan_items" \
+	'.counters[] | select(.name == "HOSTTAB_IPV6").needed' 6
+resmon_plan_test "$plan_items" \
+	'.counters[] | select(.name == "ATCAM").needed' 8
+resmon_plan_test "$plan_items" .headroom 9961
+resmon_plan_test '[ { "type": "fdb", "count": 10000 } ]' .fits false
+
+# A batch that needs more slots than fit in 64 bits is rejected.
+val=$((echo -n '{ "jsonrpc": "2.0", "id": 1, "method": "plan",
+		  "params": { "items": [ { "type": "acl", "key_blocks": 12,
+					   "count": 9223372036854775807 } ] } }'; \
+	sleep 0.2) | nc -U --udp resmon.ctl | jq ".error.code")
+if [[ $val -ne -32602 ]]; then
+	echo "Plan of an overflowing batch failed with $val, but should with -32602"
+	EXIT_STATUS=1
+fi
+
+####################### Bulk injection #######################
+reg_id=8013
+a_op_protocol="00010000"
+lpm_ipv4_before=$(resmon_stats_get LPM_IPV4)
+
+for i in 1 2 3 4 5; do
+	ralue_payload=${ralue_ipv4_payload/c6010203/c601030$i}
+	reg_tlv=$ralue_type_len$a_op_protocol$ralue_payload
+	echo $(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv
+done > /tmp/resmon.emads
+
+$RESMON emads file /tmp/resmon.emads 2> /dev/null
+rm /tmp/resmon.emads
+
+ralue_payload=${ralue_ipv4_payload/c6010203/c6010306}
+reg_tlv=$ralue_type_len$a_op_protocol$ralue_payload
+emad=$(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv
+emad_base64=$(printf "$(echo $emad | sed 's/../\\x&/g')" | base64 -w0)
+
+val=$((echo -n '{ "jsonrpc": "2.0", "id": 1, "method": "emads",
+		  "params": { "emads": [ "'$emad_base64'" ] } }'; \
+	sleep 0.2) | nc -U --udp resmon.ctl | jq ".result.emads")
+if [[ $val -ne 1 ]]; then
+	echo "Injected $val EMADs in base64, but should have injected 1"
+	EXIT_STATUS=1
+fi
+
+val=$(resmon_stats_get LPM_IPV4)
+if [[ $val -ne $((lpm_ipv4_before + 6)) ]]; then
+	echo "LPM_IPV4 is $val after bulk injection, but should be $((lpm_ipv4_before + 6))"
+	EXIT_STATUS=1
+fi
+
+####################### Health #######################
+resmon_health_get()
+{
+	local filter=$1; shift
+
+	(echo -n '{ "jsonrpc": "2.0", "id": 1, "method": "health" }'; \
+		sleep 0.2) | nc -U --udp resmon.ctl | jq ".result$filter"
+}
+
+# The file of five EMADs above was processed in one go.
+val=$(resmon_health_get .batch.max)
+if [[ $val -ne 5 ]]; then
+	echo "Largest batch is $val, but should be 5"
+	EXIT_STATUS=1
+fi
+
+val=$(resmon_health_get '.registers[] | select(.name == "RALUE").time_ns.count')
+expected_val=$(($(resmon_regs_get RALUE processed) + \
+		$(resmon_regs_get RALUE ignored) + \
+		$(resmon_regs_get RALUE errors)))
+if [[ $val -ne $expected_val ]]; then
+	echo "RALUE processing times of $val EMADs, but should be of $expected_val"
+	EXIT_STATUS=1
+fi
+
+####################### Errors #######################
+resmon_errors_get()
+{
+	local filter=$1; shift
+
+	(echo -n '{ "jsonrpc": "2.0", "id": 1, "method": "errors" }'; \
+		sleep 0.2) | nc -U --udp resmon.ctl | jq ".result$filter"
+}
+
+reg_id=8013
+truncated_filter='.classes[] | select(.name == "truncated").count'
+val_before=$(resmon_errors_get "$truncated_filter")
+
+# Cut the payload short of the RALUE register length.
+$RESMON emad string $(op_tlv_get $reg_id)$string_tlv$ralue_type_len \
+	2> /dev/null
+
+val=$(resmon_errors_get "$truncated_filter")
+if [[ $val -ne $((val_before + 1)) ]]; then
+	echo "Truncated EMADs are $val, but should be $((val_before + 1))"
+	EXIT_STATUS=1
+fi
+
+val=$(resmon_errors_get '.samples | map(select(.class == "truncated")) | length')
+if [[ $val -eq 0 ]]; then
+	echo "No sample of a truncated EMAD was kept"
+	EXIT_STATUS=1
+fi
+
+# Write a rule to a TCAM region that was never allocated.
+unknown_region_filter='.classes[] | select(.name == "unknown_region").count'
+val_before=$(resmon_errors_get "$unknown_region_filter")
+atcam_before=$(resmon_stats_get ATCAM)
+
+reg_tlv=$(ptce_reg_tlv_get 8)
+$RESMON emad string \
+	$(op_tlv_get 3027)$string_tlv${reg_tlv/11124400/11124401}$end_tlv \
+	2> /dev/null
+
+val=$(resmon_errors_get "$unknown_region_filter")
+if [[ $val -ne $((val_before + 1)) ]]; then
+	echo "Rules in unknown regions are $val, but should be $((val_before + 1))"
+	EXIT_STATUS=1
+fi
+
+val=$(resmon_stats_get ATCAM)
+if [[ $val -ne $atcam_before ]]; then
+	echo "ATCAM is $val after a rule in an unknown region, but should be $atcam_before"
+	EXIT_STATUS=1
+fi
+
+####################### Top #######################
+reg_id=8013
+a_op_protocol="00010000"
+
+# Add a route between the two samples that top takes.
+$RESMON top interval 500 count 2 &> /tmp/resmon.top &
+top_pid=$!
+sleep 0.2
+ralue_payload=${ralue_ipv4_payload/c6010203/c6010401}
+reg_tlv=$ralue_type_len$a_op_protocol$ralue_payload
+$RESMON emad string $(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv
+wait $top_pid
+
+val=$(sed -n '/^Sample 2/,$p' /tmp/resmon.top | \
+	awk '/^IPv4 LPM/ { print $(NF - 1) }')
+if [[ $val != "+1" ]]; then
+	echo "LPM_IPV4 delta in top is $val, but should be +1"
+	EXIT_STATUS=1
+fi
+rm /tmp/resmon.top
+
+########### Forecast - the device that runs out first ###########
+$RESMON stop &> /dev/null
+$RESMON start mode mock devices 2 clock manual &> /dev/null &
+sleep 1
+
+reg_id=8013
+a_op_protocol="00010000"
+
+for i in 1 2 3 4 5; do
+	ralue_payload=${ralue_ipv4_payload/c6010203/c601020$i}
+	reg_tlv=$ralue_type_len$a_op_protocol$ralue_payload
+	$RESMON emad time ${i}000000000 \
+		string $(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv
+done
+
+# The routes go to the first device, the second one stays idle. Their
+# 20000 entries of capacity together are not all available to the first.
+resmon_forecast_test TOTAL exhaustion_s 9995
+
+######## PEFA - past the end of a known KVD linear size ########
+$RESMON stop &> /dev/null
+$RESMON start mode mock kvdl-size 1003 &> /dev/null &
+sleep 1
+
+pefa_reg_tlv=${pefa_reg_tlv/0103ea/0003ea}
+iedr_actset_reg_tlv=${iedr_actset_reg_tlv/0103ea/0003ea}
+
+resmon_stats_test \
+	$(op_tlv_get 300f)$string_tlv$pefa_reg_tlv$end_tlv ACTSET 1
+
+# Slot 0x3eb is past the end. The failed write leaves the entry in the last
+# slot alone.
+resmon_stats_test \
+	$(op_tlv_get 300f)$string_tlv${pefa_reg_tlv/0003ea/0003eb}$end_tlv \
+	ACTSET 0
+
+resmon_kvdl_test size 1003
+resmon_kvdl_test used 1
+
+resmon_stats_test \
+	$(op_tlv_get 3804)$string_tlv$iedr_actset_reg_tlv$end_tlv ACTSET -1
+
+resmon_kvdl_test used 0
+
+################### Reconciliation ###################
+resmon_recon_get()
+{
+	local filter=$1; shift
+
+	(echo -n '{ "jsonrpc": "2.0", "id": 1, "method": "recon",
+		    "params": { "check": true } }'; \
+		sleep 0.2) | nc -U --udp resmon.ctl | \
+		jq ".result.resources[] | select(.name == \"kvd\")$filter"
+}
+
+$RESMON stop &> /dev/null
+$RESMON start mode mock clock manual reconcile 0 drift-threshold 4 \
+	drift-persist 2 drift-action rebase &> /dev/null &
+sleep 1
+
+reg_id=8013
+a_op_protocol="00010000"
+reg_tlv=$ralue_type_len$a_op_protocol$ralue_ipv4_payload
+$RESMON emad time 1000000000 \
+	string $(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv
+
+# Have devlink report ten more entries than resmon has seen.
+(echo -n '{ "jsonrpc": "2.0", "id": 1, "method": "occupancy",
+	    "params": { "resource": "kvd", "occupancy": 11 } }'; \
+	sleep 0.2) | nc -U --udp resmon.ctl > /dev/null
+
+val=$(resmon_recon_get .drift)
+if [[ $val -ne -10 ]]; then
+	echo "KVD drift is $val, but should be -10"
+	EXIT_STATUS=1
+fi
+
+# The drift persists in the second check, which rebases the total.
+val=$(resmon_recon_get .rebase_offset)
+if [[ $val -ne 10 ]]; then
+	echo "KVD rebase offset is $val, but should be 10"
+	EXIT_STATUS=1
+fi
+
+val=$(resmon_stats_get TOTAL)
+if [[ $val -ne 11 ]]; then
+	echo "Rebased TOTAL is $val, but should be 11"
+	EXIT_STATUS=1
+fi
+
+# The rebase is not usage growth. Writing the route again two seconds on
+# leaves the usage and its trend flat.
+$RESMON emad time 3000000000 \
+	string $(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv
+resmon_forecast_test TOTAL ew_slope 0
+
+####################### Entry ages #######################
+resmon_emad_at()
+{
+	local time_s=$1; shift
+	local payload=$1; shift
+
+	(echo -n '{ "jsonrpc": "2.0", "id": 1, "method": "emad",
+		    "params": { "payload": "'$payload'",
+				"time_ns": '$time_s'000000000 } }'; \
+		sleep 0.2) | nc -U --udp resmon.ctl > /dev/null
+}
+
+resmon_ages_test()
+{
+	local filter=$1; shift
+	local expected_val=$1; shift
+	local val
+
+	val=$((echo -n '{ "jsonrpc": "2.0", "id": 1, "method": "ages",
+			  "params": { "table": "ralue" } }'; \
+		sleep 0.2) | nc -U --udp resmon.ctl | jq ".result$filter")
+
+	if [[ "$expected_val" != "$val" ]]; then
+		echo "Ages $filter is $val, but should be $expected_val"
+		EXIT_STATUS=1
+	fi
+}
+
+$RESMON stop &> /dev/null
+$RESMON start mode mock clock manual ages on &> /dev/null &
+sleep 1
+
+reg_id=8013
+a_op_protocol="00010000"
+for i in 1 2; do
+	ralue_payload=${ralue_ipv4_payload/c6010203/c601040$i}
+	reg_tlv=$ralue_type_len$a_op_protocol$ralue_payload
+	resmon_emad_at $((i * i * 100)) \
+		$(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv
+done
+
+# At 400s, the first route is 300s old and the second one is new.
+resmon_ages_test ".tables[0].counts[0]" 1
+resmon_ages_test ".tables[0].counts[2]" 1
+resmon_ages_test ".oldest[0].age_s" 300
+
+# Two days later, the first route is deleted from its day bucket.
+a_op_protocol="00310000"
+ralue_payload=${ralue_ipv4_payload/c6010203/c6010401}
+reg_tlv=$ralue_type_len$a_op_protocol$ralue_payload
+resmon_emad_at 173200 $(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv
+
+resmon_ages_test ".tables[0].entries" 1
+resmon_ages_test ".tables[0].counts | add" 1
+resmon_ages_test ".tables[0].counts[6]" 1
+
+####################### Replay #######################
+le32()
+{
+	local val=$(printf '%08x' $1)
+
+	echo ${val:6:2}${val:4:2}${val:2:2}${val:0:2}
+}
+
+# Write EMADs given as "seconds:hexdump" to a capture as emadump does.
+pcap_write()
+{
+	local file=$1; shift
+	local eth_hdr="0102c90000010002c901020389328100"
+	local hex="d4c3b2a102000400000000000000000000000100$(le32 1)"
+	local frame
+
+	for emad in "$@"; do
+		frame=$eth_hdr${emad#*:}
+		hex=$hex$(le32 ${emad%%:*})$(le32 0)
+		hex=$hex$(le32 $((${#frame} / 2)))$(le32 $((${#frame} / 2)))
+		hex=$hex$frame
+	done
+
+	printf "$(echo $hex | sed 's/../\\x&/g')" > $file
+}
+
+resmon_replay_test()
+{
+	local field=$1; shift
+	local expected_val=$1; shift
+	local val
+
+	val=$((echo -n '{ "jsonrpc": "2.0", "id": 1, "method": "replay" }'; \
+		sleep 0.2) | nc -U --udp resmon.ctl | \
+		jq ".result.$field")
+
+	if [[ "$expected_val" != "$val" ]]; then
+		echo "Replay $field is $val, but should be $expected_val"
+		EXIT_STATUS=1
+	fi
+}
+
+reg_id=8013
+a_op_protocol="00010000"
+emads=()
+
+for i in 1 2 3 4 5; do
+	ralue_payload=${ralue_ipv4_payload/c6010203/c601020$i}
+	reg_tlv=$ralue_type_len$a_op_protocol$ralue_payload
+	emads+=($i:$(op_tlv_get $reg_id)$string_tlv$reg_tlv$end_tlv)
+done
+
+# The request that precedes a response is not replayed.
+query_op_tlv=$(op_tlv_get $reg_id)
+emads+=(6:${query_op_tlv/8201/0201}$string_tlv$reg_tlv$end_tlv)
+
+pcap_write /tmp/resmon.pcap "${emads[@]}"
+
+$RESMON stop &> /dev/null
+$RESMON start mode replay file /tmp/resmon.pcap kvd-size 10000 \
+	&> /dev/null &
+sleep 1
+
+resmon_replay_test done true
+resmon_replay_test frames 6
+resmon_replay_test emads 5
+
+val=$(resmon_stats_get LPM_IPV4)
+if [[ $val -ne 5 ]]; then
+	echo "Replayed LPM_IPV4 is $val, but should be 5"
+	EXIT_STATUS=1
+fi
+
+$RESMON replay file /tmp/resmon.pcap 2>&1 | grep -q "EMADs: 5,"
+if [[ $? -ne 0 ]]; then
+	echo "One-shot replay did not process 5 EMADs"
+	EXIT_STATUS=1
+fi
+
+rm /tmp/resmon.pcap
+
 ####################### Stop resmon #######################
-$RESMON stop 2&> /dev/null
+$RESMON stop &> /dev/null
 exit $EXIT_STATUS
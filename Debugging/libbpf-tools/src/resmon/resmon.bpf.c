@@ -4,6 +4,7 @@
 #include <bpf/bpf_core_read.h>
 #include <bpf/bpf_tracing.h>
 #include <bpf/bpf_endian.h>
+#include "resmon-bpf.h"
 
 #define EMAD_ETH_HDR_LEN		0x10
 #define EMAD_OP_TLV_LEN			0x10
@@ -46,23 +47,41 @@ struct {
 	__uint(max_entries, 256 * 1024 /* 256 KB */);
 } ringbuf SEC(".maps");
 
-static int push_to_ringbuf(const u8 *buf, size_t len)
+/* Maps devlink instances to device indices. Populated by user space. */
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, RESMON_BPF_MAX_DEVS);
+	__type(key, struct resmon_bpf_dev_key);
+	__type(value, u32);
+} devs SEC(".maps");
+
+#define RESMON_BPF_REC_SIZE(len) (sizeof(struct resmon_bpf_rec_hdr) + (len))
+
+static int push_to_ringbuf(u32 dev_index, u64 ktime_ns,
+			   const u8 *buf, size_t len)
 {
+	struct resmon_bpf_rec_hdr *hdr;
 	u8 *space;
 
-	if (len > 1024)
+	if (len > 2048)
 		return 0;
+	else if (len > 1024)
+		space = bpf_ringbuf_reserve(&ringbuf, RESMON_BPF_REC_SIZE(2048), 0);
 	else if (len > 512)
-		space = bpf_ringbuf_reserve(&ringbuf, 1024, 0);
+		space = bpf_ringbuf_reserve(&ringbuf, RESMON_BPF_REC_SIZE(1024), 0);
 	else if (len > 256)
-		space = bpf_ringbuf_reserve(&ringbuf, 512, 0);
+		space = bpf_ringbuf_reserve(&ringbuf, RESMON_BPF_REC_SIZE(512), 0);
 	else
-		space = bpf_ringbuf_reserve(&ringbuf, 256, 0);
+		space = bpf_ringbuf_reserve(&ringbuf, RESMON_BPF_REC_SIZE(256), 0);
 
 	if (!space)
 		return 0;
 
-	bpf_core_read(space, len, buf);
+	hdr = (struct resmon_bpf_rec_hdr *) space;
+	hdr->dev_index = dev_index;
+	hdr->resv = 0;
+	hdr->ktime_ns = ktime_ns;
+	bpf_core_read(space + sizeof(*hdr), len, buf);
 	bpf_ringbuf_submit(space, 0);
 
 	return 0;
@@ -84,13 +103,33 @@ inline bool is_mlxsw_spectrum(struct devlink *devlink)
 	return true;
 }
 
+static __always_inline u32 *lookup_dev_index(struct devlink *devlink)
+{
+	struct resmon_bpf_dev_key key;
+	const char *name;
+
+	__builtin_memset(&key, 0, sizeof(key));
+
+	name = BPF_CORE_READ(devlink, dev, bus, name);
+	bpf_core_read_str(&key.bus_name, sizeof(key.bus_name), name);
+	name = BPF_CORE_READ(devlink, dev, kobj.name);
+	bpf_core_read_str(&key.dev_name, sizeof(key.dev_name), name);
+
+	return bpf_map_lookup_elem(&devs, &key);
+}
+
+#define RESMON_REG_EXPAND_AS_CASE(NAME, name, ID) \
+	case ID:
+
 SEC("raw_tracepoint/devlink_hwmsg")
 int BPF_PROG(handle__devlink_hwmsg,
 	     struct devlink *devlink, bool incoming, unsigned long type,
 	     const u8 *buf, size_t len)
 {
+	u64 ktime_ns = bpf_ktime_get_ns();
 	struct emad_op_tlv op_tlv;
 	struct emad_tlv_head tlv_head;
+	u32 *dev_index;
 
 	if (!is_mlxsw_spectrum(devlink))
 		return 0;
@@ -114,15 +153,18 @@ int BPF_PROG(handle__devlink_hwmsg,
 		return 0;
 
 	switch (bpf_ntohs(op_tlv.reg_id)) {
-	case 0x300F: /* MLXSW_REG_PEFA_ID */
-	case 0x8013: /* MLXSW_REG_RALUE_ID */
-	case 0x3006: /* MLXSW_REG_PTAR_ID */
-	case 0x3027: /* MLXSW_REG_PTCE3_ID */
-	case 0x3804: /* MLXSW_REG_IEDR_ID */
-	case 0x8014: /* MLXSW_REG_RAUHT_ID */
-		return push_to_ringbuf(buf, len);
+	RESMON_REGS(RESMON_REG_EXPAND_AS_CASE)
+		break;
+	default:
+		return 0;
 	};
-	return 0;
+
+	/* Only push EMADs of devlink instances that user space tracks. */
+	dev_index = lookup_dev_index(devlink);
+	if (!dev_index)
+		return 0;
+
+	return push_to_ringbuf(*dev_index, ktime_ns, buf, len);
 
 }
 
@@ -1,7 +1,6 @@
 // SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0
 #define _GNU_SOURCE
 #include <argp.h>
-#include <stdarg.h>
 #include <stdio.h>
 
 #include "resmon.h"
@@ -19,7 +18,10 @@ static int resmon_help(void)
 	     "Usage: resmon [OPTIONS] { COMMAND | help }\n"
 	     "where  OPTIONS := [ -h | --help | -q | --quiet | -v | --verbose |\n"
 	     "			  -V | --version | --sockdir <DIR> ]\n"
-	     "	     COMMAND := { start | stop | ping | emad | stats }\n"
+	     "	     COMMAND := { start | stop | ping | emad | emads | stats | regs |\n"
+	     "			  acl | lpm | churn | bursts | plan | kvdl |\n"
+	     "			  health | errors | recon | ages | top | replay |\n"
+	     "			  load }\n"
 	     );
 	return 0;
 }
@@ -40,9 +42,54 @@ static int resmon_cmd(int argc, char **argv)
 	} else if (strcmp(*argv, "emad") == 0) {
 		NEXT_ARG_FWD();
 		return resmon_c_emad(argc, argv);
+	} else if (strcmp(*argv, "emads") == 0) {
+		NEXT_ARG_FWD();
+		return resmon_c_emads(argc, argv);
 	} else if (strcmp(*argv, "stats") == 0) {
 		NEXT_ARG_FWD();
 		return resmon_c_stats(argc, argv);
+	} else if (strcmp(*argv, "regs") == 0) {
+		NEXT_ARG_FWD();
+		return resmon_c_regs(argc, argv);
+	} else if (strcmp(*argv, "acl") == 0) {
+		NEXT_ARG_FWD();
+		return resmon_c_acl(argc, argv);
+	} else if (strcmp(*argv, "lpm") == 0) {
+		NEXT_ARG_FWD();
+		return resmon_c_lpm(argc, argv);
+	} else if (strcmp(*argv, "churn") == 0) {
+		NEXT_ARG_FWD();
+		return resmon_c_churn(argc, argv);
+	} else if (strcmp(*argv, "bursts") == 0) {
+		NEXT_ARG_FWD();
+		return resmon_c_bursts(argc, argv);
+	} else if (strcmp(*argv, "plan") == 0) {
+		NEXT_ARG_FWD();
+		return resmon_c_plan(argc, argv);
+	} else if (strcmp(*argv, "kvdl") == 0) {
+		NEXT_ARG_FWD();
+		return resmon_c_kvdl(argc, argv);
+	} else if (strcmp(*argv, "health") == 0) {
+		NEXT_ARG_FWD();
+		return resmon_c_health(argc, argv);
+	} else if (strcmp(*argv, "errors") == 0) {
+		NEXT_ARG_FWD();
+		return resmon_c_errors(argc, argv);
+	} else if (strcmp(*argv, "recon") == 0) {
+		NEXT_ARG_FWD();
+		return resmon_c_recon(argc, argv);
+	} else if (strcmp(*argv, "ages") == 0) {
+		NEXT_ARG_FWD();
+		return resmon_c_ages(argc, argv);
+	} else if (strcmp(*argv, "top") == 0) {
+		NEXT_ARG_FWD();
+		return resmon_c_top(argc, argv);
+	} else if (strcmp(*argv, "replay") == 0) {
+		NEXT_ARG_FWD();
+		return resmon_d_replay(argc, argv);
+	} else if (strcmp(*argv, "load") == 0) {
+		NEXT_ARG_FWD();
+		return resmon_load(argc, argv);
 	}
 
 	fprintf(stderr, "Unknown command \"%s\"\n", *argv);
@@ -96,18 +143,3 @@ int main(int argc, char **argv)
 
 	return resmon_cmd(argc, argv);
 }
-
-__attribute__((format(printf, 2, 3)))
-int resmon_fmterr(char **strp, const char *fmt, ...)
-{
-	va_list ap;
-	int rc;
-
-	va_start(ap, fmt);
-	rc = vasprintf(strp, fmt, ap);
-	va_end(ap);
-
-	if (rc < 0)
-		*strp = NULL;
-	return rc;
-}
@@ -3,11 +3,15 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/un.h>
+#include <linux/types.h>
 #include <json-c/json_object.h>
 
+#include "libresmon.h"
 #include "mlxsw.h"
+#include "resmon-bpf.h"
 
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof(*(x)))
 
@@ -24,6 +28,12 @@
 		      "pointer type mismatch in container_of()");	\
 	((type *)(__mptr - offsetof(type, member))); })
 
+/* Fragmentation of KVD linear is tracked for the first 2^20 slots. */
+#define RESMON_STAT_KVDL_MAX_SIZE	(1U << 20)
+
+/* PTAR lists up to 16 flexible key blocks of a region. */
+#define RESMON_REG_PTAR_KEY_BLOCK_COUNT	16
+
 /* resmon.c */
 
 extern struct resmon_env {
@@ -31,15 +41,14 @@ extern struct resmon_env {
 	int verbosity;
 } env;
 
-int resmon_fmterr(char **strp, const char *fmt, ...)
-    __attribute__((format(printf, 2, 3)));
-
 /* resmon-sock.c */
 
 struct resmon_sock {
 	int fd;
 	struct sockaddr_un sa;
 	socklen_t len;
+	/* Descriptor passed along with the last message received. */
+	int msg_fd;
 };
 
 int resmon_sock_open_d(struct resmon_sock *ctl, const char *sockdir);
@@ -52,9 +61,14 @@ void resmon_sock_close_c(struct resmon_sock *cli);
 int resmon_sock_recv(struct resmon_sock *sock,
 		     struct resmon_sock *peer,
 		     char **bufp);
+int resmon_sock_send_fd(struct resmon_sock *sock, const char *buf,
+			size_t len, int fd);
 
 /* resmon-jrpc.c */
 
+int resmon_fmterr(char **strp, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
 enum resmon_jrpc_e {
 	resmon_jrpc_e_capacity = -1,
 	resmon_jrpc_e_reg_process_emad = -2,
@@ -71,6 +85,13 @@ int resmon_jrpc_object_add_str(struct json_object *obj,
 			       const char *key, const char *str);
 int resmon_jrpc_object_add_bool(struct json_object *obj,
 				const char *key, bool val);
+int resmon_jrpc_object_add_double(struct json_object *obj,
+				  const char *key, double val);
+int resmon_jrpc_object_add_hex(struct json_object *obj, const char *key,
+			       const uint8_t *buf, size_t len);
+int resmon_jrpc_object_add_int_array(struct json_object *obj,
+				     const char *key,
+				     const uint64_t *vals, size_t num_vals);
 
 struct json_object *resmon_jrpc_new_object(struct json_object *id);
 struct json_object *resmon_jrpc_new_request(int id, const char *method);
@@ -106,18 +127,122 @@ int resmon_jrpc_dissect_params_empty(struct json_object *obj,
 int resmon_jrpc_dissect_params_emad(struct json_object *obj,
 				    const char **payload,
 				    size_t *payload_len,
+				    const char **device,
+				    int64_t *time_ns,
 				    char **error);
-
-struct resmon_jrpc_counter {
-	const char *descr;
-	int64_t value;
-	uint64_t capacity;
+enum resmon_jrpc_encoding {
+	RESMON_JRPC_ENCODING_BASE64,
+	RESMON_JRPC_ENCODING_HEX,
 };
+int resmon_jrpc_dissect_params_emads(struct json_object *obj,
+				     const char **device,
+				     struct json_object **emads,
+				     enum resmon_jrpc_encoding *encoding,
+				     char **error);
+int resmon_jrpc_dissect_params_device(struct json_object *obj,
+				     const char **device,
+				     char **error);
+int resmon_jrpc_dissect_params_stats(struct json_object *obj,
+				     const char **device,
+				     bool *forecast,
+				     char **error);
+int resmon_jrpc_dissect_params_churn(struct json_object *obj,
+				     const char **device,
+				     int64_t *top,
+				     char **error);
+int resmon_jrpc_dissect_params_recon(struct json_object *obj,
+				     const char **device,
+				     bool *check,
+				     char **error);
+int resmon_jrpc_dissect_params_ages(struct json_object *obj,
+				    const char **device,
+				    const char **table,
+				    int64_t *top,
+				    bool *by_idle,
+				    char **error);
+int resmon_jrpc_dissect_params_occupancy(struct json_object *obj,
+					 const char **device,
+					 const char **resource,
+					 int64_t *occupancy,
+					 char **error);
+
 int resmon_jrpc_dissect_stats(struct json_object *obj,
 			      struct resmon_jrpc_counter **counters,
 			      size_t *num_counters,
 			      char **error);
 
+int resmon_jrpc_dissect_regs(struct json_object *obj,
+			     struct resmon_jrpc_reg **regs,
+			     size_t *num_regs,
+			     int64_t *unknown,
+			     char **error);
+
+int resmon_jrpc_dissect_acl(struct json_object *obj,
+			    struct resmon_jrpc_acl_region **regions,
+			    size_t *num_regions,
+			    char **error);
+
+int resmon_jrpc_dissect_lpm(struct json_object *obj,
+			    struct resmon_jrpc_lpm_vr **vrs,
+			    size_t *num_vrs,
+			    char **error);
+
+int resmon_jrpc_dissect_churn(struct json_object *obj,
+			      struct resmon_jrpc_churn **regs,
+			      size_t *num_regs,
+			      struct resmon_jrpc_churn **tables,
+			      size_t *num_tables,
+			      struct resmon_jrpc_churn_key **keys,
+			      size_t *num_keys,
+			      char **error);
+
+int resmon_jrpc_dissect_bursts(struct json_object *obj,
+			       struct resmon_jrpc_burst **bursts,
+			       size_t *num_bursts,
+			       char **error);
+
+int resmon_jrpc_dissect_params_plan(struct json_object *obj,
+				    const char **device,
+				    struct resmon_jrpc_plan_item **items,
+				    size_t *num_items,
+				    char **error);
+
+int resmon_jrpc_dissect_plan(struct json_object *obj,
+			     struct resmon_jrpc_plan *plan,
+			     char **error);
+
+int resmon_jrpc_dissect_kvdl(struct json_object *obj,
+			     struct resmon_jrpc_kvdl **devs,
+			     size_t *num_devs,
+			     char **error);
+
+int resmon_jrpc_dissect_health(struct json_object *obj,
+			       struct resmon_jrpc_health *health,
+			       char **error);
+
+int resmon_jrpc_dissect_errors(struct json_object *obj,
+			       struct resmon_jrpc_errors *errors,
+			       char **error);
+
+int resmon_jrpc_dissect_recon(struct json_object *obj,
+			      struct resmon_jrpc_recon *recon,
+			      char **error);
+
+int resmon_jrpc_dissect_ages(struct json_object *obj,
+			     struct resmon_jrpc_ages *ages,
+			     char **error);
+
+int resmon_jrpc_dissect_emads(struct json_object *obj,
+			      struct resmon_jrpc_emads *emads,
+			      char **error);
+
+int resmon_jrpc_decode_hex(uint8_t *dec, const char *enc, size_t enc_len);
+int resmon_jrpc_decode_base64(uint8_t *dec, size_t *dec_len,
+			      const char *enc, size_t enc_len);
+
+int resmon_jrpc_send(struct resmon_sock *sock, struct json_object *obj);
+int resmon_jrpc_send_fd(struct resmon_sock *sock, struct json_object *obj,
+			int fd);
 int resmon_jrpc_send(struct resmon_sock *sock, struct json_object *obj);
 
 /* resmon-c.c */
@@ -125,7 +250,38 @@ int resmon_jrpc_send(struct resmon_sock *sock, struct json_object *obj);
 int resmon_c_ping(int argc, char **argv);
 int resmon_c_stop(int argc, char **argv);
 int resmon_c_emad(int argc, char **argv);
+int resmon_c_emads(int argc, char **argv);
 int resmon_c_stats(int argc, char **argv);
+int resmon_c_regs(int argc, char **argv);
+int resmon_c_acl(int argc, char **argv);
+int resmon_c_lpm(int argc, char **argv);
+int resmon_c_churn(int argc, char **argv);
+int resmon_c_bursts(int argc, char **argv);
+int resmon_c_plan(int argc, char **argv);
+int resmon_c_kvdl(int argc, char **argv);
+int resmon_c_health(int argc, char **argv);
+int resmon_c_errors(int argc, char **argv);
+int resmon_c_recon(int argc, char **argv);
+int resmon_c_ages(int argc, char **argv);
+int resmon_c_top(int argc, char **argv);
+
+/* resmon-gen.c */
+
+/* Room for the longest EMAD that the functions below generate. */
+#define RESMON_GEN_EMAD_MAX_LEN		0x400
+
+size_t resmon_gen_ralue(uint8_t *buf, bool ipv6, uint32_t i, bool delete);
+size_t resmon_gen_rauht(uint8_t *buf, uint32_t i, bool delete);
+size_t resmon_gen_ptar(uint8_t *buf, uint32_t region, uint16_t size,
+		       bool release);
+size_t resmon_gen_ptce3(uint8_t *buf, uint32_t region, uint32_t rule,
+			bool valid);
+size_t resmon_gen_pefa(uint8_t *buf, uint32_t index);
+size_t resmon_gen_iedr(uint8_t *buf, uint32_t index);
+
+/* resmon-load.c */
+
+int resmon_load(int argc, char **argv);
 
 /* resmon-stat.c */
 
@@ -138,8 +294,10 @@ int resmon_c_stats(int argc, char **argv);
 	X(LPM_IPV6, "IPv6 LPM") \
 	X(ATCAM, "ATCAM") \
 	X(ACTSET, "ACL Action Set") \
+	X(ADJ, "Adjacency") \
 	X(HOSTTAB_IPV4, "IPv4 Host Table") \
-	X(HOSTTAB_IPV6, "IPv6 Host Table")
+	X(HOSTTAB_IPV6, "IPv6 Host Table") \
+	X(FDB, "FDB")
 
 enum resmon_counter {
 	RESMON_COUNTERS(RESMON_COUNTER_EXPAND_AS_ENUM)
@@ -147,6 +305,63 @@ enum resmon_counter {
 
 enum { resmon_counter_count = 0 RESMON_COUNTERS(EXPAND_AS_PLUS1) };
 
+#define RESMON_REG_EXPAND_AS_ENUM(NAME, name, ID) \
+	RESMON_REG_ ## NAME,
+
+enum resmon_reg {
+	RESMON_REGS(RESMON_REG_EXPAND_AS_ENUM)
+};
+
+enum { resmon_reg_count = 0 RESMON_REGS(EXPAND_AS_PLUS1) };
+
+/* Tables of entries that resmon tracks on behalf of the registers.
+ *
+ * X(NAME, name)
+ */
+#define RESMON_STAT_TABLES(X) \
+	X(RALUE, ralue) \
+	X(PTCE3, ptce3) \
+	X(KVDL, kvdl) \
+	X(RAUHT, rauht) \
+	X(FDB, fdb)
+
+#define RESMON_STAT_TABLE_EXPAND_AS_ENUM(NAME, name) \
+	RESMON_STAT_TABLE_ ## NAME,
+
+enum resmon_stat_table {
+	RESMON_STAT_TABLES(RESMON_STAT_TABLE_EXPAND_AS_ENUM)
+};
+
+enum { resmon_stat_table_count = 0 RESMON_STAT_TABLES(EXPAND_AS_PLUS1) };
+
+enum resmon_reg_outcome {
+	RESMON_REG_OUTCOME_PROCESSED,
+	RESMON_REG_OUTCOME_IGNORED,
+	RESMON_REG_OUTCOME_ERROR,
+};
+
+/* Classes of EMAD processing errors.
+ *
+ * X(NAME, name, DESCRIPTION)
+ */
+#define RESMON_REG_ERRORS(X) \
+	X(TRUNCATED, truncated, "Payload truncated") \
+	X(MALFORMED, malformed, "Malformed EMAD") \
+	X(UNKNOWN_REG, unknown_reg, "Unknown register") \
+	X(INSERT_FAILED, insert_failed, "Insert failed") \
+	X(DELETE_MISSING, delete_missing, "Delete of a missing key") \
+	X(UNKNOWN_REGION, unknown_region, "Rule in an unknown region") \
+	X(REGION_UNDERFLOW, region_underflow, "Region usage underflow")
+
+#define RESMON_REG_ERROR_EXPAND_AS_ENUM(NAME, name, DESCRIPTION) \
+	RESMON_REG_ERROR_ ## NAME,
+
+enum resmon_reg_error {
+	RESMON_REG_ERRORS(RESMON_REG_ERROR_EXPAND_AS_ENUM)
+};
+
+enum { resmon_reg_error_count = 0 RESMON_REG_ERRORS(EXPAND_AS_PLUS1) };
+
 struct resmon_stat;
 
 struct resmon_stat_counters {
@@ -158,6 +373,10 @@ struct resmon_stat_dip {
 	uint8_t dip[16];
 };
 
+struct resmon_stat_mac {
+	uint8_t mac[6];
+};
+
 struct resmon_stat_tcam_region_info {
 	uint8_t tcam_region_info[16];
 };
@@ -171,9 +390,182 @@ struct resmon_stat_kvd_alloc {
 	enum resmon_counter counter;
 };
 
-struct resmon_stat *resmon_stat_create(void);
+struct resmon_stat_churn_counts {
+	uint64_t adds;
+	uint64_t deletes;
+	/* Writes of entries that were already present. */
+	uint64_t redundant;
+};
+
+struct resmon_stat_churn {
+	struct resmon_stat_churn_counts counts;
+	/* Exponentially weighted moving averages, in events per second. */
+	double add_rate;
+	double delete_rate;
+	double redundant_rate;
+};
+
+struct resmon_stat_hist {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t max;
+	/* Number of values of 2^i to 2^(i+1)-1, with 0 counted in bin 0. */
+	uint64_t bins[RESMON_STAT_HIST_COUNT];
+};
+
+void resmon_stat_hist_record(struct resmon_stat_hist *hist, uint64_t val);
+void resmon_stat_hist_add(struct resmon_stat_hist *sum,
+			  const struct resmon_stat_hist *hist);
+
+struct resmon_stat_reg_stat {
+	uint64_t processed;
+	uint64_t ignored;
+	uint64_t errors;
+	uint64_t time_ns;
+	/* Processing time of the individual EMADs. */
+	struct resmon_stat_hist time_hist;
+	struct resmon_stat_churn churn;
+};
+
+struct resmon_stat_reg_stats {
+	struct resmon_stat_reg_stat regs[resmon_reg_count];
+	/* EMADs that could not be attributed to a known register. */
+	uint64_t unknown;
+};
+
+struct resmon_stat_config {
+	/* EMADs further apart than this belong to different bursts. */
+	uint64_t burst_gap_ns;
+	/* Time only advances through resmon_stat_clock_set(). */
+	bool manual_clock;
+	/* Keep the time of insertion and of the last update of each table
+	 * entry, and the age histograms of the tables.
+	 */
+	bool track_ages;
+};
+
+struct resmon_stat *resmon_stat_create(const struct resmon_stat_config *config);
 void resmon_stat_destroy(struct resmon_stat *stat);
+int resmon_stat_clock_set(struct resmon_stat *stat, uint64_t now_ns);
 struct resmon_stat_counters resmon_stat_counters(struct resmon_stat *stat);
+void resmon_stat_counters_rebase(struct resmon_stat *stat, int64_t offset);
+
+struct resmon_stat_trend {
+	/* Exponentially weighted slope, in entries per second. */
+	double ew_slope;
+	/* Least-squares slope over the last samples, in entries per second. */
+	double window_slope;
+};
+
+struct resmon_stat_forecast {
+	struct resmon_stat_trend values[resmon_counter_count];
+	struct resmon_stat_trend total;
+};
+
+struct resmon_stat_forecast resmon_stat_forecast(struct resmon_stat *stat);
+
+void resmon_stat_reg_account(struct resmon_stat *stat, enum resmon_reg reg,
+			     enum resmon_reg_outcome outcome,
+			     uint64_t time_ns);
+void resmon_stat_reg_account_unknown(struct resmon_stat *stat);
+struct resmon_stat_reg_stats resmon_stat_reg_stats(struct resmon_stat *stat);
+
+/* Each error class keeps a ring of recent offending EMADs. The first
+ * RESMON_STAT_ERROR_RING_SIZE errors of a class are all kept, after that
+ * one in RESMON_STAT_ERROR_SAMPLE_RATE. Only the start of long EMADs is
+ * kept.
+ */
+#define RESMON_STAT_ERROR_RING_SIZE	8
+#define RESMON_STAT_ERROR_SAMPLE_RATE	64
+#define RESMON_STAT_ERROR_EMAD_LEN	512
+#define RESMON_STAT_ERROR_MESSAGE_LEN	128
+
+struct resmon_stat_error_sample {
+	/* CLOCK_MONOTONIC time of the error. */
+	uint64_t time_ns;
+	size_t len;
+	size_t kept_len;
+	uint8_t emad[RESMON_STAT_ERROR_EMAD_LEN];
+	char message[RESMON_STAT_ERROR_MESSAGE_LEN];
+};
+
+struct resmon_stat_error_stats {
+	uint64_t counts[resmon_reg_error_count];
+};
+
+void resmon_stat_error_account(struct resmon_stat *stat,
+			       enum resmon_reg_error error,
+			       const uint8_t *emad, size_t len,
+			       const char *message);
+struct resmon_stat_error_stats resmon_stat_error_stats(struct resmon_stat *stat);
+int resmon_stat_error_sample_foreach(struct resmon_stat *stat,
+		int (*cb)(enum resmon_reg_error error,
+			  const struct resmon_stat_error_sample *sample,
+			  void *priv),
+		void *priv);
+
+struct resmon_stat_burst {
+	/* CLOCK_MONOTONIC time of the first EMAD of the burst. */
+	uint64_t start_ns;
+	uint64_t duration_ns;
+	uint64_t emads;
+	uint64_t reg_emads[resmon_reg_count];
+	/* Peak EMADs per second. */
+	uint64_t peak_rate;
+	bool ongoing;
+};
+
+int resmon_stat_burst_foreach(struct resmon_stat *stat,
+			      int (*cb)(const struct resmon_stat_burst *,
+					void *priv),
+			      void *priv);
+
+void resmon_stat_churn_add(struct resmon_stat_churn *sum,
+			   const struct resmon_stat_churn *churn);
+const char *resmon_stat_table_name(enum resmon_stat_table table);
+int resmon_stat_table_parse(const char *name, enum resmon_stat_table *table);
+struct resmon_stat_churn resmon_stat_table_churn(struct resmon_stat *stat,
+						 enum resmon_stat_table table);
+
+struct resmon_stat_redundant_key {
+	enum resmon_stat_table table;
+	const void *key;
+	size_t key_size;
+	uint64_t redundant;
+};
+
+size_t resmon_stat_redundant_top(struct resmon_stat *stat,
+				 struct resmon_stat_redundant_key *top,
+				 size_t max_keys);
+
+/* Bin i counts the entries at most resmon_stat_age_max_s[i] seconds old
+ * that are not in an earlier bin, the last bin the rest.
+ */
+extern const uint64_t resmon_stat_age_max_s[RESMON_STAT_AGE_BIN_COUNT - 1];
+
+struct resmon_stat_ages {
+	uint64_t entries;
+	uint64_t counts[RESMON_STAT_AGE_BIN_COUNT];
+};
+
+bool resmon_stat_ages_tracked(const struct resmon_stat *stat);
+struct resmon_stat_ages resmon_stat_table_ages(struct resmon_stat *stat,
+					       enum resmon_stat_table table);
+
+struct resmon_stat_aged_key {
+	enum resmon_stat_table table;
+	const void *key;
+	size_t key_size;
+	/* Seconds since the insertion and since the last update. */
+	uint64_t age_s;
+	uint64_t idle_s;
+	uint64_t redundant;
+};
+
+size_t resmon_stat_oldest(struct resmon_stat *stat,
+			  enum resmon_stat_table table, bool by_idle,
+			  struct resmon_stat_aged_key *oldest,
+			  size_t num_keys, size_t max_keys);
 
 int resmon_stat_ralue_update(struct resmon_stat *stat,
 			     enum mlxsw_reg_ralxx_protocol protocol,
@@ -187,15 +579,55 @@ int resmon_stat_ralue_delete(struct resmon_stat *stat,
 			     uint16_t virtual_router,
 			     struct resmon_stat_dip dip);
 
+struct resmon_stat_lpm_vr {
+	enum mlxsw_reg_ralxx_protocol protocol;
+	uint16_t virtual_router;
+	uint64_t routes;
+	/* Number of routes per prefix length. */
+	uint64_t prefix_lens[RESMON_STAT_PREFIX_LEN_COUNT];
+};
+
+int resmon_stat_lpm_foreach(struct resmon_stat *stat,
+			    int (*cb)(const struct resmon_stat_lpm_vr *,
+				      void *priv),
+			    void *priv);
+
+struct resmon_stat_ptar_region {
+	struct resmon_stat_tcam_region_info tcam_region_info;
+	struct resmon_stat_kvd_alloc kvd_alloc;
+	uint16_t region_id;
+	uint16_t size;
+	uint64_t used;
+	uint64_t resizes;
+	/* Number of rules per eRP ID. */
+	uint64_t erps[RESMON_STAT_ERP_COUNT];
+	/* Number of rules per delta width, i.e. bits set in delta_mask. */
+	uint64_t deltas[RESMON_STAT_DELTA_WIDTH_COUNT];
+};
+
 int resmon_stat_ptar_alloc(struct resmon_stat *stat,
 			   struct resmon_stat_tcam_region_info region_info,
+			   uint16_t region_id,
+			   uint16_t region_size,
 			   struct resmon_stat_kvd_alloc kvda);
+int resmon_stat_ptar_resize(struct resmon_stat *stat,
+			    struct resmon_stat_tcam_region_info region_info,
+			    uint16_t region_size);
 int resmon_stat_ptar_free(struct resmon_stat *stat,
 			  struct resmon_stat_tcam_region_info region_info);
 int resmon_stat_ptar_get(struct resmon_stat *stat,
 			 struct resmon_stat_tcam_region_info region_info,
 			 struct resmon_stat_kvd_alloc *ret_kvd_alloc);
-
+int resmon_stat_ptar_foreach(struct resmon_stat *stat,
+			     int (*cb)(const struct resmon_stat_ptar_region *,
+				       void *priv),
+			     void *priv);
+
+/* Rules are rejected with -EINVAL for an eRP ID out of range, and with
+ * -ENOENT for a region that is not known. A rule that is freed from an
+ * unknown region, or from one whose usage would underflow, is deleted,
+ * and -ENOENT or -ERANGE is returned to report it.
+ */
 int resmon_stat_ptce3_alloc(struct resmon_stat *stat,
 			struct resmon_stat_tcam_region_info tcam_region_info,
 			const struct resmon_stat_flex2_key_blocks *key_blocks,
@@ -219,6 +651,21 @@ int resmon_stat_kvdl_free(struct resmon_stat *stat,
 			  uint32_t index,
 			  struct resmon_stat_kvd_alloc kvd_alloc);
 
+struct resmon_stat_kvdl_frag {
+	/* Slots tracked. Unless the size of KVD linear is known, the space
+	 * ends with the highest slot in use.
+	 */
+	uint64_t size;
+	uint64_t used;
+	uint64_t largest_free_run;
+	uint64_t free_runs;
+	/* Number of free runs of 2^i to 2^(i+1)-1 slots. */
+	uint64_t run_hist[RESMON_STAT_KVDL_RUN_HIST_COUNT];
+};
+
+int resmon_stat_kvdl_size_set(struct resmon_stat *stat, uint64_t size);
+struct resmon_stat_kvdl_frag resmon_stat_kvdl_frag(struct resmon_stat *stat);
+
 int resmon_stat_rauht_update(struct resmon_stat *stat,
 			     enum mlxsw_reg_ralxx_protocol protocol,
 			     uint16_t rif,
@@ -228,38 +675,204 @@ int resmon_stat_rauht_delete(struct resmon_stat *stat,
 			     enum mlxsw_reg_ralxx_protocol protocol,
 			     uint16_t rif,
 			     struct resmon_stat_dip dip);
+
+int resmon_stat_fdb_update(struct resmon_stat *stat,
+			   struct resmon_stat_mac mac,
+			   uint16_t fid,
+			   struct resmon_stat_kvd_alloc kvda);
+int resmon_stat_fdb_delete(struct resmon_stat *stat,
+			   struct resmon_stat_mac mac,
+			   uint16_t fid);
 /* resmon-dl.c */
 
-int resmon_dl_get_kvd_size(uint64_t *size, char **error);
+int resmon_dl_get_devs(int (*cb)(const char *bus_name, const char *dev_name,
+				 void *priv),
+		       void *priv, char **error);
+int resmon_dl_get_kvd_size(const char *bus_name, const char *dev_name,
+			   uint64_t *size, char **error);
+int resmon_dl_get_kvdl_size(const char *bus_name, const char *dev_name,
+			    uint64_t *size, char **error);
+int resmon_dl_get_resource_occ(const char *bus_name, const char *dev_name,
+			       const char *resource_name, bool *present,
+			       uint64_t *occ, char **error);
+
+/* resmon-recon.c */
+
+/* Devlink resources whose occupancy resmon reconciles its accounting
+ * against. Which of them have their occupancy reported depends on the ASIC.
+ *
+ * X(NAME, name, DEVLINK_NAME)
+ */
+#define RESMON_RECON_RESOURCES(X) \
+	X(KVD, kvd, "kvd") \
+	X(KVDL, kvdl, "linear")
+
+#define RESMON_RECON_RESOURCE_EXPAND_AS_ENUM(NAME, name, DEVLINK_NAME) \
+	RESMON_RECON_RESOURCE_ ## NAME,
+
+enum resmon_recon_resource {
+	RESMON_RECON_RESOURCES(RESMON_RECON_RESOURCE_EXPAND_AS_ENUM)
+};
+
+enum { resmon_recon_resource_count =
+	0 RESMON_RECON_RESOURCES(EXPAND_AS_PLUS1) };
+
+enum resmon_recon_action {
+	RESMON_RECON_ACTION_FLAG,
+	RESMON_RECON_ACTION_REBASE,
+};
+
+struct resmon_recon_config {
+	/* Time between the checks. Zero disables the periodic checks. */
+	uint64_t interval_ns;
+	/* Drift of more than threshold entries that is seen in persist
+	 * checks in a row is acted upon.
+	 */
+	uint64_t threshold;
+	unsigned int persist;
+	enum resmon_recon_action action;
+};
+
+struct resmon_recon_state {
+	uint64_t checks;
+	/* Failed to get the occupancy. */
+	uint64_t failures;
+	/* The rest is as of the last check. */
+	bool present;
+	uint64_t occupancy;
+	int64_t accounted;
+	/* Accounted minus occupancy. */
+	int64_t drift;
+	/* Checks in a row that saw the drift beyond the threshold. */
+	unsigned int over;
+	bool flagged;
+	uint64_t rebases;
+	/* Sum of the corrections made by the rebases. */
+	int64_t rebase_offset;
+};
+
+struct resmon_recon {
+	struct resmon_recon_config config;
+	int timerfd;
+};
 
 /* resmon-back.c */
 
+struct resmon_dev {
+	char *bus_name;
+	char *dev_name;
+	struct resmon_stat *stat;
+	struct resmon_recon_state recon[resmon_recon_resource_count];
+};
+
+/* How well the back end keeps up with the EMADs. */
+struct resmon_back_health {
+	/* From the tracepoint hit to the EMAD having been processed. Only
+	 * the hw back end knows when the tracepoint was hit.
+	 */
+	struct resmon_stat_hist delay_ns;
+	/* EMADs processed per activity of the back end. */
+	struct resmon_stat_hist batch;
+	/* CPU time spent processing them. */
+	uint64_t cpu_ns;
+	uint64_t start_ns;
+};
+
+/* Token bucket that limits the logging of EMAD processing errors. */
+struct resmon_back_log {
+	double tokens;
+	uint64_t last_ns;
+	uint64_t logged;
+	uint64_t suppressed;
+	/* Suppressed since the last message. */
+	uint64_t unreported;
+};
+
 struct resmon_back {
 	const struct resmon_back_cls *cls;
+	struct resmon_stat_config stat_config;
+	struct resmon_dev *devs;
+	size_t num_devs;
+	struct resmon_back_health health;
+	struct resmon_back_log log;
+	struct resmon_recon recon;
+};
+
+struct resmon_back_args {
+	unsigned int num_devs;
+	struct resmon_stat_config stat_config;
+	struct resmon_recon_config recon_config;
+
+	/* Mock mode. A KVD linear size of 0 leaves it unknown. */
+	uint64_t mock_kvdl_size;
+
+	/* Replay mode. A speed of 0 replays as fast as possible. */
+	const char *replay_file;
+	double replay_speed;
+	uint64_t replay_kvd_size;
 };
 
 struct resmon_back_cls {
-	struct resmon_back *(*init)(void);
+	struct resmon_back *(*init)(const struct resmon_back_args *args);
 	void (*fini)(struct resmon_back *back);
 
-	int (*get_capacity)(struct resmon_back *back, uint64_t *capacity,
-			    char **error);
+	int (*get_capacity)(struct resmon_back *back,
+			    const struct resmon_dev *dev,
+			    uint64_t *capacity, char **error);
+	/* Optional. Back ends without it are not reconciled. */
+	int (*get_occupancy)(struct resmon_back *back,
+			     const struct resmon_dev *dev,
+			     enum resmon_recon_resource resource,
+			     bool *present, uint64_t *occupancy,
+			     char **error);
 	bool (*handle_method)(struct resmon_back *back,
-			      struct resmon_stat *stat,
 			      const char *method,
 			      struct resmon_sock *peer,
 			      struct json_object *params_obj,
 			      struct json_object *id);
 	int (*pollfd)(struct resmon_back *back);
-	int (*activity)(struct resmon_back *back, struct resmon_stat *stat);
+	int (*activity)(struct resmon_back *back);
 };
 
+int resmon_back_add_dev(struct resmon_back *back,
+			const char *bus_name, const char *dev_name);
+void resmon_back_fini_devs(struct resmon_back *back);
+struct resmon_dev *resmon_back_find_dev(struct resmon_back *back,
+					const char *name);
+uint64_t resmon_back_clock_ns(clockid_t clk);
+
+struct resmon_back_replay_stats {
+	uint64_t frames;	/* Read from the capture. */
+	uint64_t emads;		/* Passed to the register decoder. */
+	uint64_t errors;	/* Of those, failed to process. */
+	uint64_t bytes;
+	uint64_t elapsed_ns;
+	bool done;
+};
+
+const struct resmon_back_replay_stats *
+resmon_back_replay_stats(struct resmon_back *back);
+
 extern const struct resmon_back_cls resmon_back_cls_hw;
 extern const struct resmon_back_cls resmon_back_cls_mock;
+extern const struct resmon_back_cls resmon_back_cls_replay;
+
+int resmon_recon_init(struct resmon_back *back,
+		      const struct resmon_recon_config *config);
+void resmon_recon_fini(struct resmon_back *back);
+int resmon_recon_pollfd(struct resmon_back *back);
+int resmon_recon_activity(struct resmon_back *back);
+void resmon_recon_check(struct resmon_back *back, struct resmon_dev *dev);
+const char *resmon_recon_resource_name(enum resmon_recon_resource resource);
+const char *
+resmon_recon_resource_devlink_name(enum resmon_recon_resource resource);
+int resmon_recon_resource_parse(const char *name,
+				enum resmon_recon_resource *resource);
 
 /* resmon-d.c */
 
 int resmon_d_start(int argc, char **argv);
+int resmon_d_replay(int argc, char **argv);
 
 void resmon_d_respond_error(struct resmon_sock *ctl,
 			    struct json_object *id, int code,
@@ -271,5 +884,14 @@ void resmon_d_respond_memerr(struct resmon_sock *peer, struct json_object *id);
 
 /* resmon-reg.c */
 
+bool resmon_reg_emad_is_tracked(const uint8_t *buf, size_t len);
 int resmon_reg_process_emad(struct resmon_stat *stat,
 			    const uint8_t *buf, size_t len, char **error);
+
+struct resmon_stat_kvd_alloc resmon_reg_ralue_kvd_alloc(bool ipv6,
+							uint8_t prefix_len);
+struct resmon_stat_kvd_alloc resmon_reg_ptar_kvd_alloc(size_t nkeys);
+struct resmon_stat_kvd_alloc resmon_reg_pefa_kvd_alloc(void);
+struct resmon_stat_kvd_alloc resmon_reg_rauht_kvd_alloc(bool ipv6);
+struct resmon_stat_kvd_alloc resmon_reg_ratr_kvd_alloc(void);
+struct resmon_stat_kvd_alloc resmon_reg_sfd_kvd_alloc(void);